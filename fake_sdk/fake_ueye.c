@@ -0,0 +1,869 @@
+/*
+ * Simulated uEye SDK with a single monochrome camera, for building and
+ * testing the module on machines without the SDK or a camera. A thread
+ * fills the sequence buffers at the set frame rate while live video is on.
+ *
+ * Every is_InitCamera hands out a new handle, calls with any other handle
+ * fail with IS_INVALID_CAMERA_HANDLE, and the device cannot be opened again
+ * while a handle to it is still open, as with the real driver.
+ *
+ * The fake_* functions let tests unplug the camera, inject errors and
+ * constrain the settings. They are exported from the extension module and
+ * are reached through ctypes.
+ */
+#include "uEye.h"
+#include "uEye_tools.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+#define FAKE_SERIAL "4102000001"
+#define FAKE_MAX_BUFFERS 512
+/* memIDs handed out by is_SetAllocatedImageMem */
+#define FAKE_USER_MEM_ID 500000
+
+#define CHECK_HANDLE(h) \
+    if ((h) == IS_INVALID_HIDS || (h) != open_handle) \
+    { \
+        return IS_INVALID_CAMERA_HANDLE; \
+    }
+
+static HIDS open_handle = IS_INVALID_HIDS;
+static HIDS next_handle = 1;
+
+static int width = 640;
+static int height = 480;
+static int bitdepth = 8;
+static int color_mode = IS_CM_MONO8;
+static double frame_rate = 200.0;
+static double exposure = 5.0;
+static int gain = 0;
+static UINT pixel_clock = 30;
+static int trigger = 0;
+static int rop = 0;
+static IS_RECT aoi = {0, 0, 640, 480};
+
+/* Sequence buffers, and the queue of filled ones, guarded by lock */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t filled = PTHREAD_COND_INITIALIZER;
+static char * buffers[FAKE_MAX_BUFFERS];
+static int locked[FAKE_MAX_BUFFERS];
+static UEYEIMAGEINFO infos[FAKE_MAX_BUFFERS];
+static int num_buffers;
+static int ready[FAKE_MAX_BUFFERS];
+static int ready_head;
+static int ready_count;
+static uint64_t frame_number;
+
+static volatile int live;
+static pthread_t producer;
+
+/* Test knobs */
+int fake_missing = 0;
+int fake_inits = 0;
+int fake_exit_calls = 0;
+int fake_user_mem = 0;
+int fake_rop_supported = 0;
+int fake_clamp = 0;
+/* Set to make the arrival event unavailable, reconnecting then has to poll */
+int fake_no_arrival_event = 0;
+/* Arrival events handed out by is_WaitEvent */
+int fake_arrivals = 0;
+static volatile int fail_next;
+static volatile int wait_error;
+static volatile int still;
+static double clock_ppm;
+static double clock_offset;
+
+/* Pending arrival of the camera, raised when it is plugged back in */
+static pthread_cond_t arrival = PTHREAD_COND_INITIALIZER;
+static int arrival_enabled;
+static int arrival_pending;
+
+/**
+  * Returns the handle of the open camera, so tests can call the SDK directly
+  */
+HIDS fake_handle(void)
+{
+    return open_handle;
+}
+
+/**
+  * Unplugs the camera (1) or plugs it back in (0)
+  */
+void fake_set_missing(int missing)
+{
+    pthread_mutex_lock(&lock);
+    if (fake_missing && !missing && arrival_enabled)
+    {
+        arrival_pending = 1;
+        pthread_cond_broadcast(&arrival);
+    }
+    fake_missing = missing;
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+  * Makes the next successful is_WaitForNextImage fail with IS_TRANSFER_ERROR
+  */
+void fake_fail_next(void)
+{
+    fail_next = 1;
+}
+
+/**
+  * Makes every is_WaitForNextImage return code until reset with 0
+  */
+void fake_set_wait_error(int code)
+{
+    wait_error = code;
+}
+
+void fake_set_trigger(int mode)
+{
+    trigger = mode;
+}
+
+/**
+  * Skews the device clock by ppm and shifts it by offset nanoseconds
+  */
+void fake_set_clock(double ppm, double offset)
+{
+    clock_ppm = ppm;
+    clock_offset = offset;
+}
+
+/**
+  * Delivers the same image over and over instead of a moving pattern
+  */
+void fake_set_still(int value)
+{
+    still = value;
+}
+
+/**
+  * With fake_clamp set the frame rate is held below ten times the pixel clock
+  * and the exposure below the frame period, like on a real sensor
+  */
+static void apply_limits(void)
+{
+    if (!fake_clamp)
+    {
+        return;
+    }
+    if (frame_rate > pixel_clock * 10.0)
+    {
+        frame_rate = pixel_clock * 10.0;
+    }
+    if (exposure > 1000.0 / frame_rate)
+    {
+        exposure = 1000.0 / frame_rate;
+    }
+}
+
+static void mirror(unsigned char * image)
+{
+    int bytes = bitdepth / 8;
+    size_t line = (size_t)width * bytes;
+    unsigned char * a;
+    unsigned char * b;
+    unsigned char t;
+    int x;
+    int y;
+    int k;
+
+    if (rop & IS_SET_ROP_MIRROR_LEFTRIGHT)
+    {
+        for (y = 0; y < height; y++)
+        {
+            for (x = 0; x < width / 2; x++)
+            {
+                for (k = 0; k < bytes; k++)
+                {
+                    a = image + y * line + x * bytes + k;
+                    b = image + y * line + (width - 1 - x) * bytes + k;
+                    t = *a;
+                    *a = *b;
+                    *b = t;
+                }
+            }
+        }
+    }
+    if (rop & IS_SET_ROP_MIRROR_UPDOWN)
+    {
+        for (y = 0; y < height / 2; y++)
+        {
+            for (x = 0; x < (int)line; x++)
+            {
+                a = image + y * line + x;
+                b = image + (height - 1 - y) * line + x;
+                t = *a;
+                *a = *b;
+                *b = t;
+            }
+        }
+    }
+}
+
+/**
+  * @return A buffer neither locked by the caller nor queued, or -1
+  * @note Called with lock held
+  */
+static int next_free(void)
+{
+    int i;
+    int k;
+    int queued;
+
+    for (i = 0; i < num_buffers; i++)
+    {
+        if (locked[i])
+        {
+            continue;
+        }
+        queued = 0;
+        for (k = 0; k < ready_count; k++)
+        {
+            if (ready[(ready_head + k) % FAKE_MAX_BUFFERS] == i)
+            {
+                queued = 1;
+            }
+        }
+        if (!queued)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+  * Fills the next free buffer with a test pattern and queues it. A frame
+  * without a free buffer is lost, as on the device.
+  */
+static void produce(void)
+{
+    struct timespec now;
+    unsigned char * image;
+    size_t line = (size_t)width * (bitdepth / 8);
+    size_t x;
+    int y;
+    int i;
+
+    pthread_mutex_lock(&lock);
+    i = next_free();
+    if (i >= 0)
+    {
+        image = (unsigned char *)buffers[i];
+        for (y = 0; y < height; y++)
+        {
+            for (x = 0; x < line; x++)
+            {
+                image[y * line + x] = (unsigned char)(x + y + (still ? 0 : frame_number));
+            }
+        }
+        /* Lets tests see which exposure a frame was taken with */
+        image[0] = (unsigned char)exposure;
+        mirror(image);
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        memset(&infos[i], 0, sizeof(UEYEIMAGEINFO));
+        infos[i].u64FrameNumber = frame_number;
+        infos[i].dwImageWidth = width;
+        infos[i].dwImageHeight = height;
+        infos[i].dwImageBuffers = num_buffers;
+        infos[i].u64TimestampDevice = (uint64_t)((((double)now.tv_sec * 1e9 + now.tv_nsec) * (1.0 + clock_ppm * 1e-6) + clock_offset) / 100);
+        infos[i].TimestampSystem.wYear = 2026;
+        infos[i].TimestampSystem.wMonth = 1;
+        infos[i].TimestampSystem.wDay = 1;
+
+        ready[(ready_head + ready_count) % FAKE_MAX_BUFFERS] = i;
+        ready_count++;
+        pthread_cond_broadcast(&filled);
+    }
+    frame_number++;
+    pthread_mutex_unlock(&lock);
+}
+
+static void * producer_main(void * arg)
+{
+    struct timespec period;
+
+    while (live)
+    {
+        period.tv_sec = 0;
+        period.tv_nsec = (long)(1e9 / frame_rate);
+        nanosleep(&period, NULL);
+        if (!trigger)
+        {
+            produce();
+        }
+    }
+    return NULL;
+}
+
+static void live_start(void)
+{
+    if (!live)
+    {
+        live = 1;
+        pthread_create(&producer, NULL, producer_main, NULL);
+    }
+}
+
+static void live_stop(void)
+{
+    if (live)
+    {
+        live = 0;
+        pthread_join(producer, NULL);
+    }
+}
+
+static void sequence_clear(void)
+{
+    pthread_mutex_lock(&lock);
+    num_buffers = 0;
+    ready_count = 0;
+    pthread_mutex_unlock(&lock);
+}
+
+int is_GetError(HIDS h, INT * code, IS_CHAR ** message)
+{
+    *code = -1;
+    *message = "simulated camera";
+    return IS_SUCCESS;
+}
+
+int is_GetNumberOfCameras(INT * count)
+{
+    *count = 1;
+    return IS_SUCCESS;
+}
+
+int is_GetCameraList(UEYE_CAMERA_LIST * list)
+{
+    if (fake_missing)
+    {
+        return IS_NO_SUCCESS;
+    }
+    list->uci[0].dwCameraID = 1;
+    list->uci[0].dwDeviceID = 1;
+    list->uci[0].dwInUse = open_handle != IS_INVALID_HIDS;
+    strcpy(list->uci[0].SerNo, FAKE_SERIAL);
+    strcpy(list->uci[0].Model, "FAKE");
+    return IS_SUCCESS;
+}
+
+/**
+  * Opens the camera under a new handle. Like a replugged device, it comes
+  * back with its default exposure.
+  */
+int is_InitCamera(HIDS * h, HWND window)
+{
+    if (fake_missing)
+    {
+        return IS_CANT_OPEN_DEVICE;
+    }
+    if (open_handle != IS_INVALID_HIDS)
+    {
+        return IS_ALL_DEVICES_BUSY;
+    }
+    fake_inits++;
+    exposure = 5.0;
+    open_handle = next_handle++;
+    *h = open_handle;
+    return IS_SUCCESS;
+}
+
+int is_ExitCamera(HIDS h)
+{
+    fake_exit_calls++;
+    CHECK_HANDLE(h);
+    live_stop();
+    sequence_clear();
+    open_handle = IS_INVALID_HIDS;
+    return IS_SUCCESS;
+}
+
+int is_GetCameraInfo(HIDS h, CAMINFO * info)
+{
+    CHECK_HANDLE(h);
+    memset(info, 0, sizeof(*info));
+    strcpy(info->SerNo, FAKE_SERIAL);
+    strcpy(info->ID, "IDS");
+    return IS_SUCCESS;
+}
+
+int is_GetSensorInfo(HIDS h, SENSORINFO * info)
+{
+    CHECK_HANDLE(h);
+    memset(info, 0, sizeof(*info));
+    info->nMaxWidth = width;
+    info->nMaxHeight = height;
+    info->nColorMode = IS_COLORMODE_MONOCHROME;
+    return IS_SUCCESS;
+}
+
+int is_ParameterSet(HIDS h, UINT command, void * param, UINT size)
+{
+    CHECK_HANDLE(h);
+    return IS_SUCCESS;
+}
+
+int is_AOI(HIDS h, UINT command, void * param, UINT size)
+{
+    CHECK_HANDLE(h);
+    if (command == IS_AOI_IMAGE_GET_AOI)
+    {
+        aoi.s32Width = width;
+        aoi.s32Height = height;
+        *(IS_RECT *)param = aoi;
+    }
+    else
+    {
+        aoi = *(IS_RECT *)param;
+    }
+    return IS_SUCCESS;
+}
+
+int is_GetColorDepth(HIDS h, INT * bits, INT * mode)
+{
+    CHECK_HANDLE(h);
+    *bits = bitdepth;
+    *mode = color_mode;
+    return IS_SUCCESS;
+}
+
+int is_InitImageQueue(HIDS h, INT mode)
+{
+    CHECK_HANDLE(h);
+    return IS_SUCCESS;
+}
+
+int is_ExitImageQueue(HIDS h)
+{
+    CHECK_HANDLE(h);
+    return IS_SUCCESS;
+}
+
+int is_SetHardwareGain(HIDS h, INT master, INT red, INT green, INT blue)
+{
+    CHECK_HANDLE(h);
+    if (master >= 0x8000)
+    {
+        return gain;
+    }
+    if (master != IS_IGNORE_PARAMETER)
+    {
+        gain = master;
+    }
+    return IS_SUCCESS;
+}
+
+int is_SetDisplayMode(HIDS h, INT mode)
+{
+    CHECK_HANDLE(h);
+    return IS_SUCCESS;
+}
+
+int is_SetFrameRate(HIDS h, double fps, double * actual)
+{
+    CHECK_HANDLE(h);
+    if (fps != IS_GET_FRAMERATE)
+    {
+        frame_rate = fps;
+        apply_limits();
+    }
+    *actual = frame_rate;
+    return IS_SUCCESS;
+}
+
+int is_PixelClock(HIDS h, UINT command, void * param, UINT size)
+{
+    CHECK_HANDLE(h);
+    if (command == IS_PIXELCLOCK_CMD_GET)
+    {
+        *(UINT *)param = pixel_clock;
+    }
+    else
+    {
+        pixel_clock = *(UINT *)param;
+        apply_limits();
+    }
+    return IS_SUCCESS;
+}
+
+int is_Exposure(HIDS h, UINT command, void * param, UINT size)
+{
+    CHECK_HANDLE(h);
+    if (command == IS_EXPOSURE_CMD_GET_EXPOSURE)
+    {
+        *(double *)param = exposure;
+    }
+    else
+    {
+        exposure = *(double *)param;
+        apply_limits();
+        *(double *)param = exposure;
+    }
+    return IS_SUCCESS;
+}
+
+int is_AutoParameter(HIDS h, UINT command, void * param, UINT size)
+{
+    CHECK_HANDLE(h);
+    return IS_SUCCESS;
+}
+
+/**
+  * Registers memory the caller allocated. The fake demands the page alignment
+  * the module promises.
+  */
+int is_SetAllocatedImageMem(HIDS h, INT w, INT hgt, INT bits, char * memory, INT * id)
+{
+    CHECK_HANDLE(h);
+    if ((size_t)memory % 4096 != 0)
+    {
+        return IS_NO_SUCCESS;
+    }
+    fake_user_mem++;
+    *id = FAKE_USER_MEM_ID + rand() % 100000;
+    return IS_SUCCESS;
+}
+
+int is_FreeImageMem(HIDS h, char * memory, INT id)
+{
+    CHECK_HANDLE(h);
+    fake_user_mem--;
+    return IS_SUCCESS;
+}
+
+int is_AddToSequence(HIDS h, char * memory, INT id)
+{
+    CHECK_HANDLE(h);
+    pthread_mutex_lock(&lock);
+    buffers[num_buffers] = memory;
+    locked[num_buffers] = 0;
+    num_buffers++;
+    pthread_mutex_unlock(&lock);
+    return IS_SUCCESS;
+}
+
+int is_ClearSequence(HIDS h)
+{
+    CHECK_HANDLE(h);
+    sequence_clear();
+    return IS_SUCCESS;
+}
+
+int is_GetImageMemPitch(HIDS h, INT * pitch)
+{
+    CHECK_HANDLE(h);
+    *pitch = width * ((bitdepth + 7) / 8);
+    return IS_SUCCESS;
+}
+
+int is_WaitForNextImage(HIDS h, UINT timeout, char ** memory, INT * id)
+{
+    struct timespec deadline;
+    struct timespec pause = {0, 10000000L};
+    int i;
+
+    CHECK_HANDLE(h);
+    if (wait_error != 0)
+    {
+        nanosleep(&pause, NULL);
+        return wait_error;
+    }
+
+    pthread_mutex_lock(&lock);
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += (long)timeout * 1000000L;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+    deadline.tv_nsec %= 1000000000L;
+    while (ready_count == 0)
+    {
+        if (pthread_cond_timedwait(&filled, &lock, &deadline) == ETIMEDOUT)
+        {
+            pthread_mutex_unlock(&lock);
+            return IS_TIMED_OUT;
+        }
+    }
+    if (fail_next)
+    {
+        fail_next = 0;
+        pthread_mutex_unlock(&lock);
+        return IS_TRANSFER_ERROR;
+    }
+    i = ready[ready_head];
+    ready_head = (ready_head + 1) % FAKE_MAX_BUFFERS;
+    ready_count--;
+    locked[i] = 1;
+    *memory = buffers[i];
+    *id = i;
+    pthread_mutex_unlock(&lock);
+    return IS_SUCCESS;
+}
+
+int is_UnlockSeqBuf(HIDS h, INT id, char * memory)
+{
+    int i;
+
+    CHECK_HANDLE(h);
+    pthread_mutex_lock(&lock);
+    for (i = 0; i < num_buffers; i++)
+    {
+        if (buffers[i] == memory)
+        {
+            locked[i] = 0;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return IS_SUCCESS;
+}
+
+int is_GetImageInfo(HIDS h, INT id, UEYEIMAGEINFO * info, INT size)
+{
+    CHECK_HANDLE(h);
+    if (id < 0 || id >= num_buffers)
+    {
+        return IS_NO_SUCCESS;
+    }
+    *info = infos[id];
+    return IS_SUCCESS;
+}
+
+int is_CaptureVideo(HIDS h, INT wait)
+{
+    CHECK_HANDLE(h);
+    live_start();
+    return IS_SUCCESS;
+}
+
+int is_StopLiveVideo(HIDS h, INT wait)
+{
+    CHECK_HANDLE(h);
+    live_stop();
+    return IS_SUCCESS;
+}
+
+int is_FreezeVideo(HIDS h, INT wait)
+{
+    CHECK_HANDLE(h);
+    live_start();
+    produce();
+    return IS_SUCCESS;
+}
+
+int is_CaptureStatus(HIDS h, UINT command, void * param, UINT size)
+{
+    CHECK_HANDLE(h);
+    if (command == IS_CAPTURE_STATUS_INFO_CMD_GET)
+    {
+        memset(param, 0, size);
+    }
+    return IS_SUCCESS;
+}
+
+/*
+ * The arrival of a new device is signalled on handle 0, independent of any
+ * open camera
+ */
+#define CHECK_EVENT_HANDLE(h, event) \
+    if ((event) == IS_SET_EVENT_NEW_DEVICE ? (h) != 0 || fake_no_arrival_event : (h) != open_handle || (h) == IS_INVALID_HIDS) \
+    { \
+        return IS_INVALID_CAMERA_HANDLE; \
+    }
+
+int is_EnableEvent(HIDS h, INT event)
+{
+    CHECK_EVENT_HANDLE(h, event);
+    if (event == IS_SET_EVENT_NEW_DEVICE)
+    {
+        pthread_mutex_lock(&lock);
+        arrival_enabled = 1;
+        arrival_pending = 0;
+        pthread_mutex_unlock(&lock);
+    }
+    return IS_SUCCESS;
+}
+
+int is_DisableEvent(HIDS h, INT event)
+{
+    CHECK_EVENT_HANDLE(h, event);
+    if (event == IS_SET_EVENT_NEW_DEVICE)
+    {
+        pthread_mutex_lock(&lock);
+        arrival_enabled = 0;
+        pthread_mutex_unlock(&lock);
+    }
+    return IS_SUCCESS;
+}
+
+int is_InitEvent(HIDS h, HANDLE object, INT event)
+{
+    CHECK_EVENT_HANDLE(h, event);
+    return IS_SUCCESS;
+}
+
+int is_ExitEvent(HIDS h, INT event)
+{
+    CHECK_EVENT_HANDLE(h, event);
+    return IS_SUCCESS;
+}
+
+/**
+  * Simulates the removal event, signalled while the camera is unplugged, and
+  * the arrival event, signalled once when it is plugged back in
+  */
+int is_WaitEvent(HIDS h, INT event, INT timeout)
+{
+    struct timespec pause = {0, 1000000L * (timeout > 100 ? 100 : timeout)};
+    struct timespec deadline;
+    int returnCode = IS_TIMED_OUT;
+
+    CHECK_EVENT_HANDLE(h, event);
+    if (event == IS_SET_EVENT_NEW_DEVICE)
+    {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeout / 1000;
+        deadline.tv_nsec += (long)(timeout % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_mutex_lock(&lock);
+        while (arrival_enabled && !arrival_pending)
+        {
+            if (pthread_cond_timedwait(&arrival, &lock, &deadline) == ETIMEDOUT)
+            {
+                break;
+            }
+        }
+        if (arrival_pending)
+        {
+            arrival_pending = 0;
+            fake_arrivals++;
+            returnCode = IS_SUCCESS;
+        }
+        pthread_mutex_unlock(&lock);
+        return returnCode;
+    }
+    if (event == IS_SET_EVENT_REMOVE && fake_missing)
+    {
+        return IS_SUCCESS;
+    }
+    nanosleep(&pause, NULL);
+    return returnCode;
+}
+
+int is_SetColorMode(HIDS h, INT mode)
+{
+    CHECK_HANDLE(h);
+    if (mode == IS_GET_COLOR_MODE)
+    {
+        return color_mode;
+    }
+    color_mode = mode;
+    switch (mode)
+    {
+    case IS_CM_MONO8:
+    case IS_CM_SENSOR_RAW8:
+        bitdepth = 8;
+        break;
+    case IS_CM_MONO16:
+    case IS_CM_MONO12:
+    case IS_CM_UYVY_PACKED:
+    case IS_CM_CBYCRY_PACKED:
+        bitdepth = 16;
+        break;
+    case IS_CM_BGR8_PACKED:
+    case IS_CM_RGB8_PACKED:
+        bitdepth = 24;
+        break;
+    default:
+        bitdepth = 32;
+        break;
+    }
+    return IS_SUCCESS;
+}
+
+int is_SetExternalTrigger(HIDS h, INT mode)
+{
+    CHECK_HANDLE(h);
+    if (mode == IS_GET_EXTERNALTRIGGER)
+    {
+        return trigger;
+    }
+    trigger = mode;
+    return IS_SUCCESS;
+}
+
+int is_SetRopEffect(HIDS h, INT effect, INT param, INT reserved)
+{
+    CHECK_HANDLE(h);
+    if (effect == IS_GET_ROP_EFFECT)
+    {
+        return rop;
+    }
+    if (effect == IS_GET_SUPPORTED_ROP_EFFECT)
+    {
+        return fake_rop_supported;
+    }
+    rop = param ? (rop | effect) : (rop & ~effect);
+    return IS_SUCCESS;
+}
+
+int is_DeviceFeature(HIDS h, UINT command, void * param, UINT size)
+{
+    CHECK_HANDLE(h);
+    if (command == IS_DEVICE_FEATURE_CMD_GET_TEMPERATURE)
+    {
+        /* 25.0 degrees */
+        *(WORD *)param = 0x0190;
+        return IS_SUCCESS;
+    }
+    return IS_NOT_SUPPORTED;
+}
+
+int is_Sequencer(HIDS h, UINT command, void * param, UINT size)
+{
+    CHECK_HANDLE(h);
+    return IS_NOT_SUPPORTED;
+}
+
+int isavi_InitAVI(INT * id, HIDS h)
+{
+    CHECK_HANDLE(h);
+    *id = 1;
+    return IS_AVI_NO_ERR;
+}
+
+int isavi_ExitAVI(INT id)
+{
+    return IS_AVI_NO_ERR;
+}
+
+int isavi_OpenAVI(INT id, const char * path)
+{
+    return IS_AVI_NO_ERR;
+}
+
+int isavi_StopAVI(INT id)
+{
+    return IS_AVI_NO_ERR;
+}
+
+int isavi_CloseAVI(INT id)
+{
+    return IS_AVI_NO_ERR;
+}
+
+int isavi_SetFrameRate(INT id, double fps)
+{
+    return IS_AVI_NO_ERR;
+}
@@ -0,0 +1,83 @@
+/*
+ * Counts the calls to malloc, calloc and realloc of the whole process, for
+ * tests/bench_allocations.py. Build it as a shared library and preload it:
+ *
+ *     cc -shared -fPIC -o malloc_count.so fake_sdk/malloc_count.c -ldl
+ *     LD_PRELOAD=./malloc_count.so python tests/bench_allocations.py
+ *
+ * malloc_count() returns the number of calls so far and is reached through
+ * ctypes. Linux only.
+ */
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <stddef.h>
+
+static void * (*real_malloc)(size_t);
+static void * (*real_calloc)(size_t, size_t);
+static void * (*real_realloc)(void *, size_t);
+static void (*real_free)(void *);
+static volatile long malloc_calls = 0;
+
+/* dlsym allocates with calloc before real_calloc is known */
+static char bootstrap[4096];
+static size_t bootstrap_used = 0;
+
+long malloc_count(void)
+{
+    return __atomic_load_n(&malloc_calls, __ATOMIC_RELAXED);
+}
+
+void * malloc(size_t size)
+{
+    if (real_malloc == NULL)
+    {
+        real_malloc = (void * (*)(size_t))dlsym(RTLD_NEXT, "malloc");
+    }
+    __atomic_add_fetch(&malloc_calls, 1, __ATOMIC_RELAXED);
+    return real_malloc(size);
+}
+
+void * calloc(size_t count, size_t size)
+{
+    void * memory;
+
+    if (real_calloc == NULL)
+    {
+        if (bootstrap_used + ((count * size + 15) & ~(size_t)15) <= sizeof(bootstrap))
+        {
+            memory = bootstrap + bootstrap_used;
+            bootstrap_used += (count * size + 15) & ~(size_t)15;
+            return memory;
+        }
+        real_calloc = (void * (*)(size_t, size_t))dlsym(RTLD_NEXT, "calloc");
+        if (real_calloc == NULL)
+        {
+            return NULL;
+        }
+    }
+    __atomic_add_fetch(&malloc_calls, 1, __ATOMIC_RELAXED);
+    return real_calloc(count, size);
+}
+
+void * realloc(void * memory, size_t size)
+{
+    if (real_realloc == NULL)
+    {
+        real_realloc = (void * (*)(void *, size_t))dlsym(RTLD_NEXT, "realloc");
+    }
+    __atomic_add_fetch(&malloc_calls, 1, __ATOMIC_RELAXED);
+    return real_realloc(memory, size);
+}
+
+void free(void * memory)
+{
+    if ((char *)memory >= bootstrap && (char *)memory < bootstrap + sizeof(bootstrap))
+    {
+        return;
+    }
+    if (real_free == NULL)
+    {
+        real_free = (void (*)(void *))dlsym(RTLD_NEXT, "free");
+    }
+    real_free(memory);
+}
@@ -0,0 +1,265 @@
+/*
+ * Stand-in for the uEye SDK header, declaring the part of the API the module
+ * uses. Only meant for building against fake_ueye.c: the constants are not
+ * the values of the real SDK.
+ */
+#ifndef FAKE_UEYE_H
+#define FAKE_UEYE_H
+
+#include <stdint.h>
+
+typedef uint32_t DWORD;
+typedef uint32_t HIDS;
+typedef int INT;
+typedef unsigned int UINT;
+typedef unsigned short WORD;
+typedef int BOOL;
+typedef char IS_CHAR;
+typedef void * HWND;
+typedef uint64_t UINT64;
+typedef double IS_DOUBLE;
+typedef void * HANDLE;
+
+typedef struct
+{
+    WORD wYear, wMonth, wDay, wHour, wMinute, wSecond, wMilliseconds;
+} UEYETIME;
+
+typedef struct
+{
+    DWORD dwFlags;
+    uint8_t bySequencerIndex;
+    uint64_t u64TimestampDevice;
+    UEYETIME TimestampSystem;
+    DWORD dwIoStatus;
+    WORD wAOIIndex;
+    WORD wAOICycle;
+    uint64_t u64FrameNumber;
+    DWORD dwImageBuffers;
+    DWORD dwImageBuffersInUse;
+    DWORD dwReserved3;
+    DWORD dwImageHeight;
+    DWORD dwImageWidth;
+    WORD wHostProcessTime;
+} UEYEIMAGEINFO;
+
+typedef struct
+{
+    DWORD dwCameraID, dwDeviceID, dwSensorID, dwInUse;
+    IS_CHAR SerNo[16];
+    IS_CHAR Model[16];
+    DWORD dwStatus;
+} UEYE_CAMERA_INFO;
+
+typedef struct
+{
+    DWORD dwCount;
+    UEYE_CAMERA_INFO uci[1];
+} UEYE_CAMERA_LIST;
+
+typedef struct
+{
+    char SerNo[12];
+    char ID[20];
+    char Version[10];
+    char Date[12];
+    unsigned char Select;
+    unsigned char Type;
+    char Reserved[8];
+} CAMINFO;
+
+typedef struct
+{
+    WORD SensorID;
+    IS_CHAR strSensorName[32];
+    char nColorMode;
+    DWORD nMaxWidth, nMaxHeight;
+    BOOL bMasterGain, bRGain, bGGain, bBGain, bGlobShutter;
+    WORD wPixelSize;
+    char nUpperLeftBayerPixel;
+} SENSORINFO;
+
+typedef struct
+{
+    INT s32X, s32Y, s32Width, s32Height;
+} IS_RECT;
+
+typedef struct
+{
+    UINT dwCapStatusCnt_Total;
+    unsigned char reserved[60];
+    UINT adwCapStatusCnt_Detail[256];
+} UEYE_CAPTURE_STATUS_INFO;
+
+typedef struct
+{
+    UINT u32PathIndex;
+    UINT u32NextIndex;
+    UINT u32TriggerSource;
+    UINT u32TriggerActivation;
+} IS_SEQUENCER_PATH;
+
+#define IS_INVALID_HIDS 0
+
+#define IS_SUCCESS 0
+#define IS_NO_SUCCESS -1
+#define IS_TIMED_OUT 122
+#define IS_CANT_OPEN_DEVICE 3
+#define IS_INVALID_CAMERA_HANDLE 1
+#define IS_IGNORE_PARAMETER -1
+#define IS_DONT_WAIT 0
+#define IS_WAIT 1
+#define IS_CAMERA_TYPE_UEYE_USB_SE 1
+#define IS_CAMERA_TYPE_UEYE_USB_LE 2
+#define IS_CAMERA_TYPE_UEYE_USB_ML 3
+#define IS_CAMERA_TYPE_UEYE_USB3_CP 4
+#define IS_CAMERA_TYPE_UEYE_USB3_LE 5
+#define IS_CAMERA_TYPE_UEYE_USB3_ML 6
+#define IS_CAMERA_TYPE_UEYE_USB3_XC 7
+#define IS_CAMERA_TYPE_UEYE_ETH_SE 8
+#define IS_CAMERA_TYPE_UEYE_ETH_REP 9
+#define IS_CAMERA_TYPE_UEYE_ETH_CP 10
+#define IS_CAMERA_TYPE_UEYE_ETH_LE 11
+#define IS_CAMERA_TYPE_UEYE_PMC 12
+#define IS_COLORMODE_MONOCHROME 1
+#define IS_COLORMODE_BAYER 2
+#define IS_COLORMODE_CBYCRY 4
+#define IS_COLORMODE_JPEG 8
+#define BAYER_PIXEL_RED 0
+#define BAYER_PIXEL_GREEN 1
+#define BAYER_PIXEL_BLUE 2
+#define IS_PARAMETERSET_CMD_SAVE_FILE 1
+#define IS_PARAMETERSET_CMD_LOAD_FILE 2
+#define IS_AOI_IMAGE_GET_AOI 1
+#define IS_AOI_IMAGE_SET_AOI 2
+#define IS_CM_MONO8 6
+#define IS_CM_MONO16 28
+#define IS_CM_MONO12 26
+#define IS_CM_MONO10 34
+#define IS_CM_SENSOR_RAW8 11
+#define IS_CM_BGR8_PACKED 1
+#define IS_CM_RGB8_PACKED 129
+#define IS_CM_BGRA8_PACKED 0
+#define IS_CM_RGBA8_PACKED 128
+#define IS_CM_CBYCRY_PACKED 23
+#define IS_CM_UYVY_PACKED 12
+#define IS_SET_DM_DIB 1
+#define IS_GET_DISPLAY_MODE 0x8000
+#define IS_SET_ENABLE_AUTO_GAIN 0x8800
+#define IS_GET_DEFAULT_MASTER 0x8000
+#define IS_GET_DEFAULT_RED 0x8001
+#define IS_GET_DEFAULT_GREEN 0x8002
+#define IS_GET_DEFAULT_BLUE 0x8003
+#define IS_GET_MASTER_GAIN 0x8000
+#define IS_GET_RED_GAIN 0x8001
+#define IS_GET_GREEN_GAIN 0x8002
+#define IS_GET_BLUE_GAIN 0x8003
+#define IS_GET_FRAMERATE 0x8000
+#define IS_PIXELCLOCK_CMD_SET 6
+#define IS_PIXELCLOCK_CMD_GET 5
+#define IS_EXPOSURE_CMD_SET_EXPOSURE 12
+#define IS_EXPOSURE_CMD_GET_EXPOSURE 7
+#define IS_AWB_CMD_SET_TYPE 1
+#define IS_AWB_CMD_GET_TYPE 2
+#define IS_SET_EVENT_FRAME 2
+#define IS_SET_EVENT_REMOVE 8
+#define IS_SET_EVENT_REMOVAL 19
+#define IS_SET_EVENT_NEW_DEVICE 20
+#define IS_SET_EVENT_DEVICE_RECONNECTED 50
+#define IS_SET_EVENT_CAPTURE_STATUS 63
+#define IS_CAPTURE_STATUS_INFO_CMD_GET 2
+#define IS_CAPTURE_STATUS_INFO_CMD_RESET 1
+#define IS_CAP_STATUS_API_NO_DEST_MEM 0xa2
+#define IS_CAP_STATUS_API_CONVERSION_FAILED 0xa3
+#define IS_CAP_STATUS_API_IMAGE_LOCKED 0xa5
+#define IS_CAP_STATUS_DRV_OUT_OF_BUFFERS 0xb2
+#define IS_CAP_STATUS_DRV_DEVICE_NOT_READY 0xb4
+#define IS_CAP_STATUS_USB_TRANSFER_FAILED 0xc7
+#define IS_CAP_STATUS_DEV_MISSED_IMAGES 0xe5
+#define IS_CAP_STATUS_DEV_TIMEOUT 0xd6
+#define IS_CAP_STATUS_DEV_FRAME_CAPTURE_FAILED 0xd9
+#define IS_CAP_STATUS_ETH_BUFFER_OVERRUN 0xe4
+#define IS_CAP_STATUS_ETH_MISSED_IMAGES 0xe5
+#define IS_TRANSFER_ERROR 130
+#define IS_NO_ACTIVE_IMG_MEM 108
+#define IS_CAPTURE_RUNNING 140
+#define IS_DEVICE_ALREADY_PAIRED 197
+#define IS_OUT_OF_MEMORY 2
+#define IS_INVALID_PARAMETER 125
+#define IS_NOT_SUPPORTED 155
+#define IS_BAD_STRUCTURE_SIZE 115
+#define IS_NOT_CALIBRATED 222
+#define IS_NO_USB20 213
+#define IS_ALL_DEVICES_BUSY 129
+#define IS_DEVICE_NOT_FOUND 0
+#define IS_USE_DEVICE_ID 0x8000
+#define IS_SET_TRIGGER_OFF 0
+#define IS_SET_TRIGGER_SOFTWARE 0x1000
+#define IS_GET_EXTERNALTRIGGER 0x8000
+#define IS_SET_ROP_MIRROR_UPDOWN 8
+#define IS_SET_ROP_MIRROR_LEFTRIGHT 0x20
+#define IS_GET_ROP_EFFECT 0x8000
+#define IS_GET_SUPPORTED_ROP_EFFECT 0x8001
+#define IS_GET_COLOR_MODE 0x8000
+#define IS_DEVICE_FEATURE_CMD_GET_TEMPERATURE 0x40000
+#define IS_SEQUENCER_MODE_ENABLED_SET 1
+#define IS_SEQUENCER_MODE_ENABLED_GET 2
+#define IS_SEQUENCER_CONFIGURATION_ENABLED_SET 5
+#define IS_SEQUENCER_SET_SELECTED_SET 11
+#define IS_SEQUENCER_PATH_SET_SELECTED_SET 30
+#define IS_SEQUENCER_TRIGGER_SOURCE_SET 20
+#define IS_SEQUENCER_FEATURE_SELECTED_SET 25
+#define IS_SEQUENCER_FEATURE_VALUE_SET 24
+#define IS_SEQUENCER_SET_SAVE 13
+#define IS_SEQUENCER_SET_PATH_SET 26
+#define IS_SEQUENCER_SET_START_SET 15
+#define IS_SEQUENCER_FEATURE_SUPPORTED_GET 23
+#define IS_FEATURE_EXPOSURE 1
+#define IS_FEATURE_GAIN 2
+#define IS_TRIGGER_SOURCE_FRAME_START 0x20
+#define IS_TRIGGER_SOURCE_FRAME_END 0x40
+#define IS_TRIGGER_ACTIVATION_RISINGEDGE 1
+#define IS_CONFIG_CPU_IDLE_STATES_CMD_SET_DISABLE_ON_OPEN 1
+
+int is_GetError(HIDS, INT *, IS_CHAR **);
+int is_GetNumberOfCameras(INT *);
+int is_GetCameraList(UEYE_CAMERA_LIST *);
+int is_InitCamera(HIDS *, HWND);
+int is_ExitCamera(HIDS);
+int is_GetCameraInfo(HIDS, CAMINFO *);
+int is_GetSensorInfo(HIDS, SENSORINFO *);
+int is_ParameterSet(HIDS, UINT, void *, UINT);
+int is_AOI(HIDS, UINT, void *, UINT);
+int is_GetColorDepth(HIDS, INT *, INT *);
+int is_InitImageQueue(HIDS, INT);
+int is_ExitImageQueue(HIDS);
+int is_SetHardwareGain(HIDS, INT, INT, INT, INT);
+int is_SetDisplayMode(HIDS, INT);
+int is_SetFrameRate(HIDS, double, double *);
+int is_PixelClock(HIDS, UINT, void *, UINT);
+int is_Exposure(HIDS, UINT, void *, UINT);
+int is_AutoParameter(HIDS, UINT, void *, UINT);
+int is_FreeImageMem(HIDS, char *, INT);
+int is_ClearSequence(HIDS);
+int is_SetAllocatedImageMem(HIDS, INT, INT, INT, char *, INT *);
+int is_AddToSequence(HIDS, char *, INT);
+int is_WaitForNextImage(HIDS, UINT, char **, INT *);
+int is_UnlockSeqBuf(HIDS, INT, char *);
+int is_GetImageInfo(HIDS, INT, UEYEIMAGEINFO *, INT);
+int is_CaptureVideo(HIDS, INT);
+int is_StopLiveVideo(HIDS, INT);
+int is_FreezeVideo(HIDS, INT);
+int is_CaptureStatus(HIDS, UINT, void *, UINT);
+int is_EnableEvent(HIDS, INT);
+int is_DisableEvent(HIDS, INT);
+int is_InitEvent(HIDS, HANDLE, INT);
+int is_ExitEvent(HIDS, INT);
+int is_WaitEvent(HIDS, INT, INT);
+int is_SetColorMode(HIDS, INT);
+int is_SetExternalTrigger(HIDS, INT);
+int is_SetRopEffect(HIDS, INT, INT, INT);
+int is_DeviceFeature(HIDS, UINT, void *, UINT);
+int is_Sequencer(HIDS, UINT, void *, UINT);
+int is_GetImageMemPitch(HIDS, INT *);
+
+#endif
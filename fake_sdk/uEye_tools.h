@@ -0,0 +1,16 @@
+/*
+ * Stand-in for the uEye AVI tools header, see uEye.h
+ */
+#ifndef FAKE_UEYE_TOOLS_H
+#define FAKE_UEYE_TOOLS_H
+
+#define IS_AVI_NO_ERR 0
+
+int isavi_InitAVI(INT *, HIDS);
+int isavi_ExitAVI(INT);
+int isavi_OpenAVI(INT, const char *);
+int isavi_StopAVI(INT);
+int isavi_CloseAVI(INT);
+int isavi_SetFrameRate(INT, double);
+
+#endif
@@ -4,15 +4,23 @@ import platform
 import os
 import numpy as np
 
-if sys.platform == "win32":
+if os.environ.get('IDS_FAKE_SDK'):
+    # Build against the simulated camera in fake_sdk, for testing without the SDK (POSIX only)
+    args = {
+        'extra_compile_args': ['-std=gnu99', '-pthread'],
+        'define_macros': [('NPY_NO_DEPRECATED_API', 'NPY_1_7_API_VERSION')],
+        'libraries': ['m', 'pthread'],
+        'include_dirs': ['fake_sdk', np.get_include()]
+    }
+elif sys.platform == "win32":
     python_path = os.path.dirname(sys.executable)
     include_dir = python_path + "\\include"
     lib_dir = python_path + "\\libs"
     architecture, op_sys = platform.architecture()
     if architecture == '64bit':
-        libs = ['ueye_api_64', 'ueye_tools_64']
+        libs = ['ueye_api_64', 'ueye_tools_64', 'ws2_32']
     else:
-        libs = ['ueye_api', 'ueye_tools']
+        libs = ['ueye_api', 'ueye_tools', 'ws2_32']
     args = {
         'extra_compile_args': [],
         'define_macros': [('_IDS_EXPORT', None), ('_CRT_SECURE_NO_WARNINGS', None), ('NPY_NO_DEPRECATED_API', 'NPY_1_7_API_VERSION')],
@@ -24,7 +32,9 @@ else:
     # TODO: Support this on Linux systems
     args = {}
 
-args['sources'] = ['src/ids.c', 'src/ids_camera.c', 'src/ids_camera_images.c', 'src/ids_camera_properties.c', 'src/ids_camera_video.c', 'src/utility.c']
+args['sources'] = ['src/ids.c', 'src/ids_blobs.c', 'src/ids_camera.c', 'src/ids_camera_bracket.c', 'src/ids_camera_capture.c', 'src/ids_camera_clock.c', 'src/ids_camera_gate.c', 'src/ids_camera_images.c', 'src/ids_camera_properties.c', 'src/ids_camera_settings.c', 'src/ids_camera_stats.c', 'src/ids_camera_threads.c', 'src/ids_camera_video.c', 'src/ids_convert.c', 'src/ids_edges.c', 'src/ids_frame.c', 'src/ids_frame_stats.c', 'src/ids_hdr.c', 'src/ids_metrics.c', 'src/ids_numa.c', 'src/ids_preview.c', 'src/ids_recorder.c', 'src/ids_socket.c', 'src/ids_stream.c', 'src/ids_thread.c', 'src/ids_timelapse.c', 'src/ids_tiff.c', 'src/ids_trace.c', 'src/ids_transform.c', 'src/ids_undistort.c', 'src/utility.c']
+if os.environ.get('IDS_FAKE_SDK'):
+    args['sources'].append('fake_sdk/fake_ueye.c')
 
 coreExtension = Extension("ids", **args)
 
@@ -1,22 +1,232 @@
 #include <uEye.h>
 #include "ids.h"
+#include <stddef.h>
 
-PyObject * IDSError;
+extern int camera_images_init(void);
+extern int blobs_init(void);
+extern PyObject * ids_metrics_server(PyObject * self, PyObject * args, PyObject * kwds);
+extern PyObject * ids_frame_stats(PyObject * self, PyObject * args, PyObject * kwds);
+extern PyObject * ids_hdr_merge(PyObject * self, PyObject * args, PyObject * kwds);
+extern PyObject * ids_find_blobs(PyObject * self, PyObject * args, PyObject * kwds);
+extern PyObject * ids_blob_benchmark(PyObject * self, PyObject * args, PyObject * kwds);
+extern PyObject * ids_find_edges(PyObject * self, PyObject * args, PyObject * kwds);
+extern PyObject * ids_find_contours(PyObject * self, PyObject * args, PyObject * kwds);
+extern PyObject * ids_edge_benchmark(PyObject * self, PyObject * args, PyObject * kwds);
+extern PyObject * ids_convert_benchmark(PyObject * self, PyObject * args, PyObject * kwds);
+extern PyObject * ids_orientation_benchmark(PyObject * self, PyObject * args, PyObject * kwds);
+extern PyObject * ids_undistort(PyObject * self, PyObject * args, PyObject * kwds);
+extern PyObject * ids_undistort_benchmark(PyObject * self, PyObject * args, PyObject * kwds);
+extern PyObject * ids_read_dump(PyObject * self, PyObject * args);
+extern PyObject * ids_read_tiff(PyObject * self, PyObject * args);
+extern PyObject * ids_numa_benchmark(PyObject * self, PyObject * args, PyObject * kwds);
+extern PyObject * ids_stream_benchmark(PyObject * self, PyObject * args, PyObject * kwds);
+extern PyObject * ids_trace_start(PyObject * self, PyObject * args, PyObject * kwds);
+extern PyObject * ids_trace_stop(PyObject * self);
+extern PyObject * ids_trace_dump(PyObject * self, PyObject * args, PyObject * kwds);
+
+/*
+ * SDK return codes with a known meaning. These are raised without asking
+ * the SDK for the error text, every other code falls back to is_GetError.
+ */
+static const struct
+{
+    int          code;
+    /* Offset of the exception in ModuleState */
+    size_t       type;
+    const char * message;
+} known_errors[] = {
+    {IS_TIMED_OUT, offsetof(ModuleState, timeout), "Timed out waiting for an image"},
+    {IS_TRANSFER_ERROR, offsetof(ModuleState, transfer_error), "Image transfer failed"},
+    {IS_INVALID_CAMERA_HANDLE, offsetof(ModuleState, device_lost), "Invalid camera handle, the camera may have been disconnected"},
+    {IS_CANT_OPEN_DEVICE, offsetof(ModuleState, device_lost), "Could not open the camera"},
+    {IS_INVALID_PARAMETER, offsetof(ModuleState, invalid_parameter), "Invalid parameter"},
+    {IS_NOT_SUPPORTED, offsetof(ModuleState, not_supported), "Not supported by this camera"},
+    {IS_CAPTURE_RUNNING, offsetof(ModuleState, error), "Capture is already running"},
+    {IS_OUT_OF_MEMORY, offsetof(ModuleState, error), "Out of memory"},
+    {IS_NO_SUCCESS, offsetof(ModuleState, error), "General error"},
+};
 
 /**
-  * General function to print errors that may occur whilst using the SDK
-  */  
-void print_error(Camera * self)
+  * Raises the exception of the camera's module matching an SDK return code
+  */
+void raise_error(Camera * self, int returnCode)
+{
+    raise_module_error(self->state, self, returnCode);
+}
+
+/**
+  * Raises the exception matching an SDK return code. The exception carries
+  * the return code in its code attribute.
+  * @arg state State of the module whose exceptions are raised
+  * @arg self Camera the error came from, may be NULL
+  * @arg returnCode Value returned by the failing SDK call
+  */
+void raise_module_error(ModuleState * state, Camera * self, int returnCode)
 {
+    PyObject * type = state->error;
+    PyObject * exc;
+    PyObject * code;
+    const char * message = NULL;
+    char * sdk_message;
+    char text[256];
     int errorCode;
-    char * message;
+    int i;
 
-    int returnCode = is_GetError(self->handle, &errorCode, &message);
-    if (returnCode != IS_SUCCESS)
+    for (i = 0; i < (int)(sizeof(known_errors) / sizeof(known_errors[0])); i++)
+    {
+        if (known_errors[i].code == returnCode)
+        {
+            type = *(PyObject **)((char *)state + known_errors[i].type);
+            message = known_errors[i].message;
+            break;
+        }
+    }
+    if (message == NULL)
     {
         message = "Could not obtain error";
+        if (self != NULL && is_GetError(camera_handle(self), &errorCode, &sdk_message) == IS_SUCCESS)
+        {
+            message = sdk_message;
+        }
+    }
+
+    PyOS_snprintf(text, sizeof(text), "uEye SDK error %d %s", returnCode, message);
+    exc = PyObject_CallFunction(type, "s", text);
+    if (exc == NULL)
+    {
+        return;
+    }
+    code = Py_BuildValue("i", returnCode);
+    PyObject_SetAttrString(exc, "code", code);
+    Py_DECREF(code);
+    PyErr_SetObject(type, exc);
+    Py_DECREF(exc);
+}
+
+/*
+ * Creates the exception hierarchy of one module object. raise_error finds
+ * it through the state the camera's type points at.
+ */
+static int create_exceptions(ModuleState * state)
+{
+    state->error = PyErr_NewExceptionWithDoc("ids.IDSError",
+            "Base class for exceptions caused by an error with the IDS camera or libraries.\n"
+            "The SDK return code is available as the code attribute.",
+            NULL, NULL);
+    if (state->error == NULL)
+    {
+        return -1;
+    }
+    state->timeout = PyErr_NewExceptionWithDoc("ids.IDSTimeout",
+            "Raised when no image arrived in time.", state->error, NULL);
+    state->transfer_error = PyErr_NewExceptionWithDoc("ids.IDSTransferError",
+            "Raised when an image transfer from the camera failed.", state->error, NULL);
+    state->device_lost = PyErr_NewExceptionWithDoc("ids.IDSDeviceLost",
+            "Raised when the camera could not be opened or was disconnected.", state->error, NULL);
+    state->invalid_parameter = PyErr_NewExceptionWithDoc("ids.IDSInvalidParameter",
+            "Raised when the SDK rejected a parameter.", state->error, NULL);
+    state->not_supported = PyErr_NewExceptionWithDoc("ids.IDSNotSupported",
+            "Raised when the camera does not support the requested feature.", state->error, NULL);
+    if (state->timeout == NULL || state->transfer_error == NULL || state->device_lost == NULL ||
+        state->invalid_parameter == NULL || state->not_supported == NULL)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Sets up the native state shared by every module object: the NumPy and
+ * datetime APIs, the metrics registry and the trace buffers
+ */
+static int ids_init_once(void)
+{
+    static int initialized = 0;
+
+    if (initialized)
+    {
+        return 0;
+    }
+    if (camera_images_init() < 0)
+        return -1;
+    if (blobs_init() < 0)
+        return -1;
+    capture_init();
+    metrics_init();
+    trace_init();
+    initialized = 1;
+    return 0;
+}
+
+/*
+ * The types of the module, created from their specs in this order by
+ * add_objects. The FrameLease is internal and not added to the module.
+ */
+static const struct
+{
+    const char *  name;
+    PyType_Spec * spec;
+    size_t        type;
+} module_types[] = {
+    {"Camera", &ids_CameraSpec, offsetof(ModuleState, camera_type)},
+    {"Video", &ids_VideoSpec, offsetof(ModuleState, video_type)},
+    {"StreamServer", &ids_StreamServerSpec, offsetof(ModuleState, stream_server_type)},
+    {"StreamClient", &ids_StreamClientSpec, offsetof(ModuleState, stream_client_type)},
+    {"MetricsServer", &ids_MetricsServerSpec, offsetof(ModuleState, metrics_server_type)},
+    {"Preview", &ids_PreviewSpec, offsetof(ModuleState, preview_type)},
+    {"Dump", &ids_DumpSpec, offsetof(ModuleState, dump_type)},
+    {"TiffWriter", &ids_TiffWriterSpec, offsetof(ModuleState, tiff_writer_type)},
+    {"Timelapse", &ids_TimelapseSpec, offsetof(ModuleState, timelapse_type)},
+    {"Preset", &ids_PresetSpec, offsetof(ModuleState, preset_type)},
+    {"Frame", &ids_FrameSpec, offsetof(ModuleState, frame_type)},
+    {NULL, &ids_FrameLeaseSpec, offsetof(ModuleState, frame_lease_type)},
+};
+
+#define MODULE_TYPE(state, i) (*(PyTypeObject **)((char *)(state) + module_types[i].type))
+
+ModuleState * module_state(PyObject * module)
+{
+    return (ModuleState *)PyModule_GetState(module);
+}
+
+/*
+ * Creates the exceptions and types of a module object and adds them to it
+ */
+static int add_objects(PyObject * m)
+{
+    ModuleState * state = module_state(m);
+    int i;
+
+    if (create_exceptions(state) < 0)
+    {
+        return -1;
+    }
+    /* IDS Exceptions */
+    if (PyModule_AddObjectRef(m, "IDSError", state->error) < 0 ||
+        PyModule_AddObjectRef(m, "IDSTimeout", state->timeout) < 0 ||
+        PyModule_AddObjectRef(m, "IDSTransferError", state->transfer_error) < 0 ||
+        PyModule_AddObjectRef(m, "IDSDeviceLost", state->device_lost) < 0 ||
+        PyModule_AddObjectRef(m, "IDSInvalidParameter", state->invalid_parameter) < 0 ||
+        PyModule_AddObjectRef(m, "IDSNotSupported", state->not_supported) < 0)
+    {
+        return -1;
     }
-    PyErr_Format(IDSError, "uEye SDK error %d %s", returnCode, message);
+
+    /* IDS Objects */
+    for (i = 0; i < (int)(sizeof(module_types) / sizeof(module_types[0])); i++)
+    {
+        MODULE_TYPE(state, i) = (PyTypeObject *)PyType_FromModuleAndSpec(m, module_types[i].spec, NULL);
+        if (MODULE_TYPE(state, i) == NULL)
+        {
+            return -1;
+        }
+        if (module_types[i].name != NULL &&
+            PyModule_AddObjectRef(m, module_types[i].name, (PyObject *)MODULE_TYPE(state, i)) < 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
 }
 
 /**
@@ -29,7 +239,7 @@ PyObject * ids_number_cameras(PyObject * self)
     returnCode = is_GetNumberOfCameras(&num_cams);
     if (returnCode != IS_SUCCESS)
     {
-        PyErr_Format(IDSError, "uEye SDK error %d", returnCode);
+        raise_module_error(module_state(self), NULL, returnCode);
         return NULL;
     }
     return Py_BuildValue("i", num_cams);
@@ -55,7 +265,7 @@ PyObject * ids_all_cameras_info(PyObject * self)
     returnCode = is_GetNumberOfCameras(&num_cams);
     if (returnCode != IS_SUCCESS)
     {
-        PyErr_Format(IDSError, "uEye SDK error %d\n", returnCode);
+        raise_module_error(module_state(self), NULL, returnCode);
         return NULL;
     }
 
@@ -72,7 +282,7 @@ PyObject * ids_all_cameras_info(PyObject * self)
     if (returnCode != IS_SUCCESS)
     {
         Py_DECREF(list);
-        PyErr_Format(IDSError, "uEye SDK error %d\n", returnCode);
+        raise_module_error(module_state(self), NULL, returnCode);
         return NULL;
     }
 
@@ -120,86 +330,159 @@ PyMethodDef idsMethods[] =
     {"all_cams_info", (PyCFunction)ids_all_cameras_info, METH_NOARGS,
      "Returns a list of all camera information"
     },
+    {"metrics_server", (PyCFunction)ids_metrics_server, METH_VARARGS | METH_KEYWORDS,
+     "Serve Prometheus metrics for all open cameras over HTTP, returns a MetricsServer"
+    },
+    {"hdr_merge", (PyCFunction)ids_hdr_merge, METH_VARARGS | METH_KEYWORDS,
+     "Fuse an exposure bracket of uint8/uint16 frames into a float32 radiance image"
+    },
+    {"frame_stats", (PyCFunction)ids_frame_stats, METH_VARARGS | METH_KEYWORDS,
+     "Histogram, min/max/mean/std, saturated pixel count and sharpness of an image"
+    },
+    {"find_blobs", (PyCFunction)ids_find_blobs, METH_VARARGS | METH_KEYWORDS,
+     "Centroids, areas and bounding boxes of the connected blobs of a mono image as a structured array"
+    },
+    {"blob_benchmark", (PyCFunction)ids_blob_benchmark, METH_VARARGS | METH_KEYWORDS,
+     "Measure find_blobs on synthetic particle images at several particle densities"
+    },
+    {"find_edges", (PyCFunction)ids_find_edges, METH_VARARGS | METH_KEYWORDS,
+     "Subpixel edge points of a mono image as an (N, 2) float32 array of x, y"
+    },
+    {"find_contours", (PyCFunction)ids_find_contours, METH_VARARGS | METH_KEYWORDS,
+     "Subpixel contours of a mono image as a list of (N, 2) float32 arrays, longest first"
+    },
+    {"edge_benchmark", (PyCFunction)ids_edge_benchmark, METH_VARARGS | METH_KEYWORDS,
+     "Measure find_contours and its accuracy on a synthetic image of drops"
+    },
+    {"convert_benchmark", (PyCFunction)ids_convert_benchmark, METH_VARARGS | METH_KEYWORDS,
+     "Measure the output format converters on random frames, each next to its scalar reference"
+    },
+    {"orientation_benchmark", (PyCFunction)ids_orientation_benchmark, METH_VARARGS | METH_KEYWORDS,
+     "Measure every orientation against NumPy slicing followed by a C-contiguous copy"
+    },
+    {"undistort", (PyCFunction)ids_undistort, METH_VARARGS | METH_KEYWORDS,
+     "Remove lens distortion from an image given OpenCV's camera matrix and distortion coefficients"
+    },
+    {"undistort_benchmark", (PyCFunction)ids_undistort_benchmark, METH_VARARGS | METH_KEYWORDS,
+     "Measure undistortion throughput and its accuracy against a double precision reference"
+    },
+    {"read_dump", (PyCFunction)ids_read_dump, METH_VARARGS,
+     "Read the frames of a file written by Camera.dump as a list of (image, info)"
+    },
+    {"read_tiff", (PyCFunction)ids_read_tiff, METH_VARARGS,
+     "Map the pages of a TIFF file written by Camera.record_tiff as a list of (image, info)"
+    },
+    {"numa_benchmark", (PyCFunction)ids_numa_benchmark, METH_VARARGS | METH_KEYWORDS,
+     "Measure memcpy and frame_stats throughput for every pair of CPU and memory NUMA node"
+    },
+    {"stream_benchmark", (PyCFunction)ids_stream_benchmark, METH_VARARGS | METH_KEYWORDS,
+     "Measure frame streaming through a loopback connection, for the whole frame and for an ROI"
+    },
+    {"trace_start", (PyCFunction)ids_trace_start, METH_VARARGS | METH_KEYWORDS,
+     "Start recording the stages of the acquisition pipeline, dropping earlier events"
+    },
+    {"trace_stop", (PyCFunction)ids_trace_stop, METH_NOARGS,
+     "Stop recording pipeline stages, returns the number of recorded and dropped events"
+    },
+    {"trace_dump", (PyCFunction)ids_trace_dump, METH_VARARGS | METH_KEYWORDS,
+     "Write the recorded stages as Chrome trace-event JSON to path, or return it as a string"
+    },
     {NULL, NULL, 0, NULL} /* sentinel */
 };
 
-#if PY_MAJOR_VERSION >= 3
 /*
- * This is only needed for Python3
- * IDS module initialization
- * Based on https://docs.python.org/3/extending/extending.html#the-module-s-method-table-and-initialization-function
+ * Multi-phase initialisation (PEP 489): the module object is created by the
+ * interpreter and filled in by ids_exec with types and exceptions of its
+ * own, so importing it again after removing it from sys.modules, or in a
+ * subinterpreter, builds a fresh module.
  */
-static struct PyModuleDef idsModule = {
-    PyModuleDef_HEAD_INIT,
-    "ids", /* name of module */
-    NULL,  /* module documentation */
-    -1,    /* size of perinterpreter state of the module,
-              or -1 if the module keeps state in global variables. */
-    idsMethods
-};
-#endif
-
-#if PY_MAJOR_VERSION >= 3
-PyMODINIT_FUNC PyInit_ids(void)
+static int ids_exec(PyObject * m)
 {
-    PyObject * m;
+    if (ids_init_once() < 0)
+    {
+        return -1;
+    }
+    return add_objects(m);
+}
 
-    ids_CameraType.tp_new = PyType_GenericNew;
-    if (PyType_Ready(&ids_CameraType) < 0)
-        return NULL;
-    ids_VideoType.tp_new = PyType_GenericNew;
-    if (PyType_Ready(&ids_VideoType) < 0)
-        return NULL;
+static int ids_traverse(PyObject * m, visitproc visit, void * arg)
+{
+    ModuleState * state = module_state(m);
+    int i;
 
-    m = PyModule_Create(&idsModule);
-    if (m == NULL)
+    for (i = 0; i < (int)(sizeof(module_types) / sizeof(module_types[0])); i++)
     {
-        return NULL;
+        Py_VISIT(MODULE_TYPE(state, i));
     }
-
-    /* IDS Exceptions */
-    IDSError = PyErr_NewExceptionWithDoc("ids_core.IDSError",
-            "Base class for exceptions caused by an error with the IDS camera or libraries.",
-            NULL, NULL);
-    Py_INCREF(IDSError);
-    PyModule_AddObject(m, "IDSError", IDSError);
-   
-    /* IDS Objects */
-    Py_INCREF(&ids_CameraType);
-    Py_INCREF(&ids_VideoType);
-    PyModule_AddObject(m, "Camera", (PyObject *)(&ids_CameraType));
-    PyModule_AddObject(m, "Video", (PyObject *)(&ids_VideoType));
-    return m;
+    Py_VISIT(state->error);
+    Py_VISIT(state->timeout);
+    Py_VISIT(state->transfer_error);
+    Py_VISIT(state->device_lost);
+    Py_VISIT(state->invalid_parameter);
+    Py_VISIT(state->not_supported);
+    return 0;
 }
-#else
-PyMODINIT_FUNC initids(void)
+
+static int ids_clear(PyObject * m)
 {
-    PyObject* m;
+    ModuleState * state = module_state(m);
+    int i;
 
-    ids_CameraType.tp_new = PyType_GenericNew;
-    if (PyType_Ready(&ids_CameraType) < 0)
-        return NULL;
+    for (i = 0; i < (int)(sizeof(module_types) / sizeof(module_types[0])); i++)
+    {
+        Py_CLEAR(MODULE_TYPE(state, i));
+    }
+    Py_CLEAR(state->error);
+    Py_CLEAR(state->timeout);
+    Py_CLEAR(state->transfer_error);
+    Py_CLEAR(state->device_lost);
+    Py_CLEAR(state->invalid_parameter);
+    Py_CLEAR(state->not_supported);
+    return 0;
+}
 
-    ids_VideoType.tp_new = PyType_GenericNew;
-    if (PyType_Ready(&ids_VideoType) < 0)
-        return NULL;
+static void ids_free(void * m)
+{
+    ids_clear((PyObject *)m);
+}
 
-    m = Py_InitModule("ids", idsMethods);
+static PyModuleDef_Slot idsSlots[] = {
+    {Py_mod_exec, (void *)ids_exec},
+#ifdef Py_mod_multiple_interpreters
+    /*
+     * The frame freelists, the array pool, the metrics registry, the trace
+     * buffers and the NumPy C API table are shared by the whole process and
+     * hold objects of the interpreter that created them
+     */
+    {Py_mod_multiple_interpreters, Py_MOD_MULTIPLE_INTERPRETERS_NOT_SUPPORTED},
+#endif
+#ifdef Py_mod_gil
+    /*
+     * Capture control, the SDK handle, the settings cache, the counters and
+     * the freelists are locked or atomic, so free-threaded builds keep the
+     * GIL off
+     */
+    {Py_mod_gil, Py_MOD_GIL_NOT_USED},
+#endif
+    {0, NULL}
+};
 
-    /* IDS Exceptions */
-    IDSError = PyErr_NewExceptionWithDoc("ids.IDSError",
-            "Base class for exceptions caused by an error with the IDS camera or libraries.",
-            NULL, NULL);
-    Py_INCREF(IDSError);
-    PyModule_AddObject(m, "IDSError", IDSError);
-   
-    /* IDS Objects */
-    Py_INCREF(&ids_CameraType);
-    Py_INCREF(&ids_VideoType);
-    PyModule_AddObject(m, "Camera", (PyObject *)(&ids_CameraType));
-    PyModule_AddObject(m, "Video", (PyObject *)(&ids_VideoType));
+static struct PyModuleDef idsModule = {
+    PyModuleDef_HEAD_INIT,
+    "ids",                 /* name of module */
+    NULL,                  /* module documentation */
+    sizeof(ModuleState),   /* size of the per-module state */
+    idsMethods,
+    idsSlots,
+    ids_traverse,
+    ids_clear,
+    ids_free
+};
+
+PyMODINIT_FUNC PyInit_ids(void)
+{
+    return PyModuleDef_Init(&idsModule);
 }
-#endif
 
 int main(int argc, char *argv[])
 {
@@ -213,13 +496,11 @@ int main(int argc, char *argv[])
     /* Pass argv[0] to the Pythin interpreter */
     Py_SetProgramName(name);
 
-    /* Initialize the Python interpreter */
-    Py_Initialize();
-
     /* Add a static module */
 #if PY_MAJOR_VERSION >= 3
-    PyInit_ids();
-#else
-    initids();
+    PyImport_AppendInittab("ids", PyInit_ids);
 #endif
+
+    /* Initialize the Python interpreter */
+    Py_Initialize();
 }
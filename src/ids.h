@@ -15,12 +15,482 @@
 #include "stdint.h"
 #endif
 
+#include "ids_thread.h"
+
+/* The types are created from specs with the module they belong to */
+#if PY_VERSION_HEX < 0x030A0000
+#error "ids needs Python 3.10 or later"
+#endif
+
+/* Flags of every type, immutable like the static types they replaced */
+#define IDS_TPFLAGS (Py_TPFLAGS_DEFAULT | Py_TPFLAGS_IMMUTABLETYPE)
+
 /*
- * Struct that defines the underlying Camera class
+ * Per-object locking for the free-threaded build. Before 3.13 the GIL
+ * already serialises these sections, so they compile to a plain block.
+ */
+#ifndef Py_BEGIN_CRITICAL_SECTION
+#define Py_BEGIN_CRITICAL_SECTION(op) {
+#define Py_END_CRITICAL_SECTION() }
+#endif
+
+/* Number of sequence buffers allocated when capture starts implicitly */
+#define DEFAULT_CAPTURE_BUFFERS 8
+/* Maximum number of native consumers attached to a single capture engine */
+#define MAX_FRAME_SINKS 8
+/* Maximum number of steps in an exposure bracket */
+#define MAX_BRACKET_STEPS 16
+/* Frames the bracket controller can have in flight between programming and capture */
+#define BRACKET_SCHEDULE_SIZE 64
+/* Most pre-trigger frames the motion gate holds back */
+#define MAX_GATE_PRE 64
+/*
+ * Ring size while gating: the history locks pre buffers, and a whole event
+ * (history plus trigger frame) must fit into the delivery queue, which holds
+ * half the ring
  */
+#define GATE_MIN_BUFFERS(pre) (3 * (pre) + 8)
+
+struct Camera;
+struct FrameRing;
+struct Timelapse;
+
+/* Number of log2 buckets in a latency histogram, bucket i counts samples below 2^i microseconds */
+#define STATS_HISTOGRAM_BUCKETS 32
+
+/*
+ * Lock-free latency histogram. Any thread may record into it.
+ */
+typedef struct
+{
+    volatile int64_t   count;
+    volatile int64_t   total_ns;
+    volatile int64_t   max_ns;
+    volatile int64_t   buckets[STATS_HISTOGRAM_BUCKETS];
+} LatencyHistogram;
+
+/*
+ * Stages of the acquisition pipeline that are timed for every frame
+ */
+enum StatsStage
+{
+    STAGE_SDK_WAIT,            /* blocked in is_WaitForNextImage */
+    STAGE_BUFFER_TO_DEQUEUE,   /* buffer filled by the device until dequeued */
+    STAGE_DEQUEUE_TO_DELIVERY, /* dequeued until handed to Python as an ndarray */
+    STAGE_DELIVERY_TO_RELEASE, /* held by Python until the buffer was released */
+    STAGE_COUNT,
+};
+
+/*
+ * Per-camera acquisition counters. Updated from the capture thread and from
+ * whichever thread releases a frame, read by Camera.stats() at any time.
+ */
+typedef struct
+{
+    volatile int64_t   frames_captured;
+    volatile int64_t   frames_delivered;
+    volatile int64_t   frames_released;
+    volatile int64_t   frames_dropped;
+    volatile int64_t   frames_missing;
+    volatile int64_t   gap_events;
+    volatile int64_t   wait_errors;
+    volatile int64_t   last_frame_number;
+    volatile int64_t   delivery_high_water;
+    volatile int64_t   sdk_buffers_high_water;
+    volatile int64_t   locked_buffers;
+    volatile int64_t   locked_buffers_high_water;
+    volatile int64_t   transfer_failures;
+    volatile int64_t   capture_status[256];
+    volatile int64_t   measured_fps_milli;
+    volatile int64_t   disconnects;
+    volatile int64_t   reconnects;
+    volatile int64_t   downtime_ns;
+    volatile int64_t   last_downtime_ns;
+    /* Raw is_DeviceFeature temperature word, -1 while no reading exists */
+    volatile int64_t   temperature_raw;
+    int64_t            fps_window_frames;
+    int64_t            device_offset_ns;
+    int64_t            last_status_poll_ns;
+    /* Frame objects and arrays handed out by get_image, new or recycled */
+    volatile int64_t   frame_objects_allocated;
+    volatile int64_t   frame_objects_reused;
+    volatile int64_t   arrays_allocated;
+    volatile int64_t   arrays_reused;
+    LatencyHistogram   latency[STAGE_COUNT];
+} CameraStats;
+
+/* Largest histogram computed by the frame statistics kernel */
+#define FRAME_STATS_MAX_BINS 4096
+
+/*
+ * Statistics of one frame, see frame_stats_compute
+ */
+typedef struct
+{
+    int                valid;
+    int                bins;
+    int                bits;
+    int                subsample;
+    uint64_t           count;
+    uint32_t           min;
+    uint32_t           max;
+    double             mean;
+    double             std;
+    uint64_t           saturated;
+    /* Variance of the 4-neighbour Laplacian, higher is sharper */
+    double             sharpness;
+    uint32_t           histogram[FRAME_STATS_MAX_BINS];
+} FrameStats;
+
+/*
+ * A single SDK sequence buffer. While refcount is non-zero the buffer is
+ * locked in the image queue and its contents (and info) are stable.
+ */
+typedef struct FrameSlot
+{
+    struct FrameRing * ring;
+    char *             pBuffer;
+    INT                memID;
+    volatile long      refcount;
+    uint64_t           sequence;
+    int64_t            dequeue_ns;
+    int64_t            delivered_ns;
+    UEYEIMAGEINFO      info;
+    /* Bracket step the frame was taken with, -1 when unknown or bracketing is off */
+    int                bracket_index;
+    double             bracket_exposure;
+    int                bracket_gain;
+    /* Filled by the capture thread while Camera.auto_stats is set, NULL until first used */
+    FrameStats *       frame_stats;
+    /* Why the motion gate passed the frame, see enum GateRole */
+    int                gate_role;
+    int64_t            gate_event;
+    double             gate_score;
+    /* Device timestamp mapped onto the monotonic clock, 0 until the mapping is known */
+    int64_t            host_ns;
+    /* Deadline of Camera.timelapse the frame was taken for, -1 when none */
+    int64_t            timelapse_index;
+    int64_t            timelapse_deadline_ns;
+} FrameSlot;
+
+/*
+ * The set of sequence buffers registered with the SDK for one capture run.
+ * The ring outlives the run for as long as any of its slots is still locked.
+ */
+typedef struct FrameRing
+{
+    HIDS               handle;
+    volatile long      refcount;
+    int                count;
+    int                width;
+    int                height;
+    int                bitdepth;
+    int                color;
+    int                pitch;
+    FrameSlot *        slots;
+    CameraStats *      stats;
+    /* Set once the device was lost and handle closed, slots then go back without the SDK */
+    volatile int       closed;
+    /* Orders slot unlocks against closing the handle */
+    ids_mutex_t        lock;
+
+    /* Page-aligned block the slots were carved from, registered with the SDK */
+    char *             memory;
+    size_t             memory_size;
+    int                huge_pages;
+    int                numa_node;
+    /* Set when the buffers were locked into RAM for the capture thread */
+    int                memory_locked;
+} FrameRing;
+
+/*
+ * Callback invoked on the capture thread for every dequeued frame. The sink
+ * must not block; it retains the slot if it needs it past the call.
+ */
+typedef void (*frame_sink_func)(void * context, FrameSlot * slot);
+
 typedef struct
+{
+    frame_sink_func    func;
+    void *             context;
+} FrameSink;
+
+/*
+ * Repeating list of exposures and gains cycled through frame by frame,
+ * either by the SDK sequencer or by the capture thread itself
+ */
+typedef struct
+{
+    int                count;
+    int                use_sequencer;
+    int                latency;
+    int                has_gain;
+    double             exposure[MAX_BRACKET_STEPS];
+    int                gain[MAX_BRACKET_STEPS];
+
+    /* Controller state, only touched by the capture thread */
+    int                next;
+    struct
+    {
+        uint64_t       frame_number;
+        int            index;
+    } schedule[BRACKET_SCHEDULE_SIZE];
+} Bracket;
+
+enum GateRole
+{
+    GATE_NONE,
+    GATE_PRE,     /* held back before an event */
+    GATE_TRIGGER, /* showed change itself */
+    GATE_POST,    /* passed after the last changed frame */
+};
+
+/*
+ * Motion gate in front of the delivery queue. Frames are scored against a
+ * running background on a sampling grid; only frames around a change are
+ * delivered to get_image.
+ */
+typedef struct
+{
+    /* Only changed while capture is stopped */
+    int                enabled;
+    double             threshold;
+    int                grid;
+    int                pre;
+    int                post;
+    int                learn_q8;
+
+    /* Only touched by the capture thread */
+    uint8_t *          samples;
+    uint8_t *          background;
+    uint16_t *         background_fixed;
+    int                size;
+    int                initialized;
+    FrameSlot *        history[MAX_GATE_PRE];
+    int                history_head;
+    int                history_count;
+    int                post_remaining;
+    int64_t            event;
+
+    volatile int64_t   frames_passed;
+    volatile int64_t   frames_gated;
+    volatile int64_t   events;
+    volatile int64_t   last_score_milli;
+} Gate;
+
+/* Samples the device-to-host clock regression looks back over */
+#define CLOCK_WINDOW 512
+
+/*
+ * Running linear fit of the dequeue time against the device timestamp,
+ * host_ns = host_origin + intercept + slope * (ticks - tick_origin) * 100
+ */
+typedef struct
+{
+    /* Recent samples relative to the first one, only touched by the capture thread */
+    uint64_t           base_ticks;
+    int64_t            base_ns;
+    double             device[CLOCK_WINDOW];
+    double             host[CLOCK_WINDOW];
+    int                head;
+    int                count;
+    int                since_fit;
+    uint64_t           last_ticks;
+    /* Frame with the least latency since bucket_start, the candidate sample */
+    int                pending;
+    double             pending_device;
+    double             pending_host;
+    double             bucket_start;
+
+    /* Current fit, written by the capture thread and read under lock elsewhere */
+    ids_mutex_t        lock;
+    int                valid;
+    uint64_t           tick_origin;
+    int64_t            host_origin;
+    double             intercept;
+    double             slope;
+    double             residual_ns;
+    double             step_ns;
+    int64_t            realtime_offset_ns;
+    int                points;
+    double             span_s;
+    int64_t            fits;
+    int64_t            resets;
+} ClockSync;
+
+/*
+ * State of the native acquisition engine owned by a Camera
+ */
+typedef struct
+{
+    /*
+     * Serialises starting, stopping and reconfiguring capture between
+     * Python threads, see capture_control_lock
+     */
+    ids_mutex_t        control_lock;
+
+    FrameRing *        ring;
+    ids_thread_t       thread;
+    volatile int       running;
+    uint64_t           sequence;
+
+    /* Last is_WaitForNextImage failure other than a timeout, 0 once frames flow again */
+    volatile int       last_error;
+
+    /*
+     * Set while live video is off and frames only come from software
+     * triggers, see ids_timelapse.c. Only changed with the control lock held.
+     */
+    volatile int       idle;
+
+    /* Device loss recovery, see capture_recover */
+    volatile int       simulate_loss;
+    volatile int64_t   disconnected_since_ns;
+#ifdef _WIN32
+    HANDLE             remove_event;
+#endif
+
+    /* Frames waiting to be picked up by get_image, guarded by lock */
+    ids_mutex_t        lock;
+    ids_cond_t         frame_ready;
+    FrameSlot **       delivery;
+    int                delivery_head;
+    int                delivery_count;
+    int                delivery_capacity;
+
+    /* Only changed while capture is stopped */
+    Bracket            bracket;
+
+    /*
+     * Placement of the sequence buffers, only changed while capture is
+     * stopped. With either set the buffers are allocated here and handed to
+     * the SDK; numa_node also binds the capture thread to that node.
+     */
+    int                numa_node;
+    int                huge_pages;
+
+    /* Grid step of the per-frame statistics, 0 when they are off */
+    volatile int       stats_subsample;
+
+    Gate               gate;
+
+    ClockSync          clock;
+
+    /* Native consumers, guarded by sink_lock */
+    ids_mutex_t        sink_lock;
+    FrameSink          sinks[MAX_FRAME_SINKS];
+    int                num_sinks;
+
+    /* Running Camera.timelapse, changed with both the control lock and sink_lock held */
+    struct Timelapse * timelapse;
+} Capture;
+
+/*
+ * Settings applied through the Camera properties, replayed onto the device
+ * after it was reopened. Only fields flagged in applied are restored.
+ */
+enum SettingFlags
+{
+    SETTING_PIXEL_CLOCK   = 1 << 0,
+    SETTING_AOI           = 1 << 1,
+    SETTING_FRAME_RATE    = 1 << 2,
+    SETTING_EXPOSURE      = 1 << 3,
+    SETTING_MASTER_GAIN   = 1 << 4,
+    SETTING_RED_GAIN      = 1 << 5,
+    SETTING_GREEN_GAIN    = 1 << 6,
+    SETTING_BLUE_GAIN     = 1 << 7,
+    SETTING_WHITE_BALANCE = 1 << 8,
+    SETTING_DISPLAY_MODE  = 1 << 9,
+    SETTING_COLOR_MODE    = 1 << 10,
+    SETTING_TRIGGER       = 1 << 11,
+    SETTING_ROP_EFFECT    = 1 << 12,
+};
+
+typedef struct
+{
+    unsigned int applied;
+    UINT         pixel_clock;
+    IS_RECT      aoi;
+    double       frame_rate;
+    double       exposure;
+    int          master_gain;
+    int          red_gain;
+    int          green_gain;
+    int          blue_gain;
+    UINT         white_balance;
+    int          display_mode;
+    int          color_mode;
+    int          trigger;
+    int          rop_effect;
+} CameraSettings;
+
+/*
+ * Native threads grouped by the scheduling options they share, see
+ * Camera.configure_threads
+ */
+enum ThreadRole
+{
+    THREAD_CAPTURE,    /* the capture thread */
+    THREAD_PROCESSING, /* preview worker and recorder copy thread */
+    THREAD_WRITER,     /* dump writers and stream connections */
+    THREAD_ROLES
+};
+
+/*
+ * Scheduling options for the native threads of one role, applied by each
+ * thread as it starts. The outcome fields hold errno values, 0 on success.
+ */
+typedef struct
+{
+    int                configured;
+    uint64_t           cpus[IDS_MAX_CPUS / 64];
+    int                priority;
+    int                lock_memory;
+
+    volatile int       affinity_error;
+    volatile int       priority_error;
+    volatile int       lock_error;
+    volatile int64_t   threads_applied;
+    volatile int64_t   lock_attempts;
+} ThreadOptions;
+
+/*
+ * Pixel format of the arrays get_image returns, see Camera.output_format
+ */
+enum OutputFormat
+{
+    OUTPUT_RAW,    /* the sequence buffer itself, not copied */
+    OUTPUT_RGB8,
+    OUTPUT_GRAY8,
+    OUTPUT_GRAY16,
+    OUTPUT_FORMATS
+};
+
+/*
+ * Geometry of the arrays get_image returns relative to the sensor, see
+ * Camera.orientation. The mirrors apply first, then the transpose.
+ */
+enum Orientation
+{
+    ORIENT_FLIP_LR   = 1 << 0,
+    ORIENT_FLIP_UD   = 1 << 1,
+    ORIENT_TRANSPOSE = 1 << 2,
+    ORIENTATIONS     = 1 << 3
+};
+
+struct Recorder;
+struct Undistort;
+struct Timelapse;
+struct ModuleState;
+
+/*
+ * Struct that defines the underlying Camera class
+ */
+typedef struct Camera
 {
     PyObject_HEAD
+    /* State of the module that created the type, kept alive by the type */
+    struct ModuleState * state;
     HIDS        handle;
     uint32_t    width;
     uint32_t    height;
@@ -28,6 +498,30 @@ typedef struct
     int         color;
     int         autofeatures;
     int         status;
+    char        serial[16];
+    Capture     capture;
+    CameraStats stats;
+
+    /* Guards settings, which the capture thread reads while reconnecting */
+    ids_mutex_t    settings_lock;
+    CameraSettings settings;
+    /* Also guarded by settings_lock */
+    ThreadOptions  threads[THREAD_ROLES];
+
+    /* Pre-trigger recorder, NULL unless record() was called */
+    struct Recorder * recorder;
+
+    /* Conversion applied by get_image, see enum OutputFormat */
+    volatile int output_format;
+    /* Requested orientation, see enum Orientation */
+    volatile int orientation;
+    /* Lens undistortion, NULL unless set_undistort() was called */
+    struct Undistort * undistort;
+    /*
+     * Last schedule started by timelapse(), kept running after its Timelapse
+     * was dropped; changed with the control lock held
+     */
+    struct Timelapse * timelapse;
 
 } Camera;
 
@@ -37,6 +531,7 @@ typedef struct
 typedef struct
 {
     PyObject_HEAD
+    struct ModuleState * state;
     HIDS         handle;
     int          videoID;
     char         filename[256];
@@ -44,6 +539,15 @@ typedef struct
     volatile int is_capture;
 } Video;
 
+/*
+ * Struct that defines the Preset class, an in-memory settings snapshot
+ */
+typedef struct
+{
+    PyObject_HEAD
+    CameraSettings settings;
+} Preset;
+
 /*
  * Enum defining the current status of the camera
  */
@@ -59,23 +563,204 @@ enum Status
  */
 extern PyMethodDef idsMethods[];
 
+/*
+ * Types and exceptions of one module object. Every interpreter that
+ * imports the module builds its own from the specs below.
+ */
+typedef struct ModuleState
+{
+    PyTypeObject * camera_type;
+    PyTypeObject * video_type;
+    PyTypeObject * stream_server_type;
+    PyTypeObject * stream_client_type;
+    PyTypeObject * metrics_server_type;
+    PyTypeObject * preview_type;
+    PyTypeObject * dump_type;
+    PyTypeObject * tiff_writer_type;
+    PyTypeObject * timelapse_type;
+    PyTypeObject * frame_type;
+    PyTypeObject * frame_lease_type;
+    PyTypeObject * preset_type;
+
+    PyObject *     error;
+    PyObject *     timeout;
+    PyObject *     transfer_error;
+    PyObject *     device_lost;
+    PyObject *     invalid_parameter;
+    PyObject *     not_supported;
+} ModuleState;
+
+extern ModuleState * module_state(PyObject * module);
+
 /*
  * Data Structures for the Camera Object
  */
-extern PyTypeObject ids_CameraType;
+extern PyType_Spec ids_CameraSpec;
 extern PyMethodDef camera_methods[];
 extern PyGetSetDef camera_properties[];
 
 /**
   * Data Structures for the Video Object
   */ 
-extern PyTypeObject ids_VideoType;
+extern PyType_Spec ids_VideoSpec;
 extern PyMethodDef video_methods[];
 
-void print_error(Camera * self);
+/**
+  * Data Structures for the frame streaming server and client
+  */
+extern PyType_Spec ids_StreamServerSpec;
+extern PyType_Spec ids_StreamClientSpec;
+
+/**
+  * Data Structures for the metrics endpoint
+  */
+extern PyType_Spec ids_MetricsServerSpec;
+
+/**
+  * Data Structures for the live preview
+  */
+extern PyType_Spec ids_PreviewSpec;
+
+/**
+  * Data Structures for pre-trigger recording
+  */
+extern PyType_Spec ids_DumpSpec;
+
+/**
+  * Data Structures for BigTIFF recording
+  */
+extern PyType_Spec ids_TiffWriterSpec;
+
+/**
+  * Data Structures for timelapse scheduling
+  */
+extern PyType_Spec ids_TimelapseSpec;
+
+/**
+  * Data Structures for the frames returned by get_image
+  */
+extern PyType_Spec ids_FrameSpec;
+extern PyType_Spec ids_FrameLeaseSpec;
+extern PyObject * frame_from_slot(Camera * camera, FrameSlot * slot);
+extern void frame_pool_init(void);
+extern int frame_pool_arrays_enabled(void);
+extern PyObject * camera_get_image_info(Camera * self, FrameSlot * slot);
+
+/**
+  * Data Structures for settings presets
+  */
+extern PyType_Spec ids_PresetSpec;
+extern void metrics_init(void);
+extern int  metrics_register_camera(Camera * camera);
+extern void metrics_unregister_camera(Camera * camera);
+
+void raise_error(Camera * self, int returnCode);
+void raise_module_error(ModuleState * state, Camera * self, int returnCode);
+
+/* Capture engine, implemented in ids_camera_capture.c */
+extern void capture_init(void);
+extern int  camera_capture_init(Camera * self);
+extern void camera_capture_destroy(Camera * self);
+extern int  camera_capture_start(Camera * self, int buffers);
+extern void camera_capture_stop(Camera * self);
+extern int  camera_capture_ensure(Camera * self, int buffers, int * started);
+extern void capture_control_lock(Camera * self);
+extern void capture_control_unlock(Camera * self);
+extern FrameSlot * camera_capture_next(Camera * self, int timeout_ms);
+extern void capture_deliver(Camera * self, FrameSlot * slot);
+extern void capture_flush(Camera * self);
+extern int  capture_set_live(Camera * self, int live);
+extern int  camera_add_sink(Camera * self, frame_sink_func func, void * context);
+extern void camera_remove_sink(Camera * self, frame_sink_func func, void * context);
+extern void frame_slot_retain(FrameSlot * slot);
+extern void frame_slot_release(FrameSlot * slot);
+extern void frame_ring_decref(FrameRing * ring);
+extern FrameRing * capture_ring_acquire(Camera * self);
+extern int  capture_buffer_count(Camera * self);
+extern PyObject * capture_buffers_as_dict(Camera * self);
+
+/* Settings cache, implemented in ids_camera_settings.c */
+extern void settings_init(Camera * self);
+extern void settings_destroy(Camera * self);
+extern HIDS camera_handle(Camera * self);
+extern void settings_snapshot(Camera * self, CameraSettings * settings);
+extern int  settings_apply(HIDS handle, const CameraSettings * settings);
+extern void settings_read(HIDS handle, CameraSettings * settings);
+extern void settings_refresh_dependents(Camera * self);
+extern unsigned int settings_diff(const CameraSettings * current, const CameraSettings * target);
+extern void settings_merge(CameraSettings * into, const CameraSettings * from, unsigned int flags);
+
+/* Exposure bracketing, implemented in ids_camera_bracket.c */
+extern void bracket_program(Camera * self, HIDS handle);
+extern void bracket_on_frame(Camera * self, FrameSlot * slot);
+
+/* Motion gate, implemented in ids_camera_gate.c */
+extern void gate_on_frame(Camera * self, FrameSlot * slot);
+extern void gate_reset(Camera * self);
+extern void gate_destroy(Camera * self);
+extern PyObject * gate_stats_as_dict(Camera * self);
+
+/* Device clock correlation, implemented in ids_camera_clock.c */
+extern void clock_on_frame(Camera * self, FrameSlot * slot);
+extern int64_t clock_realtime_offset(Camera * self);
+extern PyObject * clock_stats_as_dict(Camera * self);
+
+/* Thread scheduling controls, implemented in ids_camera_threads.c */
+extern void thread_options_apply(Camera * self, int role);
+extern int  thread_options_lock_memory(Camera * self, int role, void * memory, size_t size);
+extern PyObject * thread_options_as_dict(Camera * self);
+
+/* Timelapse scheduling, implemented in ids_timelapse.c */
+extern int timelapse_on_frame(Camera * self, FrameSlot * slot);
+extern void timelapse_close(Camera * self);
+
+/* Pre-trigger recorder, implemented in ids_recorder.c */
+extern void recorder_close(Camera * self);
+extern PyObject * recorder_stats_as_dict(Camera * self);
+
+/* Output format converters, implemented in ids_convert.c */
+extern int convert_format_parse(const char * name);
+extern const char * convert_format_name(int format);
+extern PyObject * convert_slot(Camera * self, FrameSlot * slot, int format);
+
+/* Host-side orientation, implemented in ids_transform.c */
+extern int orientation_parse(const char * name);
+extern const char * orientation_name(int orientation);
+extern int camera_host_orientation(Camera * self);
+extern PyObject * transform_slot(Camera * self, FrameSlot * slot, int format, int orientation);
+
+/* Lens undistortion, implemented in ids_undistort.c */
+extern void undistort_close(Camera * self);
+extern int undistort_layout(int color, int * channels, int * sample_bytes);
+extern PyObject * undistort_copy(Camera * self, const uint8_t * src, size_t pitch, int ndims, Py_intptr_t * dimensions, int type, int channels, int sample_bytes);
+extern PyObject * undistort_stats_as_dict(Camera * self);
+
+/* Pipeline tracing, implemented in ids_trace.c */
+extern volatile int ids_trace_enabled;
+extern void trace_init(void);
+extern void trace_record(const char * name, int64_t start_ns, int64_t frame);
+extern void trace_thread_name(const char * name);
+extern void trace_thread_exit(void);
+
+/*
+ * A traced stage is bracketed by TRACE_BEGIN and TRACE_END, which cost one
+ * branch each while tracing is off. name must be a string literal.
+ */
+#define TRACE_BEGIN(start) ((start) = ids_trace_enabled ? ids_monotonic_ns() : 0)
+#define TRACE_END(name, start, frame) do { if ((start) != 0) trace_record((name), (start), (frame)); } while (0)
+
+/* Frame statistics kernel, implemented in ids_frame_stats.c */
+extern void frame_stats_compute(FrameStats * stats, const char * data, int width, int height, int pitch, int channels, int bits, int subsample, uint32_t saturation, int bins);
+extern void frame_stats_on_capture(Camera * self, FrameSlot * slot);
+extern PyObject * frame_stats_as_dict(const FrameStats * stats);
 
-/* IDS Exception Objects */
-extern PyObject * IDSError;
+/* Acquisition statistics, implemented in ids_camera_stats.c */
+extern void stats_reset(CameraStats * stats);
+extern void stats_record_latency(CameraStats * stats, int stage, int64_t elapsed_ns);
+extern void stats_on_capture(Camera * self, FrameSlot * slot, int64_t wait_ns);
+extern void stats_on_delivery(CameraStats * stats, FrameSlot * slot);
+extern void stats_on_release(CameraStats * stats, FrameSlot * slot);
+extern void stats_poll_capture_status(Camera * self);
 
 /* Wrapper functions for converting Python Objects to string and supporting both Python 2 and Python 3 */
 extern int check_is_string(PyObject * value);
@@ -0,0 +1,999 @@
+#include <uEye.h>
+#include "ids.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#define PY_ARRAY_UNIQUE_SYMBOL ids_ARRAY_API
+#define NO_IMPORT_ARRAY
+#include <numpy/arrayobject.h>
+
+#if NPY_ABI_VERSION < 0x02000000
+/* NumPy 2 made the descriptor opaque and added the accessor */
+#define PyDataType_ELSIZE(descr) ((descr)->elsize)
+#endif
+
+/* Fewest rows a strip gets, below that the merge outweighs the parallelism */
+#define BLOB_MIN_STRIP_ROWS         64
+#define BLOB_MAX_THREADS            64
+#define BLOB_INITIAL_RUNS           1024
+
+#define DEFAULT_BENCHMARK_SIZE      2048
+#define DEFAULT_BENCHMARK_REPEAT    5
+/* Synthetic particles: Gaussian spots on a noisy background */
+#define BENCHMARK_BACKGROUND        16
+#define BENCHMARK_NOISE             8
+#define BENCHMARK_PEAK              160
+#define BENCHMARK_SIGMA             1.5
+#define BENCHMARK_THRESHOLD         48
+
+/*
+ * Horizontal run of foreground pixels. Runs are numbered in raster order and
+ * joined with union-find, always under the lowest index, so the root of a
+ * component is its first run and accumulates the whole component.
+ */
+typedef struct
+{
+    int32_t            parent;
+    int32_t            y;
+    int32_t            x0;
+    int32_t            x1;
+    int32_t            xmin;
+    int32_t            xmax;
+    int32_t            ymax;
+    int64_t            area;
+    uint64_t           mass;
+    uint64_t           mass_x;
+    uint64_t           mass_y;
+} BlobRun;
+
+/*
+ * One element of the array find_blobs returns, laid out like blob_descr
+ */
+typedef struct
+{
+    double             x;
+    double             y;
+    double             mass;
+    int32_t            area;
+    int32_t            xmin;
+    int32_t            ymin;
+    int32_t            xmax;
+    int32_t            ymax;
+} BlobRecord;
+
+/*
+ * Rows [row0, row1) of the image, handled by one thread. With an adaptive
+ * threshold the strips start on a tile row, and each first computes the
+ * means of its own tiles.
+ */
+typedef struct
+{
+    const char *       data;
+    int                pitch;
+    int                width;
+    int                height;
+    int                wide;
+    int                row0;
+    int                row1;
+    int                dark;
+    double             threshold;
+    int                block;
+    /* Tile means, tiles_y rows of tiles_x, shared by all strips */
+    float *            means;
+    int                tiles_x;
+    int                tiles_y;
+
+    BlobRun *          runs;
+    int                count;
+    int                capacity;
+    /* Runs of row0 are [0, first_end), runs of row1 - 1 are [last_begin, count) */
+    int                first_end;
+    int                last_begin;
+    int                failed;
+} BlobStrip;
+
+static PyArray_Descr * blob_descr = NULL;
+
+/**
+  * Builds the dtype of the find_blobs result
+  * @return 0 on success, -1 with a Python exception set
+  */
+int blobs_init(void)
+{
+    PyObject * fields;
+    int result;
+
+    fields = Py_BuildValue("[(s,s),(s,s),(s,s),(s,s),(s,s),(s,s),(s,s),(s,s)]",
+            "x", "f8", "y", "f8", "mass", "f8", "area", "i4",
+            "xmin", "i4", "ymin", "i4", "xmax", "i4", "ymax", "i4");
+    if (fields == NULL)
+    {
+        return -1;
+    }
+    result = PyArray_DescrAlignConverter(fields, &blob_descr);
+    Py_DECREF(fields);
+    if (!result)
+    {
+        return -1;
+    }
+    if (PyDataType_ELSIZE(blob_descr) != sizeof(BlobRecord))
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Blob record layout does not match its dtype");
+        return -1;
+    }
+    return 0;
+}
+
+static int32_t run_find(BlobRun * runs, int32_t i)
+{
+    int32_t root = i;
+    int32_t next;
+
+    while (runs[root].parent != root)
+    {
+        root = runs[root].parent;
+    }
+    while (runs[i].parent != root)
+    {
+        next = runs[i].parent;
+        runs[i].parent = root;
+        i = next;
+    }
+    return root;
+}
+
+static void run_union(BlobRun * runs, int32_t a, int32_t b)
+{
+    a = run_find(runs, a);
+    b = run_find(runs, b);
+    if (a < b)
+    {
+        runs[b].parent = a;
+    }
+    else if (b < a)
+    {
+        runs[a].parent = b;
+    }
+}
+
+/**
+  * Joins the runs of a row to the 8-connected runs of the row above it.
+  * Both ranges are sorted by x.
+  */
+static void runs_connect(BlobRun * runs, int above_begin, int above_end, int begin, int end)
+{
+    int i, j, k;
+
+    j = above_begin;
+    for (i = begin; i < end; i++)
+    {
+        while (j < above_end && runs[j].x1 + 1 < runs[i].x0)
+        {
+            j++;
+        }
+        for (k = j; k < above_end && runs[k].x0 <= runs[i].x1 + 1; k++)
+        {
+            run_union(runs, i, k);
+        }
+    }
+}
+
+/**
+  * Appends a finished run to the strip
+  * @return 0 on success, -1 when out of memory
+  */
+static int strip_push(BlobStrip * strip, int y, int x0, int x1, uint64_t mass, uint64_t mass_x)
+{
+    BlobRun * grown;
+    BlobRun * run;
+
+    if (strip->count == strip->capacity)
+    {
+        grown = (BlobRun *)realloc(strip->runs, 2 * (size_t)strip->capacity * sizeof(BlobRun));
+        if (grown == NULL)
+        {
+            return -1;
+        }
+        strip->runs = grown;
+        strip->capacity *= 2;
+    }
+    run = &strip->runs[strip->count];
+    run->parent = strip->count;
+    run->y = y;
+    run->x0 = x0;
+    run->x1 = x1;
+    run->xmin = x0;
+    run->xmax = x1;
+    run->ymax = y;
+    run->area = x1 - x0 + 1;
+    run->mass = mass;
+    run->mass_x = mass_x;
+    run->mass_y = mass * (uint64_t)y;
+    strip->count++;
+    return 0;
+}
+
+/**
+  * Averages the tiles of the tile rows that start in the strip
+  */
+static void blob_means_main(void * arg)
+{
+    BlobStrip * strip = (BlobStrip *)arg;
+    const char * row;
+    uint64_t sum;
+    int block = strip->block;
+    int ty, tx, y, x;
+    int y1, x1;
+
+    if (strip->row0 >= strip->row1)
+    {
+        return;
+    }
+    for (ty = strip->row0 / block; ty * block < strip->row1; ty++)
+    {
+        y1 = (ty + 1) * block < strip->height ? (ty + 1) * block : strip->height;
+        for (tx = 0; tx < strip->tiles_x; tx++)
+        {
+            x1 = (tx + 1) * block < strip->width ? (tx + 1) * block : strip->width;
+            sum = 0;
+            for (y = ty * block; y < y1; y++)
+            {
+                row = strip->data + (size_t)y * strip->pitch;
+                if (strip->wide)
+                {
+                    for (x = tx * block; x < x1; x++)
+                    {
+                        sum += ((const uint16_t *)row)[x];
+                    }
+                }
+                else
+                {
+                    for (x = tx * block; x < x1; x++)
+                    {
+                        sum += ((const uint8_t *)row)[x];
+                    }
+                }
+            }
+            strip->means[ty * strip->tiles_x + tx] = (float)((double)sum / ((double)(y1 - ty * block) * (x1 - tx * block)));
+        }
+    }
+}
+
+/**
+  * Splits a pixel coordinate into the two nearest tile centres and the
+  * weight of the second
+  */
+static void tile_position(int pixel, int block, int tiles, int * first, double * fraction)
+{
+    double position = (pixel + 0.5) / block - 0.5;
+
+    if (position <= 0.0)
+    {
+        *first = 0;
+        *fraction = 0.0;
+    }
+    else if (position >= tiles - 1)
+    {
+        *first = tiles - 1;
+        *fraction = 0.0;
+    }
+    else
+    {
+        *first = (int)position;
+        *fraction = position - *first;
+    }
+}
+
+/**
+  * Sets the level of every pixel of row y: the tile means interpolated
+  * bilinearly between tile centres, moved by the threshold towards the
+  * blobs. Without the interpolation the level would step at tile borders
+  * and pull the centroids of blobs on them.
+  * @arg columns Tile of each column, fractions its interpolation weight
+  * @arg profile Scratch space for tiles_x means
+  */
+static void strip_row_levels(BlobStrip * strip, int y, const int * columns, const double * fractions, double * profile, int * levels)
+{
+    const float * above;
+    const float * below;
+    double fraction;
+    double mean;
+    int first;
+    int next;
+    int x;
+
+    tile_position(y, strip->block, strip->tiles_y, &first, &fraction);
+    above = strip->means + first * strip->tiles_x;
+    below = first + 1 < strip->tiles_y ? above + strip->tiles_x : above;
+    for (x = 0; x < strip->tiles_x; x++)
+    {
+        profile[x] = above[x] + fraction * (below[x] - above[x]);
+    }
+    for (x = 0; x < strip->width; x++)
+    {
+        first = columns[x];
+        next = first + 1 < strip->tiles_x ? first + 1 : first;
+        mean = profile[first] + fractions[x] * (profile[next] - profile[first]);
+        levels[x] = strip->dark ? (int)ceil(mean - strip->threshold) : (int)floor(mean + strip->threshold);
+    }
+}
+
+/*
+ * Scans the samples of a row. A pixel belongs to a blob when its weight,
+ * the distance past its level, is positive.
+ */
+#define SCAN_ROW(type, level)                                                  \
+    for (i = 0; i < strip->width; i++)                                         \
+    {                                                                          \
+        weight = sign * ((int)((const type *)row)[i] - (level));               \
+        if (weight > 0)                                                        \
+        {                                                                      \
+            if (!open)                                                         \
+            {                                                                  \
+                open = 1;                                                      \
+                start = i;                                                     \
+                mass = 0;                                                      \
+                mass_x = 0;                                                    \
+            }                                                                  \
+            mass += weight;                                                    \
+            mass_x += (uint64_t)weight * i;                                    \
+        }                                                                      \
+        else if (open)                                                         \
+        {                                                                      \
+            open = 0;                                                          \
+            if (strip_push(strip, y, start, i - 1, mass, mass_x) != 0)         \
+            {                                                                  \
+                return -1;                                                     \
+            }                                                                  \
+        }                                                                      \
+    }
+
+/**
+  * Extracts the runs of one row
+  * @arg levels Level of each pixel, NULL for the fixed threshold
+  * @return 0 on success, -1 when out of memory
+  */
+static int strip_scan_row(BlobStrip * strip, int y, const int * levels)
+{
+    const char * row = strip->data + (size_t)y * strip->pitch;
+    uint64_t mass = 0;
+    uint64_t mass_x = 0;
+    int open = 0;
+    int start = 0;
+    int weight;
+    int sign = strip->dark ? -1 : 1;
+    int level = strip->dark ? (int)ceil(strip->threshold) : (int)floor(strip->threshold);
+    int i;
+
+    if (levels != NULL && strip->wide)
+    {
+        SCAN_ROW(uint16_t, levels[i])
+    }
+    else if (levels != NULL)
+    {
+        SCAN_ROW(uint8_t, levels[i])
+    }
+    else if (strip->wide)
+    {
+        SCAN_ROW(uint16_t, level)
+    }
+    else
+    {
+        SCAN_ROW(uint8_t, level)
+    }
+    if (open && strip_push(strip, y, start, strip->width - 1, mass, mass_x) != 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+  * Labels the runs of a strip. Runs on a thread of its own, failures are
+  * reported through strip->failed.
+  */
+static void blob_strip_main(void * arg)
+{
+    BlobStrip * strip = (BlobStrip *)arg;
+    int * levels = NULL;
+    int * columns = NULL;
+    double * fractions = NULL;
+    double * profile = NULL;
+    int above_begin = 0;
+    int above_end = 0;
+    int begin;
+    int x, y;
+
+    strip->capacity = BLOB_INITIAL_RUNS;
+    strip->runs = (BlobRun *)malloc(strip->capacity * sizeof(BlobRun));
+    if (strip->block > 0)
+    {
+        levels = (int *)malloc((strip->width + 1) * sizeof(int));
+        columns = (int *)malloc((strip->width + 1) * sizeof(int));
+        fractions = (double *)malloc((strip->width + 1) * sizeof(double));
+        profile = (double *)malloc((strip->tiles_x + 1) * sizeof(double));
+    }
+    if (strip->runs == NULL || (strip->block > 0 && (levels == NULL || columns == NULL || fractions == NULL || profile == NULL)))
+    {
+        strip->failed = 1;
+        goto done;
+    }
+    for (x = 0; strip->block > 0 && x < strip->width; x++)
+    {
+        tile_position(x, strip->block, strip->tiles_x, &columns[x], &fractions[x]);
+    }
+
+    for (y = strip->row0; y < strip->row1; y++)
+    {
+        if (levels != NULL)
+        {
+            strip_row_levels(strip, y, columns, fractions, profile, levels);
+        }
+        begin = strip->count;
+        if (strip_scan_row(strip, y, levels) != 0)
+        {
+            strip->failed = 1;
+            break;
+        }
+        runs_connect(strip->runs, above_begin, above_end, begin, strip->count);
+        above_begin = begin;
+        above_end = strip->count;
+        if (y == strip->row0)
+        {
+            strip->first_end = strip->count;
+        }
+    }
+    strip->last_begin = above_begin;
+
+done:
+    free(levels);
+    free(columns);
+    free(fractions);
+    free(profile);
+}
+
+/**
+  * Runs func on every strip, the first one on the calling thread. A strip
+  * whose thread could not be started runs on the calling thread as well.
+  */
+static void blob_run_strips(BlobStrip * strips, int count, void (*func)(void *))
+{
+    ids_thread_t handles[BLOB_MAX_THREADS];
+    int started[BLOB_MAX_THREADS];
+    int s;
+
+    for (s = 1; s < count; s++)
+    {
+        started[s] = ids_thread_start(&handles[s], func, &strips[s]) == 0;
+    }
+    func(&strips[0]);
+    for (s = 1; s < count; s++)
+    {
+        if (started[s])
+        {
+            ids_thread_join(handles[s]);
+        }
+        else
+        {
+            func(&strips[s]);
+        }
+    }
+}
+
+/**
+  * Labels the 8-connected components of an image, splitting it into strips
+  * for up to threads threads and joining the runs across strip borders.
+  * Runs without the GIL.
+  * @arg runs Set to the runs in raster order, each root holding the totals
+  *           of its component; free() it
+  * @return Number of runs, -1 when out of memory
+  */
+static int blob_label(const char * data, int width, int height, int pitch, int wide, double threshold, int block, int dark, int threads, BlobRun ** runs)
+{
+    BlobStrip strips[BLOB_MAX_THREADS];
+    float * means = NULL;
+    BlobRun * all = NULL;
+    BlobRun * run;
+    BlobRun * root;
+    int tiles_x = 0;
+    int tiles_y = 0;
+    int rows;
+    int count;
+    int total = 0;
+    int offset;
+    int failed = 0;
+    int s, i;
+
+    count = height / BLOB_MIN_STRIP_ROWS;
+    if (threads < count)
+    {
+        count = threads;
+    }
+    if (count < 1)
+    {
+        count = 1;
+    }
+    rows = (height + count - 1) / count;
+    if (block > 0)
+    {
+        rows = (rows + block - 1) / block * block;
+        tiles_x = (width + block - 1) / block;
+        tiles_y = (height + block - 1) / block;
+        means = (float *)malloc(((size_t)tiles_x * tiles_y + 1) * sizeof(float));
+        if (means == NULL)
+        {
+            return -1;
+        }
+    }
+
+    memset(strips, 0, sizeof(strips));
+    for (s = 0; s < count; s++)
+    {
+        strips[s].data = data;
+        strips[s].pitch = pitch;
+        strips[s].width = width;
+        strips[s].height = height;
+        strips[s].wide = wide;
+        strips[s].row0 = s * rows < height ? s * rows : height;
+        strips[s].row1 = (s + 1) * rows < height ? (s + 1) * rows : height;
+        strips[s].dark = dark;
+        strips[s].threshold = threshold;
+        strips[s].block = block;
+        strips[s].means = means;
+        strips[s].tiles_x = tiles_x;
+        strips[s].tiles_y = tiles_y;
+    }
+    /* Every strip interpolates between the tile rows of its neighbours */
+    if (block > 0)
+    {
+        blob_run_strips(strips, count, blob_means_main);
+    }
+    blob_run_strips(strips, count, blob_strip_main);
+    free(means);
+
+    for (s = 0; s < count; s++)
+    {
+        failed |= strips[s].failed;
+        total += strips[s].count;
+    }
+    if (!failed)
+    {
+        all = (BlobRun *)malloc((total > 0 ? total : 1) * sizeof(BlobRun));
+        failed = all == NULL;
+    }
+    if (!failed)
+    {
+        offset = 0;
+        for (s = 0; s < count; s++)
+        {
+            memcpy(all + offset, strips[s].runs, strips[s].count * sizeof(BlobRun));
+            for (i = offset; i < offset + strips[s].count; i++)
+            {
+                all[i].parent += offset;
+            }
+            if (s > 0 && strips[s].row0 < strips[s].row1)
+            {
+                runs_connect(all, offset - strips[s - 1].count + strips[s - 1].last_begin, offset, offset, offset + strips[s].first_end);
+            }
+            offset += strips[s].count;
+        }
+
+        /* Roots come first in raster order, so one pass folds every run into its root */
+        for (i = 0; i < total; i++)
+        {
+            run = &all[i];
+            root = &all[run_find(all, i)];
+            if (root == run)
+            {
+                continue;
+            }
+            root->area += run->area;
+            root->mass += run->mass;
+            root->mass_x += run->mass_x;
+            root->mass_y += run->mass_y;
+            root->xmin = run->xmin < root->xmin ? run->xmin : root->xmin;
+            root->xmax = run->xmax > root->xmax ? run->xmax : root->xmax;
+            root->ymax = run->ymax > root->ymax ? run->ymax : root->ymax;
+        }
+    }
+
+    for (s = 0; s < count; s++)
+    {
+        free(strips[s].runs);
+    }
+    if (failed)
+    {
+        free(all);
+        return -1;
+    }
+    *runs = all;
+    return total;
+}
+
+/**
+  * Copies the components with an area in [min_area, max_area] into records
+  * @arg records NULL to only count them
+  * @return Number of components kept
+  */
+static int blob_collect(const BlobRun * runs, int count, int64_t min_area, int64_t max_area, BlobRecord * records)
+{
+    const BlobRun * run;
+    int kept = 0;
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        run = &runs[i];
+        if (run->parent != i || run->area < min_area || run->area > max_area)
+        {
+            continue;
+        }
+        if (records != NULL)
+        {
+            records[kept].x = (double)run->mass_x / run->mass;
+            records[kept].y = (double)run->mass_y / run->mass;
+            records[kept].mass = (double)run->mass;
+            records[kept].area = (int32_t)run->area;
+            records[kept].xmin = run->xmin;
+            records[kept].ymin = run->y;
+            records[kept].xmax = run->xmax;
+            records[kept].ymax = run->ymax;
+        }
+        kept++;
+    }
+    return kept;
+}
+
+static int blob_default_threads(void)
+{
+    int threads = ids_cpu_count();
+
+    return threads < 1 ? 1 : (threads > BLOB_MAX_THREADS ? BLOB_MAX_THREADS : threads);
+}
+
+/**
+  * Finds the 8-connected blobs of a mono uint8 or uint16 image with their
+  * intensity-weighted centroids
+  * This means the definition of the function is:
+  *     def find_blobs(image, threshold, block=None, dark=False, min_area=1, max_area=None, threads=None)
+  * @arg threshold Level a pixel must exceed, or with dark=True fall below.
+  *      With block it is added to (or subtracted from) the mean of the
+  *      block x block tile the pixel lies in.
+  * @return A structured array with the fields x, y, mass, area, xmin, ymin,
+  *         xmax and ymax, one element per blob in raster order. Each pixel
+  *         weighs its distance past the level; mass is the sum of weights.
+  */
+PyObject * ids_find_blobs(PyObject * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"image", "threshold", "block", "dark", "min_area", "max_area", "threads", NULL};
+    PyObject * image_obj;
+    PyObject * block_obj = Py_None;
+    PyObject * max_area_obj = Py_None;
+    PyObject * threads_obj = Py_None;
+    PyArrayObject * image;
+    PyArrayObject * contiguous;
+    PyObject * result;
+    BlobRun * runs = NULL;
+    npy_intp dimensions[1];
+    double threshold;
+    long long min_area = 1;
+    long long max_area;
+    int block = 0;
+    int dark = 0;
+    int threads = 0;
+    int count;
+    int kept;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "Od|OiLOO", kwlist, &image_obj, &threshold, &block_obj, &dark, &min_area, &max_area_obj, &threads_obj))
+    {
+        return NULL;
+    }
+    if ((block_obj != Py_None && (block = (int)PyLong_AsLong(block_obj)) == -1 && PyErr_Occurred())
+            || (threads_obj != Py_None && (threads = (int)PyLong_AsLong(threads_obj)) == -1 && PyErr_Occurred()))
+    {
+        return NULL;
+    }
+    max_area = max_area_obj != Py_None ? PyLong_AsLongLong(max_area_obj) : -1;
+    if (max_area == -1 && PyErr_Occurred())
+    {
+        return NULL;
+    }
+    if (max_area_obj == Py_None)
+    {
+        max_area = (long long)1 << 62;
+    }
+    if (threads_obj == Py_None)
+    {
+        threads = blob_default_threads();
+    }
+    if (block_obj != Py_None && block < 2)
+    {
+        PyErr_SetString(PyExc_ValueError, "block must be at least 2");
+        return NULL;
+    }
+    if (threads < 1 || threads > BLOB_MAX_THREADS)
+    {
+        PyErr_Format(PyExc_ValueError, "threads must be between 1 and %d", BLOB_MAX_THREADS);
+        return NULL;
+    }
+
+    image = (PyArrayObject *)PyArray_FROMANY(image_obj, NPY_NOTYPE, 2, 2, 0);
+    if (image == NULL)
+    {
+        return NULL;
+    }
+    if (PyArray_TYPE(image) != NPY_UINT8 && PyArray_TYPE(image) != NPY_UINT16)
+    {
+        Py_DECREF(image);
+        PyErr_SetString(PyExc_TypeError, "find_blobs expects a 2D uint8 or uint16 image");
+        return NULL;
+    }
+    /* Rows may be padded, as in the sequence buffers, but not strided */
+    if (PyArray_STRIDE(image, 1) != PyArray_ITEMSIZE(image) || PyArray_STRIDE(image, 0) < 0)
+    {
+        contiguous = (PyArrayObject *)PyArray_FROMANY((PyObject *)image, PyArray_TYPE(image), 2, 2, NPY_ARRAY_CARRAY);
+        Py_DECREF(image);
+        if (contiguous == NULL)
+        {
+            return NULL;
+        }
+        image = contiguous;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    count = blob_label(PyArray_BYTES(image), (int)PyArray_DIM(image, 1), (int)PyArray_DIM(image, 0), (int)PyArray_STRIDE(image, 0),
+            PyArray_TYPE(image) == NPY_UINT16, threshold, block, dark != 0, threads, &runs);
+    kept = count < 0 ? 0 : blob_collect(runs, count, min_area, max_area, NULL);
+    Py_END_ALLOW_THREADS
+    Py_DECREF(image);
+    if (count < 0)
+    {
+        return PyErr_NoMemory();
+    }
+
+    dimensions[0] = kept;
+    Py_INCREF(blob_descr);
+    result = PyArray_NewFromDescr(&PyArray_Type, blob_descr, 1, dimensions, NULL, NULL, 0, NULL);
+    if (result != NULL)
+    {
+        blob_collect(runs, count, min_area, max_area, (BlobRecord *)PyArray_DATA((PyArrayObject *)result));
+    }
+    free(runs);
+    return result;
+}
+
+/*
+ * One density of the benchmark
+ */
+typedef struct
+{
+    int                size;
+    int                particles;
+    int                repeat;
+    int                threads;
+
+    int                ok;
+    int                blobs;
+    int64_t            best_ns;
+    double             error_px;
+} BlobBenchmark;
+
+static uint32_t benchmark_random(uint32_t * state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+/**
+  * Draws Gaussian spots at random subpixel positions over background noise
+  * @arg centers Set to the x, y of every particle
+  */
+static void benchmark_render(uint8_t * image, int size, int particles, double * centers)
+{
+    uint32_t state = 12345;
+    double cx, cy, value;
+    int radius = (int)ceil(3 * BENCHMARK_SIGMA);
+    int x, y, p;
+    int level;
+
+    for (p = 0; p < size * size; p++)
+    {
+        image[p] = (uint8_t)(BENCHMARK_BACKGROUND + benchmark_random(&state) % BENCHMARK_NOISE);
+    }
+    for (p = 0; p < particles; p++)
+    {
+        cx = radius + (benchmark_random(&state) / 16777216.0) * (size - 2 * radius - 1);
+        cy = radius + (benchmark_random(&state) / 16777216.0) * (size - 2 * radius - 1);
+        centers[2 * p] = cx;
+        centers[2 * p + 1] = cy;
+        for (y = (int)cy - radius; y <= (int)cy + radius + 1; y++)
+        {
+            for (x = (int)cx - radius; x <= (int)cx + radius + 1; x++)
+            {
+                value = BENCHMARK_PEAK * exp(-((x - cx) * (x - cx) + (y - cy) * (y - cy)) / (2 * BENCHMARK_SIGMA * BENCHMARK_SIGMA));
+                level = image[y * size + x] + (int)(value + 0.5);
+                image[y * size + x] = (uint8_t)(level > 255 ? 255 : level);
+            }
+        }
+    }
+}
+
+/**
+  * Times find_blobs on one synthetic image and measures the centroid error
+  * of the blobs that hold exactly one particle
+  */
+static void blob_benchmark_run(BlobBenchmark * bench)
+{
+    uint8_t * image = (uint8_t *)malloc((size_t)bench->size * bench->size);
+    double * centers = (double *)malloc(2 * (size_t)(bench->particles > 0 ? bench->particles : 1) * sizeof(double));
+    BlobRecord * records = NULL;
+    BlobRun * runs = NULL;
+    int64_t start;
+    int64_t elapsed;
+    double squares = 0.0;
+    double dx, dy;
+    int matched = 0;
+    int inside;
+    int count = 0;
+    int i, p, last = 0;
+
+    bench->ok = 0;
+    if (image == NULL || centers == NULL)
+    {
+        goto done;
+    }
+    benchmark_render(image, bench->size, bench->particles, centers);
+
+    for (i = 0; i < bench->repeat; i++)
+    {
+        free(runs);
+        runs = NULL;
+        start = ids_monotonic_ns();
+        count = blob_label((const char *)image, bench->size, bench->size, bench->size, 0, BENCHMARK_THRESHOLD, 0, 0, bench->threads, &runs);
+        if (count >= 0)
+        {
+            bench->blobs = blob_collect(runs, count, 1, (int64_t)1 << 62, NULL);
+        }
+        elapsed = ids_monotonic_ns() - start;
+        if (count < 0)
+        {
+            goto done;
+        }
+        if (i == 0 || elapsed < bench->best_ns)
+        {
+            bench->best_ns = elapsed;
+        }
+    }
+
+    records = (BlobRecord *)malloc((bench->blobs > 0 ? bench->blobs : 1) * sizeof(BlobRecord));
+    if (records == NULL)
+    {
+        goto done;
+    }
+    blob_collect(runs, count, 1, (int64_t)1 << 62, records);
+    for (i = 0; i < bench->blobs; i++)
+    {
+        inside = 0;
+        for (p = 0; p < bench->particles; p++)
+        {
+            if (centers[2 * p] >= records[i].xmin && centers[2 * p] <= records[i].xmax
+                    && centers[2 * p + 1] >= records[i].ymin && centers[2 * p + 1] <= records[i].ymax)
+            {
+                inside++;
+                last = p;
+            }
+        }
+        if (inside == 1)
+        {
+            dx = records[i].x - centers[2 * last];
+            dy = records[i].y - centers[2 * last + 1];
+            squares += dx * dx + dy * dy;
+            matched++;
+        }
+    }
+    bench->error_px = matched > 0 ? sqrt(squares / matched) : 0.0;
+    bench->ok = 1;
+
+done:
+    free(records);
+    free(runs);
+    free(centers);
+    free(image);
+}
+
+/**
+  * Function to measure find_blobs on synthetic particle images
+  * This means the definition of the function is:
+  *     def blob_benchmark(densities=(100, 1000, 10000), size=2048, repeat=5, threads=None)
+  * @arg densities Numbers of particles per image
+  * @return A list of dictionaries with the particles drawn, the blobs found
+  *         (touching particles merge), the best time in ms, the frame rate
+  *         that allows and the RMS centroid error of isolated particles
+  */
+PyObject * ids_blob_benchmark(PyObject * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"densities", "size", "repeat", "threads", NULL};
+    PyObject * densities = NULL;
+    PyObject * sequence;
+    PyObject * threads_obj = Py_None;
+    PyObject * results;
+    PyObject * result;
+    BlobBenchmark bench;
+    int size = DEFAULT_BENCHMARK_SIZE;
+    int repeat = DEFAULT_BENCHMARK_REPEAT;
+    int threads;
+    Py_ssize_t i;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OiiO", kwlist, &densities, &size, &repeat, &threads_obj))
+    {
+        return NULL;
+    }
+    threads = threads_obj == Py_None ? blob_default_threads() : (int)PyLong_AsLong(threads_obj);
+    if (threads == -1 && PyErr_Occurred())
+    {
+        return NULL;
+    }
+    if (size < 64 || repeat < 1 || threads < 1 || threads > BLOB_MAX_THREADS)
+    {
+        PyErr_Format(PyExc_ValueError, "size must be at least 64, repeat positive and threads between 1 and %d", BLOB_MAX_THREADS);
+        return NULL;
+    }
+    if (densities == NULL)
+    {
+        sequence = Py_BuildValue("(iii)", 100, 1000, 10000);
+    }
+    else
+    {
+        sequence = PySequence_Fast(densities, "densities must be a sequence of particle counts");
+    }
+    if (sequence == NULL)
+    {
+        return NULL;
+    }
+
+    results = PyList_New(0);
+    for (i = 0; results != NULL && i < PySequence_Fast_GET_SIZE(sequence); i++)
+    {
+        memset(&bench, 0, sizeof(bench));
+        bench.size = size;
+        bench.repeat = repeat;
+        bench.threads = threads;
+        bench.particles = (int)PyLong_AsLong(PySequence_Fast_GET_ITEM(sequence, i));
+        if (bench.particles < 0 && !PyErr_Occurred())
+        {
+            PyErr_SetString(PyExc_ValueError, "densities must not be negative");
+        }
+        if (PyErr_Occurred())
+        {
+            Py_CLEAR(results);
+            break;
+        }
+
+        Py_BEGIN_ALLOW_THREADS
+        blob_benchmark_run(&bench);
+        Py_END_ALLOW_THREADS
+        if (!bench.ok)
+        {
+            Py_CLEAR(results);
+            PyErr_NoMemory();
+            break;
+        }
+
+        result = Py_BuildValue("{s:i,s:i,s:i,s:d,s:d,s:d}",
+                "particles", bench.particles,
+                "blobs", bench.blobs,
+                "threads", threads,
+                "ms", bench.best_ns / 1e6,
+                "fps", bench.best_ns > 0 ? 1e9 / bench.best_ns : 0.0,
+                "centroid_error_px", bench.error_px);
+        if (result == NULL || PyList_Append(results, result) != 0)
+        {
+            Py_XDECREF(result);
+            Py_CLEAR(results);
+            break;
+        }
+        Py_DECREF(result);
+    }
+    Py_DECREF(sequence);
+    return results;
+}
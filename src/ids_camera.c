@@ -5,8 +5,28 @@
 #include <wchar.h>
 
 extern PyObject * get_gain(Camera * self, int command);
-extern PyObject * camera_get_image(Camera * self);
+extern PyObject * camera_get_image(Camera * self, PyObject * args, PyObject * kwds);
 extern PyObject * camera_video(Camera * self);
+extern PyObject * camera_start_capture(Camera * self, PyObject * args, PyObject * kwds);
+extern PyObject * camera_stop_capture(Camera * self);
+extern PyObject * camera_stream(Camera * self, PyObject * args, PyObject * kwds);
+extern PyObject * camera_preview(Camera * self, PyObject * args, PyObject * kwds);
+extern PyObject * camera_stats(Camera * self);
+extern PyObject * camera_reset_stats(Camera * self);
+extern PyObject * camera_simulate_disconnect(Camera * self);
+extern PyObject * camera_snapshot(Camera * self);
+extern PyObject * camera_apply(Camera * self, PyObject * args);
+extern PyObject * camera_bracket(Camera * self, PyObject * args, PyObject * kwds);
+extern PyObject * camera_gate(Camera * self, PyObject * args, PyObject * kwds);
+extern PyObject * camera_record(Camera * self, PyObject * args, PyObject * kwds);
+extern PyObject * camera_dump(Camera * self, PyObject * args, PyObject * kwds);
+extern PyObject * camera_record_tiff(Camera * self, PyObject * args, PyObject * kwds);
+extern PyObject * camera_timelapse(Camera * self, PyObject * args, PyObject * kwds);
+extern PyObject * camera_set_undistort(Camera * self, PyObject * args, PyObject * kwds);
+extern PyObject * camera_configure_threads(Camera * self, PyObject * args, PyObject * kwds);
+extern PyObject * camera_stress_test(Camera * self, PyObject * args, PyObject * kwds);
+extern PyObject * camera_scaling_benchmark(Camera * self, PyObject * args, PyObject * kwds);
+extern PyObject * camera_device_time_to_host(Camera * self, PyObject * args, PyObject * kwds);
 
 /*
  * Initialize the attributes of the newly created Camera object to 0
@@ -24,6 +44,7 @@ PyObject* camera_new
 
     if (self != NULL)
     {
+        self->state        = (ModuleState *)PyType_GetModuleState(type);
         self->handle       = 0;
         self->width        = 0;
         self->height       = 0;
@@ -31,6 +52,13 @@ PyObject* camera_new
         self->color        = 0;
         self->autofeatures = 0;
         self->status       = (int)NOT_READY;
+        self->output_format = OUTPUT_RAW;
+        self->orientation  = 0;
+        self->undistort    = NULL;
+        camera_capture_init(self);
+        settings_init(self);
+        stats_reset(&self->stats);
+        self->stats.temperature_raw = -1;
     }
     return(PyObject *)self;
 }
@@ -40,12 +68,22 @@ PyObject* camera_new
  */
 void camera_dealloc(Camera* self)
 {
-    if (self->status == READY)
+    PyTypeObject * type = Py_TYPE(self);
+
+    metrics_unregister_camera(self);
+    recorder_close(self);
+    undistort_close(self);
+    timelapse_close(self);
+    camera_capture_destroy(self);
+    settings_destroy(self);
+    /* A camera lost for good already closed its handle */
+    if (self->handle != IS_INVALID_HIDS)
     {
-        is_ExitImageQueue(self->handle);
+        is_ExitCamera(self->handle);
     }
-    is_ExitCamera(self->handle);
-    Py_TYPE(self)->tp_free((PyObject *)self);
+    type->tp_free((PyObject *)self);
+    /* Instances of a heap type hold a reference to it */
+    Py_DECREF(type);
 }
 
 /*
@@ -69,10 +107,10 @@ PyObject * camera_camera_info(Camera * self)
     PyObject * type;
     PyObject * dict = PyDict_New();
 
-    int returnCode = is_GetCameraInfo(self->handle, &cam_info);
+    int returnCode = is_GetCameraInfo(camera_handle(self), &cam_info);
     if (returnCode != IS_SUCCESS)
     {
-        print_error(self);
+        raise_error(self, returnCode);
         return NULL;
     }
 
@@ -163,10 +201,10 @@ PyObject * camera_sensor_info(Camera * self)
     PyObject * color_mode;
     PyObject * dict = PyDict_New();
     
-    int returnCode = is_GetSensorInfo(self->handle, &sensor_info);
+    int returnCode = is_GetSensorInfo(camera_handle(self), &sensor_info);
     if (returnCode!= IS_SUCCESS)
     {
-        print_error(self);
+        raise_error(self, returnCode);
         return NULL;
     }
 
@@ -254,10 +292,10 @@ PyObject * camera_save_settings(Camera * self, PyObject * args)
 
     len = strlen(filename) + 1;
 
-    returnCode = is_ParameterSet(self->handle, IS_PARAMETERSET_CMD_SAVE_FILE, (void *)filename, NULL);
+    returnCode = is_ParameterSet(camera_handle(self), IS_PARAMETERSET_CMD_SAVE_FILE, (void *)filename, NULL);
     if (returnCode != IS_SUCCESS)
     {
-        print_error(self);
+        raise_error(self, returnCode);
         return NULL;
     }
     Py_RETURN_NONE;
@@ -280,10 +318,10 @@ PyObject * camera_load_settings(Camera * self, PyObject * args)
 
     len = strlen(filename) + 1;
 
-    returnCode = is_ParameterSet(self->handle, IS_PARAMETERSET_CMD_LOAD_FILE, (void *)filename, NULL);
+    returnCode = is_ParameterSet(camera_handle(self), IS_PARAMETERSET_CMD_LOAD_FILE, (void *)filename, NULL);
     if (returnCode != IS_SUCCESS)
     {
-        print_error(self);
+        raise_error(self, returnCode);
         return NULL;
     }
     Py_RETURN_NONE;
@@ -299,10 +337,10 @@ PyObject * camera_get_aoi(Camera * self)
     PyObject * dict = PyDict_New();
 
     IS_RECT rectAOI;
-    returnCode = is_AOI(self->handle, IS_AOI_IMAGE_GET_AOI, (void *)&rectAOI, sizeof(rectAOI));
+    returnCode = is_AOI(camera_handle(self), IS_AOI_IMAGE_GET_AOI, (void *)&rectAOI, sizeof(rectAOI));
     if (returnCode != IS_SUCCESS)
     {
-        print_error(self);
+        raise_error(self, returnCode);
         return NULL;
     }
 
@@ -337,13 +375,19 @@ PyObject * camera_set_aoi(Camera * self, PyObject * args, PyObject * kwds)
     rectAOI.s32Width = width;
     rectAOI.s32Height = height;
 
-    returnCode = is_AOI(self->handle, IS_AOI_IMAGE_SET_AOI, (void * )&rectAOI, sizeof(rectAOI));
+    returnCode = is_AOI(camera_handle(self), IS_AOI_IMAGE_SET_AOI, (void * )&rectAOI, sizeof(rectAOI));
     if (returnCode != IS_SUCCESS)
     {
-        print_error(self);
+        raise_error(self, returnCode);
         return NULL;
     }
 
+    ids_mutex_lock(&self->settings_lock);
+    self->settings.aoi = rectAOI;
+    self->settings.applied |= SETTING_AOI;
+    ids_mutex_unlock(&self->settings_lock);
+    settings_refresh_dependents(self);
+
     Py_RETURN_NONE;
 }
 
@@ -397,6 +441,7 @@ int camera_init(Camera * self, PyObject * args, PyObject * kwds)
         PyErr_SetString(PyExc_KeyError, "'manufacturer'");
         return -1;
     }
+    strncpy(self->serial, PyBytes_AsString(PyDict_GetItemString(camera_info, "serial_num")), sizeof(self->serial) - 1);
 
     sensor_info = camera_sensor_info(self);
     if (!sensor_info)
@@ -423,20 +468,18 @@ int camera_init(Camera * self, PyObject * args, PyObject * kwds)
     returnCode = is_GetColorDepth(self->handle, &self->bitdepth, &self->color);
     if (returnCode != IS_SUCCESS)
     {
-        print_error(self);
-        return -1;
-    }
-
-    returnCode = is_InitImageQueue(self->handle, 0);
-    if (returnCode != IS_SUCCESS)
-    {
-        print_error(self);
+        raise_error(self, returnCode);
         return -1;
     }
 
     Py_DECREF(camera_info);
 
     self->status = (int)READY;
+    if (metrics_register_camera(self) != 0 &&
+        PyErr_WarnEx(PyExc_RuntimeWarning, "Out of memory, the camera is left out of the metrics endpoint", 1) < 0)
+    {
+        return -1;
+    }
 
     return 0;
 }
@@ -517,52 +560,90 @@ PyMethodDef camera_methods[] = {
     {"get_aoi", (PyCFunction) camera_get_aoi, METH_VARARGS,
      "Get Area of Interest"
     },
-    {"get_image", (PyCFunction) camera_get_image, METH_NOARGS,
-     "Get the next image waiting in queue"
+    {"set_undistort", (PyCFunction) camera_set_undistort, METH_VARARGS | METH_KEYWORDS,
+     "Remove lens distortion from every frame get_image returns, None turns it off"
+    },
+    {"get_image", (PyCFunction) camera_get_image, METH_VARARGS | METH_KEYWORDS,
+     "Get the next image waiting in queue, raise_on_timeout=False returns None on timeout"
     },
     {"video", (PyCFunction) camera_video, METH_NOARGS,
      "Get the video object"
     },
+    {"start_capture", (PyCFunction) camera_start_capture, METH_VARARGS | METH_KEYWORDS,
+     "Start native capture into a ring of sequence buffers"
+    },
+    {"stop_capture", (PyCFunction) camera_stop_capture, METH_NOARGS,
+     "Stop native capture"
+    },
+    {"stream", (PyCFunction) camera_stream, METH_VARARGS | METH_KEYWORDS,
+     "Serve frames over TCP or a Unix-domain socket, returns a StreamServer"
+    },
+    {"preview", (PyCFunction) camera_preview, METH_VARARGS | METH_KEYWORDS,
+     "Render downscaled RGB frames at a reduced rate, returns a Preview"
+    },
+    {"record", (PyCFunction) camera_record, METH_VARARGS | METH_KEYWORDS,
+     "Keep the most recent frames in host memory, sized in seconds, gigabytes or frames"
+    },
+    {"dump", (PyCFunction) camera_dump, METH_VARARGS | METH_KEYWORDS,
+     "Write the recorded frames from pre seconds before to post seconds after now to a file, returns a Dump"
+    },
+    {"record_tiff", (PyCFunction) camera_record_tiff, METH_VARARGS | METH_KEYWORDS,
+     "Stream frames into multi-page BigTIFF files on background threads, returns a TiffWriter"
+    },
+    {"timelapse", (PyCFunction) camera_timelapse, METH_VARARGS | METH_KEYWORDS,
+     "Take a frame every interval seconds at absolute deadlines, by software trigger or from live video, returns a Timelapse"
+    },
+    {"configure_threads", (PyCFunction) camera_configure_threads, METH_VARARGS | METH_KEYWORDS,
+     "Set CPU affinity, SCHED_FIFO priority and memory locking for the capture, processing or writer threads"
+    },
+    {"stress_test", (PyCFunction) camera_stress_test, METH_VARARGS | METH_KEYWORDS,
+     "Measure frame loss under synthetic CPU load with default and configured capture thread scheduling"
+    },
+    {"scaling_benchmark", (PyCFunction) camera_scaling_benchmark, METH_VARARGS | METH_KEYWORDS,
+     "Measure frames per second analysed by work(frame) running in 1, 2, 4 and 8 threads"
+    },
+    {"device_time_to_host", (PyCFunction) camera_device_time_to_host, METH_VARARGS | METH_KEYWORDS,
+     "Map a device timestamp onto the monotonic (or, with realtime=True, wall) clock in nanoseconds"
+    },
+    {"stats", (PyCFunction) camera_stats, METH_NOARGS,
+     "Returns a dictionary of acquisition counters and per-stage latency histograms"
+    },
+    {"reset_stats", (PyCFunction) camera_reset_stats, METH_NOARGS,
+     "Reset the acquisition counters"
+    },
+    {"snapshot", (PyCFunction) camera_snapshot, METH_NOARGS,
+     "Capture the current settings into a Preset"
+    },
+    {"apply", (PyCFunction) camera_apply, METH_VARARGS,
+     "Apply a Preset, changing only what differs, returns the switch time in seconds"
+    },
+    {"bracket", (PyCFunction) camera_bracket, METH_VARARGS | METH_KEYWORDS,
+     "Cycle through a list of exposures (and gains) frame by frame, each frame's info records its bracket step"
+    },
+    {"gate", (PyCFunction) camera_gate, METH_VARARGS | METH_KEYWORDS,
+     "Only deliver frames around changes in the scene to get_image, None turns gating off"
+    },
+    {"_simulate_disconnect", (PyCFunction) camera_simulate_disconnect, METH_NOARGS,
+     "Handle the camera as if it was unplugged, to exercise reconnecting"
+    },
     {NULL} /* Sentinel */
 };
 
-PyTypeObject ids_CameraType = {
-    PyVarObject_HEAD_INIT(NULL, 0)
-    "ids.Camera",               /* tp_name */
-    sizeof(Camera),             /* tp_basicsize */
-    0,                          /* tp_itemsize */
-    (destructor)camera_dealloc, /* tp_dealloc */
-    0,                         /* tp_print */
-    0,                         /* tp_getattr */
-    0,                         /* tp_setattr */
-    0,                         /* tp_compare */
-    0,                         /* tp_repr */
-    0,                         /* tp_as_number */
-    0,                         /* tp_as_sequence */
-    0,                         /* tp_as_mapping */
-    0,                         /* tp_hash */
-    0,                         /* tp_call */
-    0,                         /* tp_str */
-    0,                         /* tp_getattro */
-    0,                         /* tp_setattro */
-    0,                         /* tp_as_buffer */
-    Py_TPFLAGS_DEFAULT,        /* tp_flags */
-    "Wrapper object around IDS Camera", /* tp_doc */
-    0,                         /* tp_traverse */
-    0,                         /* tp_clear */
-    0,                         /* tp_richcompare */
-    0,                         /* tp_weaklistoffset */
-    0,                         /* tp_iter */
-    0,                         /* tp_iternext */
-    camera_methods,            /* tp_methods */
-    camera_members,            /* tp_members */
-    camera_properties,         /* tp_getset */
-    0,                         /* tp_base */
-    0,                         /* tp_dict */
-    0,                         /* tp_descr_get */
-    0,                         /* tp_descr_set */
-    0,                         /* tp_dictoffset */
-    (initproc)camera_init,     /* tp_init */
-    0,                         /* tp_alloc */
-    camera_new,                /* tp_new */
+static PyType_Slot camera_slots[] = {
+    {Py_tp_dealloc, (void *)camera_dealloc},
+    {Py_tp_doc, (void *)"Wrapper object around IDS Camera"},
+    {Py_tp_methods, camera_methods},
+    {Py_tp_members, camera_members},
+    {Py_tp_getset, camera_properties},
+    {Py_tp_init, (void *)camera_init},
+    {Py_tp_new, (void *)camera_new},
+    {0, NULL} /* Sentinel */
+};
+
+PyType_Spec ids_CameraSpec = {
+    "ids.Camera",              /* name */
+    sizeof(Camera),            /* basicsize */
+    0,                         /* itemsize */
+    IDS_TPFLAGS,               /* flags */
+    camera_slots,              /* slots */
 };
@@ -0,0 +1,293 @@
+#include <uEye.h>
+#include "ids.h"
+#include <string.h>
+
+/* Frames between writing a setting and the first frame exposed with it */
+#define DEFAULT_BRACKET_LATENCY 2
+
+/**
+  * Programs one sequencer set per bracket step, each switching to the next
+  * at the end of its frame, and starts the sequencer at the first set
+  * @return IS_SUCCESS, or the code of the first call that failed
+  */
+static int sequencer_program(HIDS handle, const Bracket * bracket)
+{
+    IS_SEQUENCER_PATH path;
+    UINT features = 0;
+    UINT value;
+    UINT set;
+    UINT feature;
+    double feature_value;
+    int returnCode;
+    int i;
+
+    returnCode = is_Sequencer(handle, IS_SEQUENCER_FEATURE_SUPPORTED_GET, (void *)&features, sizeof(features));
+    if (returnCode != IS_SUCCESS)
+    {
+        return returnCode;
+    }
+    if (!(features & IS_FEATURE_EXPOSURE) || (bracket->has_gain && !(features & IS_FEATURE_GAIN)))
+    {
+        return IS_NOT_SUPPORTED;
+    }
+
+    value = 0;
+    is_Sequencer(handle, IS_SEQUENCER_MODE_ENABLED_SET, (void *)&value, sizeof(value));
+    value = 1;
+    returnCode = is_Sequencer(handle, IS_SEQUENCER_CONFIGURATION_ENABLED_SET, (void *)&value, sizeof(value));
+    if (returnCode != IS_SUCCESS)
+    {
+        return returnCode;
+    }
+
+    for (i = 0; i < bracket->count && returnCode == IS_SUCCESS; i++)
+    {
+        set = i + 1;
+        returnCode = is_Sequencer(handle, IS_SEQUENCER_SET_SELECTED_SET, (void *)&set, sizeof(set));
+        if (returnCode != IS_SUCCESS)
+        {
+            break;
+        }
+
+        feature = IS_FEATURE_EXPOSURE;
+        feature_value = bracket->exposure[i];
+        is_Sequencer(handle, IS_SEQUENCER_FEATURE_SELECTED_SET, (void *)&feature, sizeof(feature));
+        returnCode = is_Sequencer(handle, IS_SEQUENCER_FEATURE_VALUE_SET, (void *)&feature_value, sizeof(feature_value));
+        if (returnCode == IS_SUCCESS && bracket->has_gain)
+        {
+            feature = IS_FEATURE_GAIN;
+            feature_value = bracket->gain[i];
+            is_Sequencer(handle, IS_SEQUENCER_FEATURE_SELECTED_SET, (void *)&feature, sizeof(feature));
+            returnCode = is_Sequencer(handle, IS_SEQUENCER_FEATURE_VALUE_SET, (void *)&feature_value, sizeof(feature_value));
+        }
+
+        path.u32PathIndex = 0;
+        path.u32NextIndex = (i + 1) % bracket->count + 1;
+        path.u32TriggerSource = IS_TRIGGER_SOURCE_FRAME_END;
+        path.u32TriggerActivation = IS_TRIGGER_ACTIVATION_RISINGEDGE;
+        if (returnCode == IS_SUCCESS)
+        {
+            returnCode = is_Sequencer(handle, IS_SEQUENCER_SET_PATH_SET, (void *)&path, sizeof(path));
+        }
+        if (returnCode == IS_SUCCESS)
+        {
+            returnCode = is_Sequencer(handle, IS_SEQUENCER_SET_SAVE, (void *)&set, sizeof(set));
+        }
+    }
+
+    if (returnCode == IS_SUCCESS)
+    {
+        set = 1;
+        returnCode = is_Sequencer(handle, IS_SEQUENCER_SET_START_SET, (void *)&set, sizeof(set));
+    }
+    value = 0;
+    is_Sequencer(handle, IS_SEQUENCER_CONFIGURATION_ENABLED_SET, (void *)&value, sizeof(value));
+    if (returnCode == IS_SUCCESS)
+    {
+        value = 1;
+        returnCode = is_Sequencer(handle, IS_SEQUENCER_MODE_ENABLED_SET, (void *)&value, sizeof(value));
+    }
+    return returnCode;
+}
+
+static void sequencer_disable(HIDS handle)
+{
+    UINT value = 0;
+
+    is_Sequencer(handle, IS_SEQUENCER_MODE_ENABLED_SET, (void *)&value, sizeof(value));
+}
+
+/**
+  * Sets the camera up for the configured bracket, preferring the sequencer
+  * and falling back to the capture thread controller. Called while capture
+  * is stopped, and after a reconnect. Does not need the GIL.
+  */
+void bracket_program(Camera * self, HIDS handle)
+{
+    Bracket * bracket = &self->capture.bracket;
+    int i;
+
+    bracket->next = 0;
+    for (i = 0; i < BRACKET_SCHEDULE_SIZE; i++)
+    {
+        bracket->schedule[i].index = -1;
+    }
+    if (bracket->count == 0)
+    {
+        return;
+    }
+
+    bracket->use_sequencer = sequencer_program(handle, bracket) == IS_SUCCESS;
+    if (!bracket->use_sequencer)
+    {
+        sequencer_disable(handle);
+    }
+}
+
+/**
+  * Tags a dequeued frame with the bracket step it was exposed with and,
+  * when the controller drives the bracket, programs the step for the frame
+  * latency frames ahead. Called on the capture thread for every frame.
+  */
+void bracket_on_frame(Camera * self, FrameSlot * slot)
+{
+    Bracket * bracket = &self->capture.bracket;
+    uint64_t frame_number = slot->info.u64FrameNumber;
+    int entry = (int)(frame_number % BRACKET_SCHEDULE_SIZE);
+    int next;
+    int index = -1;
+
+    if (bracket->count == 0)
+    {
+        slot->bracket_index = -1;
+        return;
+    }
+
+    if (bracket->use_sequencer)
+    {
+        index = (int)slot->info.bySequencerIndex - 1;
+    }
+    else
+    {
+        if (bracket->schedule[entry].index >= 0 && bracket->schedule[entry].frame_number == frame_number)
+        {
+            index = bracket->schedule[entry].index;
+        }
+        bracket->schedule[entry].index = -1;
+
+        next = bracket->next;
+        bracket->next = (next + 1) % bracket->count;
+        is_Exposure(self->handle, IS_EXPOSURE_CMD_SET_EXPOSURE, (void *)&bracket->exposure[next], sizeof(double));
+        if (bracket->has_gain)
+        {
+            is_SetHardwareGain(self->handle, bracket->gain[next], IS_IGNORE_PARAMETER, IS_IGNORE_PARAMETER, IS_IGNORE_PARAMETER);
+        }
+        entry = (int)((frame_number + bracket->latency) % BRACKET_SCHEDULE_SIZE);
+        bracket->schedule[entry].frame_number = frame_number + bracket->latency;
+        bracket->schedule[entry].index = next;
+    }
+
+    if (index < 0 || index >= bracket->count)
+    {
+        slot->bracket_index = -1;
+        return;
+    }
+    slot->bracket_index = index;
+    slot->bracket_exposure = bracket->exposure[index];
+    slot->bracket_gain = bracket->has_gain ? bracket->gain[index] : -1;
+}
+
+/**
+  * Configures exposure bracketing
+  * def bracket(self, exposures, gains=None, latency=2)
+  * @arg exposures Exposure times in ms cycled through frame by frame, None or
+  *      an empty list turns bracketing off
+  * @arg gains Optional master gains, one per exposure
+  * @arg latency Frames between setting a parameter and the first frame taken
+  *      with it, only used when the sequencer is not available
+  * @return "sequencer" or "controller" depending on what drives the bracket,
+  *      None when bracketing was turned off
+  */
+PyObject * camera_bracket(Camera * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"exposures", "gains", "latency", NULL};
+    Bracket * bracket = &self->capture.bracket;
+    PyObject * exposures = Py_None;
+    PyObject * gains = Py_None;
+    PyObject * exposure_seq = NULL;
+    PyObject * gain_seq = NULL;
+    CameraSettings restore;
+    int latency = DEFAULT_BRACKET_LATENCY;
+    int count = 0;
+    int buffers = 0;
+    int result;
+    int i;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OOi", kwlist, &exposures, &gains, &latency))
+    {
+        return NULL;
+    }
+
+    if (exposures != Py_None)
+    {
+        exposure_seq = PySequence_Fast(exposures, "exposures must be a sequence");
+        if (exposure_seq == NULL)
+        {
+            return NULL;
+        }
+        count = (int)PySequence_Fast_GET_SIZE(exposure_seq);
+    }
+    if (count > MAX_BRACKET_STEPS || latency < 0 || latency >= BRACKET_SCHEDULE_SIZE)
+    {
+        Py_XDECREF(exposure_seq);
+        PyErr_Format(PyExc_ValueError, "At most %d exposures and a latency below %d frames are supported", MAX_BRACKET_STEPS, BRACKET_SCHEDULE_SIZE);
+        return NULL;
+    }
+    if (count > 0 && gains != Py_None)
+    {
+        gain_seq = PySequence_Fast(gains, "gains must be a sequence");
+        if (gain_seq == NULL || PySequence_Fast_GET_SIZE(gain_seq) != count)
+        {
+            Py_XDECREF(gain_seq);
+            Py_DECREF(exposure_seq);
+            if (!PyErr_Occurred())
+            {
+                PyErr_SetString(PyExc_ValueError, "gains must have one entry per exposure");
+            }
+            return NULL;
+        }
+    }
+
+    capture_control_lock(self);
+    if (self->capture.running)
+    {
+        buffers = capture_buffer_count(self);
+        camera_capture_stop(self);
+    }
+
+    /* Leave the camera at the exposure and gain last set through the properties */
+    if (bracket->count > 0)
+    {
+        sequencer_disable(camera_handle(self));
+        settings_snapshot(self, &restore);
+        restore.applied &= SETTING_EXPOSURE | SETTING_MASTER_GAIN;
+        settings_apply(camera_handle(self), &restore);
+    }
+
+    bracket->count = 0;
+    bracket->has_gain = gain_seq != NULL;
+    bracket->latency = latency;
+    for (i = 0; i < count; i++)
+    {
+        bracket->exposure[i] = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(exposure_seq, i));
+        if (gain_seq != NULL)
+        {
+            bracket->gain[i] = (int)PyLong_AsLong(PySequence_Fast_GET_ITEM(gain_seq, i));
+        }
+    }
+    Py_XDECREF(exposure_seq);
+    Py_XDECREF(gain_seq);
+    if (PyErr_Occurred())
+    {
+        capture_control_unlock(self);
+        return NULL;
+    }
+    bracket->count = count;
+
+    Py_BEGIN_ALLOW_THREADS
+    bracket_program(self, camera_handle(self));
+    Py_END_ALLOW_THREADS
+
+    result = buffers != 0 ? camera_capture_start(self, buffers) : 0;
+    capture_control_unlock(self);
+    if (result != 0)
+    {
+        return NULL;
+    }
+
+    if (count == 0)
+    {
+        Py_RETURN_NONE;
+    }
+    return Py_BuildValue("s", bracket->use_sequencer ? "sequencer" : "controller");
+}
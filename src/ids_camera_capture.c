@@ -0,0 +1,1201 @@
+#include <uEye.h>
+#include "ids.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* How long the capture thread blocks in the SDK before re-checking for shutdown */
+#define CAPTURE_POLL_TIMEOUT 100
+
+/* Interval between attempts to reopen a lost camera while it settles after arriving, or without the arrival event */
+#define RECONNECT_POLL_MS 250
+/* How long attempts keep being made at RECONNECT_POLL_MS after an arrival */
+#define RECONNECT_SETTLE_MS 2000
+/* Longest wait for an arrival event before trying to reopen anyway */
+#define RECONNECT_FALLBACK_MS 2000
+
+/* Alignment of every sequence buffer handed to the SDK, a page so SIMD loads never straddle one */
+#define BUFFER_ALIGNMENT 4096
+
+/**
+  * Frees the buffers of a ring once nothing references it anymore. The SDK
+  * registrations are dropped only while the ring's handle is still open.
+  */
+void frame_ring_decref(FrameRing * ring)
+{
+    int i;
+
+    if (ids_atomic_dec(&ring->refcount) != 0)
+    {
+        return;
+    }
+
+    for (i = 0; i < ring->count; i++)
+    {
+        if (ring->slots[i].pBuffer != NULL && !ring->closed)
+        {
+            is_FreeImageMem(ring->handle, ring->slots[i].pBuffer, ring->slots[i].memID);
+        }
+        free(ring->slots[i].frame_stats);
+    }
+    /* is_FreeImageMem only unregisters memory passed to is_SetAllocatedImageMem */
+    ids_large_free(ring->memory, ring->memory_size);
+    ids_mutex_destroy(&ring->lock);
+    free(ring->slots);
+    free(ring);
+}
+
+/**
+  * Marks the ring's handle as closed, so that releasing its slots no longer
+  * calls into the SDK. Once this returns no unlock is in flight, and the
+  * handle may be closed even though Python still holds frames of the ring.
+  */
+static void frame_ring_close(FrameRing * ring)
+{
+    ids_mutex_lock(&ring->lock);
+    ring->closed = 1;
+    ids_mutex_unlock(&ring->lock);
+}
+
+/**
+  * Takes a reference to the ring of the running capture, which the capture
+  * thread replaces when it reopens a lost camera
+  * @return The ring, to be given back with frame_ring_decref, or NULL when
+  *         capture is stopped
+  */
+FrameRing * capture_ring_acquire(Camera * self)
+{
+    FrameRing * ring;
+
+    ids_mutex_lock(&self->settings_lock);
+    ring = self->capture.ring;
+    if (ring != NULL)
+    {
+        ids_atomic_inc(&ring->refcount);
+    }
+    ids_mutex_unlock(&self->settings_lock);
+    return ring;
+}
+
+/**
+  * Number of sequence buffers of the running capture
+  * @return The count, or DEFAULT_CAPTURE_BUFFERS when capture is stopped
+  */
+int capture_buffer_count(Camera * self)
+{
+    FrameRing * ring = capture_ring_acquire(self);
+    int count = DEFAULT_CAPTURE_BUFFERS;
+
+    if (ring != NULL)
+    {
+        count = ring->count;
+        frame_ring_decref(ring);
+    }
+    return count;
+}
+
+/**
+  * Replaces the handle and ring that other threads reach through
+  * camera_handle and capture_ring_acquire
+  */
+static void capture_publish(Camera * self, HIDS handle, FrameRing * ring)
+{
+    ids_mutex_lock(&self->settings_lock);
+    self->handle = handle;
+    self->capture.ring = ring;
+    ids_mutex_unlock(&self->settings_lock);
+}
+
+/**
+  * Allocates one page-aligned block for all sequence buffers, on the
+  * configured NUMA node and on huge pages if requested. The module owns the
+  * memory rather than the SDK, so frames held by Python stay readable after
+  * the handle of a lost camera was closed.
+  * @return The size of one buffer, 0 on failure
+  */
+static size_t frame_ring_alloc_memory(Camera * self, FrameRing * ring, int buffers)
+{
+    size_t line = ((size_t)self->width * ((self->bitdepth + 7) / 8) + 63) & ~(size_t)63;
+    size_t size = (line * self->height + BUFFER_ALIGNMENT - 1) & ~(size_t)(BUFFER_ALIGNMENT - 1);
+
+    ring->numa_node = self->capture.numa_node;
+    ring->memory_size = size * buffers;
+    ring->memory = (char *)ids_large_alloc(ring->memory_size, self->capture.huge_pages, ring->numa_node, &ring->huge_pages);
+    return ring->memory != NULL ? size : 0;
+}
+
+/**
+  * Allocates a ring of sequence buffers sized for the full sensor and adds
+  * every buffer to the SDK image sequence of handle. Does not need the GIL.
+  * @arg returnCode Receives the SDK error when the allocation fails
+  * @return The new ring, or NULL on failure
+  */
+static FrameRing * frame_ring_alloc(Camera * self, HIDS handle, int buffers, int * returnCode)
+{
+    FrameRing * ring;
+    size_t buffer_size = 0;
+    int i;
+
+    *returnCode = IS_OUT_OF_MEMORY;
+    ring = (FrameRing *)calloc(1, sizeof(FrameRing));
+    if (ring == NULL)
+    {
+        return NULL;
+    }
+    ring->slots = (FrameSlot *)calloc(buffers, sizeof(FrameSlot));
+    if (ring->slots == NULL)
+    {
+        free(ring);
+        return NULL;
+    }
+
+    ring->handle = handle;
+    ring->refcount = 1;
+    ring->count = buffers;
+    ring->width = self->width;
+    ring->height = self->height;
+    ring->bitdepth = self->bitdepth;
+    ring->color = self->color;
+    ring->stats = &self->stats;
+    ring->numa_node = -1;
+    ids_mutex_init(&ring->lock);
+
+    buffer_size = frame_ring_alloc_memory(self, ring, buffers);
+    if (buffer_size == 0)
+    {
+        frame_ring_decref(ring);
+        return NULL;
+    }
+
+    for (i = 0; i < buffers; i++)
+    {
+        FrameSlot * slot = &ring->slots[i];
+        slot->ring = ring;
+
+        slot->pBuffer = ring->memory + i * buffer_size;
+        *returnCode = is_SetAllocatedImageMem(handle, self->width, self->height, self->bitdepth, slot->pBuffer, &slot->memID);
+        if (*returnCode != IS_SUCCESS)
+        {
+            slot->pBuffer = NULL;
+            is_ClearSequence(handle);
+            frame_ring_decref(ring);
+            return NULL;
+        }
+
+        *returnCode = is_AddToSequence(handle, slot->pBuffer, slot->memID);
+        if (*returnCode != IS_SUCCESS)
+        {
+            is_ClearSequence(handle);
+            frame_ring_decref(ring);
+            return NULL;
+        }
+    }
+
+    if (is_GetImageMemPitch(handle, &ring->pitch) != IS_SUCCESS)
+    {
+        ring->pitch = self->width * ((self->bitdepth + 7) / 8);
+    }
+
+    ring->memory_locked = thread_options_lock_memory(self, THREAD_CAPTURE, ring->memory, ring->memory_size);
+
+    *returnCode = IS_SUCCESS;
+    return ring;
+}
+
+static FrameSlot * frame_ring_lookup(FrameRing * ring, INT memID, char * pBuffer)
+{
+    int i;
+
+    for (i = 0; i < ring->count; i++)
+    {
+        if (ring->slots[i].memID == memID || ring->slots[i].pBuffer == pBuffer)
+        {
+            return &ring->slots[i];
+        }
+    }
+    return NULL;
+}
+
+void frame_slot_retain(FrameSlot * slot)
+{
+    CameraStats * stats = slot->ring->stats;
+
+    if (ids_atomic_inc(&slot->refcount) == 1)
+    {
+        ids_atomic_inc(&slot->ring->refcount);
+        ids_atomic_max64(&stats->locked_buffers_high_water, ids_atomic_add64(&stats->locked_buffers, 1));
+    }
+}
+
+/**
+  * Drops a reference to a slot, handing the buffer back to the SDK once the
+  * last user is done with it
+  */
+void frame_slot_release(FrameSlot * slot)
+{
+    FrameRing * ring = slot->ring;
+    int64_t trace_start;
+
+    if (ids_atomic_dec(&slot->refcount) != 0)
+    {
+        return;
+    }
+
+    ids_atomic_add64(&ring->stats->locked_buffers, -1);
+    TRACE_BEGIN(trace_start);
+    ids_mutex_lock(&ring->lock);
+    if (!ring->closed)
+    {
+        is_UnlockSeqBuf(ring->handle, slot->memID, slot->pBuffer);
+    }
+    ids_mutex_unlock(&ring->lock);
+    TRACE_END("unlock", trace_start, slot->sequence);
+    frame_ring_decref(ring);
+}
+
+/**
+  * Queues a slot for get_image, taking over the caller's reference. When the
+  * consumer falls behind the oldest queued frame is dropped so the SDK always
+  * keeps free buffers to capture into.
+  */
+void capture_deliver(Camera * self, FrameSlot * slot)
+{
+    Capture * capture = &self->capture;
+    FrameSlot * dropped = NULL;
+    int tail;
+
+    ids_mutex_lock(&capture->lock);
+    if (capture->delivery_count == capture->delivery_capacity)
+    {
+        dropped = capture->delivery[capture->delivery_head];
+        capture->delivery_head = (capture->delivery_head + 1) % capture->delivery_capacity;
+        capture->delivery_count--;
+    }
+    tail = (capture->delivery_head + capture->delivery_count) % capture->delivery_capacity;
+    capture->delivery[tail] = slot;
+    capture->delivery_count++;
+    ids_atomic_max64(&self->stats.delivery_high_water, capture->delivery_count);
+    ids_cond_signal(&capture->frame_ready);
+    ids_mutex_unlock(&capture->lock);
+
+    if (dropped != NULL)
+    {
+        ids_atomic_add64(&self->stats.frames_dropped, 1);
+        frame_slot_release(dropped);
+    }
+}
+
+static void capture_dispatch(Capture * capture, FrameSlot * slot)
+{
+    int i;
+
+    ids_mutex_lock(&capture->sink_lock);
+    for (i = 0; i < capture->num_sinks; i++)
+    {
+        capture->sinks[i].func(capture->sinks[i].context, slot);
+    }
+    ids_mutex_unlock(&capture->sink_lock);
+}
+
+/**
+  * Arms the device removal notification on the camera handle
+  */
+static void device_events_enable(Camera * self, HIDS handle)
+{
+#ifdef _WIN32
+    Capture * capture = &self->capture;
+
+    if (capture->remove_event == NULL)
+    {
+        capture->remove_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+    }
+    is_InitEvent(handle, capture->remove_event, IS_SET_EVENT_REMOVE);
+#endif
+    is_EnableEvent(handle, IS_SET_EVENT_REMOVE);
+}
+
+static void device_events_disable(HIDS handle)
+{
+    is_DisableEvent(handle, IS_SET_EVENT_REMOVE);
+#ifdef _WIN32
+    is_ExitEvent(handle, IS_SET_EVENT_REMOVE);
+#endif
+}
+
+/*
+ * Notification for cameras plugged into the system, armed while any camera
+ * is being reconnected. The SDK raises it on handle 0, independent of any
+ * camera. Whichever capture thread sees it counts it in arrival_count, so an
+ * arrival wakes every camera waiting to be reconnected.
+ */
+static ids_mutex_t arrival_lock;
+static int arrival_users;
+static int arrival_armed;
+static volatile long arrival_count;
+#ifdef _WIN32
+static HANDLE arrival_event;
+#endif
+
+void capture_init(void)
+{
+    ids_mutex_init(&arrival_lock);
+}
+
+/**
+  * Arms the arrival notification for one more reconnecting camera
+  * @return 1 if it is armed, 0 if reconnecting has to poll
+  */
+static int device_arrival_enable(void)
+{
+    int armed;
+
+    ids_mutex_lock(&arrival_lock);
+    if (arrival_users++ == 0)
+    {
+#ifdef _WIN32
+        if (arrival_event == NULL)
+        {
+            arrival_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+        }
+        arrival_armed = arrival_event != NULL &&
+                        is_InitEvent(0, arrival_event, IS_SET_EVENT_NEW_DEVICE) == IS_SUCCESS &&
+                        is_EnableEvent(0, IS_SET_EVENT_NEW_DEVICE) == IS_SUCCESS;
+#else
+        arrival_armed = is_EnableEvent(0, IS_SET_EVENT_NEW_DEVICE) == IS_SUCCESS;
+#endif
+    }
+    armed = arrival_armed;
+    ids_mutex_unlock(&arrival_lock);
+    return armed;
+}
+
+static void device_arrival_disable(void)
+{
+    ids_mutex_lock(&arrival_lock);
+    if (--arrival_users == 0 && arrival_armed)
+    {
+        is_DisableEvent(0, IS_SET_EVENT_NEW_DEVICE);
+#ifdef _WIN32
+        is_ExitEvent(0, IS_SET_EVENT_NEW_DEVICE);
+#endif
+        arrival_armed = 0;
+    }
+    ids_mutex_unlock(&arrival_lock);
+}
+
+/**
+  * Waits until a camera is plugged in, in slices short enough to notice
+  * when capture stops
+  * @arg seen The arrival count this thread has acted on, updated on return
+  * @return 1 after an arrival, 0 on timeout or when capture stopped
+  */
+static int device_arrival_wait(Capture * capture, long * seen, int timeout_ms)
+{
+    int64_t deadline = ids_monotonic_ns() + (int64_t)timeout_ms * 1000000LL;
+    int arrived;
+
+    while (capture->running && ids_monotonic_ns() < deadline)
+    {
+        if (arrival_count != *seen)
+        {
+            *seen = arrival_count;
+            return 1;
+        }
+#ifdef _WIN32
+        arrived = WaitForSingleObject(arrival_event, CAPTURE_POLL_TIMEOUT) == WAIT_OBJECT_0;
+#else
+        arrived = is_WaitEvent(0, IS_SET_EVENT_NEW_DEVICE, CAPTURE_POLL_TIMEOUT) == IS_SUCCESS;
+#endif
+        if (arrived)
+        {
+            ids_atomic_inc(&arrival_count);
+        }
+    }
+    return 0;
+}
+
+/**
+  * Decides whether a failed wait means the camera is gone
+  */
+static int device_lost(Camera * self, int returnCode)
+{
+    if (returnCode == IS_INVALID_CAMERA_HANDLE)
+    {
+        return 1;
+    }
+#ifdef _WIN32
+    return self->capture.remove_event != NULL && WaitForSingleObject(self->capture.remove_event, 0) == WAIT_OBJECT_0;
+#else
+    return is_WaitEvent(self->handle, IS_SET_EVENT_REMOVE, 0) == IS_SUCCESS;
+#endif
+}
+
+/**
+  * Looks up the device id of the camera with the given serial number
+  * @arg handle Receives the device id tagged with IS_USE_DEVICE_ID, ready for is_InitCamera
+  */
+static int find_device(const char * serial, HIDS * handle)
+{
+    UEYE_CAMERA_LIST * cameras;
+    int num_cams;
+    int returnCode;
+    int i;
+
+    returnCode = is_GetNumberOfCameras(&num_cams);
+    if (returnCode != IS_SUCCESS)
+    {
+        return returnCode;
+    }
+    if (num_cams == 0 || serial[0] == '\0')
+    {
+        return IS_CANT_OPEN_DEVICE;
+    }
+
+    cameras = (UEYE_CAMERA_LIST *)malloc(sizeof(DWORD) + num_cams * sizeof(UEYE_CAMERA_INFO));
+    if (cameras == NULL)
+    {
+        return IS_OUT_OF_MEMORY;
+    }
+    cameras->dwCount = num_cams;
+
+    returnCode = is_GetCameraList(cameras);
+    if (returnCode == IS_SUCCESS)
+    {
+        returnCode = IS_CANT_OPEN_DEVICE;
+        for (i = 0; i < (int)cameras->dwCount; i++)
+        {
+            if (strcmp(cameras->uci[i].SerNo, serial) == 0)
+            {
+                *handle = (HIDS)(cameras->uci[i].dwDeviceID | IS_USE_DEVICE_ID);
+                returnCode = IS_SUCCESS;
+                break;
+            }
+        }
+    }
+
+    free(cameras);
+    return returnCode;
+}
+
+/**
+  * Opens the camera again, restores its settings and buffer ring and restarts
+  * live capture on it. On success self->handle and capture->ring are replaced
+  * under the settings lock.
+  */
+static int capture_reopen(Camera * self, int buffers)
+{
+    Capture * capture = &self->capture;
+    CameraSettings settings;
+    FrameRing * ring;
+    HIDS handle;
+    int returnCode;
+
+    returnCode = find_device(self->serial, &handle);
+    if (returnCode != IS_SUCCESS)
+    {
+        return returnCode;
+    }
+    returnCode = is_InitCamera(&handle, NULL);
+    if (returnCode != IS_SUCCESS)
+    {
+        return returnCode;
+    }
+
+    /* A setting the device now rejects must not keep it offline */
+    settings_snapshot(self, &settings);
+    settings_apply(handle, &settings);
+    bracket_program(self, handle);
+
+    ring = frame_ring_alloc(self, handle, buffers, &returnCode);
+    if (ring == NULL)
+    {
+        goto fail_camera;
+    }
+    returnCode = is_InitImageQueue(handle, 0);
+    if (returnCode != IS_SUCCESS)
+    {
+        goto fail_ring;
+    }
+    /* A timelapse in trigger mode keeps live video off */
+    returnCode = capture->idle ? IS_SUCCESS : is_CaptureVideo(handle, IS_DONT_WAIT);
+    if (returnCode != IS_SUCCESS)
+    {
+        goto fail_queue;
+    }
+
+    device_events_enable(self, handle);
+    capture_publish(self, handle, ring);
+    return IS_SUCCESS;
+
+fail_queue:
+    is_ExitImageQueue(handle);
+fail_ring:
+    is_ClearSequence(handle);
+    frame_ring_decref(ring);
+fail_camera:
+    is_ExitCamera(handle);
+    return returnCode;
+}
+
+/**
+  * Called on the capture thread once the camera is gone. Closes the stale
+  * handle first, the SDK does not open a device again while it is still held
+  * open, then keeps trying to reopen the camera by serial number until that
+  * succeeds or capture stops. Between attempts it waits for the SDK to report
+  * a new device, and polls only while a device settles after arriving, when
+  * no arrival was seen for RECONNECT_FALLBACK_MS, or when the SDK cannot
+  * report arrivals. Frames still held by Python keep the old ring's memory
+  * alive until they are released.
+  * @return 0 once capture resumed, -1 if capture was stopped meanwhile
+  */
+static int capture_recover(Camera * self)
+{
+    Capture * capture = &self->capture;
+    FrameRing * lost_ring = capture->ring;
+    HIDS lost_handle = self->handle;
+    int64_t lost_ns = ids_monotonic_ns();
+    int64_t attempt_ns;
+    int64_t settle_until_ns = 0;
+    int64_t downtime;
+    long seen_arrivals = arrival_count;
+    int armed;
+    int waited_ms;
+
+    capture->last_error = IS_INVALID_CAMERA_HANDLE;
+    ids_atomic_store64(&capture->disconnected_since_ns, lost_ns);
+    ids_atomic_add64(&self->stats.disconnects, 1);
+    self->status = (int)NOT_READY;
+
+    is_StopLiveVideo(lost_handle, IS_DONT_WAIT);
+    is_ExitImageQueue(lost_handle);
+    is_ClearSequence(lost_handle);
+    device_events_disable(lost_handle);
+    frame_ring_close(lost_ring);
+    /* Nobody reaches the stale handle anymore, even once the SDK hands its number out again */
+    capture_publish(self, IS_INVALID_HIDS, lost_ring);
+    is_ExitCamera(lost_handle);
+    armed = device_arrival_enable();
+
+    while (capture->running)
+    {
+        attempt_ns = ids_monotonic_ns();
+        if (capture_reopen(self, lost_ring->count) == IS_SUCCESS)
+        {
+            break;
+        }
+        if (armed && attempt_ns >= settle_until_ns)
+        {
+            if (device_arrival_wait(capture, &seen_arrivals, RECONNECT_FALLBACK_MS))
+            {
+                settle_until_ns = ids_monotonic_ns() + RECONNECT_SETTLE_MS * 1000000LL;
+            }
+            continue;
+        }
+        waited_ms = (int)((ids_monotonic_ns() - attempt_ns) / 1000000LL);
+        if (waited_ms < RECONNECT_POLL_MS)
+        {
+            ids_sleep_ms(RECONNECT_POLL_MS - waited_ms);
+        }
+    }
+    device_arrival_disable();
+    if (capture->ring == lost_ring)
+    {
+        return -1;
+    }
+    frame_ring_decref(lost_ring);
+
+    downtime = ids_monotonic_ns() - lost_ns;
+    ids_atomic_store64(&self->stats.last_downtime_ns, downtime);
+    ids_atomic_add64(&self->stats.downtime_ns, downtime);
+    ids_atomic_add64(&self->stats.reconnects, 1);
+    ids_atomic_store64(&capture->disconnected_since_ns, 0);
+    self->status = (int)READY;
+    return 0;
+}
+
+/**
+  * Body of the native capture thread. Runs without the GIL and never touches
+  * Python objects.
+  */
+static void capture_thread_main(void * arg)
+{
+    Camera * self = (Camera *)arg;
+    Capture * capture = &self->capture;
+    FrameRing * ring = capture->ring;
+    FrameSlot * slot;
+    char * pBuffer;
+    INT memID;
+    int returnCode;
+    int passed;
+    int64_t wait_start;
+    int64_t trace_start;
+
+    trace_thread_name("ids capture");
+    if (capture->numa_node >= 0)
+    {
+        /* Best effort, the capture runs unbound where the OS refuses */
+        ids_thread_bind_node(capture->numa_node);
+    }
+    /* An explicit CPU list takes precedence over the node */
+    thread_options_apply(self, THREAD_CAPTURE);
+
+    while (capture->running)
+    {
+        stats_poll_capture_status(self);
+
+        wait_start = ids_monotonic_ns();
+        if (capture->simulate_loss)
+        {
+            capture->simulate_loss = 0;
+            returnCode = IS_INVALID_CAMERA_HANDLE;
+        }
+        else
+        {
+            returnCode = is_WaitForNextImage(self->handle, CAPTURE_POLL_TIMEOUT, &pBuffer, &memID);
+        }
+        if (returnCode != IS_SUCCESS && device_lost(self, returnCode))
+        {
+            if (capture_recover(self) != 0)
+            {
+                break;
+            }
+            ring = capture->ring;
+            continue;
+        }
+        if (returnCode == IS_TIMED_OUT)
+        {
+            continue;
+        }
+        if (returnCode != IS_SUCCESS)
+        {
+            ids_atomic_add64(&self->stats.wait_errors, 1);
+            capture->last_error = returnCode;
+            ids_sleep_ms(1);
+            continue;
+        }
+        capture->last_error = 0;
+
+        slot = frame_ring_lookup(ring, memID, pBuffer);
+        if (slot == NULL)
+        {
+            is_UnlockSeqBuf(self->handle, memID, pBuffer);
+            continue;
+        }
+
+        frame_slot_retain(slot);
+        slot->dequeue_ns = ids_monotonic_ns();
+        slot->sequence = capture->sequence++;
+        /* Only waits that returned a frame, timeouts are polls */
+        if (ids_trace_enabled)
+        {
+            trace_record("sdk_wait", wait_start, slot->sequence);
+        }
+
+        TRACE_BEGIN(trace_start);
+        if (is_GetImageInfo(self->handle, memID, &slot->info, sizeof(slot->info)) != IS_SUCCESS)
+        {
+            memset(&slot->info, 0, sizeof(slot->info));
+        }
+        TRACE_END("image_info", trace_start, slot->sequence);
+
+        TRACE_BEGIN(trace_start);
+        stats_on_capture(self, slot, slot->dequeue_ns - wait_start);
+        clock_on_frame(self, slot);
+        bracket_on_frame(self, slot);
+        frame_stats_on_capture(self, slot);
+        passed = timelapse_on_frame(self, slot);
+        TRACE_END("capture_hooks", trace_start, slot->sequence);
+        if (!passed)
+        {
+            /* Streamed between two deadlines of a timelapse */
+            frame_slot_release(slot);
+            continue;
+        }
+
+        TRACE_BEGIN(trace_start);
+        capture_dispatch(capture, slot);
+        TRACE_END("sinks", trace_start, slot->sequence);
+
+        TRACE_BEGIN(trace_start);
+        if (capture->gate.enabled)
+        {
+            gate_on_frame(self, slot);
+        }
+        else
+        {
+            capture_deliver(self, slot);
+        }
+        TRACE_END("deliver", trace_start, slot->sequence);
+    }
+}
+
+/**
+  * Initializes the synchronization primitives of the capture engine.
+  * Called once from camera_new.
+  */
+int camera_capture_init(Camera * self)
+{
+    Capture * capture = &self->capture;
+
+    memset(capture, 0, sizeof(Capture));
+    capture->numa_node = -1;
+    ids_mutex_init(&capture->control_lock);
+    ids_mutex_init(&capture->lock);
+    ids_mutex_init(&capture->sink_lock);
+    ids_mutex_init(&capture->clock.lock);
+    ids_cond_init(&capture->frame_ready);
+    return 0;
+}
+
+void camera_capture_destroy(Camera * self)
+{
+    Capture * capture = &self->capture;
+
+    camera_capture_stop(self);
+    gate_destroy(self);
+    ids_cond_destroy(&capture->frame_ready);
+#ifdef _WIN32
+    if (capture->remove_event != NULL)
+    {
+        CloseHandle(capture->remove_event);
+    }
+#endif
+    ids_mutex_destroy(&capture->clock.lock);
+    ids_mutex_destroy(&capture->sink_lock);
+    ids_mutex_destroy(&capture->lock);
+    ids_mutex_destroy(&capture->control_lock);
+}
+
+/**
+  * Takes the lock that makes a stop, reconfigure and restart one step for
+  * other Python threads. camera_capture_stop drops the GIL while joining the
+  * capture thread, so without it a second thread could start capture on a
+  * half torn down engine, with or without a GIL.
+  * @note Waits with the thread detached, so the holder can take the GIL (or,
+  *       in the free-threaded build, a stop-the-world pause can finish)
+  */
+void capture_control_lock(Camera * self)
+{
+    Py_BEGIN_ALLOW_THREADS
+    ids_mutex_lock(&self->capture.control_lock);
+    Py_END_ALLOW_THREADS
+}
+
+void capture_control_unlock(Camera * self)
+{
+    ids_mutex_unlock(&self->capture.control_lock);
+}
+
+/**
+  * Starts capture unless it is running, for the methods that start it
+  * implicitly
+  * @arg started Set to 1 if this call started capture, may be NULL
+  * @return 0 on success, -1 with a Python exception set
+  */
+int camera_capture_ensure(Camera * self, int buffers, int * started)
+{
+    Capture * capture = &self->capture;
+    int result = 0;
+    int queued;
+
+    if (started != NULL)
+    {
+        *started = 0;
+    }
+    if (capture->running && (!capture->idle || capture->timelapse != NULL))
+    {
+        return 0;
+    }
+    capture_control_lock(self);
+    if (!capture->running)
+    {
+        result = camera_capture_start(self, buffers);
+        if (result == 0 && started != NULL)
+        {
+            *started = 1;
+        }
+    }
+    else if (capture->idle && capture->timelapse == NULL)
+    {
+        /*
+         * A finished timelapse left live video off; resume it once its
+         * frames were read, so that they are not pushed out of the queue
+         */
+        ids_mutex_lock(&capture->lock);
+        queued = capture->delivery_count;
+        ids_mutex_unlock(&capture->lock);
+        if (queued == 0)
+        {
+            Py_BEGIN_ALLOW_THREADS
+            result = capture_set_live(self, 1);
+            Py_END_ALLOW_THREADS
+            if (result != IS_SUCCESS)
+            {
+                raise_error(self, result);
+                result = -1;
+            }
+        }
+    }
+    capture_control_unlock(self);
+    return result;
+}
+
+/**
+  * Starts or stops live video while capture keeps running. The capture
+  * thread goes on polling either way, so frames of software triggers are
+  * still delivered while live video is off. Callable without the GIL.
+  * @return The SDK return code
+  * @note Called with the control lock held
+  */
+int capture_set_live(Camera * self, int live)
+{
+    Capture * capture = &self->capture;
+    int returnCode = IS_SUCCESS;
+
+    if (live && capture->idle)
+    {
+        if (capture->running)
+        {
+            returnCode = is_CaptureVideo(camera_handle(self), IS_DONT_WAIT);
+        }
+        if (returnCode == IS_SUCCESS)
+        {
+            capture->idle = 0;
+        }
+    }
+    else if (!live && !capture->idle)
+    {
+        capture->idle = 1;
+        if (capture->running)
+        {
+            returnCode = is_StopLiveVideo(camera_handle(self), IS_WAIT);
+        }
+    }
+    return returnCode;
+}
+
+/**
+  * Allocates the sequence ring, starts live capture and spawns the capture thread
+  * @arg buffers Number of sequence buffers to allocate
+  * @return 0 on success, -1 with a Python exception set
+  * @note Called with the control lock held
+  */
+int camera_capture_start(Camera * self, int buffers)
+{
+    Capture * capture = &self->capture;
+    FrameRing * ring;
+    int returnCode;
+
+    if (capture->running)
+    {
+        return 0;
+    }
+    if (buffers < 2)
+    {
+        PyErr_SetString(PyExc_ValueError, "At least 2 capture buffers are required");
+        return -1;
+    }
+    if (capture->timelapse == NULL)
+    {
+        capture->idle = 0;
+    }
+    if (capture->gate.enabled && buffers < GATE_MIN_BUFFERS(capture->gate.pre))
+    {
+        buffers = GATE_MIN_BUFFERS(capture->gate.pre);
+    }
+
+    ring = frame_ring_alloc(self, self->handle, buffers, &returnCode);
+    if (ring == NULL)
+    {
+        raise_error(self, returnCode);
+        return -1;
+    }
+    capture_publish(self, self->handle, ring);
+
+    capture->delivery_capacity = buffers / 2;
+    capture->delivery = (FrameSlot **)calloc(capture->delivery_capacity, sizeof(FrameSlot *));
+    if (capture->delivery == NULL)
+    {
+        PyErr_NoMemory();
+        goto fail_ring;
+    }
+    capture->delivery_head = 0;
+    capture->delivery_count = 0;
+
+    returnCode = is_InitImageQueue(self->handle, 0);
+    if (returnCode != IS_SUCCESS)
+    {
+        raise_error(self, returnCode);
+        goto fail_delivery;
+    }
+
+    returnCode = capture->idle ? IS_SUCCESS : is_CaptureVideo(self->handle, IS_DONT_WAIT);
+    if (returnCode != IS_SUCCESS)
+    {
+        raise_error(self, returnCode);
+        goto fail_queue;
+    }
+
+    capture->last_error = 0;
+    device_events_enable(self, self->handle);
+    capture->running = 1;
+    if (ids_thread_start(&capture->thread, capture_thread_main, self) != 0)
+    {
+        capture->running = 0;
+        PyErr_SetString(PyExc_RuntimeError, "Unable to start capture thread");
+        is_StopLiveVideo(self->handle, IS_WAIT);
+        goto fail_queue;
+    }
+
+    return 0;
+
+fail_queue:
+    is_ExitImageQueue(self->handle);
+fail_delivery:
+    free(capture->delivery);
+    capture->delivery = NULL;
+fail_ring:
+    is_ClearSequence(self->handle);
+    capture_publish(self, self->handle, NULL);
+    frame_ring_decref(ring);
+    return -1;
+}
+
+/**
+  * Stops the capture thread and live video, and drops every queued frame.
+  * Frames still held by Python keep their buffers until released.
+  * @note Called with the control lock held, except from camera_dealloc
+  */
+void camera_capture_stop(Camera * self)
+{
+    Capture * capture = &self->capture;
+    FrameRing * ring;
+
+    if (!capture->running)
+    {
+        return;
+    }
+
+    capture->running = 0;
+    Py_BEGIN_ALLOW_THREADS
+    ids_thread_join(capture->thread);
+    is_StopLiveVideo(self->handle, IS_WAIT);
+    Py_END_ALLOW_THREADS
+
+    capture_flush(self);
+    gate_reset(self);
+
+    is_ExitImageQueue(self->handle);
+    is_ClearSequence(self->handle);
+    device_events_disable(self->handle);
+    free(capture->delivery);
+    capture->delivery = NULL;
+    ring = capture->ring;
+    capture_publish(self, self->handle, NULL);
+    frame_ring_decref(ring);
+}
+
+/**
+  * Drops every frame waiting for get_image and wakes the waiting threads
+  */
+void capture_flush(Camera * self)
+{
+    Capture * capture = &self->capture;
+
+    ids_mutex_lock(&capture->lock);
+    while (capture->delivery_count > 0)
+    {
+        FrameSlot * slot = capture->delivery[capture->delivery_head];
+        capture->delivery_head = (capture->delivery_head + 1) % capture->delivery_capacity;
+        capture->delivery_count--;
+        frame_slot_release(slot);
+    }
+    ids_cond_broadcast(&capture->frame_ready);
+    ids_mutex_unlock(&capture->lock);
+}
+
+/**
+  * Waits for the next delivered frame. Must be called without the GIL.
+  * @return A slot whose reference now belongs to the caller, or NULL on timeout
+  */
+FrameSlot * camera_capture_next(Camera * self, int timeout_ms)
+{
+    Capture * capture = &self->capture;
+    FrameSlot * slot = NULL;
+    int64_t deadline = ids_monotonic_ns() + (int64_t)timeout_ms * 1000000LL;
+    int64_t remaining;
+
+    ids_mutex_lock(&capture->lock);
+    while (capture->running && capture->delivery_count == 0)
+    {
+        remaining = (deadline - ids_monotonic_ns()) / 1000000LL;
+        if (remaining <= 0 || ids_cond_wait(&capture->frame_ready, &capture->lock, (int)remaining))
+        {
+            break;
+        }
+    }
+    if (capture->delivery_count > 0)
+    {
+        slot = capture->delivery[capture->delivery_head];
+        capture->delivery_head = (capture->delivery_head + 1) % capture->delivery_capacity;
+        capture->delivery_count--;
+    }
+    ids_mutex_unlock(&capture->lock);
+
+    return slot;
+}
+
+/**
+  * Attaches a native consumer that sees every frame on the capture thread
+  * @return 0 on success, -1 if all sink slots are taken
+  */
+int camera_add_sink(Camera * self, frame_sink_func func, void * context)
+{
+    Capture * capture = &self->capture;
+    int returnCode = -1;
+
+    ids_mutex_lock(&capture->sink_lock);
+    if (capture->num_sinks < MAX_FRAME_SINKS)
+    {
+        capture->sinks[capture->num_sinks].func = func;
+        capture->sinks[capture->num_sinks].context = context;
+        capture->num_sinks++;
+        returnCode = 0;
+    }
+    ids_mutex_unlock(&capture->sink_lock);
+    return returnCode;
+}
+
+/**
+  * Detaches a consumer. Once this returns the sink is guaranteed not to be
+  * running and will not be called again.
+  */
+void camera_remove_sink(Camera * self, frame_sink_func func, void * context)
+{
+    Capture * capture = &self->capture;
+    int i;
+
+    ids_mutex_lock(&capture->sink_lock);
+    for (i = 0; i < capture->num_sinks; i++)
+    {
+        if (capture->sinks[i].func == func && capture->sinks[i].context == context)
+        {
+            memmove(&capture->sinks[i], &capture->sinks[i + 1], (capture->num_sinks - i - 1) * sizeof(FrameSink));
+            capture->num_sinks--;
+            break;
+        }
+    }
+    ids_mutex_unlock(&capture->sink_lock);
+}
+
+/**
+  * Function to start native capture
+  * This means the definition of the method is:
+  *     def start_capture(self, buffers=16, numa_node=None, huge_pages=False)
+  * @arg numa_node Node to place the buffers on and run the capture thread on
+  * @arg huge_pages Back the buffers with huge pages where the OS allows it
+  * @note The placement also applies when capture restarts implicitly
+  */
+PyObject * camera_start_capture(Camera * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"buffers", "numa_node", "huge_pages", NULL};
+    int buffers = DEFAULT_CAPTURE_BUFFERS;
+    PyObject * numa_node = Py_None;
+    int huge_pages = 0;
+    long node = -1;
+    int result;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|iOi", kwlist, &buffers, &numa_node, &huge_pages))
+    {
+        return NULL;
+    }
+    if (numa_node != Py_None)
+    {
+        node = PyLong_AsLong(numa_node);
+        if (PyErr_Occurred())
+        {
+            return NULL;
+        }
+        if (node < 0 || node >= ids_numa_node_count())
+        {
+            PyErr_Format(PyExc_ValueError, "numa_node must be between 0 and %d", ids_numa_node_count() - 1);
+            return NULL;
+        }
+    }
+    capture_control_lock(self);
+    if (self->capture.running)
+    {
+        result = self->capture.numa_node != (int)node || self->capture.huge_pages != (huge_pages != 0);
+        capture_control_unlock(self);
+        if (result)
+        {
+            PyErr_SetString(PyExc_RuntimeError, "Call stop_capture() before changing the buffer placement");
+            return NULL;
+        }
+        Py_RETURN_NONE;
+    }
+
+    self->capture.numa_node = (int)node;
+    self->capture.huge_pages = huge_pages != 0;
+    result = camera_capture_start(self, buffers);
+    capture_control_unlock(self);
+    if (result != 0)
+    {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+/**
+  * Where the sequence buffers of the running capture live
+  * @return A dictionary, or None when capture is stopped
+  */
+PyObject * capture_buffers_as_dict(Camera * self)
+{
+    FrameRing * ring;
+    PyObject * result;
+
+    ring = capture_ring_acquire(self);
+    if (ring == NULL)
+    {
+        Py_RETURN_NONE;
+    }
+    result = Py_BuildValue("{s:i,s:O,s:O,s:i,s:K}",
+            "count", ring->count,
+            "user_memory", Py_True,
+            "huge_pages", ring->huge_pages ? Py_True : Py_False,
+            "numa_node", ring->numa_node,
+            "bytes", (unsigned PY_LONG_LONG)ring->memory_size);
+    frame_ring_decref(ring);
+    return result;
+}
+
+PyObject * camera_stop_capture(Camera * self)
+{
+    capture_control_lock(self);
+    camera_capture_stop(self);
+    capture_control_unlock(self);
+    Py_RETURN_NONE;
+}
+
+/**
+  * Makes the capture thread handle the camera as if it had been unplugged,
+  * for exercising the reconnect path without touching the hardware
+  */
+PyObject * camera_simulate_disconnect(Camera * self)
+{
+    int running;
+
+    capture_control_lock(self);
+    running = self->capture.running;
+    if (running)
+    {
+        self->capture.simulate_loss = 1;
+    }
+    capture_control_unlock(self);
+    if (!running)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Capture is not running");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
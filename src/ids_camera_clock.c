@@ -0,0 +1,342 @@
+#include <uEye.h>
+#include "ids.h"
+#include <math.h>
+#include <string.h>
+
+/* Samples needed before the first fit */
+#define CLOCK_MIN_POINTS   16
+/* Samples between fits, which keeps the per-frame cost to a comparison */
+#define CLOCK_REFIT        8
+/*
+ * Each sample is the fastest delivery of a 10ms bucket, so the window spans
+ * at least 5s however high the frame rate
+ */
+#define CLOCK_BUCKET_NS    1e7
+/* A sample this far off the fit means the device clock was reset */
+#define CLOCK_RESET_NS     1e9
+
+/**
+  * Returns the k-th smallest of values, reordering them
+  */
+static double select_kth(double * values, int count, int k)
+{
+    int low = 0;
+    int high = count - 1;
+    double pivot;
+    double swap;
+    int i, j;
+
+    while (low < high)
+    {
+        pivot = values[(low + high) / 2];
+        i = low;
+        j = high;
+        while (i <= j)
+        {
+            while (values[i] < pivot)
+            {
+                i++;
+            }
+            while (values[j] > pivot)
+            {
+                j--;
+            }
+            if (i <= j)
+            {
+                swap = values[i];
+                values[i] = values[j];
+                values[j] = swap;
+                i++;
+                j--;
+            }
+        }
+        if (k <= j)
+        {
+            high = j;
+        }
+        else if (k >= i)
+        {
+            low = i;
+        }
+        else
+        {
+            break;
+        }
+    }
+    return values[k];
+}
+
+/**
+  * Least squares fit of host against device over the samples whose residual
+  * to the previous line is at most limit
+  * @return Number of samples used
+  */
+static int clock_fit_line(const ClockSync * clock, double intercept, double slope, double limit, double * fit_intercept, double * fit_slope)
+{
+    double mean_x = 0.0, mean_y = 0.0;
+    double sxx = 0.0, sxy = 0.0;
+    double dx;
+    int used = 0;
+    int i;
+
+    for (i = 0; i < clock->count; i++)
+    {
+        if (clock->host[i] - (intercept + slope * clock->device[i]) <= limit)
+        {
+            mean_x += clock->device[i];
+            mean_y += clock->host[i];
+            used++;
+        }
+    }
+    if (used < 2)
+    {
+        return used;
+    }
+    mean_x /= used;
+    mean_y /= used;
+    for (i = 0; i < clock->count; i++)
+    {
+        if (clock->host[i] - (intercept + slope * clock->device[i]) <= limit)
+        {
+            dx = clock->device[i] - mean_x;
+            sxx += dx * dx;
+            sxy += dx * (clock->host[i] - mean_y);
+        }
+    }
+    *fit_slope = sxx > 0.0 ? sxy / sxx : 1.0;
+    *fit_intercept = mean_y - *fit_slope * mean_x;
+    return used;
+}
+
+/**
+  * Refits the mapping. The dequeue time is the device time plus a transfer
+  * latency that is never negative, so after a plain fit only the samples on
+  * or below the median residual are kept: the line follows the fastest
+  * deliveries and ignores the late ones.
+  */
+static void clock_refit(ClockSync * clock, double newest)
+{
+    double residuals[CLOCK_WINDOW];
+    double first_intercept = 0.0, first_slope = 1.0;
+    double intercept, slope;
+    double median;
+    double squares = 0.0;
+    double residual;
+    double previous;
+    int64_t before, realtime, after;
+    int used;
+    int i;
+
+    if (clock->count < 2 || clock_fit_line(clock, 0.0, 1.0, HUGE_VAL, &first_intercept, &first_slope) < 2)
+    {
+        return;
+    }
+    for (i = 0; i < clock->count; i++)
+    {
+        residuals[i] = clock->host[i] - (first_intercept + first_slope * clock->device[i]);
+    }
+    median = select_kth(residuals, clock->count, clock->count / 2);
+    used = clock_fit_line(clock, first_intercept, first_slope, median, &intercept, &slope);
+    if (used < 2)
+    {
+        return;
+    }
+
+    /* Spread of the kept samples around the final line */
+    used = 0;
+    for (i = 0; i < clock->count; i++)
+    {
+        if (clock->host[i] - (first_intercept + first_slope * clock->device[i]) <= median)
+        {
+            residual = clock->host[i] - (intercept + slope * clock->device[i]);
+            squares += residual * residual;
+            used++;
+        }
+    }
+
+    before = ids_monotonic_ns();
+    realtime = ids_realtime_ns();
+    after = ids_monotonic_ns();
+
+    ids_mutex_lock(&clock->lock);
+    previous = clock->valid ? clock->intercept + clock->slope * newest : intercept + slope * newest;
+    clock->step_ns = (intercept + slope * newest) - previous;
+    clock->tick_origin = clock->base_ticks;
+    clock->host_origin = clock->base_ns;
+    clock->intercept = intercept;
+    clock->slope = slope;
+    clock->residual_ns = used > 0 ? sqrt(squares / used) : 0.0;
+    clock->realtime_offset_ns = realtime - (before + (after - before) / 2);
+    clock->points = clock->count;
+    clock->span_s = clock->count > 1 ? (clock->device[(clock->head + CLOCK_WINDOW - 1) % CLOCK_WINDOW] - clock->device[clock->count < CLOCK_WINDOW ? 0 : clock->head]) / 1e9 : 0.0;
+    clock->valid = 1;
+    clock->fits++;
+    ids_mutex_unlock(&clock->lock);
+}
+
+static void clock_reset(ClockSync * clock, FrameSlot * slot)
+{
+    clock->base_ticks = slot->info.u64TimestampDevice;
+    clock->base_ns = slot->dequeue_ns;
+    clock->head = 0;
+    clock->count = 0;
+    clock->since_fit = 0;
+    clock->pending = 0;
+
+    ids_mutex_lock(&clock->lock);
+    if (clock->valid || clock->fits > 0)
+    {
+        clock->resets++;
+    }
+    clock->valid = 0;
+    ids_mutex_unlock(&clock->lock);
+}
+
+/**
+  * Adds the frame to the regression and stamps it with its host time.
+  * Runs on the capture thread for every frame.
+  */
+void clock_on_frame(Camera * self, FrameSlot * slot)
+{
+    ClockSync * clock = &self->capture.clock;
+    uint64_t ticks = slot->info.u64TimestampDevice;
+    double device;
+    double host;
+
+    slot->host_ns = 0;
+    if (ticks == 0)
+    {
+        return;
+    }
+    if ((clock->count == 0 && !clock->pending) || ticks <= clock->last_ticks)
+    {
+        clock_reset(clock, slot);
+    }
+
+    device = (double)(ticks - clock->base_ticks) * 100.0;
+    host = (double)(slot->dequeue_ns - clock->base_ns);
+    if (clock->valid && fabs(host - (clock->intercept + clock->slope * device)) > CLOCK_RESET_NS)
+    {
+        clock_reset(clock, slot);
+        device = 0.0;
+        host = 0.0;
+    }
+    clock->last_ticks = ticks;
+
+    if (clock->pending && host - clock->bucket_start < CLOCK_BUCKET_NS)
+    {
+        if (host - device < clock->pending_host - clock->pending_device)
+        {
+            clock->pending_device = device;
+            clock->pending_host = host;
+        }
+    }
+    else
+    {
+        if (clock->pending)
+        {
+            clock->device[clock->head] = clock->pending_device;
+            clock->host[clock->head] = clock->pending_host;
+            clock->head = (clock->head + 1) % CLOCK_WINDOW;
+            if (clock->count < CLOCK_WINDOW)
+            {
+                clock->count++;
+            }
+            clock->since_fit++;
+
+            if (clock->count >= CLOCK_MIN_POINTS && (!clock->valid || clock->since_fit >= CLOCK_REFIT))
+            {
+                clock_refit(clock, device);
+                clock->since_fit = 0;
+            }
+        }
+        clock->pending = 1;
+        clock->pending_device = device;
+        clock->pending_host = host;
+        clock->bucket_start = host;
+    }
+
+    /* Only the capture thread writes the fit, it reads it without the lock */
+    if (clock->valid)
+    {
+        slot->host_ns = clock->host_origin + (int64_t)(clock->intercept + clock->slope * device);
+    }
+}
+
+int64_t clock_realtime_offset(Camera * self)
+{
+    ClockSync * clock = &self->capture.clock;
+    int64_t offset;
+
+    ids_mutex_lock(&clock->lock);
+    offset = clock->realtime_offset_ns;
+    ids_mutex_unlock(&clock->lock);
+    return offset;
+}
+
+PyObject * clock_stats_as_dict(Camera * self)
+{
+    ClockSync * clock = &self->capture.clock;
+    ClockSync fit;
+
+    ids_mutex_lock(&clock->lock);
+    fit.valid = clock->valid;
+    fit.slope = clock->slope;
+    fit.residual_ns = clock->residual_ns;
+    fit.step_ns = clock->step_ns;
+    fit.realtime_offset_ns = clock->realtime_offset_ns;
+    fit.points = clock->points;
+    fit.span_s = clock->span_s;
+    fit.fits = clock->fits;
+    fit.resets = clock->resets;
+    ids_mutex_unlock(&clock->lock);
+
+    return Py_BuildValue("{s:O,s:d,s:d,s:d,s:L,s:i,s:d,s:L,s:L}",
+            "synchronized", fit.valid ? Py_True : Py_False,
+            "drift_ppm", fit.valid && fit.slope > 0.0 ? (1.0 / fit.slope - 1.0) * 1e6 : 0.0,
+            "residual_ns", fit.residual_ns,
+            "last_step_ns", fit.step_ns,
+            "realtime_offset_ns", fit.realtime_offset_ns,
+            "points", fit.points,
+            "span_s", fit.span_s,
+            "fits", fit.fits,
+            "resets", fit.resets);
+}
+
+/**
+  * Function to convert a device timestamp with the current clock mapping
+  * This means the definition of the method is:
+  *     def device_time_to_host(self, timestamp_device, realtime=False)
+  * @arg timestamp_device Device timestamp in 0.1us ticks, as in a frame's info
+  * @return Nanoseconds on the monotonic clock (or since the epoch with
+  *         realtime=True), None before the mapping is known
+  */
+PyObject * camera_device_time_to_host(Camera * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"timestamp_device", "realtime", NULL};
+    ClockSync * clock = &self->capture.clock;
+    unsigned PY_LONG_LONG ticks;
+    int realtime = 0;
+    int64_t host;
+    int valid;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "K|i", kwlist, &ticks, &realtime))
+    {
+        return NULL;
+    }
+
+    ids_mutex_lock(&clock->lock);
+    valid = clock->valid;
+    host = clock->host_origin + (int64_t)(clock->intercept + clock->slope * ((double)((int64_t)(ticks - clock->tick_origin)) * 100.0));
+    if (realtime)
+    {
+        host += clock->realtime_offset_ns;
+    }
+    ids_mutex_unlock(&clock->lock);
+
+    if (!valid)
+    {
+        Py_RETURN_NONE;
+    }
+    return Py_BuildValue("L", host);
+}
@@ -0,0 +1,349 @@
+#include <uEye.h>
+#include "ids.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#define DEFAULT_GATE_PRE   4
+#define DEFAULT_GATE_POST  4
+#define DEFAULT_GATE_GRID  8
+#define DEFAULT_GATE_LEARN 0.05
+/* Most frames the gate passes on after the last frame that showed change */
+#define MAX_GATE_POST      1024
+
+/**
+  * Sum of absolute differences of two runs of 8 bit samples
+  */
+static uint64_t sad_u8(const uint8_t * a, const uint8_t * b, int n)
+{
+    uint64_t total = 0;
+    int i = 0;
+
+#if defined(__AVX2__)
+    __m256i sum = _mm256_setzero_si256();
+    uint64_t lanes[4];
+
+    for (; i + 32 <= n; i += 32)
+    {
+        sum = _mm256_add_epi64(sum, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i *)(a + i)), _mm256_loadu_si256((const __m256i *)(b + i))));
+    }
+    _mm256_storeu_si256((__m256i *)lanes, sum);
+    total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(__SSE2__)
+    __m128i sum = _mm_setzero_si128();
+    uint64_t lanes[2];
+
+    for (; i + 16 <= n; i += 16)
+    {
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(a + i)), _mm_loadu_si128((const __m128i *)(b + i))));
+    }
+    _mm_storeu_si128((__m128i *)lanes, sum);
+    total = lanes[0] + lanes[1];
+#endif
+    for (; i < n; i++)
+    {
+        total += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+    }
+    return total;
+}
+
+/**
+  * Picks every grid-th pixel of a row as an 8 bit intensity: the sample of
+  * mono formats, the top 8 bits of wide mono formats and green otherwise
+  */
+static void gate_sample_row(const FrameRing * ring, const char * row, int width, int grid, uint8_t * out)
+{
+    int bytes = ring->bitdepth / 8 > 0 ? ring->bitdepth / 8 : 1;
+    int shift = 0;
+    int offset = bytes >= 3 ? 1 : 0;
+    int x;
+
+    switch (ring->color)
+    {
+        case IS_CM_MONO10:
+            shift = 2;
+            break;
+        case IS_CM_MONO12:
+            shift = 4;
+            break;
+        case IS_CM_MONO16:
+            shift = 8;
+            break;
+        default:
+            break;
+    }
+
+    if (shift != 0)
+    {
+        for (x = 0; x < width; x += grid)
+        {
+            *out++ = (uint8_t)(((const uint16_t *)row)[x] >> shift);
+        }
+    }
+    else if (bytes == 1 && grid == 1)
+    {
+        memcpy(out, row, width);
+    }
+    else
+    {
+        for (x = 0; x < width; x += grid)
+        {
+            *out++ = (uint8_t)row[x * bytes + offset];
+        }
+    }
+}
+
+/**
+  * Samples the frame on the grid and returns the mean absolute difference to
+  * the background, then blends the frame into the background
+  * @return The score in 8 bit intensity levels, -1 for the first frame
+  */
+static double gate_score(Gate * gate, FrameSlot * slot)
+{
+    FrameRing * ring = slot->ring;
+    int width = slot->info.dwImageWidth ? (int)slot->info.dwImageWidth : ring->width;
+    int height = slot->info.dwImageHeight ? (int)slot->info.dwImageHeight : ring->height;
+    int columns = (width + gate->grid - 1) / gate->grid;
+    int rows = (height + gate->grid - 1) / gate->grid;
+    int size = columns * rows;
+    uint64_t sad;
+    int32_t delta;
+    int y;
+    int i;
+
+    if (size != gate->size)
+    {
+        free(gate->samples);
+        free(gate->background);
+        free(gate->background_fixed);
+        gate->samples = (uint8_t *)malloc(size);
+        gate->background = (uint8_t *)malloc(size);
+        gate->background_fixed = (uint16_t *)malloc(size * sizeof(uint16_t));
+        gate->size = size;
+        gate->initialized = 0;
+        if (gate->samples == NULL || gate->background == NULL || gate->background_fixed == NULL)
+        {
+            gate->size = 0;
+            return -1.0;
+        }
+    }
+
+    for (y = 0; y < rows; y++)
+    {
+        gate_sample_row(ring, slot->pBuffer + (size_t)y * gate->grid * ring->pitch, width, gate->grid, gate->samples + y * columns);
+    }
+
+    if (!gate->initialized)
+    {
+        for (i = 0; i < size; i++)
+        {
+            gate->background_fixed[i] = (uint16_t)(gate->samples[i] << 8);
+        }
+        memcpy(gate->background, gate->samples, size);
+        gate->initialized = 1;
+        return -1.0;
+    }
+
+    sad = sad_u8(gate->samples, gate->background, size);
+
+    /* Exponential running average in 8.8 fixed point */
+    for (i = 0; i < size; i++)
+    {
+        delta = ((int32_t)gate->samples[i] << 8) - gate->background_fixed[i];
+        gate->background_fixed[i] = (uint16_t)(gate->background_fixed[i] + ((delta * gate->learn_q8) >> 8));
+        gate->background[i] = (uint8_t)(gate->background_fixed[i] >> 8);
+    }
+
+    return (double)sad / size;
+}
+
+static void gate_pass(Camera * self, FrameSlot * slot, int role)
+{
+    Gate * gate = &self->capture.gate;
+
+    slot->gate_role = role;
+    slot->gate_event = gate->event;
+    ids_atomic_add64(&gate->frames_passed, 1);
+    capture_deliver(self, slot);
+}
+
+/**
+  * Decides on the capture thread whether a frame reaches get_image. Frames
+  * without change are held in the pre-trigger history, and released once
+  * it overflows. A frame whose score exceeds the threshold is delivered after
+  * the history, followed by the next post frames.
+  * @note Takes over the capture thread's reference to the slot
+  */
+void gate_on_frame(Camera * self, FrameSlot * slot)
+{
+    Gate * gate = &self->capture.gate;
+    FrameSlot * oldest;
+    double score = gate_score(gate, slot);
+
+    slot->gate_score = score;
+    if (score >= 0)
+    {
+        ids_atomic_store64(&gate->last_score_milli, (int64_t)(score * 1000));
+    }
+
+    if (score > gate->threshold)
+    {
+        if (gate->post_remaining == 0)
+        {
+            gate->event = ids_atomic_add64(&gate->events, 1);
+            while (gate->history_count > 0)
+            {
+                oldest = gate->history[gate->history_head];
+                gate->history_head = (gate->history_head + 1) % MAX_GATE_PRE;
+                gate->history_count--;
+                gate_pass(self, oldest, GATE_PRE);
+            }
+        }
+        gate->post_remaining = gate->post;
+        gate_pass(self, slot, GATE_TRIGGER);
+        return;
+    }
+
+    if (gate->post_remaining > 0)
+    {
+        gate->post_remaining--;
+        gate_pass(self, slot, GATE_POST);
+        return;
+    }
+
+    if (gate->pre == 0)
+    {
+        ids_atomic_add64(&gate->frames_gated, 1);
+        frame_slot_release(slot);
+        return;
+    }
+    if (gate->history_count == gate->pre)
+    {
+        oldest = gate->history[gate->history_head];
+        gate->history_head = (gate->history_head + 1) % MAX_GATE_PRE;
+        gate->history_count--;
+        ids_atomic_add64(&gate->frames_gated, 1);
+        frame_slot_release(oldest);
+    }
+    gate->history[(gate->history_head + gate->history_count) % MAX_GATE_PRE] = slot;
+    gate->history_count++;
+}
+
+/**
+  * Releases the frames held in the history and forgets the background.
+  * Called once the capture thread has stopped.
+  */
+void gate_reset(Camera * self)
+{
+    Gate * gate = &self->capture.gate;
+
+    while (gate->history_count > 0)
+    {
+        frame_slot_release(gate->history[gate->history_head]);
+        gate->history_head = (gate->history_head + 1) % MAX_GATE_PRE;
+        gate->history_count--;
+    }
+    gate->history_head = 0;
+    gate->post_remaining = 0;
+    gate->initialized = 0;
+}
+
+void gate_destroy(Camera * self)
+{
+    Gate * gate = &self->capture.gate;
+
+    gate_reset(self);
+    free(gate->samples);
+    free(gate->background);
+    free(gate->background_fixed);
+    gate->samples = NULL;
+    gate->background = NULL;
+    gate->background_fixed = NULL;
+    gate->size = 0;
+}
+
+PyObject * gate_stats_as_dict(Camera * self)
+{
+    Gate * gate = &self->capture.gate;
+
+    return Py_BuildValue("{s:O,s:L,s:L,s:L,s:d}",
+            "enabled", gate->enabled ? Py_True : Py_False,
+            "frames_passed", ids_atomic_load64(&gate->frames_passed),
+            "frames_gated", ids_atomic_load64(&gate->frames_gated),
+            "events", ids_atomic_load64(&gate->events),
+            "last_score", ids_atomic_load64(&gate->last_score_milli) / 1000.0);
+}
+
+/**
+  * Function to only deliver frames around changes in the scene to get_image
+  * This means the definition of the method is:
+  *     def gate(self, threshold=None, pre=4, post=4, grid=8, learn=0.05)
+  * @arg threshold Mean absolute difference to the background, in 8 bit levels,
+  *      above which a frame counts as changed. None turns gating off.
+  * @note Restarts a running capture, with enough buffers to hold the history
+  */
+PyObject * camera_gate(Camera * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"threshold", "pre", "post", "grid", "learn", NULL};
+    Gate * gate = &self->capture.gate;
+    PyObject * threshold = Py_None;
+    int pre = DEFAULT_GATE_PRE;
+    int post = DEFAULT_GATE_POST;
+    int grid = DEFAULT_GATE_GRID;
+    double learn = DEFAULT_GATE_LEARN;
+    double value = 0.0;
+    int running;
+    int buffers;
+    int result;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|Oiiid", kwlist, &threshold, &pre, &post, &grid, &learn))
+    {
+        return NULL;
+    }
+    if (threshold != Py_None)
+    {
+        value = PyFloat_AsDouble(threshold);
+        if (PyErr_Occurred())
+        {
+            return NULL;
+        }
+    }
+    if (pre < 0 || pre > MAX_GATE_PRE || post < 0 || post > MAX_GATE_POST)
+    {
+        PyErr_Format(PyExc_ValueError, "pre must be between 0 and %d and post between 0 and %d", MAX_GATE_PRE, MAX_GATE_POST);
+        return NULL;
+    }
+    if (value < 0.0 || grid < 1 || learn < 0.0 || learn > 1.0)
+    {
+        PyErr_SetString(PyExc_ValueError, "threshold must not be negative, grid must be positive and learn between 0 and 1");
+        return NULL;
+    }
+
+    capture_control_lock(self);
+    running = self->capture.running;
+    buffers = running ? capture_buffer_count(self) : DEFAULT_CAPTURE_BUFFERS;
+    if (running)
+    {
+        camera_capture_stop(self);
+    }
+    gate_reset(self);
+
+    gate->enabled = threshold != Py_None;
+    gate->threshold = value;
+    gate->pre = pre;
+    gate->post = post;
+    gate->grid = grid;
+    gate->learn_q8 = (int)(learn * 256 + 0.5);
+
+    /* camera_capture_start grows the ring to GATE_MIN_BUFFERS */
+    result = running ? camera_capture_start(self, buffers) : 0;
+    capture_control_unlock(self);
+    if (result != 0)
+    {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
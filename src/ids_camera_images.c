@@ -1,86 +1,85 @@
 #include <uEye.h>
 #include "ids.h"
 #include <datetime.h>
+#define PY_ARRAY_UNIQUE_SYMBOL ids_ARRAY_API
 #include <numpy/arrayobject.h>
 
 #define IMAGE_TIMEOUT 1000
 
-int camera_free_api_mem(Camera * self, char ** ppBuffer, INT * pMemID, int isInSeq)
+/*
+ * Keys of the info dictionary, interned once so that building it does not
+ * allocate a string per key and frame
+ */
+enum InfoKey
 {
-    int returnCode;
-
-    returnCode = is_FreeImageMem(self->handle, *ppBuffer, *pMemID);
-    if (returnCode != IS_SUCCESS)
-    {
-        print_error(self);
-        return -1;
-    }
-
-    if (isInSeq)
-    {
-        returnCode = is_ClearSequence(self->handle);
-    }
-
-    return 0;
-}
-
-int camera_alloc_api_mem(Camera * self, char ** ppBuffer, INT * pMemID)
+    INFO_TIMESTAMP,
+    INFO_DIGITAL_INPUT,
+    INFO_GPIO1,
+    INFO_GPIO2,
+    INFO_FRAME_NUMBER,
+    INFO_CAMERA_BUFFERS,
+    INFO_USED_CAMERA_BUFFERS,
+    INFO_HEIGHT,
+    INFO_WIDTH,
+    INFO_TIMESTAMP_DEVICE,
+    INFO_TIMESTAMP_NS,
+    INFO_TIMESTAMP_REALTIME_NS,
+    INFO_BRACKET,
+    INFO_GATE,
+    INFO_STATS,
+    INFO_ORIENTATION,
+    INFO_TIMELAPSE,
+    INFO_KEY_COUNT,
+};
+
+static const char * info_key_names[INFO_KEY_COUNT] = {
+    "timestamp", "digital_input", "gpio1", "gpio2", "frame_number",
+    "camera_buffers", "used_camera_buffers", "height", "width",
+    "timestamp_device", "timestamp_ns", "timestamp_realtime_ns",
+    "bracket", "gate", "stats", "orientation", "timelapse",
+};
+
+static PyObject * info_keys[INFO_KEY_COUNT];
+
+/**
+  * Imports the NumPy and datetime C APIs used to build frames.
+  * Called once from the module initialization.
+  * @return 0 on success, -1 with a Python exception set
+  */
+int camera_images_init(void)
 {
-    int returnCode;
+    int i;
 
-    returnCode = is_AllocImageMem(self->handle, self->width, self->height, self->bitdepth, ppBuffer, pMemID);
-    if (returnCode != IS_SUCCESS)
+    if (_import_array() < 0)
     {
-        print_error(self);
         return -1;
     }
-
-    returnCode = is_SetImageMem(self->handle, *ppBuffer, *pMemID);
-    if (returnCode != IS_SUCCESS)
-    {
-        print_error(self);
-        camera_free_api_mem(self, ppBuffer, pMemID, 0);
-    }
-
-    returnCode = is_AddToSequence(self->handle, *ppBuffer, *pMemID);
-    if (returnCode != IS_SUCCESS)
+    frame_pool_init();
+    PyDateTime_IMPORT;
+    if (PyDateTimeAPI == NULL)
     {
-        print_error(self);
-        camera_free_api_mem(self, ppBuffer, pMemID, 0);
         return -1;
     }
-
-    return 0;
-}
-
-int camera_wait_for_image(Camera * self, char ** ppBuffer, INT * pImgID)
-{
-    int retCode;
-
-    retCode = is_WaitForNextImage(self->handle, IMAGE_TIMEOUT, ppBuffer, pImgID);
-    if (retCode != IS_SUCCESS)
+    for (i = 0; i < INFO_KEY_COUNT; i++)
     {
-        print_error(self);
-        return -1;
+#if PY_MAJOR_VERSION >= 3
+        info_keys[i] = PyUnicode_InternFromString(info_key_names[i]);
+#else
+        info_keys[i] = PyString_InternFromString(info_key_names[i]);
+#endif
+        if (info_keys[i] == NULL)
+        {
+            return -1;
+        }
     }
     return 0;
 }
 
-int camera_unlock_image_queue_buffer(Camera * self, INT imgID, char * pBuffer)
-{
-    int retCode;
-    retCode = is_UnlockSeqBuf(self->handle, imgID, pBuffer); 
-    if (retCode != IS_SUCCESS)
-    {
-        print_error(self);
-    }
-    return retCode;
-}
+static const char * gate_roles[] = {"none", "pre", "trigger", "post"};
 
-PyObject * camera_get_image_info(Camera * self, INT imgID, int * pRetVal)
+PyObject * camera_get_image_info(Camera * self, FrameSlot * slot)
 {
-    UEYEIMAGEINFO imageInfo;
-    int returnCode;
+    const UEYEIMAGEINFO * pInfo = &slot->info;
     PyObject * info = PyDict_New();
     PyObject * timestamp;
     PyObject * digital_input;
@@ -91,33 +90,50 @@ PyObject * camera_get_image_info(Camera * self, INT imgID, int * pRetVal)
     PyObject * used_camera_buffers;
     PyObject * height;
     PyObject * width;
-
-    returnCode = is_GetImageInfo(self->handle, imgID, &imageInfo, sizeof(imageInfo));
-    if (returnCode != IS_SUCCESS)
+    PyObject * bracket;
+    PyObject * gate;
+    PyObject * stats;
+    PyObject * orientation;
+    PyObject * timelapse;
+    PyObject * timestamp_device;
+    PyObject * host_time;
+    PyObject * realtime;
+
+    timestamp = PyDateTime_FromDateAndTime(pInfo->TimestampSystem.wYear, pInfo->TimestampSystem.wMonth, pInfo->TimestampSystem.wDay, pInfo->TimestampSystem.wHour, pInfo->TimestampSystem.wMinute, pInfo->TimestampSystem.wSecond, pInfo->TimestampSystem.wMilliseconds);
+    digital_input = Py_BuildValue("I", pInfo->dwIoStatus&4);
+    gpio1 = Py_BuildValue("I", pInfo->dwIoStatus&2);
+    gpio2 = Py_BuildValue("I", pInfo->dwIoStatus&1);
+    frame_number = Py_BuildValue("K", pInfo->u64FrameNumber);
+    camera_buffers = Py_BuildValue("I", pInfo->dwImageBuffers);
+    used_camera_buffers = Py_BuildValue("I", pInfo->dwImageBuffersInUse);
+    height = Py_BuildValue("I", pInfo->dwImageHeight);
+    width = Py_BuildValue("I", pInfo->dwImageWidth);
+    timestamp_device = Py_BuildValue("K", pInfo->u64TimestampDevice);
+    if (slot->host_ns != 0)
     {
-        print_error(self);
-        return NULL;
+        host_time = Py_BuildValue("L", slot->host_ns);
+        realtime = Py_BuildValue("L", slot->host_ns + clock_realtime_offset(self));
+    }
+    else
+    {
+        Py_INCREF(Py_None);
+        Py_INCREF(Py_None);
+        host_time = Py_None;
+        realtime = Py_None;
     }
 
-    timestamp = PyDateTime_FromDateAndTime(imageInfo.TimestampSystem.wYear, imageInfo.TimestampSystem.wMonth, imageInfo.TimestampSystem.wDay, imageInfo.TimestampSystem.wHour, imageInfo.TimestampSystem.wMinute, imageInfo.TimestampSystem.wSecond, imageInfo.TimestampSystem.wMilliseconds);
-    digital_input = Py_BuildValue("I", imageInfo.dwIoStatus&4);
-    gpio1 = Py_BuildValue("I", imageInfo.dwIoStatus&2);
-    gpio2 = Py_BuildValue("I", imageInfo.dwIoStatus&1);
-    frame_number = Py_BuildValue("K", imageInfo.u64FrameNumber);
-    camera_buffers = Py_BuildValue("I", imageInfo.dwImageBuffers);
-    used_camera_buffers = Py_BuildValue("I", imageInfo.dwImageBuffersInUse);
-    height = Py_BuildValue("I", imageInfo.dwImageHeight);
-    width = Py_BuildValue("I", imageInfo.dwImageWidth);
-
-    PyDict_SetItemString(info, "timestamp", timestamp);
-    PyDict_SetItemString(info, "digital_input", digital_input);
-    PyDict_SetItemString(info, "gpio1", gpio1);
-    PyDict_SetItemString(info, "gpio2", gpio2);
-    PyDict_SetItemString(info, "frame_number", frame_number);
-    PyDict_SetItemString(info, "camera_buffers", camera_buffers);
-    PyDict_SetItemString(info, "used_camera_buffers", used_camera_buffers);
-    PyDict_SetItemString(info, "height", height);
-    PyDict_SetItemString(info, "width", width);
+    PyDict_SetItem(info, info_keys[INFO_TIMESTAMP], timestamp);
+    PyDict_SetItem(info, info_keys[INFO_DIGITAL_INPUT], digital_input);
+    PyDict_SetItem(info, info_keys[INFO_GPIO1], gpio1);
+    PyDict_SetItem(info, info_keys[INFO_GPIO2], gpio2);
+    PyDict_SetItem(info, info_keys[INFO_FRAME_NUMBER], frame_number);
+    PyDict_SetItem(info, info_keys[INFO_CAMERA_BUFFERS], camera_buffers);
+    PyDict_SetItem(info, info_keys[INFO_USED_CAMERA_BUFFERS], used_camera_buffers);
+    PyDict_SetItem(info, info_keys[INFO_HEIGHT], height);
+    PyDict_SetItem(info, info_keys[INFO_WIDTH], width);
+    PyDict_SetItem(info, info_keys[INFO_TIMESTAMP_DEVICE], timestamp_device);
+    PyDict_SetItem(info, info_keys[INFO_TIMESTAMP_NS], host_time);
+    PyDict_SetItem(info, info_keys[INFO_TIMESTAMP_REALTIME_NS], realtime);
 
     Py_DECREF(timestamp);
     Py_DECREF(digital_input);
@@ -128,88 +144,114 @@ PyObject * camera_get_image_info(Camera * self, INT imgID, int * pRetVal)
     Py_DECREF(used_camera_buffers);
     Py_DECREF(height);
     Py_DECREF(width);
+    Py_DECREF(timestamp_device);
+    Py_DECREF(host_time);
+    Py_DECREF(realtime);
 
-    return info;
-}
-
-PyObject * camera_get_image_as_ndarray(Camera * self, char * pBuffer, int * pRetVal)
-{
-    PyObject * img;
-    int ndims;
-    npy_intp dimensions[3];
-
-    dimensions[0] = self->height;
-    dimensions[1] = self->width;
-    if (self->color == IS_CM_MONO8 || self->color == IS_CM_SENSOR_RAW8)
+    if (slot->bracket_index >= 0)
     {
-        ndims = 2;
+        bracket = Py_BuildValue("{s:i,s:d,s:i}",
+                "index", slot->bracket_index,
+                "exposure", slot->bracket_exposure,
+                "gain", slot->bracket_gain);
+        PyDict_SetItem(info, info_keys[INFO_BRACKET], bracket);
+        Py_DECREF(bracket);
     }
-    else
+
+    if (slot->gate_role != GATE_NONE)
     {
-        ndims = 3;
-        dimensions[2] = self->bitdepth/8;
+        gate = Py_BuildValue("{s:s,s:L,s:d}",
+                "role", gate_roles[slot->gate_role],
+                "event", slot->gate_event,
+                "score", slot->gate_score);
+        PyDict_SetItem(info, info_keys[INFO_GATE], gate);
+        Py_DECREF(gate);
     }
 
-    img = PyArray_SimpleNewFromData(ndims, dimensions, NPY_UINT8, pBuffer);
-    *pRetVal = 0;
-
-    return img;
-}
-
-PyObject * camera_get_image(Camera * self)
-{
-    int retCode;
-    INT nMemID = 0;
-    INT apiMemID;
-    char * apiMem;
-    char * pBuffer = NULL;
-    PyObject * img;
-    PyObject * image_info;
-    PyObject * returnObj;
-
-    retCode = camera_alloc_api_mem(self, &apiMem, &apiMemID);
-    if (retCode != 0)
+    if (slot->frame_stats != NULL && slot->frame_stats->valid)
     {
-        return NULL;
+        stats = frame_stats_as_dict(slot->frame_stats);
+        if (stats == NULL)
+        {
+            Py_DECREF(info);
+            return NULL;
+        }
+        PyDict_SetItem(info, info_keys[INFO_STATS], stats);
+        Py_DECREF(stats);
     }
 
-    retCode = camera_wait_for_image(self, &pBuffer, &nMemID);
-    if (retCode != 0)
+    if (self->orientation != 0)
     {
-        return NULL;
+        orientation = Py_BuildValue("s", orientation_name(self->orientation));
+        PyDict_SetItem(info, info_keys[INFO_ORIENTATION], orientation);
+        Py_DECREF(orientation);
     }
 
-    img = camera_get_image_as_ndarray(self, pBuffer, &retCode);
-    if (retCode != 0)
+    if (slot->timelapse_index >= 0)
     {
-        return NULL;
+        timelapse = Py_BuildValue("{s:L,s:L}",
+                "index", slot->timelapse_index,
+                "deadline_ns", slot->timelapse_deadline_ns);
+        PyDict_SetItem(info, info_keys[INFO_TIMELAPSE], timelapse);
+        Py_DECREF(timelapse);
     }
 
-    image_info = camera_get_image_info(self, nMemID, &retCode);
-    if (retCode != 0)
+    return info;
+}
+
+/**
+  * Returns the next frame as an ids.Frame, which unpacks as (ndarray, info)
+  * @arg raise_on_timeout When false a timeout returns None instead of raising
+  *      IDSTimeout, which keeps polling loops free of exception overhead
+  * @note The Frame and its array come from freelists, and the info
+  *       dictionary is only built when it is asked for
+  */
+PyObject * camera_get_image(Camera * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"raise_on_timeout", NULL};
+    int raise_on_timeout = 1;
+    int returnCode;
+    FrameSlot * slot;
+    PyObject * frame;
+    int64_t call_start;
+    int64_t trace_start;
+    int64_t sequence;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p", kwlist, &raise_on_timeout))
     {
-        Py_DECREF(img);
         return NULL;
     }
 
-    retCode = camera_unlock_image_queue_buffer(self, nMemID, pBuffer);
-    if (retCode != IS_SUCCESS)
+    if (camera_capture_ensure(self, DEFAULT_CAPTURE_BUFFERS, NULL) != 0)
     {
-        Py_DECREF(img);
-        Py_DECREF(image_info);
         return NULL;
     }
 
-    returnObj = Py_BuildValue("(OO)", img, image_info);
+    TRACE_BEGIN(call_start);
+    trace_start = call_start;
+    Py_BEGIN_ALLOW_THREADS
+    slot = camera_capture_next(self, IMAGE_TIMEOUT);
+    Py_END_ALLOW_THREADS
+    sequence = slot != NULL ? (int64_t)slot->sequence : -1;
+    TRACE_END("queue_wait", trace_start, sequence);
 
-    retCode = camera_free_api_mem(self, &apiMem, &apiMemID, 1);
-    if (retCode != IS_SUCCESS)
+    if (slot == NULL)
     {
-        printf("Something went wrong while cleaning up memory\n");
+        /* Report why frames stopped arriving when the capture thread knows */
+        returnCode = self->capture.last_error ? self->capture.last_error : IS_TIMED_OUT;
+        if (returnCode == IS_TIMED_OUT && !raise_on_timeout)
+        {
+            Py_RETURN_NONE;
+        }
+        raise_error(self, returnCode);
+        return NULL;
     }
+    stats_on_delivery(&self->stats, slot);
+
+    TRACE_BEGIN(trace_start);
+    frame = frame_from_slot(self, slot);
+    TRACE_END("wrap", trace_start, sequence);
+    TRACE_END("get_image", call_start, sequence);
 
-    Py_DECREF(img);
-    Py_DECREF(image_info);
-   
-    return returnObj;
+    return frame;
 }
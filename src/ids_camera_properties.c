@@ -12,10 +12,38 @@
   * @arg blue_gain The new value of blue gain
   *
   * @return The returnCode of the function call is_SetHardwareGain produced by IDS library
+  * @note Gains that were set are remembered so they survive a reconnect
   */ 
 int set_gain(Camera * self, int master_gain, int red_gain, int green_gain, int blue_gain)
 {
-    return is_SetHardwareGain(self->handle, master_gain, red_gain, green_gain, blue_gain);
+    int returnCode = is_SetHardwareGain(camera_handle(self), master_gain, red_gain, green_gain, blue_gain);
+
+    if (returnCode == IS_SUCCESS)
+    {
+        ids_mutex_lock(&self->settings_lock);
+        if (master_gain != IS_IGNORE_PARAMETER)
+        {
+            self->settings.master_gain = master_gain;
+            self->settings.applied |= SETTING_MASTER_GAIN;
+        }
+        if (red_gain != IS_IGNORE_PARAMETER)
+        {
+            self->settings.red_gain = red_gain;
+            self->settings.applied |= SETTING_RED_GAIN;
+        }
+        if (green_gain != IS_IGNORE_PARAMETER)
+        {
+            self->settings.green_gain = green_gain;
+            self->settings.applied |= SETTING_GREEN_GAIN;
+        }
+        if (blue_gain != IS_IGNORE_PARAMETER)
+        {
+            self->settings.blue_gain = blue_gain;
+            self->settings.applied |= SETTING_BLUE_GAIN;
+        }
+        ids_mutex_unlock(&self->settings_lock);
+    }
+    return returnCode;
 }
 
 /**
@@ -29,7 +57,7 @@ int set_gain(Camera * self, int master_gain, int red_gain, int green_gain, int b
   */ 
 PyObject * get_gain(Camera * self, int command)
 {
-    int val = is_SetHardwareGain(self->handle, command, IS_IGNORE_PARAMETER, IS_IGNORE_PARAMETER, IS_IGNORE_PARAMETER);
+    int val = is_SetHardwareGain(camera_handle(self), command, IS_IGNORE_PARAMETER, IS_IGNORE_PARAMETER, IS_IGNORE_PARAMETER);
 
     return Py_BuildValue("i", val);
 }
@@ -41,7 +69,7 @@ int display_mode_command(HIDS handle, int command)
 
 PyObject * camera_get_display_mode(Camera * self, void * closure)
 {
-    int value = display_mode_command(self->handle, IS_GET_DISPLAY_MODE);
+    int value = display_mode_command(camera_handle(self), IS_GET_DISPLAY_MODE);
 
     return Py_BuildValue("i", value);
 }
@@ -57,12 +85,49 @@ int camera_set_display_mode(Camera * self, PyObject * value, void * closure)
         return -1;
     }
     command = (int)PyLong_AsLong(value);
-    returnCode = display_mode_command(self->handle, command);
+    returnCode = display_mode_command(camera_handle(self), command);
     if (returnCode != IS_SUCCESS)
     {
-        print_error(self);
+        raise_error(self, returnCode);
+        return -1;
+    }
+
+    ids_mutex_lock(&self->settings_lock);
+    self->settings.display_mode = command;
+    self->settings.applied |= SETTING_DISPLAY_MODE;
+    ids_mutex_unlock(&self->settings_lock);
+    return 0;
+}
+
+PyObject * camera_get_auto_stats(Camera * self, void * closure)
+{
+    return Py_BuildValue("i", self->capture.stats_subsample);
+}
+
+/**
+  * Sets the grid step of the statistics computed for every captured frame,
+  * 1 for every pixel, 0 to turn them off. Frames carry them in info["stats"].
+  */
+int camera_set_auto_stats(Camera * self, PyObject * value, void * closure)
+{
+    long subsample;
+
+    if (value == NULL)
+    {
+        PyErr_SetString(PyExc_TypeError, "auto_stats can't be deleted");
+        return -1;
+    }
+    subsample = value == Py_None ? 0 : PyLong_AsLong(value);
+    if (subsample == -1 && PyErr_Occurred())
+    {
+        return -1;
+    }
+    if (subsample < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "auto_stats must be 0 (off) or a positive subsampling step");
         return -1;
     }
+    self->capture.stats_subsample = (int)subsample;
     return 0;
 }
 
@@ -102,7 +167,7 @@ int camera_set_master_gain(Camera * self, PyObject * value, void * closure)
     returnCode = set_gain(self, master_gain, red_gain, green_gain, blue_gain);
     if (returnCode != IS_SUCCESS)
     {
-        print_error(self);
+        raise_error(self, returnCode);
         return -1;
     }
 
@@ -138,7 +203,7 @@ int camera_set_red_gain(Camera * self, PyObject * value, void * closure)
     returnCode = set_gain(self, master_gain, red_gain, green_gain, blue_gain);
     if (returnCode != IS_SUCCESS)
     {
-        print_error(self);
+        raise_error(self, returnCode);
         return -1;
     }
 
@@ -174,7 +239,7 @@ int camera_set_green_gain(Camera * self, PyObject * value, void * closure)
     returnCode = set_gain(self, master_gain, red_gain, green_gain, blue_gain);
     if (returnCode != IS_SUCCESS)
     {
-        print_error(self);
+        raise_error(self, returnCode);
         return -1;
     }
 
@@ -210,7 +275,7 @@ int camera_set_blue_gain(Camera * self, PyObject * value, void * closure)
     returnCode = set_gain(self, master_gain, red_gain, green_gain, blue_gain);
     if (returnCode != IS_SUCCESS)
     {
-        print_error(self);
+        raise_error(self, returnCode);
         return -1;
     }
 
@@ -229,12 +294,18 @@ int camera_set_frame_rate(Camera * self, PyObject * value, void * closure)
     double wantedVal;
 
     wantedVal = PyFloat_AsDouble(value);
-    returnCode = is_SetFrameRate(self->handle, wantedVal, &setVal);
+    returnCode = is_SetFrameRate(camera_handle(self), wantedVal, &setVal);
     if (returnCode != IS_SUCCESS)
     {
-        print_error(self);
+        raise_error(self, returnCode);
         return -1;
     }
+
+    ids_mutex_lock(&self->settings_lock);
+    self->settings.frame_rate = wantedVal;
+    self->settings.applied |= SETTING_FRAME_RATE;
+    ids_mutex_unlock(&self->settings_lock);
+    settings_refresh_dependents(self);
     return 0;
 }
 
@@ -244,10 +315,10 @@ PyObject * camera_get_frame_rate(Camera * self, void * closure)
     double val;
     PyObject * value;
 
-    returnCode = is_SetFrameRate(self->handle, IS_GET_FRAMERATE, &val);
+    returnCode = is_SetFrameRate(camera_handle(self), IS_GET_FRAMERATE, &val);
     if (returnCode != IS_SUCCESS)
     {
-        print_error(self);
+        raise_error(self, returnCode);
         return NULL;
     }
     
@@ -268,12 +339,18 @@ int camera_set_pixel_clock(Camera * self, PyObject * value, void * closure)
     if (PyLong_Check(value))
     {
         nPixelClock = (UINT)PyLong_AsLong(value);
-        returnCode = is_PixelClock(self->handle, IS_PIXELCLOCK_CMD_SET,(void*)&nPixelClock, sizeof(nPixelClock));
+        returnCode = is_PixelClock(camera_handle(self), IS_PIXELCLOCK_CMD_SET,(void*)&nPixelClock, sizeof(nPixelClock));
         if (returnCode != IS_SUCCESS)
         {
-            print_error(self);
+            raise_error(self, returnCode);
             return -1;
         }
+
+        ids_mutex_lock(&self->settings_lock);
+        self->settings.pixel_clock = nPixelClock;
+        self->settings.applied |= SETTING_PIXEL_CLOCK;
+        ids_mutex_unlock(&self->settings_lock);
+        settings_refresh_dependents(self);
     }
     else
     {
@@ -288,10 +365,10 @@ PyObject * camera_get_pixel_clock(Camera * self, void * closure)
     int returnCode;
     UINT nPixelClock;
 
-    returnCode = is_PixelClock(self->handle, IS_PIXELCLOCK_CMD_GET, (void*)&nPixelClock, sizeof(nPixelClock));
+    returnCode = is_PixelClock(camera_handle(self), IS_PIXELCLOCK_CMD_GET, (void*)&nPixelClock, sizeof(nPixelClock));
     if (returnCode != IS_SUCCESS)
     {
-        print_error(self);
+        raise_error(self, returnCode);
         return NULL;
     }
     
@@ -312,12 +389,18 @@ int camera_set_exposure(Camera * self, PyObject * value, void * clousre)
     if (PyFloat_Check(value))
     {
         exposure_time = PyFloat_AsDouble(value);
-        returnCode = is_Exposure(self->handle, IS_EXPOSURE_CMD_SET_EXPOSURE, (void*)&exposure_time, sizeof(exposure_time));
+        returnCode = is_Exposure(camera_handle(self), IS_EXPOSURE_CMD_SET_EXPOSURE, (void*)&exposure_time, sizeof(exposure_time));
         if (returnCode != IS_SUCCESS)
         {
-            print_error(self);
+            raise_error(self, returnCode);
             return -1;
         }
+
+        ids_mutex_lock(&self->settings_lock);
+        self->settings.exposure = exposure_time;
+        self->settings.applied |= SETTING_EXPOSURE;
+        ids_mutex_unlock(&self->settings_lock);
+        settings_refresh_dependents(self);
     }
     else
     {
@@ -332,10 +415,10 @@ PyObject * camera_get_exposure(Camera * self, void * closure)
 {
     int returnCode;
     double exposure_time;
-    returnCode = is_Exposure(self->handle, IS_EXPOSURE_CMD_GET_EXPOSURE, (void*)&exposure_time, sizeof(exposure_time));
+    returnCode = is_Exposure(camera_handle(self), IS_EXPOSURE_CMD_GET_EXPOSURE, (void*)&exposure_time, sizeof(exposure_time));
     if (returnCode != IS_SUCCESS)
     {
-        print_error(self);
+        raise_error(self, returnCode);
         return NULL;
     }
     return Py_BuildValue("d", exposure_time);
@@ -359,12 +442,17 @@ int camera_set_white_balance(Camera * self, PyObject * value, void * closure)
 #endif
     {
         nType = (UINT)(PyLong_AsLong(value));
-        returnCode = is_AutoParameter(self->handle,IS_AWB_CMD_SET_TYPE, (void*)&nType, sizeof(nType));
+        returnCode = is_AutoParameter(camera_handle(self),IS_AWB_CMD_SET_TYPE, (void*)&nType, sizeof(nType));
         if (returnCode != IS_SUCCESS)
         {
-            print_error(self);
+            raise_error(self, returnCode);
             return -1;
         }
+
+        ids_mutex_lock(&self->settings_lock);
+        self->settings.white_balance = nType;
+        self->settings.applied |= SETTING_WHITE_BALANCE;
+        ids_mutex_unlock(&self->settings_lock);
     }
     else
     {
@@ -375,15 +463,118 @@ int camera_set_white_balance(Camera * self, PyObject * value, void * closure)
     return 0;
 }
 
+PyObject * camera_get_output_format(Camera * self, void * closure)
+{
+    return Py_BuildValue("s", convert_format_name(self->output_format));
+}
+
+/**
+  * Selects the pixel format of the arrays get_image returns: "raw" wraps the
+  * sequence buffer as delivered, "rgb8", "gray8" and "gray16" convert it
+  * into a new array and hand the buffer back to the SDK at once
+  */
+int camera_set_output_format(Camera * self, PyObject * value, void * closure)
+{
+    int format;
+
+    if (value == NULL)
+    {
+        PyErr_SetString(PyExc_TypeError, "output_format can't be deleted");
+        return -1;
+    }
+    if (!check_is_string(value))
+    {
+        PyErr_SetString(PyExc_TypeError, "output_format must be a string");
+        return -1;
+    }
+    format = convert_format_parse(get_as_string(value));
+    if (format < 0)
+    {
+        return -1;
+    }
+    self->output_format = format;
+    return 0;
+}
+
+PyObject * camera_get_orientation(Camera * self, void * closure)
+{
+    return Py_BuildValue("s", orientation_name(self->orientation));
+}
+
+/**
+  * Selects the geometry of the arrays get_image returns. The mirrors the
+  * camera supports are handed to the SDK as ROP effects, whatever is left
+  * is applied on the host as frames are copied out of the sequence buffer.
+  */
+int camera_set_orientation(Camera * self, PyObject * value, void * closure)
+{
+    int orientation;
+    int supported;
+    int rop = 0;
+    int returnCode;
+
+    if (value == NULL)
+    {
+        PyErr_SetString(PyExc_TypeError, "orientation can't be deleted");
+        return -1;
+    }
+    if (!check_is_string(value))
+    {
+        PyErr_SetString(PyExc_TypeError, "orientation must be a string");
+        return -1;
+    }
+    orientation = orientation_parse(get_as_string(value));
+    if (orientation < 0)
+    {
+        return -1;
+    }
+
+    supported = is_SetRopEffect(camera_handle(self), IS_GET_SUPPORTED_ROP_EFFECT, 0, 0);
+    if ((orientation & ORIENT_FLIP_LR) && (supported & IS_SET_ROP_MIRROR_LEFTRIGHT))
+    {
+        rop |= IS_SET_ROP_MIRROR_LEFTRIGHT;
+    }
+    if ((orientation & ORIENT_FLIP_UD) && (supported & IS_SET_ROP_MIRROR_UPDOWN))
+    {
+        rop |= IS_SET_ROP_MIRROR_UPDOWN;
+    }
+    returnCode = is_SetRopEffect(camera_handle(self), IS_SET_ROP_MIRROR_LEFTRIGHT, (rop & IS_SET_ROP_MIRROR_LEFTRIGHT) != 0, 0);
+    if (returnCode == IS_SUCCESS)
+    {
+        returnCode = is_SetRopEffect(camera_handle(self), IS_SET_ROP_MIRROR_UPDOWN, (rop & IS_SET_ROP_MIRROR_UPDOWN) != 0, 0);
+    }
+
+    ids_mutex_lock(&self->settings_lock);
+    if (returnCode == IS_SUCCESS)
+    {
+        self->settings.rop_effect = rop;
+        self->settings.applied |= SETTING_ROP_EFFECT;
+        self->orientation = orientation;
+    }
+    else
+    {
+        /* Only one of the mirrors may have changed */
+        self->settings.applied &= ~SETTING_ROP_EFFECT;
+    }
+    ids_mutex_unlock(&self->settings_lock);
+
+    if (returnCode != IS_SUCCESS)
+    {
+        raise_error(self, returnCode);
+        return -1;
+    }
+    return 0;
+}
+
 PyObject * camera_get_white_balance(Camera * self, void * closure)
 {
     int returnCode;
     UINT nType = 0;
 
-    returnCode = is_AutoParameter(self->handle, IS_AWB_CMD_GET_TYPE, (void*)&nType, sizeof(nType));
+    returnCode = is_AutoParameter(camera_handle(self), IS_AWB_CMD_GET_TYPE, (void*)&nType, sizeof(nType));
     if (returnCode != IS_SUCCESS)
     {
-        print_error(self);
+        raise_error(self, returnCode);
         return NULL;
     }
     return Py_BuildValue("i", nType);
@@ -399,5 +590,8 @@ PyGetSetDef camera_properties[] = {
     {"exposure", (getter)camera_get_exposure, (setter)camera_set_exposure, "Exposure Time", NULL},
     {"white_balance", (getter)camera_get_white_balance, (setter)camera_set_white_balance, "Auto White Balance", NULL},
     {"display_mode", (getter)camera_get_display_mode, (setter)camera_set_display_mode, "Display Mode", NULL},
+    {"auto_stats", (getter)camera_get_auto_stats, (setter)camera_set_auto_stats, "Per-frame statistics subsampling step, 0 when off", NULL},
+    {"output_format", (getter)camera_get_output_format, (setter)camera_set_output_format, "Pixel format of the arrays get_image returns: raw, rgb8, gray8 or gray16", NULL},
+    {"orientation", (getter)camera_get_orientation, (setter)camera_set_orientation, "Flip, rotation or transpose of the arrays get_image returns", NULL},
     {NULL} /* sentinel */
 };
@@ -0,0 +1,530 @@
+#include <uEye.h>
+#include "ids.h"
+#include <string.h>
+
+void settings_init(Camera * self)
+{
+    memset(&self->settings, 0, sizeof(CameraSettings));
+    ids_mutex_init(&self->settings_lock);
+}
+
+void settings_destroy(Camera * self)
+{
+    ids_mutex_destroy(&self->settings_lock);
+}
+
+/**
+  * Returns the SDK handle of the camera. The capture thread replaces it
+  * under settings_lock when it reopens a lost camera, so every other thread
+  * reads it through here.
+  */
+HIDS camera_handle(Camera * self)
+{
+    HIDS handle;
+
+    ids_mutex_lock(&self->settings_lock);
+    handle = self->handle;
+    ids_mutex_unlock(&self->settings_lock);
+    return handle;
+}
+
+/**
+  * Copies the cached settings, safe to call from any thread
+  */
+void settings_snapshot(Camera * self, CameraSettings * settings)
+{
+    ids_mutex_lock(&self->settings_lock);
+    *settings = self->settings;
+    ids_mutex_unlock(&self->settings_lock);
+}
+
+static void keep_first_error(int * result, int returnCode)
+{
+    if (returnCode != IS_SUCCESS && *result == IS_SUCCESS)
+    {
+        *result = returnCode;
+    }
+}
+
+/**
+  * Writes the flagged settings to a camera. Settings are applied in
+  * dependency order: the color mode sets the buffer layout, the pixel clock
+  * bounds the frame rate, which in turn bounds the exposure. Does not need
+  * the GIL.
+  * @return IS_SUCCESS, or the code of the first call that failed
+  */
+int settings_apply(HIDS handle, const CameraSettings * settings)
+{
+    int result = IS_SUCCESS;
+    UINT pixel_clock = settings->pixel_clock;
+    IS_RECT aoi = settings->aoi;
+    double exposure = settings->exposure;
+    double frame_rate;
+    UINT white_balance = settings->white_balance;
+    unsigned int gains = SETTING_MASTER_GAIN | SETTING_RED_GAIN | SETTING_GREEN_GAIN | SETTING_BLUE_GAIN;
+
+    if (settings->applied & SETTING_COLOR_MODE)
+    {
+        keep_first_error(&result, is_SetColorMode(handle, settings->color_mode));
+    }
+    if (settings->applied & SETTING_PIXEL_CLOCK)
+    {
+        keep_first_error(&result, is_PixelClock(handle, IS_PIXELCLOCK_CMD_SET, (void *)&pixel_clock, sizeof(pixel_clock)));
+    }
+    if (settings->applied & SETTING_AOI)
+    {
+        keep_first_error(&result, is_AOI(handle, IS_AOI_IMAGE_SET_AOI, (void *)&aoi, sizeof(aoi)));
+    }
+    if (settings->applied & SETTING_FRAME_RATE)
+    {
+        keep_first_error(&result, is_SetFrameRate(handle, settings->frame_rate, &frame_rate));
+    }
+    if (settings->applied & SETTING_EXPOSURE)
+    {
+        keep_first_error(&result, is_Exposure(handle, IS_EXPOSURE_CMD_SET_EXPOSURE, (void *)&exposure, sizeof(exposure)));
+    }
+    if (settings->applied & gains)
+    {
+        keep_first_error(&result, is_SetHardwareGain(handle,
+                (settings->applied & SETTING_MASTER_GAIN) ? settings->master_gain : IS_IGNORE_PARAMETER,
+                (settings->applied & SETTING_RED_GAIN) ? settings->red_gain : IS_IGNORE_PARAMETER,
+                (settings->applied & SETTING_GREEN_GAIN) ? settings->green_gain : IS_IGNORE_PARAMETER,
+                (settings->applied & SETTING_BLUE_GAIN) ? settings->blue_gain : IS_IGNORE_PARAMETER));
+    }
+    if (settings->applied & SETTING_WHITE_BALANCE)
+    {
+        keep_first_error(&result, is_AutoParameter(handle, IS_AWB_CMD_SET_TYPE, (void *)&white_balance, sizeof(white_balance)));
+    }
+    if (settings->applied & SETTING_TRIGGER)
+    {
+        keep_first_error(&result, is_SetExternalTrigger(handle, settings->trigger));
+    }
+    if (settings->applied & SETTING_DISPLAY_MODE)
+    {
+        keep_first_error(&result, is_SetDisplayMode(handle, settings->display_mode));
+    }
+    if (settings->applied & SETTING_ROP_EFFECT)
+    {
+        keep_first_error(&result, is_SetRopEffect(handle, IS_SET_ROP_MIRROR_LEFTRIGHT, (settings->rop_effect & IS_SET_ROP_MIRROR_LEFTRIGHT) != 0, 0));
+        keep_first_error(&result, is_SetRopEffect(handle, IS_SET_ROP_MIRROR_UPDOWN, (settings->rop_effect & IS_SET_ROP_MIRROR_UPDOWN) != 0, 0));
+    }
+    return result;
+}
+
+/**
+  * Reads every setting the camera reports into settings. Settings the
+  * camera can not report are left unflagged. Does not need the GIL.
+  */
+void settings_read(HIDS handle, CameraSettings * settings)
+{
+    memset(settings, 0, sizeof(CameraSettings));
+
+    settings->color_mode = is_SetColorMode(handle, IS_GET_COLOR_MODE);
+    settings->applied |= SETTING_COLOR_MODE;
+    if (is_PixelClock(handle, IS_PIXELCLOCK_CMD_GET, (void *)&settings->pixel_clock, sizeof(settings->pixel_clock)) == IS_SUCCESS)
+    {
+        settings->applied |= SETTING_PIXEL_CLOCK;
+    }
+    if (is_AOI(handle, IS_AOI_IMAGE_GET_AOI, (void *)&settings->aoi, sizeof(settings->aoi)) == IS_SUCCESS)
+    {
+        settings->applied |= SETTING_AOI;
+    }
+    if (is_SetFrameRate(handle, IS_GET_FRAMERATE, &settings->frame_rate) == IS_SUCCESS)
+    {
+        settings->applied |= SETTING_FRAME_RATE;
+    }
+    if (is_Exposure(handle, IS_EXPOSURE_CMD_GET_EXPOSURE, (void *)&settings->exposure, sizeof(settings->exposure)) == IS_SUCCESS)
+    {
+        settings->applied |= SETTING_EXPOSURE;
+    }
+    settings->master_gain = is_SetHardwareGain(handle, IS_GET_MASTER_GAIN, IS_IGNORE_PARAMETER, IS_IGNORE_PARAMETER, IS_IGNORE_PARAMETER);
+    settings->red_gain = is_SetHardwareGain(handle, IS_GET_RED_GAIN, IS_IGNORE_PARAMETER, IS_IGNORE_PARAMETER, IS_IGNORE_PARAMETER);
+    settings->green_gain = is_SetHardwareGain(handle, IS_GET_GREEN_GAIN, IS_IGNORE_PARAMETER, IS_IGNORE_PARAMETER, IS_IGNORE_PARAMETER);
+    settings->blue_gain = is_SetHardwareGain(handle, IS_GET_BLUE_GAIN, IS_IGNORE_PARAMETER, IS_IGNORE_PARAMETER, IS_IGNORE_PARAMETER);
+    settings->applied |= SETTING_MASTER_GAIN | SETTING_RED_GAIN | SETTING_GREEN_GAIN | SETTING_BLUE_GAIN;
+    if (is_AutoParameter(handle, IS_AWB_CMD_GET_TYPE, (void *)&settings->white_balance, sizeof(settings->white_balance)) == IS_SUCCESS)
+    {
+        settings->applied |= SETTING_WHITE_BALANCE;
+    }
+    settings->trigger = is_SetExternalTrigger(handle, IS_GET_EXTERNALTRIGGER);
+    settings->applied |= SETTING_TRIGGER;
+    settings->display_mode = is_SetDisplayMode(handle, IS_GET_DISPLAY_MODE);
+    settings->applied |= SETTING_DISPLAY_MODE;
+    settings->rop_effect = is_SetRopEffect(handle, IS_GET_ROP_EFFECT, 0, 0) & (IS_SET_ROP_MIRROR_LEFTRIGHT | IS_SET_ROP_MIRROR_UPDOWN);
+    settings->applied |= SETTING_ROP_EFFECT;
+}
+
+/**
+  * Re-reads the frame rate and the exposure of the settings in the cache.
+  * The SDK clamps both to a range that follows the pixel clock, the AOI and
+  * for the exposure the frame rate, so the value written is not always the
+  * value the camera holds afterwards. Does not need the GIL.
+  */
+void settings_refresh_dependents(Camera * self)
+{
+    HIDS handle = camera_handle(self);
+    double frame_rate;
+    double exposure;
+    int have_frame_rate = is_SetFrameRate(handle, IS_GET_FRAMERATE, &frame_rate) == IS_SUCCESS;
+    int have_exposure = is_Exposure(handle, IS_EXPOSURE_CMD_GET_EXPOSURE, (void *)&exposure, sizeof(exposure)) == IS_SUCCESS;
+
+    ids_mutex_lock(&self->settings_lock);
+    if (have_frame_rate)
+    {
+        self->settings.frame_rate = frame_rate;
+    }
+    else
+    {
+        self->settings.applied &= ~SETTING_FRAME_RATE;
+    }
+    if (have_exposure)
+    {
+        self->settings.exposure = exposure;
+    }
+    else
+    {
+        self->settings.applied &= ~SETTING_EXPOSURE;
+    }
+    ids_mutex_unlock(&self->settings_lock);
+}
+
+/*
+ * Compares or copies the single setting selected by flag
+ */
+static int setting_equal(const CameraSettings * a, const CameraSettings * b, unsigned int flag)
+{
+    switch (flag)
+    {
+        case SETTING_PIXEL_CLOCK:
+            return a->pixel_clock == b->pixel_clock;
+        case SETTING_AOI:
+            return memcmp(&a->aoi, &b->aoi, sizeof(IS_RECT)) == 0;
+        case SETTING_FRAME_RATE:
+            return a->frame_rate == b->frame_rate;
+        case SETTING_EXPOSURE:
+            return a->exposure == b->exposure;
+        case SETTING_MASTER_GAIN:
+            return a->master_gain == b->master_gain;
+        case SETTING_RED_GAIN:
+            return a->red_gain == b->red_gain;
+        case SETTING_GREEN_GAIN:
+            return a->green_gain == b->green_gain;
+        case SETTING_BLUE_GAIN:
+            return a->blue_gain == b->blue_gain;
+        case SETTING_WHITE_BALANCE:
+            return a->white_balance == b->white_balance;
+        case SETTING_DISPLAY_MODE:
+            return a->display_mode == b->display_mode;
+        case SETTING_COLOR_MODE:
+            return a->color_mode == b->color_mode;
+        case SETTING_TRIGGER:
+            return a->trigger == b->trigger;
+        case SETTING_ROP_EFFECT:
+            return a->rop_effect == b->rop_effect;
+    }
+    return 0;
+}
+
+static void setting_copy(CameraSettings * into, const CameraSettings * from, unsigned int flag)
+{
+    switch (flag)
+    {
+        case SETTING_PIXEL_CLOCK:
+            into->pixel_clock = from->pixel_clock;
+            break;
+        case SETTING_AOI:
+            into->aoi = from->aoi;
+            break;
+        case SETTING_FRAME_RATE:
+            into->frame_rate = from->frame_rate;
+            break;
+        case SETTING_EXPOSURE:
+            into->exposure = from->exposure;
+            break;
+        case SETTING_MASTER_GAIN:
+            into->master_gain = from->master_gain;
+            break;
+        case SETTING_RED_GAIN:
+            into->red_gain = from->red_gain;
+            break;
+        case SETTING_GREEN_GAIN:
+            into->green_gain = from->green_gain;
+            break;
+        case SETTING_BLUE_GAIN:
+            into->blue_gain = from->blue_gain;
+            break;
+        case SETTING_WHITE_BALANCE:
+            into->white_balance = from->white_balance;
+            break;
+        case SETTING_DISPLAY_MODE:
+            into->display_mode = from->display_mode;
+            break;
+        case SETTING_COLOR_MODE:
+            into->color_mode = from->color_mode;
+            break;
+        case SETTING_TRIGGER:
+            into->trigger = from->trigger;
+            break;
+        case SETTING_ROP_EFFECT:
+            into->rop_effect = from->rop_effect;
+            break;
+    }
+    into->applied |= flag;
+}
+
+/**
+  * @return The flags of the settings in target that current does not know
+  *      or holds a different value for. A setting whose range depends on a
+  *      changed one is included too, since the SDK may have clamped it.
+  */
+unsigned int settings_diff(const CameraSettings * current, const CameraSettings * target)
+{
+    unsigned int changed = 0;
+    unsigned int flag;
+
+    for (flag = 1; flag <= SETTING_ROP_EFFECT; flag <<= 1)
+    {
+        if ((target->applied & flag) && (!(current->applied & flag) || !setting_equal(current, target, flag)))
+        {
+            changed |= flag;
+        }
+    }
+    if (changed & (SETTING_COLOR_MODE | SETTING_PIXEL_CLOCK | SETTING_AOI))
+    {
+        changed |= target->applied & (SETTING_FRAME_RATE | SETTING_EXPOSURE);
+    }
+    if (changed & SETTING_FRAME_RATE)
+    {
+        changed |= target->applied & SETTING_EXPOSURE;
+    }
+    return changed;
+}
+
+void settings_merge(CameraSettings * into, const CameraSettings * from, unsigned int flags)
+{
+    unsigned int flag;
+
+    for (flag = 1; flag <= SETTING_ROP_EFFECT; flag <<= 1)
+    {
+        if (flags & from->applied & flag)
+        {
+            setting_copy(into, from, flag);
+        }
+    }
+}
+
+/**
+  * Captures the current camera settings into a Preset. The settings read
+  * also become the baseline that Camera.apply diffs against.
+  */
+PyObject * camera_snapshot(Camera * self)
+{
+    Preset * preset;
+    CameraSettings settings;
+
+    Py_BEGIN_ALLOW_THREADS
+    settings_read(camera_handle(self), &settings);
+    Py_END_ALLOW_THREADS
+
+    preset = PyObject_New(Preset, self->state->preset_type);
+    if (preset == NULL)
+    {
+        return NULL;
+    }
+    preset->settings = settings;
+
+    ids_mutex_lock(&self->settings_lock);
+    settings_merge(&self->settings, &settings, settings.applied);
+    ids_mutex_unlock(&self->settings_lock);
+
+    return (PyObject *)preset;
+}
+
+/**
+  * Switches the camera to a preset, writing only the settings that differ
+  * from what the camera is known to hold
+  * @return The time the switch took in seconds
+  * @note Changing the color mode restarts a running capture since the
+  *       buffer layout changes
+  */
+PyObject * camera_apply(Camera * self, PyObject * args)
+{
+    Preset * preset;
+    CameraSettings current;
+    CameraSettings target;
+    unsigned int changed;
+    int returnCode;
+    int buffers = 0;
+    int result;
+    int64_t start = ids_monotonic_ns();
+
+    if (!PyArg_ParseTuple(args, "O!", self->state->preset_type, &preset))
+    {
+        return NULL;
+    }
+
+    capture_control_lock(self);
+    target = preset->settings;
+    settings_snapshot(self, &current);
+    changed = settings_diff(&current, &target);
+    target.applied = changed;
+
+    if ((changed & SETTING_COLOR_MODE) && self->capture.running)
+    {
+        buffers = capture_buffer_count(self);
+        camera_capture_stop(self);
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    returnCode = settings_apply(camera_handle(self), &target);
+    Py_END_ALLOW_THREADS
+
+    ids_mutex_lock(&self->settings_lock);
+    if (returnCode == IS_SUCCESS)
+    {
+        settings_merge(&self->settings, &target, changed);
+    }
+    else
+    {
+        /* Part of the switch may have happened, the cached values are stale */
+        self->settings.applied &= ~changed;
+    }
+    ids_mutex_unlock(&self->settings_lock);
+
+    if (changed & (SETTING_COLOR_MODE | SETTING_PIXEL_CLOCK | SETTING_AOI | SETTING_FRAME_RATE | SETTING_EXPOSURE))
+    {
+        Py_BEGIN_ALLOW_THREADS
+        settings_refresh_dependents(self);
+        Py_END_ALLOW_THREADS
+    }
+
+    if (changed & SETTING_COLOR_MODE)
+    {
+        is_GetColorDepth(camera_handle(self), &self->bitdepth, &self->color);
+    }
+    result = buffers != 0 ? camera_capture_start(self, buffers) : 0;
+    capture_control_unlock(self);
+    if (result != 0)
+    {
+        return NULL;
+    }
+    if (returnCode != IS_SUCCESS)
+    {
+        raise_error(self, returnCode);
+        return NULL;
+    }
+
+    return PyFloat_FromDouble((ids_monotonic_ns() - start) / 1e9);
+}
+
+static const char * preset_names[] = {
+    "pixel_clock",
+    "aoi",
+    "frame_rate",
+    "exposure",
+    "master_gain",
+    "red_gain",
+    "green_gain",
+    "blue_gain",
+    "white_balance",
+    "display_mode",
+    "color_mode",
+    "trigger",
+    "rop_effect",
+};
+
+/**
+  * Returns the settings held by the preset as a dictionary
+  */
+PyObject * preset_get_settings(Preset * self, void * closure)
+{
+    CameraSettings * settings = &self->settings;
+    PyObject * dict = PyDict_New();
+    PyObject * value;
+    unsigned int flag;
+    int i;
+
+    for (i = 0, flag = 1; flag <= SETTING_ROP_EFFECT; i++, flag <<= 1)
+    {
+        if (!(settings->applied & flag))
+        {
+            continue;
+        }
+        switch (flag)
+        {
+            case SETTING_PIXEL_CLOCK:
+                value = Py_BuildValue("I", settings->pixel_clock);
+                break;
+            case SETTING_AOI:
+                value = Py_BuildValue("(iiii)", settings->aoi.s32X, settings->aoi.s32Y, settings->aoi.s32Width, settings->aoi.s32Height);
+                break;
+            case SETTING_FRAME_RATE:
+                value = Py_BuildValue("d", settings->frame_rate);
+                break;
+            case SETTING_EXPOSURE:
+                value = Py_BuildValue("d", settings->exposure);
+                break;
+            case SETTING_MASTER_GAIN:
+                value = Py_BuildValue("i", settings->master_gain);
+                break;
+            case SETTING_RED_GAIN:
+                value = Py_BuildValue("i", settings->red_gain);
+                break;
+            case SETTING_GREEN_GAIN:
+                value = Py_BuildValue("i", settings->green_gain);
+                break;
+            case SETTING_BLUE_GAIN:
+                value = Py_BuildValue("i", settings->blue_gain);
+                break;
+            case SETTING_WHITE_BALANCE:
+                value = Py_BuildValue("I", settings->white_balance);
+                break;
+            case SETTING_DISPLAY_MODE:
+                value = Py_BuildValue("i", settings->display_mode);
+                break;
+            case SETTING_COLOR_MODE:
+                value = Py_BuildValue("i", settings->color_mode);
+                break;
+            case SETTING_TRIGGER:
+                value = Py_BuildValue("i", settings->trigger);
+                break;
+            default:
+                value = Py_BuildValue("i", settings->rop_effect);
+                break;
+        }
+        PyDict_SetItemString(dict, preset_names[i], value);
+        Py_DECREF(value);
+    }
+    return dict;
+}
+
+void preset_dealloc(Preset * self)
+{
+    PyTypeObject * type = Py_TYPE(self);
+
+    type->tp_free((PyObject *)self);
+    Py_DECREF(type);
+}
+
+/**
+  * Declaration of all the publicly accessible properties of the Preset Object
+  */
+PyGetSetDef preset_properties[] = {
+    {"settings", (getter)preset_get_settings, NULL, "Settings held by the preset", NULL},
+    {NULL} /* Sentinel */
+};
+
+static PyType_Slot preset_slots[] = {
+    {Py_tp_dealloc, (void *)preset_dealloc},
+    {Py_tp_doc, (void *)"Camera settings captured by Camera.snapshot()"},
+    {Py_tp_getset, preset_properties},
+    {0, NULL} /* Sentinel */
+};
+
+PyType_Spec ids_PresetSpec = {
+    "ids.Preset",              /* name */
+    sizeof(Preset),            /* basicsize */
+    0,                         /* itemsize */
+    IDS_TPFLAGS | Py_TPFLAGS_DISALLOW_INSTANTIATION, /* flags */
+    preset_slots,              /* slots */
+};
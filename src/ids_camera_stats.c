@@ -0,0 +1,372 @@
+#include <uEye.h>
+#include "ids.h"
+
+/* How often the capture thread polls is_CaptureStatus */
+#define CAPTURE_STATUS_POLL_NS 1000000000LL
+
+/* Number of frames after which the device clock offset window rolls over */
+#define DEVICE_OFFSET_WINDOW 1024
+
+static const char * stage_names[STAGE_COUNT] = {
+    "sdk_wait",
+    "buffer_to_dequeue",
+    "dequeue_to_delivery",
+    "delivery_to_release",
+};
+
+/*
+ * SDK capture status counters surfaced by Camera.stats()
+ */
+static const struct
+{
+    int          code;
+    const char * name;
+} capture_status_names[] = {
+    {IS_CAP_STATUS_API_NO_DEST_MEM, "no_destination_memory"},
+    {IS_CAP_STATUS_API_CONVERSION_FAILED, "conversion_failed"},
+    {IS_CAP_STATUS_API_IMAGE_LOCKED, "destination_locked"},
+    {IS_CAP_STATUS_DRV_OUT_OF_BUFFERS, "driver_out_of_buffers"},
+    {IS_CAP_STATUS_DRV_DEVICE_NOT_READY, "device_not_ready"},
+    {IS_CAP_STATUS_USB_TRANSFER_FAILED, "usb_transfer_failed"},
+    {IS_CAP_STATUS_DEV_TIMEOUT, "device_timeout"},
+    {IS_CAP_STATUS_DEV_FRAME_CAPTURE_FAILED, "frame_capture_failed"},
+    {IS_CAP_STATUS_ETH_BUFFER_OVERRUN, "eth_buffer_overrun"},
+    {IS_CAP_STATUS_DEV_MISSED_IMAGES, "missed_images"},
+};
+
+/* Window state of the device clock offset estimate, only touched by the capture thread */
+static int64_t offset_window_min(CameraStats * stats, int64_t offset, uint64_t sequence)
+{
+    static const int64_t unset = INT64_MAX;
+
+    if (sequence % DEVICE_OFFSET_WINDOW == 0 || stats->device_offset_ns == 0)
+    {
+        stats->device_offset_ns = unset;
+    }
+    if (offset < stats->device_offset_ns)
+    {
+        stats->device_offset_ns = offset;
+    }
+    return stats->device_offset_ns;
+}
+
+static void counters_clear(volatile int64_t * values, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        ids_atomic_store64(&values[i], 0);
+    }
+}
+
+/**
+  * Zeroes the counters while the capture thread may still be updating them.
+  * Every field is cleared with an atomic store, so a concurrent increment
+  * lands either before or after the reset but never tears a value.
+  * locked_buffers is a level rather than a count and is kept. The frame
+  * rate window and the clock offset window belong to the capture thread,
+  * which restarts them when it sees the frame count go backwards.
+  */
+void stats_reset(CameraStats * stats)
+{
+    int i;
+
+    ids_atomic_store64(&stats->frames_captured, 0);
+    ids_atomic_store64(&stats->frames_delivered, 0);
+    ids_atomic_store64(&stats->frames_released, 0);
+    ids_atomic_store64(&stats->frames_dropped, 0);
+    ids_atomic_store64(&stats->frames_missing, 0);
+    ids_atomic_store64(&stats->gap_events, 0);
+    ids_atomic_store64(&stats->wait_errors, 0);
+    ids_atomic_store64(&stats->last_frame_number, -1);
+    ids_atomic_store64(&stats->delivery_high_water, 0);
+    ids_atomic_store64(&stats->sdk_buffers_high_water, 0);
+    ids_atomic_store64(&stats->locked_buffers_high_water, ids_atomic_load64(&stats->locked_buffers));
+    ids_atomic_store64(&stats->transfer_failures, 0);
+    counters_clear(stats->capture_status, 256);
+    ids_atomic_store64(&stats->measured_fps_milli, 0);
+    ids_atomic_store64(&stats->disconnects, 0);
+    ids_atomic_store64(&stats->reconnects, 0);
+    ids_atomic_store64(&stats->downtime_ns, 0);
+    ids_atomic_store64(&stats->last_downtime_ns, 0);
+    ids_atomic_store64(&stats->frame_objects_allocated, 0);
+    ids_atomic_store64(&stats->frame_objects_reused, 0);
+    ids_atomic_store64(&stats->arrays_allocated, 0);
+    ids_atomic_store64(&stats->arrays_reused, 0);
+    for (i = 0; i < STAGE_COUNT; i++)
+    {
+        ids_atomic_store64(&stats->latency[i].count, 0);
+        ids_atomic_store64(&stats->latency[i].total_ns, 0);
+        ids_atomic_store64(&stats->latency[i].max_ns, 0);
+        counters_clear(stats->latency[i].buckets, STATS_HISTOGRAM_BUCKETS);
+    }
+}
+
+void stats_record_latency(CameraStats * stats, int stage, int64_t elapsed_ns)
+{
+    LatencyHistogram * histogram = &stats->latency[stage];
+    int64_t elapsed_us = elapsed_ns / 1000;
+    int bucket = 0;
+
+    if (elapsed_ns < 0)
+    {
+        return;
+    }
+    while (bucket < STATS_HISTOGRAM_BUCKETS - 1 && (elapsed_us >> bucket) != 0)
+    {
+        bucket++;
+    }
+
+    ids_atomic_add64(&histogram->buckets[bucket], 1);
+    ids_atomic_add64(&histogram->count, 1);
+    ids_atomic_add64(&histogram->total_ns, elapsed_ns);
+    ids_atomic_max64(&histogram->max_ns, elapsed_ns);
+}
+
+/**
+  * Accounts for a frame just dequeued by the capture thread: wait time,
+  * estimated in-queue latency, frame number gaps and SDK queue depth
+  * @arg wait_ns Time spent blocked in is_WaitForNextImage
+  */
+void stats_on_capture(Camera * self, FrameSlot * slot, int64_t wait_ns)
+{
+    CameraStats * stats = &self->stats;
+    int64_t frame_number = (int64_t)slot->info.u64FrameNumber;
+    int64_t last = stats->last_frame_number;
+    int64_t offset;
+
+    ids_atomic_add64(&stats->frames_captured, 1);
+    stats_record_latency(stats, STAGE_SDK_WAIT, wait_ns);
+
+    /*
+     * The device timestamp (0.1us ticks) and the dequeue time differ by a
+     * fixed clock offset plus the queueing latency. The smallest difference
+     * over a recent window approximates the offset alone.
+     */
+    if (slot->info.u64TimestampDevice != 0)
+    {
+        offset = slot->dequeue_ns - (int64_t)slot->info.u64TimestampDevice * 100;
+        stats_record_latency(stats, STAGE_BUFFER_TO_DEQUEUE, offset - offset_window_min(stats, offset, slot->sequence));
+    }
+
+    if (last >= 0 && frame_number > last + 1)
+    {
+        ids_atomic_add64(&stats->frames_missing, frame_number - last - 1);
+        ids_atomic_add64(&stats->gap_events, 1);
+    }
+    ids_atomic_store64(&stats->last_frame_number, frame_number);
+    ids_atomic_max64(&stats->sdk_buffers_high_water, slot->info.dwImageBuffersInUse);
+}
+
+void stats_on_delivery(CameraStats * stats, FrameSlot * slot)
+{
+    slot->delivered_ns = ids_monotonic_ns();
+    ids_atomic_add64(&stats->frames_delivered, 1);
+    stats_record_latency(stats, STAGE_DEQUEUE_TO_DELIVERY, slot->delivered_ns - slot->dequeue_ns);
+}
+
+void stats_on_release(CameraStats * stats, FrameSlot * slot)
+{
+    ids_atomic_add64(&stats->frames_released, 1);
+    stats_record_latency(stats, STAGE_DELIVERY_TO_RELEASE, ids_monotonic_ns() - slot->delivered_ns);
+}
+
+/**
+  * Refreshes the SDK transfer failure counters, the measured frame rate and
+  * the device temperature, at most once per second. Called from the capture
+  * thread, which keeps the USB round-trips off the metrics endpoint.
+  */
+void stats_poll_capture_status(Camera * self)
+{
+    CameraStats * stats = &self->stats;
+    UEYE_CAPTURE_STATUS_INFO status;
+    WORD raw_temperature;
+    int64_t now = ids_monotonic_ns();
+    int64_t frames = ids_atomic_load64(&stats->frames_captured);
+    int64_t elapsed = now - stats->last_status_poll_ns;
+    int i;
+
+    if (frames < stats->fps_window_frames)
+    {
+        /* reset_stats() ran, restart both windows */
+        stats->fps_window_frames = frames;
+        stats->last_status_poll_ns = now;
+        stats->device_offset_ns = 0;
+        return;
+    }
+    if (elapsed < CAPTURE_STATUS_POLL_NS)
+    {
+        return;
+    }
+    if (stats->last_status_poll_ns != 0)
+    {
+        ids_atomic_store64(&stats->measured_fps_milli, (frames - stats->fps_window_frames) * 1000000000000LL / elapsed);
+    }
+    stats->fps_window_frames = frames;
+    stats->last_status_poll_ns = now;
+
+    if (is_DeviceFeature(self->handle, IS_DEVICE_FEATURE_CMD_GET_TEMPERATURE, (void *)&raw_temperature, sizeof(raw_temperature)) == IS_SUCCESS)
+    {
+        ids_atomic_store64(&stats->temperature_raw, raw_temperature);
+    }
+    else
+    {
+        ids_atomic_store64(&stats->temperature_raw, -1);
+    }
+
+    if (is_CaptureStatus(self->handle, IS_CAPTURE_STATUS_INFO_CMD_GET, (void *)&status, sizeof(status)) != IS_SUCCESS)
+    {
+        return;
+    }
+
+    ids_atomic_store64(&stats->transfer_failures, status.dwCapStatusCnt_Total);
+    for (i = 0; i < (int)(sizeof(capture_status_names) / sizeof(capture_status_names[0])); i++)
+    {
+        ids_atomic_store64(&stats->capture_status[capture_status_names[i].code], status.adwCapStatusCnt_Detail[capture_status_names[i].code]);
+    }
+}
+
+static PyObject * histogram_as_dict(LatencyHistogram * histogram)
+{
+    PyObject * buckets = PyList_New(0);
+    PyObject * bucket;
+    PyObject * dict;
+    int64_t count = ids_atomic_load64(&histogram->count);
+    int64_t total = ids_atomic_load64(&histogram->total_ns);
+    int64_t value;
+    int i;
+
+    for (i = 0; i < STATS_HISTOGRAM_BUCKETS; i++)
+    {
+        value = ids_atomic_load64(&histogram->buckets[i]);
+        if (value == 0)
+        {
+            continue;
+        }
+        bucket = Py_BuildValue("(LL)", i == 0 ? 1LL : (1LL << i), value);
+        PyList_Append(buckets, bucket);
+        Py_DECREF(bucket);
+    }
+
+    dict = Py_BuildValue("{s:L,s:d,s:d,s:O}",
+            "count", count,
+            "mean_us", count ? (double)total / count / 1000.0 : 0.0,
+            "max_us", ids_atomic_load64(&histogram->max_ns) / 1000.0,
+            "buckets_us", buckets);
+    Py_DECREF(buckets);
+    return dict;
+}
+
+/*
+ * Returns counters and latency histograms of the acquisition pipeline
+ * @return Python Dictionary for the stats
+ * @note Histogram buckets are (upper bound in microseconds, count) pairs
+ */
+PyObject * camera_stats(Camera * self)
+{
+    CameraStats * stats = &self->stats;
+    PyObject * dict;
+    PyObject * latency = PyDict_New();
+    PyObject * failures = PyDict_New();
+    PyObject * high_water;
+    PyObject * connection;
+    PyObject * gate;
+    PyObject * recorder;
+    PyObject * undistort;
+    PyObject * buffers;
+    PyObject * threads;
+    PyObject * clock;
+    PyObject * frame_pool;
+    PyObject * value;
+    int64_t disconnected_since = ids_atomic_load64(&self->capture.disconnected_since_ns);
+    int64_t downtime = ids_atomic_load64(&stats->downtime_ns);
+    int i;
+
+    for (i = 0; i < STAGE_COUNT; i++)
+    {
+        value = histogram_as_dict(&stats->latency[i]);
+        PyDict_SetItemString(latency, stage_names[i], value);
+        Py_DECREF(value);
+    }
+
+    for (i = 0; i < (int)(sizeof(capture_status_names) / sizeof(capture_status_names[0])); i++)
+    {
+        value = Py_BuildValue("L", ids_atomic_load64(&stats->capture_status[capture_status_names[i].code]));
+        PyDict_SetItemString(failures, capture_status_names[i].name, value);
+        Py_DECREF(value);
+    }
+    value = Py_BuildValue("L", ids_atomic_load64(&stats->transfer_failures));
+    PyDict_SetItemString(failures, "total", value);
+    Py_DECREF(value);
+
+    if (disconnected_since != 0)
+    {
+        downtime += ids_monotonic_ns() - disconnected_since;
+    }
+    connection = Py_BuildValue("{s:O,s:L,s:L,s:d,s:d}",
+            "connected", disconnected_since == 0 ? Py_True : Py_False,
+            "disconnects", ids_atomic_load64(&stats->disconnects),
+            "reconnects", ids_atomic_load64(&stats->reconnects),
+            "downtime_s", downtime / 1e9,
+            "last_downtime_s", ids_atomic_load64(&stats->last_downtime_ns) / 1e9);
+
+    high_water = Py_BuildValue("{s:L,s:L,s:L}",
+            "delivery_queue", ids_atomic_load64(&stats->delivery_high_water),
+            "sdk_buffers_in_use", ids_atomic_load64(&stats->sdk_buffers_high_water),
+            "locked_buffers", ids_atomic_load64(&stats->locked_buffers_high_water));
+
+    gate = gate_stats_as_dict(self);
+    recorder = recorder_stats_as_dict(self);
+    undistort = undistort_stats_as_dict(self);
+    buffers = capture_buffers_as_dict(self);
+    threads = thread_options_as_dict(self);
+    clock = clock_stats_as_dict(self);
+    frame_pool = Py_BuildValue("{s:O,s:L,s:L,s:L,s:L}",
+            "array_pool", frame_pool_arrays_enabled() ? Py_True : Py_False,
+            "frames_allocated", ids_atomic_load64(&stats->frame_objects_allocated),
+            "frames_reused", ids_atomic_load64(&stats->frame_objects_reused),
+            "arrays_allocated", ids_atomic_load64(&stats->arrays_allocated),
+            "arrays_reused", ids_atomic_load64(&stats->arrays_reused));
+
+    dict = Py_BuildValue("{s:L,s:L,s:L,s:L,s:L,s:L,s:L,s:L,s:O,s:O,s:O,s:O,s:O,s:O,s:O,s:O,s:O,s:O,s:O}",
+            "frames_captured", ids_atomic_load64(&stats->frames_captured),
+            "frames_delivered", ids_atomic_load64(&stats->frames_delivered),
+            "frames_released", ids_atomic_load64(&stats->frames_released),
+            "frames_dropped", ids_atomic_load64(&stats->frames_dropped),
+            "frames_missing", ids_atomic_load64(&stats->frames_missing),
+            "gap_events", ids_atomic_load64(&stats->gap_events),
+            "wait_errors", ids_atomic_load64(&stats->wait_errors),
+            "locked_buffers", ids_atomic_load64(&stats->locked_buffers),
+            "transfer_failures", failures,
+            "queue_high_water", high_water,
+            "connection", connection,
+            "gate", gate,
+            "recorder", recorder,
+            "undistort", undistort,
+            "buffers", buffers,
+            "threads", threads,
+            "clock", clock,
+            "frame_pool", frame_pool,
+            "latency", latency);
+
+    Py_DECREF(failures);
+    Py_DECREF(high_water);
+    Py_DECREF(connection);
+    Py_DECREF(gate);
+    Py_DECREF(recorder);
+    Py_DECREF(undistort);
+    Py_DECREF(buffers);
+    Py_DECREF(threads);
+    Py_DECREF(clock);
+    Py_DECREF(frame_pool);
+    Py_DECREF(latency);
+    return dict;
+}
+
+PyObject * camera_reset_stats(Camera * self)
+{
+    stats_reset(&self->stats);
+    is_CaptureStatus(camera_handle(self), IS_CAPTURE_STATUS_INFO_CMD_RESET, NULL, 0);
+    Py_RETURN_NONE;
+}
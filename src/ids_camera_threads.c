@@ -0,0 +1,616 @@
+#include <uEye.h>
+#include "ids.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define MAX_THREAD_PRIORITY       99
+#define DEFAULT_STRESS_SECONDS    2.0
+#define DEFAULT_SCALING_SECONDS   1.0
+#define MAX_SCALING_THREADS       64
+/* How long a benchmark worker waits for a frame before checking for the end */
+#define SCALING_WAIT_MS           100
+
+static const char * thread_role_names[THREAD_ROLES] = {"capture", "processing", "writer"};
+
+/**
+  * Applies the options of role to the calling thread and records the outcome.
+  * Called by every native thread of the role as it starts. Failures leave the
+  * thread running with the default scheduling.
+  */
+void thread_options_apply(Camera * self, int role)
+{
+    ThreadOptions * target = &self->threads[role];
+    ThreadOptions options;
+    int i;
+
+    ids_mutex_lock(&self->settings_lock);
+    options = *target;
+    ids_mutex_unlock(&self->settings_lock);
+    if (!options.configured)
+    {
+        return;
+    }
+
+    for (i = 0; i < IDS_MAX_CPUS / 64; i++)
+    {
+        if (options.cpus[i] != 0)
+        {
+            target->affinity_error = ids_thread_set_affinity(options.cpus);
+            break;
+        }
+    }
+    if (options.priority > 0)
+    {
+        target->priority_error = ids_thread_set_realtime(options.priority);
+    }
+    ids_atomic_add64(&target->threads_applied, 1);
+}
+
+/**
+  * Locks memory owned by the threads of role into RAM if the role asks for it
+  * @return 1 when the memory is locked and must be unlocked by the caller
+  */
+int thread_options_lock_memory(Camera * self, int role, void * memory, size_t size)
+{
+    ThreadOptions * target = &self->threads[role];
+    int lock_memory;
+    int error;
+
+    ids_mutex_lock(&self->settings_lock);
+    lock_memory = target->configured && target->lock_memory;
+    ids_mutex_unlock(&self->settings_lock);
+    if (!lock_memory || memory == NULL)
+    {
+        return 0;
+    }
+
+    error = ids_memory_lock(memory, size);
+    ids_atomic_add64(&target->lock_attempts, 1);
+    /* The first failure sticks, later successes must not hide it */
+    if (error != 0 || target->lock_error == 0)
+    {
+        target->lock_error = error;
+    }
+    return error == 0;
+}
+
+/**
+  * Describes the outcome of a requested option: None when it was not asked
+  * for or no thread has started yet, "ok", or the reason it was refused
+  */
+static PyObject * thread_outcome(int requested, int64_t applied, int error)
+{
+    if (!requested || applied == 0)
+    {
+        Py_RETURN_NONE;
+    }
+    return Py_BuildValue("s", error == 0 ? "ok" : strerror(error));
+}
+
+PyObject * thread_options_as_dict(Camera * self)
+{
+    PyObject * dict = PyDict_New();
+    PyObject * cpus;
+    PyObject * value;
+    ThreadOptions options;
+    int64_t applied;
+    int has_cpus;
+    int role;
+    int cpu;
+
+    for (role = 0; dict != NULL && role < THREAD_ROLES; role++)
+    {
+        ids_mutex_lock(&self->settings_lock);
+        options = self->threads[role];
+        ids_mutex_unlock(&self->settings_lock);
+        applied = options.threads_applied;
+
+        cpus = PyList_New(0);
+        has_cpus = 0;
+        for (cpu = 0; cpus != NULL && cpu < IDS_MAX_CPUS; cpu++)
+        {
+            if (options.cpus[cpu / 64] & ((uint64_t)1 << (cpu % 64)))
+            {
+                value = Py_BuildValue("i", cpu);
+                PyList_Append(cpus, value);
+                Py_DECREF(value);
+                has_cpus = 1;
+            }
+        }
+        if (cpus == NULL)
+        {
+            Py_DECREF(dict);
+            return NULL;
+        }
+
+        value = Py_BuildValue("{s:O,s:i,s:O,s:L,s:N,s:N,s:N}",
+                "cpus", has_cpus ? cpus : Py_None,
+                "priority", options.priority,
+                "lock_memory", options.lock_memory ? Py_True : Py_False,
+                "threads_applied", applied,
+                "affinity", thread_outcome(has_cpus, applied, options.affinity_error),
+                "realtime", thread_outcome(options.priority > 0, applied, options.priority_error),
+                "memory_lock", thread_outcome(options.lock_memory, options.lock_attempts, options.lock_error));
+        Py_DECREF(cpus);
+        if (value == NULL)
+        {
+            Py_DECREF(dict);
+            return NULL;
+        }
+        PyDict_SetItemString(dict, thread_role_names[role], value);
+        Py_DECREF(value);
+    }
+    return dict;
+}
+
+/**
+  * Function to set the scheduling of the native threads of one role
+  * This means the definition of the method is:
+  *     def configure_threads(self, role, cpus=None, priority=0, lock_memory=False)
+  * @arg role "capture", "processing" (preview and record copy) or "writer"
+  *      (dump and stream connections)
+  * @arg cpus CPU numbers the threads may run on, None for all
+  * @arg priority SCHED_FIFO priority between 1 and 99, 0 for normal scheduling
+  * @arg lock_memory Lock the buffers of the role into RAM: the sequence
+  *      buffers for capture, the recorder ring for processing
+  * @note Threads started afterwards pick the options up, a running capture is
+  *       restarted. Options the OS refuses are reported in stats()["threads"].
+  */
+PyObject * camera_configure_threads(Camera * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"role", "cpus", "priority", "lock_memory", NULL};
+    ThreadOptions options;
+    PyObject * cpus = Py_None;
+    PyObject * sequence;
+    char * name;
+    long cpu;
+    int priority = 0;
+    int lock_memory = 0;
+    int role;
+    int running;
+    int buffers;
+    int result;
+    Py_ssize_t i;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|Oii", kwlist, &name, &cpus, &priority, &lock_memory))
+    {
+        return NULL;
+    }
+    for (role = 0; role < THREAD_ROLES && strcmp(name, thread_role_names[role]) != 0; role++)
+    {
+    }
+    if (role == THREAD_ROLES)
+    {
+        PyErr_Format(PyExc_ValueError, "Unknown thread role '%s', expected capture, processing or writer", name);
+        return NULL;
+    }
+    if (priority < 0 || priority > MAX_THREAD_PRIORITY)
+    {
+        PyErr_Format(PyExc_ValueError, "priority must be between 0 and %d", MAX_THREAD_PRIORITY);
+        return NULL;
+    }
+
+    memset(&options, 0, sizeof(options));
+    if (cpus != Py_None)
+    {
+        sequence = PySequence_Fast(cpus, "cpus must be a sequence of CPU numbers");
+        if (sequence == NULL)
+        {
+            return NULL;
+        }
+        for (i = 0; i < PySequence_Fast_GET_SIZE(sequence); i++)
+        {
+            cpu = PyLong_AsLong(PySequence_Fast_GET_ITEM(sequence, i));
+            if (PyErr_Occurred() || cpu < 0 || cpu >= IDS_MAX_CPUS)
+            {
+                Py_DECREF(sequence);
+                if (!PyErr_Occurred())
+                {
+                    PyErr_Format(PyExc_ValueError, "CPU numbers must be between 0 and %d", IDS_MAX_CPUS - 1);
+                }
+                return NULL;
+            }
+            options.cpus[cpu / 64] |= (uint64_t)1 << (cpu % 64);
+        }
+        Py_DECREF(sequence);
+        if (i == 0)
+        {
+            PyErr_SetString(PyExc_ValueError, "cpus must not be empty, use None for all CPUs");
+            return NULL;
+        }
+    }
+    options.priority = priority;
+    options.lock_memory = lock_memory != 0;
+    options.configured = cpus != Py_None || priority > 0 || lock_memory;
+
+    capture_control_lock(self);
+    running = role == THREAD_CAPTURE && self->capture.running;
+    buffers = running ? capture_buffer_count(self) : DEFAULT_CAPTURE_BUFFERS;
+    if (running)
+    {
+        camera_capture_stop(self);
+    }
+
+    ids_mutex_lock(&self->settings_lock);
+    self->threads[role] = options;
+    ids_mutex_unlock(&self->settings_lock);
+
+    result = running ? camera_capture_start(self, buffers) : 0;
+    capture_control_unlock(self);
+    if (result != 0)
+    {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+/**
+  * Busy loop standing in for analysis workers competing for the CPUs
+  */
+static void stress_load_main(void * arg)
+{
+    volatile int * running = (volatile int *)arg;
+    volatile double x = 1.0;
+
+    while (*running)
+    {
+        x = x * 1.0000001 + 1e-9;
+    }
+}
+
+/**
+  * Restarts capture and counts what it loses while load_threads busy loops
+  * run next to it
+  * @return A dictionary of the counters, NULL with an exception set
+  */
+static PyObject * stress_phase(Camera * self, int buffers, double seconds, int load_threads)
+{
+    CameraStats * stats = &self->stats;
+    ids_thread_t * threads;
+    volatile int running = 1;
+    int64_t captured, missing, failures, started;
+    int64_t elapsed;
+    int count = 0;
+    int result;
+    int i;
+
+    capture_control_lock(self);
+    camera_capture_stop(self);
+    result = camera_capture_start(self, buffers);
+    capture_control_unlock(self);
+    if (result != 0)
+    {
+        return NULL;
+    }
+    threads = (ids_thread_t *)calloc(load_threads > 0 ? load_threads : 1, sizeof(ids_thread_t));
+    if (threads == NULL)
+    {
+        return PyErr_NoMemory();
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    for (count = 0; count < load_threads; count++)
+    {
+        if (ids_thread_start(&threads[count], stress_load_main, (void *)&running) != 0)
+        {
+            break;
+        }
+    }
+    captured = ids_atomic_load64(&stats->frames_captured);
+    missing = ids_atomic_load64(&stats->frames_missing);
+    failures = ids_atomic_load64(&stats->transfer_failures);
+    started = ids_monotonic_ns();
+    ids_sleep_ms((int)(seconds * 1000));
+    elapsed = ids_monotonic_ns() - started;
+    captured = ids_atomic_load64(&stats->frames_captured) - captured;
+    missing = ids_atomic_load64(&stats->frames_missing) - missing;
+    failures = ids_atomic_load64(&stats->transfer_failures) - failures;
+
+    running = 0;
+    for (i = 0; i < count; i++)
+    {
+        ids_thread_join(threads[i]);
+    }
+    Py_END_ALLOW_THREADS
+    free(threads);
+
+    return Py_BuildValue("{s:i,s:L,s:L,s:L,s:d,s:d}",
+            "load_threads", count,
+            "frames_captured", captured,
+            "frames_missing", missing,
+            "transfer_failures", failures,
+            "fps", elapsed > 0 ? captured / (elapsed / 1e9) : 0.0,
+            "loss_ratio", captured + missing > 0 ? (double)missing / (captured + missing) : 0.0);
+}
+
+/**
+  * Function to measure frame loss under synthetic CPU load, once with the
+  * default scheduling and once with the options of the capture role
+  * This means the definition of the method is:
+  *     def stress_test(self, seconds=2.0, load_threads=None)
+  * @arg load_threads Busy threads to start, None for two per CPU
+  * @return {"default": {...}, "configured": {...}}
+  * @note Restarts capture for each run and leaves it running
+  */
+PyObject * camera_stress_test(Camera * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"seconds", "load_threads", NULL};
+    ThreadOptions * capture_options = &self->threads[THREAD_CAPTURE];
+    ThreadOptions saved;
+    PyObject * load = Py_None;
+    PyObject * unpinned;
+    PyObject * pinned;
+    PyObject * result;
+    double seconds = DEFAULT_STRESS_SECONDS;
+    int load_threads = 2 * ids_cpu_count();
+    int buffers = capture_buffer_count(self);
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|dO", kwlist, &seconds, &load))
+    {
+        return NULL;
+    }
+    if (load != Py_None)
+    {
+        load_threads = (int)PyLong_AsLong(load);
+        if (PyErr_Occurred())
+        {
+            return NULL;
+        }
+    }
+    if (seconds <= 0 || load_threads < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "seconds must be positive and load_threads not negative");
+        return NULL;
+    }
+    if (!capture_options->configured)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Call configure_threads('capture', ...) first");
+        return NULL;
+    }
+
+    ids_mutex_lock(&self->settings_lock);
+    saved = *capture_options;
+    capture_options->configured = 0;
+    ids_mutex_unlock(&self->settings_lock);
+
+    unpinned = stress_phase(self, buffers, seconds, load_threads);
+
+    ids_mutex_lock(&self->settings_lock);
+    *capture_options = saved;
+    ids_mutex_unlock(&self->settings_lock);
+    if (unpinned == NULL)
+    {
+        return NULL;
+    }
+
+    pinned = stress_phase(self, buffers, seconds, load_threads);
+    if (pinned == NULL)
+    {
+        Py_DECREF(unpinned);
+        return NULL;
+    }
+    result = Py_BuildValue("{s:N,s:N}", "default", unpinned, "configured", pinned);
+    return result;
+}
+
+/*
+ * One analysis thread of the scaling benchmark
+ */
+typedef struct
+{
+    Camera *           camera;
+    PyObject *         work;
+    volatile int *     running;
+    int64_t            frames;
+    PyObject *         error_type;
+    PyObject *         error_value;
+    PyObject *         error_traceback;
+} ScalingWorker;
+
+/**
+  * Takes frames off the delivery queue and hands each to work, attached to
+  * the interpreter like any Python thread
+  */
+static void scaling_worker_main(void * arg)
+{
+    ScalingWorker * worker = (ScalingWorker *)arg;
+    PyGILState_STATE gil;
+    FrameSlot * slot;
+    PyObject * frame;
+    PyObject * result;
+
+    trace_thread_name("ids benchmark");
+    gil = PyGILState_Ensure();
+    while (*worker->running && worker->error_type == NULL)
+    {
+        Py_BEGIN_ALLOW_THREADS
+        slot = camera_capture_next(worker->camera, SCALING_WAIT_MS);
+        Py_END_ALLOW_THREADS
+        if (slot == NULL)
+        {
+            continue;
+        }
+        frame = frame_from_slot(worker->camera, slot);
+        result = frame != NULL ? PyObject_CallFunctionObjArgs(worker->work, frame, NULL) : NULL;
+        Py_XDECREF(frame);
+        if (result == NULL)
+        {
+            PyErr_Fetch(&worker->error_type, &worker->error_value, &worker->error_traceback);
+            break;
+        }
+        Py_DECREF(result);
+        worker->frames++;
+    }
+    PyGILState_Release(gil);
+}
+
+/**
+  * Runs count workers for seconds
+  * @return Frames processed per second, -1 with a Python exception set
+  */
+static double scaling_phase(Camera * self, PyObject * work, int count, double seconds)
+{
+    ScalingWorker workers[MAX_SCALING_THREADS];
+    ids_thread_t threads[MAX_SCALING_THREADS];
+    volatile int running = 1;
+    int64_t frames = 0;
+    int64_t started;
+    int64_t elapsed;
+    int failed = -1;
+    int i;
+
+    memset(workers, 0, sizeof(workers));
+    Py_BEGIN_ALLOW_THREADS
+    started = ids_monotonic_ns();
+    for (i = 0; i < count; i++)
+    {
+        workers[i].camera = self;
+        workers[i].work = work;
+        workers[i].running = &running;
+        if (ids_thread_start(&threads[i], scaling_worker_main, &workers[i]) != 0)
+        {
+            break;
+        }
+    }
+    count = i;
+    ids_sleep_ms((int)(seconds * 1000));
+    running = 0;
+    for (i = 0; i < count; i++)
+    {
+        ids_thread_join(threads[i]);
+    }
+    elapsed = ids_monotonic_ns() - started;
+    Py_END_ALLOW_THREADS
+
+    for (i = 0; i < count; i++)
+    {
+        frames += workers[i].frames;
+        if (workers[i].error_type != NULL && failed < 0)
+        {
+            failed = i;
+        }
+        else if (workers[i].error_type != NULL)
+        {
+            Py_DECREF(workers[i].error_type);
+            Py_XDECREF(workers[i].error_value);
+            Py_XDECREF(workers[i].error_traceback);
+        }
+    }
+    if (failed >= 0)
+    {
+        PyErr_Restore(workers[failed].error_type, workers[failed].error_value, workers[failed].error_traceback);
+        return -1;
+    }
+    if (count == 0)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Unable to start benchmark threads");
+        return -1;
+    }
+    return elapsed > 0 ? frames / (elapsed / 1e9) : 0.0;
+}
+
+/**
+  * Function to measure how frame analysis in Python threads scales with
+  * the number of threads. Under the GIL only the parts of work that release
+  * it run in parallel; the free-threaded build runs all of it in parallel.
+  * This means the definition of the method is:
+  *     def scaling_benchmark(self, work, threads=(1, 2, 4, 8), seconds=1.0)
+  * @arg work Callable applied to every frame, from several threads at once
+  * @return {"free_threaded": bool, "gil_enabled": bool,
+  *          "frames_per_second": {threads: rate, ...}}
+  * @note Starts capture if it is not running. The frame rate has to exceed
+  *       what the threads can analyse, or the camera is what is measured.
+  */
+PyObject * camera_scaling_benchmark(Camera * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"work", "threads", "seconds", NULL};
+    PyObject * work;
+    PyObject * threads = NULL;
+    PyObject * sequence;
+    PyObject * rates;
+    PyObject * rate;
+    PyObject * is_gil_enabled;
+    PyObject * enabled;
+    int gil_enabled = 1;
+    double seconds = DEFAULT_SCALING_SECONDS;
+    double fps;
+    long count;
+    Py_ssize_t i;
+    int free_threaded = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|Od", kwlist, &work, &threads, &seconds))
+    {
+        return NULL;
+    }
+    if (!PyCallable_Check(work))
+    {
+        PyErr_SetString(PyExc_TypeError, "work must be callable");
+        return NULL;
+    }
+    if (seconds <= 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "seconds must be positive");
+        return NULL;
+    }
+    if (threads == NULL)
+    {
+        sequence = Py_BuildValue("(iiii)", 1, 2, 4, 8);
+    }
+    else
+    {
+        sequence = PySequence_Fast(threads, "threads must be a sequence of thread counts");
+    }
+    if (sequence == NULL)
+    {
+        return NULL;
+    }
+    rates = PyDict_New();
+    if (rates == NULL || camera_capture_ensure(self, DEFAULT_CAPTURE_BUFFERS, NULL) != 0)
+    {
+        Py_XDECREF(rates);
+        Py_DECREF(sequence);
+        return NULL;
+    }
+
+    for (i = 0; i < PySequence_Fast_GET_SIZE(sequence); i++)
+    {
+        count = PyLong_AsLong(PySequence_Fast_GET_ITEM(sequence, i));
+        if (!PyErr_Occurred() && (count < 1 || count > MAX_SCALING_THREADS))
+        {
+            PyErr_Format(PyExc_ValueError, "Thread counts must be between 1 and %d", MAX_SCALING_THREADS);
+        }
+        fps = PyErr_Occurred() ? -1 : scaling_phase(self, work, (int)count, seconds);
+        rate = fps < 0 ? NULL : PyFloat_FromDouble(fps);
+        if (rate == NULL || PyDict_SetItem(rates, PySequence_Fast_GET_ITEM(sequence, i), rate) != 0)
+        {
+            Py_XDECREF(rate);
+            Py_DECREF(rates);
+            Py_DECREF(sequence);
+            return NULL;
+        }
+        Py_DECREF(rate);
+    }
+    Py_DECREF(sequence);
+
+#ifdef Py_GIL_DISABLED
+    free_threaded = 1;
+#endif
+    /* Importing a module without free-threading support turns the GIL back on */
+    is_gil_enabled = PySys_GetObject("_is_gil_enabled");
+    if (is_gil_enabled != NULL)
+    {
+        enabled = PyObject_CallObject(is_gil_enabled, NULL);
+        if (enabled == NULL)
+        {
+            Py_DECREF(rates);
+            return NULL;
+        }
+        gil_enabled = PyObject_IsTrue(enabled);
+        Py_DECREF(enabled);
+    }
+    return Py_BuildValue("{s:O,s:O,s:N}",
+            "free_threaded", free_threaded ? Py_True : Py_False,
+            "gil_enabled", gil_enabled ? Py_True : Py_False,
+            "frames_per_second", rates);
+}
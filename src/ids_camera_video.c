@@ -8,25 +8,28 @@
 
 extern int display_mode_command(HIDS handle, int command);
 
-void start_video_capture(Video * self)
+/*
+ * Raises IDSError for a failed call into the AVI library
+ */
+static void raise_avi_error(ModuleState * state, int returnCode, const char * what)
 {
-    int returnCode;
-    int error = 0;
+    PyErr_Format(state->error, "uEye AVI error %d %s", returnCode, what);
+}
+
+int start_video_capture(Video * self)
+{
+    int returnCode = IS_AVI_NO_ERR;
 
     while(self->is_capture)
     {
         // TODO: Call AddFrame function
         if (returnCode != IS_AVI_NO_ERR)
         {
-            error = 1;
             break;
         }
     }
 
-    if (error)
-    {
-        printf("Error occured whilst capturing video");
-    }
+    return returnCode;
 }
 
 int set_frame_rate(Video * self)
@@ -34,10 +37,25 @@ int set_frame_rate(Video * self)
     return isavi_SetFrameRate(self->videoID, self->frame_rate);
 }
 
+/*
+ * The AVI engine only records in DIB mode
+ * @return 0 on success, -1 with a Python exception set
+ */
 int check_display_mode(Video * self)
 {
-    printf("WARNING: Changing display mode to Device Independent Bitmap(DIB)\n");
-    return display_mode_command(self->handle, IS_SET_DM_DIB);
+    int returnCode;
+
+    if (PyErr_WarnEx(PyExc_RuntimeWarning, "Changing display mode to Device Independent Bitmap (DIB)", 1) < 0)
+    {
+        return -1;
+    }
+    returnCode = display_mode_command(self->handle, IS_SET_DM_DIB);
+    if (returnCode != IS_SUCCESS)
+    {
+        raise_module_error(self->state, NULL, returnCode);
+        return -1;
+    }
+    return 0;
 }
 
 /**
@@ -50,14 +68,14 @@ PyObject * camera_video(Camera * self)
     INT videoID;
     int returnCode;
 
-    returnCode = isavi_InitAVI(&videoID, self->handle);
+    returnCode = isavi_InitAVI(&videoID, camera_handle(self));
     if (returnCode != IS_AVI_NO_ERR)
     {
-        print_error(self);
+        raise_avi_error(self->state, returnCode, "Could not initialize the AVI engine");
         return result;
     }
-    argList = Py_BuildValue("(ii)", self->handle, videoID);
-    result = PyObject_CallObject((PyObject *) &ids_VideoType, argList);
+    argList = Py_BuildValue("(ii)", camera_handle(self), videoID);
+    result = PyObject_CallObject((PyObject *)self->state->video_type, argList);
     Py_DECREF(argList);
     return result;
 }
@@ -65,27 +83,43 @@ PyObject * camera_video(Camera * self)
 PyObject * video_start(Video * self)
 {
     int returnCode;
-    returnCode = check_display_mode(self);
-    if (returnCode != IS_AVI_NO_ERR)
+    if (check_display_mode(self) != 0)
     {
-        return -1;
+        return NULL;
     }
-    returnCode = isavi_OpenAVI(self->videoID, &self->filename);
+
+    /* Keeps the setters from changing the file name or rate under the engine */
+    Py_BEGIN_CRITICAL_SECTION(self);
+    returnCode = isavi_OpenAVI(self->videoID, self->filename);
     if (returnCode != IS_AVI_NO_ERR)
     {
-        return -1;
+        raise_avi_error(self->state, returnCode, "Could not open the video file");
     }
-
-    returnCode = set_frame_rate(self);
+    else
+    {
+        returnCode = set_frame_rate(self);
+        if (returnCode != IS_AVI_NO_ERR)
+        {
+            raise_avi_error(self->state, returnCode, "Could not set the video frame rate");
+        }
+        else
+        {
+            self->is_capture = 1;
+        }
+    }
+    Py_END_CRITICAL_SECTION();
     if (returnCode != IS_AVI_NO_ERR)
     {
-        return -1;
+        return NULL;
     }
 
-    self->is_capture = 1;
-
     // TODO: Make this async
-    start_video_capture(self);
+    returnCode = start_video_capture(self);
+    if (returnCode != IS_AVI_NO_ERR)
+    {
+        raise_avi_error(self->state, returnCode, "Error occured whilst capturing video");
+        return NULL;
+    }
 
     Py_RETURN_NONE;
 }
@@ -93,19 +127,28 @@ PyObject * video_start(Video * self)
 PyObject * video_stop(Video * self)
 {
     int returnCode;
+    const char * failure = NULL;
+
+    Py_BEGIN_CRITICAL_SECTION(self);
     self->is_capture = 0;
     returnCode = isavi_StopAVI(self->videoID);
     if (returnCode != IS_AVI_NO_ERR)
     {
-        printf("Failed to stop video capture\n");
-        return -1;
+        failure = "Failed to stop video capture";
     }
-
-    returnCode = isavi_CloseAVI(self->videoID);
-    if (returnCode != IS_AVI_NO_ERR)
+    else
     {
-        printf("Failed to close video capture\n");
-        return -1;
+        returnCode = isavi_CloseAVI(self->videoID);
+        if (returnCode != IS_AVI_NO_ERR)
+        {
+            failure = "Failed to close video capture";
+        }
+    }
+    Py_END_CRITICAL_SECTION();
+    if (failure != NULL)
+    {
+        raise_avi_error(self->state, returnCode, failure);
+        return NULL;
     }
 
     Py_RETURN_NONE;
@@ -135,10 +178,12 @@ PyObject * video_new
     Video * self;
 
     self = (Video * )type->tp_alloc(type, 0);
-    if (self != NULL)
+    if (self == NULL)
     {
-        self->videoID = 0;
+        return NULL;
     }
+    self->state = (ModuleState *)PyType_GetModuleState(type);
+    self->videoID = 0;
     self->handle = -1;
     self->frame_rate = DEFAULT_FRAME_RATE;
     self->is_capture = 0;
@@ -150,8 +195,11 @@ PyObject * video_new
   */ 
 void video_dealloc(Video * self)
 {
+    PyTypeObject * type = Py_TYPE(self);
+
     isavi_ExitAVI(self->videoID);
-    Py_TYPE(self)->tp_free((PyObject *)self);
+    type->tp_free((PyObject *)self);
+    Py_DECREF(type);
 }
 
 PyObject * video_get_frame_rate(Video * self, void * closure)
@@ -162,16 +210,27 @@ PyObject * video_get_frame_rate(Video * self, void * closure)
 int video_set_frame_rate(Video * self, PyObject * value, void * closure)
 {
     double val;
-    if (self->is_capture)
+    int result = 0;
+
+    val = PyFloat_AsDouble(value);
+    if (val == -1.0 && PyErr_Occurred())
     {
-        PyErr_SetString(PyExc_IOError, "Can't set frame rate during capture");
         return -1;
     }
 
-    val = PyFloat_AsDouble(value);
-    self->frame_rate = val;
+    Py_BEGIN_CRITICAL_SECTION(self);
+    if (self->is_capture)
+    {
+        PyErr_SetString(PyExc_IOError, "Can't set frame rate during capture");
+        result = -1;
+    }
+    else
+    {
+        self->frame_rate = val;
+    }
+    Py_END_CRITICAL_SECTION();
 
-    return 0;
+    return result;
 }
 
 PyObject * video_get_filename(Video * self, void * clousre)
@@ -185,13 +244,17 @@ int video_set_filename(Video * self, PyObject * value, void * closure)
     if (check_is_string(value))
     {
         filename = get_as_string(value);
+        Py_BEGIN_CRITICAL_SECTION(self);
         strcpy(self->filename, filename);
+        Py_END_CRITICAL_SECTION();
     }
     else
     {
         PyErr_SetString(PyExc_TypeError, "Invalid type for filename");
         return -1;
     }
+
+    return 0;
 }
 
 /**
@@ -216,43 +279,20 @@ PyGetSetDef video_properties[] = {
     {NULL} /* Sentinel */
 };
 
-PyTypeObject ids_VideoType = {
-    PyVarObject_HEAD_INIT(NULL, 0)
-    "ids.Video",               /* tp_name */
-    sizeof(Video),             /* tp_basicsize */
-    0,                         /* tp_itemsize */
-    (destructor)video_dealloc, /* tp_dealloc */
-    0,                         /* tp_print */
-    0,                         /* tp_getattr */
-    0,                         /* tp_setattr */
-    0,                         /* tp_compare */
-    0,                         /* tp_repr */
-    0,                         /* tp_as_number */
-    0,                         /* tp_as_sequence */
-    0,                         /* tp_as_mapping */
-    0,                         /* tp_hash */
-    0,                         /* tp_call */
-    0,                         /* tp_str */
-    0,                         /* tp_getattro */
-    0,                         /* tp_setattro */
-    0,                         /* tp_as_buffer */
-    Py_TPFLAGS_DEFAULT,        /* tp_flags */
-    "Wrapper object around IDS Camera Video", /* tp_doc */
-    0,                         /* tp_traverse */
-    0,                         /* tp_clear */
-    0,                         /* tp_richcompare */
-    0,                         /* tp_weaklistoffset */
-    0,                         /* tp_iter */
-    0,                         /* tp_iternext */
-    video_methods,             /* tp_methods */
-    0,                         /* tp_members */
-    video_properties,          /* tp_getset */
-    0,                         /* tp_base */
-    0,                         /* tp_dict */
-    0,                         /* tp_descr_get */
-    0,                         /* tp_descr_set */
-    0,                         /* tp_dictoffset */
-    (initproc)video_init,      /* tp_init */
-    0,                         /* tp_alloc */
-    video_new,                 /* tp_new */
+static PyType_Slot video_slots[] = {
+    {Py_tp_dealloc, (void *)video_dealloc},
+    {Py_tp_doc, (void *)"Wrapper object around IDS Camera Video"},
+    {Py_tp_methods, video_methods},
+    {Py_tp_getset, video_properties},
+    {Py_tp_init, (void *)video_init},
+    {Py_tp_new, (void *)video_new},
+    {0, NULL} /* Sentinel */
+};
+
+PyType_Spec ids_VideoSpec = {
+    "ids.Video",               /* name */
+    sizeof(Video),             /* basicsize */
+    0,                         /* itemsize */
+    IDS_TPFLAGS,               /* flags */
+    video_slots,               /* slots */
 };
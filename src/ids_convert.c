@@ -0,0 +1,920 @@
+#include <uEye.h>
+#include "ids.h"
+#include <stdlib.h>
+#include <string.h>
+#define PY_ARRAY_UNIQUE_SYMBOL ids_ARRAY_API
+#define NO_IMPORT_ARRAY
+#include <numpy/arrayobject.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#define DEFAULT_BENCHMARK_WIDTH     1920
+#define DEFAULT_BENCHMARK_HEIGHT    1080
+#define DEFAULT_BENCHMARK_REPEAT    10
+
+/*
+ * BT.601 luma weights. The 8 bit output uses them in Q7, which is what a
+ * signed byte multiply can hold, the 16 bit output in Q15 for a signed word
+ * multiply. Both sets sum to exactly 1.
+ */
+#define LUMA8_RED                   38
+#define LUMA8_GREEN                 75
+#define LUMA8_BLUE                  15
+#define LUMA16_RED                  9798
+#define LUMA16_GREEN                19235
+#define LUMA16_BLUE                 3735
+
+/*
+ * BT.601 limited range YCbCr to RGB in the fixed point a 16 bit high
+ * multiply gives: 1.164 and 1.596 (Q14 on 4x the input), 0.391 and 0.813
+ * (Q14), 2.018 (Q13 on 8x the input)
+ */
+#define YUV_Y                       19071
+#define YUV_RED_V                   26149
+#define YUV_GREEN_U                 6406
+#define YUV_GREEN_V                 13320
+#define YUV_BLUE_U                  16532
+#define MULHI(a, b)                 (((a) * (b)) >> 16)
+
+/*
+ * Pixel layouts the converters read
+ */
+enum ConvertInput
+{
+    INPUT_MONO8,
+    INPUT_MONO16,
+    INPUT_COLOR,
+    INPUT_UYVY,
+    INPUT_KINDS
+};
+
+/*
+ * Layout of a source pixel
+ */
+typedef struct
+{
+    int                kind;
+    /* Bytes per pixel */
+    int                bytes;
+    /* Significant bits of a 16 bit mono sample */
+    int                bits;
+    /* Byte offsets of red and blue in a colour pixel */
+    int                red;
+    int                blue;
+} ConvertLayout;
+
+typedef void (*convert_row_func)(const uint8_t * src, uint8_t * dst, int width, const ConvertLayout * layout);
+
+static const char * format_names[OUTPUT_FORMATS] = {"raw", "rgb8", "gray8", "gray16"};
+
+static uint8_t clamp_u8(int value)
+{
+    return (uint8_t)(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+/**
+  * Scalar kernels. They are the reference the vector kernels match bit for
+  * bit and finish the pixels at the end of a row that do not fill a vector.
+  */
+static void row_copy(const uint8_t * src, uint8_t * dst, int width, const ConvertLayout * layout)
+{
+    memcpy(dst, src, (size_t)width * layout->bytes);
+}
+
+static void row_mono8_rgb_scalar(const uint8_t * src, uint8_t * dst, int width, const ConvertLayout * layout)
+{
+    int x;
+
+    for (x = 0; x < width; x++)
+    {
+        dst[3*x] = dst[3*x + 1] = dst[3*x + 2] = src[x];
+    }
+}
+
+static void row_mono8_gray16_scalar(const uint8_t * src, uint8_t * dst, int width, const ConvertLayout * layout)
+{
+    uint16_t * out = (uint16_t *)dst;
+    int x;
+
+    for (x = 0; x < width; x++)
+    {
+        out[x] = (uint16_t)(src[x] * 257);
+    }
+}
+
+static void row_mono16_rgb_scalar(const uint8_t * src, uint8_t * dst, int width, const ConvertLayout * layout)
+{
+    const uint16_t * in = (const uint16_t *)src;
+    int shift = layout->bits - 8;
+    int x;
+
+    for (x = 0; x < width; x++)
+    {
+        dst[3*x] = dst[3*x + 1] = dst[3*x + 2] = clamp_u8(in[x] >> shift);
+    }
+}
+
+static void row_mono16_gray8_scalar(const uint8_t * src, uint8_t * dst, int width, const ConvertLayout * layout)
+{
+    const uint16_t * in = (const uint16_t *)src;
+    int shift = layout->bits - 8;
+    int x;
+
+    for (x = 0; x < width; x++)
+    {
+        dst[x] = clamp_u8(in[x] >> shift);
+    }
+}
+
+static void row_mono16_gray16_scalar(const uint8_t * src, uint8_t * dst, int width, const ConvertLayout * layout)
+{
+    const uint16_t * in = (const uint16_t *)src;
+    uint16_t * out = (uint16_t *)dst;
+    int shift = 16 - layout->bits;
+    int x;
+
+    for (x = 0; x < width; x++)
+    {
+        out[x] = (uint16_t)(in[x] << shift);
+    }
+}
+
+static void row_color_rgb_scalar(const uint8_t * src, uint8_t * dst, int width, const ConvertLayout * layout)
+{
+    int x;
+
+    for (x = 0; x < width; x++, src += layout->bytes, dst += 3)
+    {
+        dst[0] = src[layout->red];
+        dst[1] = src[1];
+        dst[2] = src[layout->blue];
+    }
+}
+
+static void row_color_gray8_scalar(const uint8_t * src, uint8_t * dst, int width, const ConvertLayout * layout)
+{
+    int x;
+
+    for (x = 0; x < width; x++, src += layout->bytes)
+    {
+        dst[x] = (uint8_t)((LUMA8_RED*src[layout->red] + LUMA8_GREEN*src[1] + LUMA8_BLUE*src[layout->blue] + 64) >> 7);
+    }
+}
+
+static void row_color_gray16_scalar(const uint8_t * src, uint8_t * dst, int width, const ConvertLayout * layout)
+{
+    uint16_t * out = (uint16_t *)dst;
+    uint32_t sum;
+    int x;
+
+    for (x = 0; x < width; x++, src += layout->bytes)
+    {
+        /* Scaled by 257/256 so that white maps to 65535 */
+        sum = 2 * (LUMA16_RED*src[layout->red] + LUMA16_GREEN*src[1] + LUMA16_BLUE*src[layout->blue]);
+        out[x] = (uint16_t)((sum + (sum >> 8) + 128) >> 8);
+    }
+}
+
+/**
+  * Converts one UYVY pixel given its luma and its pair's chroma
+  */
+static void yuv_to_rgb(int y, int u, int v, uint8_t * dst)
+{
+    int luma = MULHI((y - 16) * 4, YUV_Y);
+
+    dst[0] = clamp_u8(luma + MULHI((v - 128) * 4, YUV_RED_V));
+    dst[1] = clamp_u8(luma - MULHI((u - 128) * 4, YUV_GREEN_U) - MULHI((v - 128) * 4, YUV_GREEN_V));
+    dst[2] = clamp_u8(luma + MULHI((u - 128) * 8, YUV_BLUE_U));
+}
+
+static void row_uyvy_rgb_scalar(const uint8_t * src, uint8_t * dst, int width, const ConvertLayout * layout)
+{
+    int x;
+
+    for (x = 0; x + 1 < width; x += 2, src += 4, dst += 6)
+    {
+        yuv_to_rgb(src[1], src[0], src[2], dst);
+        yuv_to_rgb(src[3], src[0], src[2], dst + 3);
+    }
+    if (x < width)
+    {
+        /* An odd last pixel has no red chroma of its own */
+        yuv_to_rgb(src[1], src[0], 128, dst);
+    }
+}
+
+static void row_uyvy_gray8_scalar(const uint8_t * src, uint8_t * dst, int width, const ConvertLayout * layout)
+{
+    int x;
+
+    for (x = 0; x < width; x++)
+    {
+        dst[x] = src[2*x + 1];
+    }
+}
+
+static void row_uyvy_gray16_scalar(const uint8_t * src, uint8_t * dst, int width, const ConvertLayout * layout)
+{
+    uint16_t * out = (uint16_t *)dst;
+    int x;
+
+    for (x = 0; x < width; x++)
+    {
+        out[x] = (uint16_t)(src[2*x + 1] * 257);
+    }
+}
+
+/**
+  * Vector kernels, 16 bytes at a time. The shuffles that regroup 3 byte
+  * pixels do not cross the 128 bit lanes of AVX2, so AVX2 builds run the
+  * same SSSE3 code.
+  */
+static void row_mono8_rgb(const uint8_t * src, uint8_t * dst, int width, const ConvertLayout * layout)
+{
+    int x = 0;
+
+#if defined(__SSSE3__)
+    __m128i first = _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+    __m128i second = _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+    __m128i third = _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+    __m128i gray;
+
+    for (; x + 16 <= width; x += 16)
+    {
+        gray = _mm_loadu_si128((const __m128i *)(src + x));
+        _mm_storeu_si128((__m128i *)(dst + 3*x), _mm_shuffle_epi8(gray, first));
+        _mm_storeu_si128((__m128i *)(dst + 3*x + 16), _mm_shuffle_epi8(gray, second));
+        _mm_storeu_si128((__m128i *)(dst + 3*x + 32), _mm_shuffle_epi8(gray, third));
+    }
+#endif
+    row_mono8_rgb_scalar(src + x, dst + 3*x, width - x, layout);
+}
+
+static void row_mono8_gray16(const uint8_t * src, uint8_t * dst, int width, const ConvertLayout * layout)
+{
+    int x = 0;
+
+#if defined(__SSE2__)
+    __m128i gray;
+
+    /* Interleaving a byte with itself multiplies it by 257 */
+    for (; x + 16 <= width; x += 16)
+    {
+        gray = _mm_loadu_si128((const __m128i *)(src + x));
+        _mm_storeu_si128((__m128i *)(dst + 2*x), _mm_unpacklo_epi8(gray, gray));
+        _mm_storeu_si128((__m128i *)(dst + 2*x + 16), _mm_unpackhi_epi8(gray, gray));
+    }
+#endif
+    row_mono8_gray16_scalar(src + x, dst + 2*x, width - x, layout);
+}
+
+static void row_mono16_rgb(const uint8_t * src, uint8_t * dst, int width, const ConvertLayout * layout)
+{
+    int x = 0;
+
+#if defined(__SSSE3__)
+    __m128i shift = _mm_cvtsi32_si128(layout->bits - 8);
+    __m128i first = _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+    __m128i second = _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+    __m128i third = _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+    __m128i gray;
+
+    for (; x + 16 <= width; x += 16)
+    {
+        gray = _mm_packus_epi16(_mm_srl_epi16(_mm_loadu_si128((const __m128i *)(src + 2*x)), shift),
+                _mm_srl_epi16(_mm_loadu_si128((const __m128i *)(src + 2*x + 16)), shift));
+        _mm_storeu_si128((__m128i *)(dst + 3*x), _mm_shuffle_epi8(gray, first));
+        _mm_storeu_si128((__m128i *)(dst + 3*x + 16), _mm_shuffle_epi8(gray, second));
+        _mm_storeu_si128((__m128i *)(dst + 3*x + 32), _mm_shuffle_epi8(gray, third));
+    }
+#endif
+    row_mono16_rgb_scalar(src + 2*x, dst + 3*x, width - x, layout);
+}
+
+static void row_mono16_gray8(const uint8_t * src, uint8_t * dst, int width, const ConvertLayout * layout)
+{
+    int x = 0;
+
+#if defined(__SSE2__)
+    __m128i shift = _mm_cvtsi32_si128(layout->bits - 8);
+    __m128i low;
+    __m128i high;
+
+    for (; x + 16 <= width; x += 16)
+    {
+        low = _mm_srl_epi16(_mm_loadu_si128((const __m128i *)(src + 2*x)), shift);
+        high = _mm_srl_epi16(_mm_loadu_si128((const __m128i *)(src + 2*x + 16)), shift);
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_packus_epi16(low, high));
+    }
+#endif
+    row_mono16_gray8_scalar(src + 2*x, dst + x, width - x, layout);
+}
+
+static void row_mono16_gray16(const uint8_t * src, uint8_t * dst, int width, const ConvertLayout * layout)
+{
+    int x = 0;
+
+#if defined(__SSE2__)
+    __m128i shift = _mm_cvtsi32_si128(16 - layout->bits);
+
+    for (; x + 8 <= width; x += 8)
+    {
+        _mm_storeu_si128((__m128i *)(dst + 2*x), _mm_sll_epi16(_mm_loadu_si128((const __m128i *)(src + 2*x)), shift));
+    }
+#endif
+    row_mono16_gray16_scalar(src + 2*x, dst + 2*x, width - x, layout);
+}
+
+static void row_color_rgb(const uint8_t * src, uint8_t * dst, int width, const ConvertLayout * layout)
+{
+    int x = 0;
+
+#if defined(__SSSE3__)
+    uint8_t order[16];
+    __m128i mask;
+    int i;
+
+    if (layout->bytes == 3 && layout->red == 0)
+    {
+        memcpy(dst, src, (size_t)width * 3);
+        return;
+    }
+    if (layout->bytes == 3)
+    {
+        /* Five pixels per vector, the 16th byte is rewritten by the next */
+        for (i = 0; i < 5; i++)
+        {
+            order[3*i] = (uint8_t)(3*i + layout->red);
+            order[3*i + 1] = (uint8_t)(3*i + 1);
+            order[3*i + 2] = (uint8_t)(3*i + layout->blue);
+        }
+        order[15] = 15;
+        mask = _mm_loadu_si128((const __m128i *)order);
+        for (; x + 6 <= width; x += 5)
+        {
+            _mm_storeu_si128((__m128i *)(dst + 3*x), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 3*x)), mask));
+        }
+    }
+    else
+    {
+        /* Four pixels per vector, the last 4 bytes are rewritten by the next */
+        for (i = 0; i < 4; i++)
+        {
+            order[3*i] = (uint8_t)(4*i + layout->red);
+            order[3*i + 1] = (uint8_t)(4*i + 1);
+            order[3*i + 2] = (uint8_t)(4*i + layout->blue);
+        }
+        memset(order + 12, 0x80, 4);
+        mask = _mm_loadu_si128((const __m128i *)order);
+        for (; x + 6 <= width; x += 4)
+        {
+            _mm_storeu_si128((__m128i *)(dst + 3*x), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 4*x)), mask));
+        }
+    }
+#else
+    if (layout->bytes == 3 && layout->red == 0)
+    {
+        memcpy(dst, src, (size_t)width * 3);
+        return;
+    }
+#endif
+    row_color_rgb_scalar(src + layout->bytes*x, dst + 3*x, width - x, layout);
+}
+
+static void row_color_gray8(const uint8_t * src, uint8_t * dst, int width, const ConvertLayout * layout)
+{
+    int x = 0;
+
+#if defined(__SSSE3__)
+    int8_t weights[16];
+    __m128i weight;
+    __m128i widen = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    __m128i round = _mm_set1_epi16(64);
+    __m128i first;
+    __m128i second;
+    __m128i luma;
+    int i;
+
+    for (i = 0; i < 4; i++)
+    {
+        weights[4*i + layout->red] = LUMA8_RED;
+        weights[4*i + 1] = LUMA8_GREEN;
+        weights[4*i + layout->blue] = LUMA8_BLUE;
+        weights[4*i + 3] = 0;
+    }
+    weight = _mm_loadu_si128((const __m128i *)weights);
+    if (layout->bytes == 3)
+    {
+        /* The second load reads 4 bytes past the 8 pixels */
+        for (; x + 10 <= width; x += 8)
+        {
+            first = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 3*x)), widen);
+            second = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 3*x + 12)), widen);
+            luma = _mm_hadd_epi16(_mm_maddubs_epi16(first, weight), _mm_maddubs_epi16(second, weight));
+            luma = _mm_srli_epi16(_mm_add_epi16(luma, round), 7);
+            _mm_storel_epi64((__m128i *)(dst + x), _mm_packus_epi16(luma, luma));
+        }
+    }
+    else
+    {
+        for (; x + 8 <= width; x += 8)
+        {
+            first = _mm_loadu_si128((const __m128i *)(src + 4*x));
+            second = _mm_loadu_si128((const __m128i *)(src + 4*x + 16));
+            luma = _mm_hadd_epi16(_mm_maddubs_epi16(first, weight), _mm_maddubs_epi16(second, weight));
+            luma = _mm_srli_epi16(_mm_add_epi16(luma, round), 7);
+            _mm_storel_epi64((__m128i *)(dst + x), _mm_packus_epi16(luma, luma));
+        }
+    }
+#endif
+    row_color_gray8_scalar(src + layout->bytes*x, dst + x, width - x, layout);
+}
+
+#if defined(__SSSE3__)
+/**
+  * Q15 luma of four pixels already spread to 4 bytes each, scaled to 16 bits
+  * and offset by -32768 so that a signed pack keeps the full range
+  */
+static __m128i luma16_quad(__m128i pixels, __m128i weight)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i sum;
+
+    sum = _mm_hadd_epi32(_mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), weight),
+            _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), weight));
+    sum = _mm_slli_epi32(sum, 1);
+    sum = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(sum, _mm_srli_epi32(sum, 8)), _mm_set1_epi32(128)), 8);
+    return _mm_sub_epi32(sum, _mm_set1_epi32(32768));
+}
+#endif
+
+static void row_color_gray16(const uint8_t * src, uint8_t * dst, int width, const ConvertLayout * layout)
+{
+    int x = 0;
+
+#if defined(__SSSE3__)
+    int16_t weights[8];
+    __m128i weight;
+    __m128i widen = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    __m128i sign = _mm_set1_epi16((short)0x8000);
+    __m128i first;
+    __m128i second;
+    int i;
+
+    for (i = 0; i < 2; i++)
+    {
+        weights[4*i + layout->red] = LUMA16_RED;
+        weights[4*i + 1] = LUMA16_GREEN;
+        weights[4*i + layout->blue] = LUMA16_BLUE;
+        weights[4*i + 3] = 0;
+    }
+    weight = _mm_loadu_si128((const __m128i *)weights);
+    if (layout->bytes == 3)
+    {
+        /* The second load reads 4 bytes past the 8 pixels */
+        for (; x + 10 <= width; x += 8)
+        {
+            first = luma16_quad(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 3*x)), widen), weight);
+            second = luma16_quad(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 3*x + 12)), widen), weight);
+            _mm_storeu_si128((__m128i *)(dst + 2*x), _mm_xor_si128(_mm_packs_epi32(first, second), sign));
+        }
+    }
+    else
+    {
+        for (; x + 8 <= width; x += 8)
+        {
+            first = luma16_quad(_mm_loadu_si128((const __m128i *)(src + 4*x)), weight);
+            second = luma16_quad(_mm_loadu_si128((const __m128i *)(src + 4*x + 16)), weight);
+            _mm_storeu_si128((__m128i *)(dst + 2*x), _mm_xor_si128(_mm_packs_epi32(first, second), sign));
+        }
+    }
+#endif
+    row_color_gray16_scalar(src + layout->bytes*x, dst + 2*x, width - x, layout);
+}
+
+static void row_uyvy_rgb(const uint8_t * src, uint8_t * dst, int width, const ConvertLayout * layout)
+{
+    int x = 0;
+
+#if defined(__SSSE3__)
+    __m128i low_word = _mm_set1_epi32(0x0000FFFF);
+    __m128i byte_mask = _mm_set1_epi16(0x00FF);
+    __m128i luma_offset = _mm_set1_epi16(16);
+    __m128i chroma_offset = _mm_set1_epi16(128);
+    __m128i rg_first = _mm_setr_epi8(0, 8, -1, 1, 9, -1, 2, 10, -1, 3, 11, -1, 4, 12, -1, 5);
+    __m128i b_first = _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1);
+    __m128i rg_second = _mm_setr_epi8(13, -1, 6, 14, -1, 7, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    __m128i b_second = _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+    __m128i pixels;
+    __m128i chroma;
+    __m128i luma;
+    __m128i u;
+    __m128i v;
+    __m128i red;
+    __m128i green;
+    __m128i blue;
+    __m128i rg;
+
+    for (; x + 8 <= width; x += 8)
+    {
+        pixels = _mm_loadu_si128((const __m128i *)(src + 2*x));
+        luma = _mm_srli_epi16(pixels, 8);
+        chroma = _mm_and_si128(pixels, byte_mask);
+        /* Spread each pair's chroma over both of its pixels */
+        u = _mm_sub_epi16(_mm_or_si128(_mm_and_si128(chroma, low_word), _mm_slli_epi32(chroma, 16)), chroma_offset);
+        v = _mm_sub_epi16(_mm_or_si128(_mm_srli_epi32(chroma, 16), _mm_andnot_si128(low_word, chroma)), chroma_offset);
+
+        luma = _mm_mulhi_epi16(_mm_slli_epi16(_mm_sub_epi16(luma, luma_offset), 2), _mm_set1_epi16(YUV_Y));
+        red = _mm_add_epi16(luma, _mm_mulhi_epi16(_mm_slli_epi16(v, 2), _mm_set1_epi16(YUV_RED_V)));
+        green = _mm_sub_epi16(luma, _mm_mulhi_epi16(_mm_slli_epi16(u, 2), _mm_set1_epi16(YUV_GREEN_U)));
+        green = _mm_sub_epi16(green, _mm_mulhi_epi16(_mm_slli_epi16(v, 2), _mm_set1_epi16(YUV_GREEN_V)));
+        blue = _mm_add_epi16(luma, _mm_mulhi_epi16(_mm_slli_epi16(u, 3), _mm_set1_epi16(YUV_BLUE_U)));
+
+        rg = _mm_packus_epi16(red, green);
+        blue = _mm_packus_epi16(blue, blue);
+        _mm_storeu_si128((__m128i *)(dst + 3*x), _mm_or_si128(_mm_shuffle_epi8(rg, rg_first), _mm_shuffle_epi8(blue, b_first)));
+        _mm_storel_epi64((__m128i *)(dst + 3*x + 16), _mm_or_si128(_mm_shuffle_epi8(rg, rg_second), _mm_shuffle_epi8(blue, b_second)));
+    }
+#endif
+    row_uyvy_rgb_scalar(src + 2*x, dst + 3*x, width - x, layout);
+}
+
+static void row_uyvy_gray8(const uint8_t * src, uint8_t * dst, int width, const ConvertLayout * layout)
+{
+    int x = 0;
+
+#if defined(__SSE2__)
+    __m128i low;
+    __m128i high;
+
+    for (; x + 16 <= width; x += 16)
+    {
+        low = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(src + 2*x)), 8);
+        high = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(src + 2*x + 16)), 8);
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_packus_epi16(low, high));
+    }
+#endif
+    row_uyvy_gray8_scalar(src + 2*x, dst + x, width - x, layout);
+}
+
+static void row_uyvy_gray16(const uint8_t * src, uint8_t * dst, int width, const ConvertLayout * layout)
+{
+    int x = 0;
+
+#if defined(__SSE2__)
+    __m128i luma;
+
+    for (; x + 8 <= width; x += 8)
+    {
+        luma = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(src + 2*x)), 8);
+        _mm_storeu_si128((__m128i *)(dst + 2*x), _mm_or_si128(luma, _mm_slli_epi16(luma, 8)));
+    }
+#endif
+    row_uyvy_gray16_scalar(src + 2*x, dst + 2*x, width - x, layout);
+}
+
+/* Converters by input layout and output format, NULL where there is none */
+static const convert_row_func convert_rows[INPUT_KINDS][OUTPUT_FORMATS] = {
+    {NULL, row_mono8_rgb, row_copy, row_mono8_gray16},
+    {NULL, row_mono16_rgb, row_mono16_gray8, row_mono16_gray16},
+    {NULL, row_color_rgb, row_color_gray8, row_color_gray16},
+    {NULL, row_uyvy_rgb, row_uyvy_gray8, row_uyvy_gray16},
+};
+
+static const convert_row_func convert_rows_scalar[INPUT_KINDS][OUTPUT_FORMATS] = {
+    {NULL, row_mono8_rgb_scalar, row_copy, row_mono8_gray16_scalar},
+    {NULL, row_mono16_rgb_scalar, row_mono16_gray8_scalar, row_mono16_gray16_scalar},
+    {NULL, row_color_rgb_scalar, row_color_gray8_scalar, row_color_gray16_scalar},
+    {NULL, row_uyvy_rgb_scalar, row_uyvy_gray8_scalar, row_uyvy_gray16_scalar},
+};
+
+/**
+  * Classifies a colour mode
+  * @return 0, -1 for a layout that cannot be converted, such as Bayer data
+  */
+static int convert_layout(int color, ConvertLayout * layout)
+{
+    memset(layout, 0, sizeof(*layout));
+    layout->bits = 8;
+    switch (color)
+    {
+        case IS_CM_MONO8:
+            layout->kind = INPUT_MONO8;
+            layout->bytes = 1;
+            return 0;
+        case IS_CM_MONO10:
+        case IS_CM_MONO12:
+        case IS_CM_MONO16:
+            layout->kind = INPUT_MONO16;
+            layout->bytes = 2;
+            layout->bits = color == IS_CM_MONO10 ? 10 : (color == IS_CM_MONO12 ? 12 : 16);
+            return 0;
+        case IS_CM_RGB8_PACKED:
+        case IS_CM_RGBA8_PACKED:
+            layout->kind = INPUT_COLOR;
+            layout->bytes = color == IS_CM_RGB8_PACKED ? 3 : 4;
+            layout->red = 0;
+            layout->blue = 2;
+            return 0;
+        case IS_CM_BGR8_PACKED:
+        case IS_CM_BGRA8_PACKED:
+            layout->kind = INPUT_COLOR;
+            layout->bytes = color == IS_CM_BGR8_PACKED ? 3 : 4;
+            layout->red = 2;
+            layout->blue = 0;
+            return 0;
+        case IS_CM_UYVY_PACKED:
+        case IS_CM_CBYCRY_PACKED:
+            layout->kind = INPUT_UYVY;
+            layout->bytes = 2;
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+/**
+  * Allocates the array a frame of the given size converts into
+  * @return New reference, NULL with a Python exception set
+  */
+static PyObject * convert_new_array(int format, int width, int height)
+{
+    npy_intp dimensions[3];
+
+    dimensions[0] = height;
+    dimensions[1] = width;
+    dimensions[2] = 3;
+    switch (format)
+    {
+        case OUTPUT_RGB8:
+            return PyArray_SimpleNew(3, dimensions, NPY_UINT8);
+        case OUTPUT_GRAY8:
+            return PyArray_SimpleNew(2, dimensions, NPY_UINT8);
+        default:
+            return PyArray_SimpleNew(2, dimensions, NPY_UINT16);
+    }
+}
+
+/**
+  * Looks up an output format by name
+  * @return The OutputFormat, -1 with a Python exception set
+  */
+int convert_format_parse(const char * name)
+{
+    int format;
+
+    for (format = 0; format < OUTPUT_FORMATS; format++)
+    {
+        if (strcmp(name, format_names[format]) == 0)
+        {
+            return format;
+        }
+    }
+    PyErr_Format(PyExc_ValueError, "Unknown output format '%s', expected 'raw', 'rgb8', 'gray8' or 'gray16'", name);
+    return -1;
+}
+
+const char * convert_format_name(int format)
+{
+    return format >= 0 && format < OUTPUT_FORMATS ? format_names[format] : "unknown";
+}
+
+/**
+  * Converts a delivered frame into a new array in one pass over the
+  * sequence buffer, with the GIL released
+  * @note The slot stays retained, the caller releases it
+  * @return New reference, NULL with a Python exception set
+  */
+PyObject * convert_slot(Camera * camera, FrameSlot * slot, int format)
+{
+    FrameRing * ring = slot->ring;
+    ConvertLayout layout;
+    convert_row_func row = NULL;
+    PyObject * image;
+    const uint8_t * src;
+    uint8_t * dst;
+    npy_intp pitch;
+    int width;
+    int height;
+    int y;
+
+    if (convert_layout(ring->color, &layout) == 0 && format > OUTPUT_RAW && format < OUTPUT_FORMATS)
+    {
+        row = convert_rows[layout.kind][format];
+    }
+    if (row == NULL)
+    {
+        PyErr_Format(PyExc_ValueError, "Color mode %d cannot be converted to %s", ring->color, convert_format_name(format));
+        return NULL;
+    }
+
+    height = slot->info.dwImageHeight ? (int)slot->info.dwImageHeight : (int)ring->height;
+    width = slot->info.dwImageWidth ? (int)slot->info.dwImageWidth : (int)ring->width;
+    image = convert_new_array(format, width, height);
+    if (image == NULL)
+    {
+        return NULL;
+    }
+
+    src = (const uint8_t *)slot->pBuffer;
+    dst = (uint8_t *)PyArray_DATA((PyArrayObject *)image);
+    pitch = PyArray_STRIDE((PyArrayObject *)image, 0);
+    Py_BEGIN_ALLOW_THREADS
+    for (y = 0; y < height; y++)
+    {
+        row(src + (size_t)y * ring->pitch, dst + y * pitch, width, &layout);
+    }
+    Py_END_ALLOW_THREADS
+    return image;
+}
+
+/*
+ * One colour mode measured by convert_benchmark
+ */
+typedef struct
+{
+    const char *       name;
+    int                color;
+} BenchmarkSource;
+
+static const BenchmarkSource benchmark_sources[] = {
+    {"mono8", IS_CM_MONO8},
+    {"mono12", IS_CM_MONO12},
+    {"rgb8", IS_CM_RGB8_PACKED},
+    {"bgr8", IS_CM_BGR8_PACKED},
+    {"rgba8", IS_CM_RGBA8_PACKED},
+    {"bgra8", IS_CM_BGRA8_PACKED},
+    {"uyvy", IS_CM_UYVY_PACKED},
+};
+
+#define BENCHMARK_PAIRS (sizeof(benchmark_sources) / sizeof(benchmark_sources[0]) * (OUTPUT_FORMATS - 1))
+
+/*
+ * Result of one source and output pair of convert_benchmark
+ */
+typedef struct
+{
+    int64_t            best_ns;
+    int64_t            scalar_ns;
+    int                exact;
+} BenchmarkResult;
+
+/**
+  * Times a row converter over a whole frame
+  * @return The best of repeat runs in nanoseconds
+  */
+static int64_t benchmark_time(convert_row_func row, const uint8_t * src, uint8_t * dst, int width, int height, size_t src_pitch, size_t dst_pitch, const ConvertLayout * layout, int repeat)
+{
+    int64_t best = 0;
+    int64_t start;
+    int64_t elapsed;
+    int i;
+    int y;
+
+    for (i = 0; i < repeat; i++)
+    {
+        start = ids_monotonic_ns();
+        for (y = 0; y < height; y++)
+        {
+            row(src + y * src_pitch, dst + y * dst_pitch, width, layout);
+        }
+        elapsed = ids_monotonic_ns() - start;
+        if (i == 0 || elapsed < best)
+        {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+/**
+  * Measures every converter and its scalar reference on random frames and
+  * checks that both produce the same output
+  * @return 0, -1 when out of memory
+  */
+static int benchmark_run(BenchmarkResult * results, int width, int height, int repeat)
+{
+    size_t src_pitch = (size_t)width * 4;
+    size_t dst_pitch = (size_t)width * 3;
+    uint8_t * src = (uint8_t *)malloc(src_pitch * height);
+    uint8_t * dst = (uint8_t *)malloc(dst_pitch * height);
+    uint8_t * reference = (uint8_t *)malloc(dst_pitch * height);
+    uint32_t seed = 12345;
+    ConvertLayout layout;
+    BenchmarkResult * result;
+    size_t i;
+    size_t s;
+    int format;
+    int y;
+
+    if (src == NULL || dst == NULL || reference == NULL)
+    {
+        free(src);
+        free(dst);
+        free(reference);
+        return -1;
+    }
+    for (i = 0; i < src_pitch * height; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        src[i] = (uint8_t)(seed >> 16);
+    }
+
+    for (s = 0; s < sizeof(benchmark_sources) / sizeof(benchmark_sources[0]); s++)
+    {
+        convert_layout(benchmark_sources[s].color, &layout);
+        for (format = OUTPUT_RGB8; format < OUTPUT_FORMATS; format++)
+        {
+            result = &results[s * (OUTPUT_FORMATS - 1) + format - 1];
+            result->best_ns = benchmark_time(convert_rows[layout.kind][format], src, dst, width, height, src_pitch, dst_pitch, &layout, repeat);
+            result->scalar_ns = benchmark_time(convert_rows_scalar[layout.kind][format], src, reference, width, height, src_pitch, dst_pitch, &layout, repeat);
+            result->exact = 1;
+            for (y = 0; y < height; y++)
+            {
+                /* Rows are compared over the bytes the output format fills */
+                if (memcmp(dst + y * dst_pitch, reference + y * dst_pitch, (size_t)width * (format == OUTPUT_GRAY8 ? 1 : (format == OUTPUT_GRAY16 ? 2 : 3))) != 0)
+                {
+                    result->exact = 0;
+                    break;
+                }
+            }
+        }
+    }
+
+    free(src);
+    free(dst);
+    free(reference);
+    return 0;
+}
+
+/**
+  * Measures the output format converters on random frames: every source
+  * layout the camera can deliver against every output format, each next to
+  * its scalar reference
+  * This means the definition of the function is:
+  *     def convert_benchmark(width=1920, height=1080, repeat=10)
+  * @return A list of dicts with source, output, ms, scalar_ms, fps,
+  *         megapixels_per_s, speedup and exact, True when the vector and
+  *         scalar kernels agree on every byte
+  */
+PyObject * ids_convert_benchmark(PyObject * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"width", "height", "repeat", NULL};
+    BenchmarkResult results[BENCHMARK_PAIRS];
+    BenchmarkResult * result;
+    PyObject * list;
+    PyObject * entry;
+    double pixels;
+    int width = DEFAULT_BENCHMARK_WIDTH;
+    int height = DEFAULT_BENCHMARK_HEIGHT;
+    int repeat = DEFAULT_BENCHMARK_REPEAT;
+    int status;
+    size_t i;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|iii", kwlist, &width, &height, &repeat))
+    {
+        return NULL;
+    }
+    if (width < 16 || height < 1 || repeat < 1)
+    {
+        PyErr_SetString(PyExc_ValueError, "width must be at least 16, height and repeat positive");
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    status = benchmark_run(results, width, height, repeat);
+    Py_END_ALLOW_THREADS
+    if (status < 0)
+    {
+        return PyErr_NoMemory();
+    }
+
+    list = PyList_New(BENCHMARK_PAIRS);
+    if (list == NULL)
+    {
+        return NULL;
+    }
+    pixels = (double)width * height;
+    for (i = 0; i < BENCHMARK_PAIRS; i++)
+    {
+        result = &results[i];
+        entry = Py_BuildValue("{s:s,s:s,s:d,s:d,s:d,s:d,s:d,s:O}",
+                "source", benchmark_sources[i / (OUTPUT_FORMATS - 1)].name,
+                "output", format_names[i % (OUTPUT_FORMATS - 1) + 1],
+                "ms", result->best_ns / 1e6,
+                "scalar_ms", result->scalar_ns / 1e6,
+                "fps", result->best_ns > 0 ? 1e9 / result->best_ns : 0.0,
+                "megapixels_per_s", result->best_ns > 0 ? pixels * 1e3 / result->best_ns : 0.0,
+                "speedup", result->best_ns > 0 ? (double)result->scalar_ns / result->best_ns : 0.0,
+                "exact", result->exact ? Py_True : Py_False);
+        if (entry == NULL)
+        {
+            Py_DECREF(list);
+            return NULL;
+        }
+        PyList_SET_ITEM(list, i, entry);
+    }
+    return list;
+}
@@ -0,0 +1,1032 @@
+#include <uEye.h>
+#include "ids.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#define PY_ARRAY_UNIQUE_SYMBOL ids_ARRAY_API
+#define NO_IMPORT_ARRAY
+#include <numpy/arrayobject.h>
+
+#define DEFAULT_MIN_POINTS          10
+
+#define DEFAULT_BENCHMARK_WIDTH     1600
+#define DEFAULT_BENCHMARK_HEIGHT    1200
+#define DEFAULT_BENCHMARK_REPEAT    5
+#define DEFAULT_BENCHMARK_DROPS     6
+/* Synthetic drops: a dark silhouette on a backlit background */
+#define BENCHMARK_BACKGROUND        220.0
+#define BENCHMARK_DROP              30.0
+#define BENCHMARK_THRESHOLD         20.0
+
+enum EdgeFit
+{
+    FIT_PARABOLA,
+    FIT_GAUSSIAN
+};
+
+/*
+ * Edge pixel that survived non-maximum suppression, with its subpixel
+ * position and the links of the contour it lies on
+ */
+typedef struct
+{
+    float              x;
+    float              y;
+    float              gx;
+    float              gy;
+    int32_t            pixel;
+    int32_t            next;
+    int32_t            prev;
+    int32_t            strong;
+} EdgePoint;
+
+/*
+ * Rectangle the edges are searched in, already clipped to the image
+ */
+typedef struct
+{
+    int                x;
+    int                y;
+    int                width;
+    int                height;
+} EdgeRoi;
+
+/*
+ * Working state of one detection
+ */
+typedef struct
+{
+    EdgeRoi            roi;
+    float *            gx;
+    float *            gy;
+    float *            magnitude;
+    /* Point of each ROI pixel, -1 where there is none */
+    int32_t *          map;
+    EdgePoint *        points;
+    int                count;
+    int                capacity;
+} EdgeDetector;
+
+/*
+ * Sobel gradient of the samples of one ROI row, divided by 8 so that it is
+ * in levels per pixel. Pixels whose 3x3 neighbourhood leaves the image get
+ * no gradient.
+ */
+#define SOBEL_ROW(type)                                                        \
+    for (x = x0; x < x1; x++)                                                  \
+    {                                                                          \
+        const type * up = (const type *)(data + (size_t)(y - 1) * pitch);      \
+        const type * mid = (const type *)(data + (size_t)y * pitch);           \
+        const type * down = (const type *)(data + (size_t)(y + 1) * pitch);    \
+        float sx = (float)((int)up[x + 1] - (int)up[x - 1]                     \
+                + 2 * ((int)mid[x + 1] - (int)mid[x - 1])                      \
+                + (int)down[x + 1] - (int)down[x - 1]);                        \
+        float sy = (float)((int)down[x - 1] - (int)up[x - 1]                   \
+                + 2 * ((int)down[x] - (int)up[x])                              \
+                + (int)down[x + 1] - (int)up[x + 1]);                          \
+        gx[x - roi->x] = sx * 0.125f;                                          \
+        gy[x - roi->x] = sy * 0.125f;                                          \
+        magnitude[x - roi->x] = sqrtf(sx * sx + sy * sy) * 0.125f;             \
+    }
+
+static void edge_gradient(EdgeDetector * detector, const char * data, int pitch, int wide, int width, int height)
+{
+    EdgeRoi * roi = &detector->roi;
+    float * gx;
+    float * gy;
+    float * magnitude;
+    int x0 = roi->x > 1 ? roi->x : 1;
+    int x1 = roi->x + roi->width < width - 1 ? roi->x + roi->width : width - 1;
+    int x, y;
+
+    memset(detector->gx, 0, (size_t)roi->width * roi->height * sizeof(float));
+    memset(detector->gy, 0, (size_t)roi->width * roi->height * sizeof(float));
+    memset(detector->magnitude, 0, (size_t)roi->width * roi->height * sizeof(float));
+    for (y = roi->y > 1 ? roi->y : 1; y < roi->y + roi->height && y < height - 1; y++)
+    {
+        gx = detector->gx + (size_t)(y - roi->y) * roi->width;
+        gy = detector->gy + (size_t)(y - roi->y) * roi->width;
+        magnitude = detector->magnitude + (size_t)(y - roi->y) * roi->width;
+        if (wide)
+        {
+            SOBEL_ROW(uint16_t)
+        }
+        else
+        {
+            SOBEL_ROW(uint8_t)
+        }
+    }
+}
+
+/**
+  * Offset of the peak of a sampled maximum from the middle sample, in
+  * [-0.5, 0.5]
+  */
+static float edge_peak_offset(float before, float middle, float after, int fit)
+{
+    float denominator;
+
+    if (fit == FIT_GAUSSIAN && before > 0.0f && after > 0.0f)
+    {
+        before = logf(before);
+        after = logf(after);
+        middle = logf(middle);
+    }
+    denominator = before - 2.0f * middle + after;
+    return denominator < 0.0f ? 0.5f * (before - after) / denominator : 0.0f;
+}
+
+static int edge_push(EdgeDetector * detector, float x, float y, int pixel, int strong)
+{
+    EdgePoint * grown;
+    EdgePoint * point;
+
+    if (detector->count == detector->capacity)
+    {
+        grown = (EdgePoint *)realloc(detector->points, 2 * (size_t)detector->capacity * sizeof(EdgePoint));
+        if (grown == NULL)
+        {
+            return -1;
+        }
+        detector->points = grown;
+        detector->capacity *= 2;
+    }
+    point = &detector->points[detector->count];
+    point->x = x;
+    point->y = y;
+    point->gx = detector->gx[pixel];
+    point->gy = detector->gy[pixel];
+    point->pixel = pixel;
+    point->next = -1;
+    point->prev = -1;
+    point->strong = strong;
+    detector->map[pixel] = detector->count++;
+    return 0;
+}
+
+/**
+  * Keeps the pixels whose gradient magnitude is a maximum along the axis
+  * closer to the gradient, and places each at the peak of a parabola (or
+  * Gaussian) through the magnitudes on that axis. Interpolating along the
+  * pixel axis rather than the gradient direction is what keeps the
+  * position error in the hundredths of a pixel.
+  * @return 0 on success, -1 when out of memory
+  */
+static int edge_suppress(EdgeDetector * detector, float low, float high, int fit)
+{
+    EdgeRoi * roi = &detector->roi;
+    const float * magnitude = detector->magnitude;
+    float before, middle, after;
+    int pixel;
+    int i, j;
+
+    for (j = 1; j < roi->height - 1; j++)
+    {
+        for (i = 1; i < roi->width - 1; i++)
+        {
+            pixel = j * roi->width + i;
+            middle = magnitude[pixel];
+            if (middle < low)
+            {
+                continue;
+            }
+            if (fabsf(detector->gx[pixel]) >= fabsf(detector->gy[pixel]))
+            {
+                before = magnitude[pixel - 1];
+                after = magnitude[pixel + 1];
+                if (before < middle && middle >= after
+                        && edge_push(detector, roi->x + i + edge_peak_offset(before, middle, after, fit), (float)(roi->y + j), pixel, middle >= high) != 0)
+                {
+                    return -1;
+                }
+            }
+            else
+            {
+                before = magnitude[pixel - roi->width];
+                after = magnitude[pixel + roi->width];
+                if (before < middle && middle >= after
+                        && edge_push(detector, (float)(roi->x + i), roi->y + j + edge_peak_offset(before, middle, after, fit), pixel, middle >= high) != 0)
+                {
+                    return -1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+  * Hysteresis: keeps the weak points 8-connected to a strong one, then
+  * compacts the kept points, which stay in raster order
+  * @return 0 on success, -1 when out of memory
+  */
+static int edge_hysteresis(EdgeDetector * detector)
+{
+    EdgePoint * points = detector->points;
+    int32_t * stack;
+    int width = detector->roi.width;
+    int top = 0;
+    int kept = 0;
+    int neighbour;
+    int p, q, dx, dy;
+
+    stack = (int32_t *)malloc(((size_t)detector->count + 1) * sizeof(int32_t));
+    if (stack == NULL)
+    {
+        return -1;
+    }
+    /* strong is 0 for weak, 1 for strong and 2 once a point is kept */
+    for (p = 0; p < detector->count; p++)
+    {
+        if (points[p].strong != 1)
+        {
+            continue;
+        }
+        points[p].strong = 2;
+        stack[top++] = p;
+        while (top > 0)
+        {
+            q = stack[--top];
+            for (dy = -1; dy <= 1; dy++)
+            {
+                for (dx = -1; dx <= 1; dx++)
+                {
+                    neighbour = detector->map[points[q].pixel + dy * width + dx];
+                    if (neighbour >= 0 && points[neighbour].strong != 2)
+                    {
+                        points[neighbour].strong = 2;
+                        stack[top++] = neighbour;
+                    }
+                }
+            }
+        }
+    }
+    free(stack);
+
+    for (p = 0; p < detector->count; p++)
+    {
+        if (points[p].strong == 2)
+        {
+            points[kept] = points[p];
+            detector->map[points[kept].pixel] = kept;
+            kept++;
+        }
+        else
+        {
+            detector->map[points[p].pixel] = -1;
+        }
+    }
+    detector->count = kept;
+    return 0;
+}
+
+static float edge_distance2(const EdgePoint * a, const EdgePoint * b)
+{
+    return (a->x - b->x) * (a->x - b->x) + (a->y - b->y) * (a->y - b->y);
+}
+
+/**
+  * Links from to to unless either already has a closer link, which keeps
+  * every point on at most one path
+  */
+static void edge_link(EdgePoint * points, int from, int to)
+{
+    float distance = edge_distance2(&points[from], &points[to]);
+
+    if (points[from].next >= 0 && edge_distance2(&points[from], &points[points[from].next]) <= distance)
+    {
+        return;
+    }
+    if (points[to].prev >= 0 && edge_distance2(&points[points[to].prev], &points[to]) <= distance)
+    {
+        return;
+    }
+    if (points[from].next >= 0)
+    {
+        points[points[from].next].prev = -1;
+    }
+    if (points[to].prev >= 0)
+    {
+        points[points[to].prev].next = -1;
+    }
+    points[from].next = to;
+    points[to].prev = from;
+}
+
+/**
+  * Links each point to the nearest neighbouring point ahead of it and the
+  * nearest one behind it along the edge. Ahead means the bright side is on
+  * the right, so every contour runs the same way round, and neighbours with
+  * an opposing gradient are never linked.
+  */
+static void edge_chain(EdgeDetector * detector)
+{
+    EdgePoint * points = detector->points;
+    EdgePoint * point;
+    EdgePoint * other;
+    float distance, side;
+    float best_ahead, best_behind;
+    int ahead, behind;
+    int width = detector->roi.width;
+    int neighbour;
+    int p, dx, dy;
+
+    for (p = 0; p < detector->count; p++)
+    {
+        point = &points[p];
+        ahead = -1;
+        behind = -1;
+        best_ahead = 0.0f;
+        best_behind = 0.0f;
+        for (dy = -1; dy <= 1; dy++)
+        {
+            for (dx = -1; dx <= 1; dx++)
+            {
+                neighbour = detector->map[point->pixel + dy * width + dx];
+                if (neighbour < 0 || neighbour == p)
+                {
+                    continue;
+                }
+                other = &points[neighbour];
+                if (point->gx * other->gx + point->gy * other->gy <= 0.0f)
+                {
+                    continue;
+                }
+                distance = edge_distance2(point, other);
+                side = (other->x - point->x) * point->gy - (other->y - point->y) * point->gx;
+                if (side > 0.0f && (ahead < 0 || distance < best_ahead))
+                {
+                    ahead = neighbour;
+                    best_ahead = distance;
+                }
+                else if (side < 0.0f && (behind < 0 || distance < best_behind))
+                {
+                    behind = neighbour;
+                    best_behind = distance;
+                }
+            }
+        }
+        if (ahead >= 0)
+        {
+            edge_link(points, p, ahead);
+        }
+        if (behind >= 0)
+        {
+            edge_link(points, behind, p);
+        }
+    }
+}
+
+/**
+  * Finds the subpixel edge points inside the ROI. Runs without the GIL.
+  * @return 0 on success, -1 when out of memory
+  */
+static int edge_detect(EdgeDetector * detector, const char * data, int pitch, int wide, int width, int height, float low, float high, int fit)
+{
+    size_t pixels = (size_t)detector->roi.width * detector->roi.height;
+
+    detector->count = 0;
+    detector->capacity = 1024;
+    detector->gx = (float *)malloc((pixels + 1) * sizeof(float));
+    detector->gy = (float *)malloc((pixels + 1) * sizeof(float));
+    detector->magnitude = (float *)malloc((pixels + 1) * sizeof(float));
+    detector->map = (int32_t *)malloc((pixels + 1) * sizeof(int32_t));
+    detector->points = (EdgePoint *)malloc(detector->capacity * sizeof(EdgePoint));
+    if (detector->gx == NULL || detector->gy == NULL || detector->magnitude == NULL || detector->map == NULL || detector->points == NULL)
+    {
+        return -1;
+    }
+    memset(detector->map, 0xff, pixels * sizeof(int32_t));
+
+    edge_gradient(detector, data, pitch, wide, width, height);
+    if (edge_suppress(detector, low, high, fit) != 0 || edge_hysteresis(detector) != 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+static void edge_free(EdgeDetector * detector)
+{
+    free(detector->gx);
+    free(detector->gy);
+    free(detector->magnitude);
+    free(detector->map);
+    free(detector->points);
+}
+
+/*
+ * Ordered contour, a range of the order array
+ */
+typedef struct
+{
+    int                start;
+    int                length;
+    int                closed;
+} EdgeContour;
+
+static int contour_compare(const void * a, const void * b)
+{
+    const EdgeContour * first = (const EdgeContour *)a;
+    const EdgeContour * second = (const EdgeContour *)b;
+
+    if (first->length != second->length)
+    {
+        return first->length > second->length ? -1 : 1;
+    }
+    return first->start - second->start;
+}
+
+/**
+  * Walks the links into contours: open ones from their first point, then
+  * the closed loops that remain. Contours are sorted longest first.
+  * @arg order Receives the point indices of every contour back to back
+  * @arg contours Receives up to count contours
+  * @return Number of contours
+  */
+static int edge_trace(EdgeDetector * detector, int32_t * order, EdgeContour * contours)
+{
+    EdgePoint * points = detector->points;
+    int used = 0;
+    int found = 0;
+    int pass, p, q;
+
+    /* prev is set to -2 on points already walked */
+    for (pass = 0; pass < 2; pass++)
+    {
+        for (p = 0; p < detector->count; p++)
+        {
+            if (points[p].prev == -2 || (pass == 0 && points[p].prev != -1))
+            {
+                continue;
+            }
+            contours[found].start = used;
+            contours[found].closed = pass == 1;
+            for (q = p; q >= 0 && points[q].prev != -2; q = points[q].next)
+            {
+                order[used++] = q;
+                points[q].prev = -2;
+            }
+            contours[found].length = used - contours[found].start;
+            found++;
+        }
+    }
+    qsort(contours, found, sizeof(EdgeContour), contour_compare);
+    return found;
+}
+
+/**
+  * @return The EdgeFit of a name, -1 with a Python exception set
+  */
+static int edge_parse_fit(const char * name)
+{
+    if (strcmp(name, "parabola") == 0)
+    {
+        return FIT_PARABOLA;
+    }
+    if (strcmp(name, "gaussian") == 0)
+    {
+        return FIT_GAUSSIAN;
+    }
+    PyErr_Format(PyExc_ValueError, "Unknown fit '%s', expected parabola or gaussian", name);
+    return -1;
+}
+
+/**
+  * Parses the arguments shared by find_edges and find_contours and runs
+  * the detector
+  * @return 0 on success, -1 with a Python exception set
+  */
+static int edge_run(PyObject * image_obj, double threshold, PyObject * low_obj, PyObject * roi_obj, const char * fit_name, EdgeDetector * detector)
+{
+    PyArrayObject * image;
+    PyArrayObject * contiguous;
+    double low = threshold / 2;
+    int fit;
+    int width, height;
+    int x0, y0, x1, y1;
+    int failed;
+
+    memset(detector, 0, sizeof(EdgeDetector));
+    if (low_obj != Py_None)
+    {
+        low = PyFloat_AsDouble(low_obj);
+        if (low == -1.0 && PyErr_Occurred())
+        {
+            return -1;
+        }
+    }
+    if (threshold <= 0.0 || low <= 0.0 || low > threshold)
+    {
+        PyErr_SetString(PyExc_ValueError, "threshold must be positive and low between 0 and threshold");
+        return -1;
+    }
+    fit = edge_parse_fit(fit_name);
+    if (fit < 0)
+    {
+        return -1;
+    }
+
+    image = (PyArrayObject *)PyArray_FROMANY(image_obj, NPY_NOTYPE, 2, 2, 0);
+    if (image == NULL)
+    {
+        return -1;
+    }
+    if (PyArray_TYPE(image) != NPY_UINT8 && PyArray_TYPE(image) != NPY_UINT16)
+    {
+        Py_DECREF(image);
+        PyErr_SetString(PyExc_TypeError, "Edge detection expects a 2D uint8 or uint16 image");
+        return -1;
+    }
+    /* Rows may be padded, as in the sequence buffers, but not strided */
+    if (PyArray_STRIDE(image, 1) != PyArray_ITEMSIZE(image) || PyArray_STRIDE(image, 0) < 0)
+    {
+        contiguous = (PyArrayObject *)PyArray_FROMANY((PyObject *)image, PyArray_TYPE(image), 2, 2, NPY_ARRAY_CARRAY);
+        Py_DECREF(image);
+        if (contiguous == NULL)
+        {
+            return -1;
+        }
+        image = contiguous;
+    }
+    width = (int)PyArray_DIM(image, 1);
+    height = (int)PyArray_DIM(image, 0);
+
+    x0 = 0;
+    y0 = 0;
+    x1 = width;
+    y1 = height;
+    if (roi_obj != Py_None)
+    {
+        if (!PyArg_ParseTuple(roi_obj, "iiii;roi must be (x, y, width, height)", &x0, &y0, &x1, &y1))
+        {
+            Py_DECREF(image);
+            return -1;
+        }
+        x1 += x0;
+        y1 += y0;
+        x0 = x0 > 0 ? x0 : 0;
+        y0 = y0 > 0 ? y0 : 0;
+        x1 = x1 < width ? x1 : width;
+        y1 = y1 < height ? y1 : height;
+    }
+    detector->roi.x = x0;
+    detector->roi.y = y0;
+    detector->roi.width = x1 > x0 ? x1 - x0 : 0;
+    detector->roi.height = y1 > y0 ? y1 - y0 : 0;
+
+    Py_BEGIN_ALLOW_THREADS
+    failed = edge_detect(detector, PyArray_BYTES(image), (int)PyArray_STRIDE(image, 0), PyArray_TYPE(image) == NPY_UINT16,
+            width, height, (float)low, (float)threshold, fit);
+    if (!failed)
+    {
+        edge_chain(detector);
+    }
+    Py_END_ALLOW_THREADS
+    Py_DECREF(image);
+    if (failed)
+    {
+        edge_free(detector);
+        PyErr_NoMemory();
+        return -1;
+    }
+    return 0;
+}
+
+/**
+  * Copies a contour into a new float32 array of (x, y) rows, repeating the
+  * first point at the end of a closed one
+  */
+static PyObject * edge_contour_array(const EdgeDetector * detector, const int32_t * order, const EdgeContour * contour)
+{
+    PyObject * array;
+    npy_intp dimensions[2];
+    float * out;
+    int i;
+
+    dimensions[0] = contour->length + (contour->closed ? 1 : 0);
+    dimensions[1] = 2;
+    array = PyArray_SimpleNew(2, dimensions, NPY_FLOAT32);
+    if (array == NULL)
+    {
+        return NULL;
+    }
+    out = (float *)PyArray_DATA((PyArrayObject *)array);
+    for (i = 0; i < dimensions[0]; i++)
+    {
+        const EdgePoint * point = &detector->points[order[contour->start + i % contour->length]];
+        out[2 * i] = point->x;
+        out[2 * i + 1] = point->y;
+    }
+    return array;
+}
+
+/**
+  * Finds the subpixel edge points of a mono image
+  * This means the definition of the function is:
+  *     def find_edges(image, threshold, low=None, roi=None, fit="parabola")
+  * @arg threshold Gradient magnitude, in levels per pixel, an edge must
+  *      reach somewhere; low (threshold / 2 by default) is where it may end
+  * @arg roi (x, y, width, height) to search in, None for the whole image
+  * @arg fit "parabola" or "gaussian", the peak model across the edge
+  * @return A float32 array of (x, y) rows in image coordinates, in raster order
+  */
+PyObject * ids_find_edges(PyObject * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"image", "threshold", "low", "roi", "fit", NULL};
+    PyObject * image_obj;
+    PyObject * low_obj = Py_None;
+    PyObject * roi_obj = Py_None;
+    PyObject * result;
+    EdgeDetector detector;
+    EdgeContour all;
+    int32_t * order;
+    const char * fit = "parabola";
+    double threshold;
+    int p;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "Od|OOs", kwlist, &image_obj, &threshold, &low_obj, &roi_obj, &fit))
+    {
+        return NULL;
+    }
+    if (edge_run(image_obj, threshold, low_obj, roi_obj, fit, &detector) != 0)
+    {
+        return NULL;
+    }
+
+    order = (int32_t *)malloc(((size_t)detector.count + 1) * sizeof(int32_t));
+    if (order == NULL)
+    {
+        edge_free(&detector);
+        return PyErr_NoMemory();
+    }
+    for (p = 0; p < detector.count; p++)
+    {
+        order[p] = p;
+    }
+    all.start = 0;
+    all.length = detector.count;
+    all.closed = 0;
+    result = edge_contour_array(&detector, order, &all);
+    free(order);
+    edge_free(&detector);
+    return result;
+}
+
+/**
+  * Finds the subpixel contours of a mono image, such as the outline of a
+  * drop for shape analysis
+  * This means the definition of the function is:
+  *     def find_contours(image, threshold, low=None, roi=None, fit="parabola", min_points=10)
+  * @arg threshold, low, roi, fit As for find_edges
+  * @arg min_points Shorter contours are dropped
+  * @return A list of float32 arrays of (x, y) rows, longest first. Closed
+  *         contours repeat their first point at the end. Every contour runs
+  *         with the darker side on its left as seen on screen, so the
+  *         outline of a dark drop runs counterclockwise.
+  */
+PyObject * ids_find_contours(PyObject * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"image", "threshold", "low", "roi", "fit", "min_points", NULL};
+    PyObject * image_obj;
+    PyObject * low_obj = Py_None;
+    PyObject * roi_obj = Py_None;
+    PyObject * contour;
+    PyObject * result;
+    EdgeDetector detector;
+    EdgeContour * contours;
+    int32_t * order;
+    const char * fit = "parabola";
+    double threshold;
+    int min_points = DEFAULT_MIN_POINTS;
+    int found = 0;
+    int i;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "Od|OOsi", kwlist, &image_obj, &threshold, &low_obj, &roi_obj, &fit, &min_points))
+    {
+        return NULL;
+    }
+    if (edge_run(image_obj, threshold, low_obj, roi_obj, fit, &detector) != 0)
+    {
+        return NULL;
+    }
+
+    order = (int32_t *)malloc(((size_t)detector.count + 1) * sizeof(int32_t));
+    contours = (EdgeContour *)malloc(((size_t)detector.count + 1) * sizeof(EdgeContour));
+    if (order != NULL && contours != NULL)
+    {
+        Py_BEGIN_ALLOW_THREADS
+        found = edge_trace(&detector, order, contours);
+        Py_END_ALLOW_THREADS
+        result = PyList_New(0);
+    }
+    else
+    {
+        result = PyErr_NoMemory();
+    }
+    for (i = 0; result != NULL && i < found && contours[i].length >= min_points; i++)
+    {
+        contour = edge_contour_array(&detector, order, &contours[i]);
+        if (contour == NULL || PyList_Append(result, contour) != 0)
+        {
+            Py_XDECREF(contour);
+            Py_CLEAR(result);
+            break;
+        }
+        Py_DECREF(contour);
+    }
+    free(contours);
+    free(order);
+    edge_free(&detector);
+    return result;
+}
+
+/*
+ * Settings and results of the benchmark
+ */
+typedef struct
+{
+    int                width;
+    int                height;
+    int                drops;
+    int                repeat;
+    int                fit;
+    double             noise;
+
+    int                ok;
+    int                contours;
+    int                points;
+    int64_t            best_ns;
+    double             rms_px;
+    double             max_px;
+} EdgeBenchmark;
+
+/*
+ * Ellipse of a synthetic drop
+ */
+typedef struct
+{
+    double             cx;
+    double             cy;
+    double             a;
+    double             b;
+} EdgeEllipse;
+
+static uint32_t benchmark_random(uint32_t * state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+static double benchmark_uniform(uint32_t * state)
+{
+    return (benchmark_random(state) + 0.5) / 16777216.0;
+}
+
+/**
+  * Approximate signed distance of (x, y) to an ellipse, negative inside
+  */
+static double ellipse_distance(const EdgeEllipse * ellipse, double x, double y)
+{
+    double dx = x - ellipse->cx;
+    double dy = y - ellipse->cy;
+    double f = dx * dx / (ellipse->a * ellipse->a) + dy * dy / (ellipse->b * ellipse->b) - 1.0;
+    double fx = 2.0 * dx / (ellipse->a * ellipse->a);
+    double fy = 2.0 * dy / (ellipse->b * ellipse->b);
+
+    return f / sqrt(fx * fx + fy * fy + 1e-12);
+}
+
+/**
+  * Draws dark elliptical drops, one per cell of a grid, on a bright
+  * background. Pixels within a pixel of an outline are supersampled 16 by
+  * 16 so the outline is anti-aliased as a lens would blur it.
+  */
+static void edge_benchmark_render(uint8_t * image, const EdgeBenchmark * bench, EdgeEllipse * ellipses)
+{
+    uint32_t state = 12345;
+    EdgeEllipse * ellipse;
+    double value, coverage, distance;
+    double u, v;
+    int columns = (int)ceil(sqrt((double)bench->drops * bench->width / bench->height));
+    int rows = (bench->drops + columns - 1) / columns;
+    double cell_width = (double)bench->width / columns;
+    double cell_height = (double)bench->height / rows;
+    double cell = cell_width < cell_height ? cell_width : cell_height;
+    int x, y, sx, sy, d;
+    int x0, x1, y0, y1;
+
+    for (d = 0; d < bench->drops; d++)
+    {
+        ellipse = &ellipses[d];
+        ellipse->a = cell * (0.25 + 0.15 * benchmark_uniform(&state));
+        ellipse->b = cell * (0.25 + 0.15 * benchmark_uniform(&state));
+        ellipse->cx = (d % columns + 0.5) * cell_width + (benchmark_uniform(&state) - 0.5) * 0.05 * cell;
+        ellipse->cy = (d / columns + 0.5) * cell_height + (benchmark_uniform(&state) - 0.5) * 0.05 * cell;
+    }
+
+    for (y = 0; y < bench->height; y++)
+    {
+        for (x = 0; x < bench->width; x++)
+        {
+            value = BENCHMARK_BACKGROUND;
+            if (bench->noise > 0.0)
+            {
+                /* Box-Muller */
+                u = benchmark_uniform(&state);
+                v = benchmark_uniform(&state);
+                value += bench->noise * sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+            }
+            image[(size_t)y * bench->width + x] = (uint8_t)(value < 0.0 ? 0 : value > 255.0 ? 255 : (int)(value + 0.5));
+        }
+    }
+
+    for (d = 0; d < bench->drops; d++)
+    {
+        ellipse = &ellipses[d];
+        x0 = (int)floor(ellipse->cx - ellipse->a) - 1;
+        x1 = (int)ceil(ellipse->cx + ellipse->a) + 1;
+        y0 = (int)floor(ellipse->cy - ellipse->b) - 1;
+        y1 = (int)ceil(ellipse->cy + ellipse->b) + 1;
+        for (y = y0 > 0 ? y0 : 0; y <= y1 && y < bench->height; y++)
+        {
+            for (x = x0 > 0 ? x0 : 0; x <= x1 && x < bench->width; x++)
+            {
+                distance = ellipse_distance(ellipse, x, y);
+                if (distance >= 1.0)
+                {
+                    continue;
+                }
+                coverage = 1.0;
+                if (distance > -1.0)
+                {
+                    coverage = 0.0;
+                    for (sy = 0; sy < 16; sy++)
+                    {
+                        for (sx = 0; sx < 16; sx++)
+                        {
+                            if (ellipse_distance(ellipse, x + (sx + 0.5) / 16 - 0.5, y + (sy + 0.5) / 16 - 0.5) < 0.0)
+                            {
+                                coverage += 1.0 / 256;
+                            }
+                        }
+                    }
+                }
+                value = image[(size_t)y * bench->width + x] - (BENCHMARK_BACKGROUND - BENCHMARK_DROP) * coverage;
+                image[(size_t)y * bench->width + x] = (uint8_t)(value < 0.0 ? 0 : (int)(value + 0.5));
+            }
+        }
+    }
+}
+
+/**
+  * Times the contour extraction on one synthetic image and measures the
+  * distance of the kept points to the true outlines
+  */
+static void edge_benchmark_run(EdgeBenchmark * bench)
+{
+    uint8_t * image = (uint8_t *)malloc((size_t)bench->width * bench->height);
+    EdgeEllipse * ellipses = (EdgeEllipse *)malloc((bench->drops > 0 ? bench->drops : 1) * sizeof(EdgeEllipse));
+    EdgeContour * contours = NULL;
+    int32_t * order = NULL;
+    EdgeDetector detector;
+    const EdgePoint * point;
+    int64_t start;
+    int64_t elapsed;
+    double squares = 0.0;
+    double distance, nearest;
+    int found = 0;
+    int failed;
+    int i, j, d;
+
+    memset(&detector, 0, sizeof(detector));
+    bench->ok = 0;
+    if (image == NULL || ellipses == NULL)
+    {
+        goto done;
+    }
+    edge_benchmark_render(image, bench, ellipses);
+
+    for (i = 0; i < bench->repeat; i++)
+    {
+        edge_free(&detector);
+        free(contours);
+        free(order);
+        memset(&detector, 0, sizeof(detector));
+        contours = NULL;
+        order = NULL;
+        start = ids_monotonic_ns();
+        detector.roi.width = bench->width;
+        detector.roi.height = bench->height;
+        failed = edge_detect(&detector, (const char *)image, bench->width, 0, bench->width, bench->height,
+                (float)(BENCHMARK_THRESHOLD / 2), (float)BENCHMARK_THRESHOLD, bench->fit);
+        if (!failed)
+        {
+            edge_chain(&detector);
+            order = (int32_t *)malloc(((size_t)detector.count + 1) * sizeof(int32_t));
+            contours = (EdgeContour *)malloc(((size_t)detector.count + 1) * sizeof(EdgeContour));
+            failed = order == NULL || contours == NULL;
+        }
+        if (!failed)
+        {
+            found = edge_trace(&detector, order, contours);
+        }
+        elapsed = ids_monotonic_ns() - start;
+        if (failed)
+        {
+            goto done;
+        }
+        if (i == 0 || elapsed < bench->best_ns)
+        {
+            bench->best_ns = elapsed;
+        }
+    }
+
+    bench->contours = 0;
+    bench->points = 0;
+    bench->max_px = 0.0;
+    for (i = 0; i < found && contours[i].length >= DEFAULT_MIN_POINTS; i++)
+    {
+        bench->contours++;
+        for (j = 0; j < contours[i].length; j++)
+        {
+            point = &detector.points[order[contours[i].start + j]];
+            nearest = -1.0;
+            for (d = 0; d < bench->drops; d++)
+            {
+                distance = fabs(ellipse_distance(&ellipses[d], point->x, point->y));
+                if (nearest < 0.0 || distance < nearest)
+                {
+                    nearest = distance;
+                }
+            }
+            squares += nearest * nearest;
+            bench->max_px = nearest > bench->max_px ? nearest : bench->max_px;
+            bench->points++;
+        }
+    }
+    bench->rms_px = bench->points > 0 ? sqrt(squares / bench->points) : 0.0;
+    bench->ok = 1;
+
+done:
+    edge_free(&detector);
+    free(contours);
+    free(order);
+    free(ellipses);
+    free(image);
+}
+
+/**
+  * Function to measure find_contours on a synthetic image of drops
+  * This means the definition of the function is:
+  *     def edge_benchmark(width=1600, height=1200, drops=6, repeat=5, noise=0.0, fit="parabola")
+  * @arg noise Standard deviation of the Gaussian noise added, in levels
+  * @return A dictionary with the best time in ms, the frame rate that
+  *         allows on one core, the contours and points found and the RMS
+  *         and largest distance of the points to the true outlines
+  */
+PyObject * ids_edge_benchmark(PyObject * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"width", "height", "drops", "repeat", "noise", "fit", NULL};
+    EdgeBenchmark bench;
+    const char * fit = "parabola";
+
+    memset(&bench, 0, sizeof(bench));
+    bench.width = DEFAULT_BENCHMARK_WIDTH;
+    bench.height = DEFAULT_BENCHMARK_HEIGHT;
+    bench.drops = DEFAULT_BENCHMARK_DROPS;
+    bench.repeat = DEFAULT_BENCHMARK_REPEAT;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|iiiids", kwlist, &bench.width, &bench.height, &bench.drops, &bench.repeat, &bench.noise, &fit))
+    {
+        return NULL;
+    }
+    if (bench.width < 64 || bench.height < 64 || bench.drops < 1 || bench.repeat < 1 || bench.noise < 0.0)
+    {
+        PyErr_SetString(PyExc_ValueError, "width and height must be at least 64, drops and repeat positive and noise not negative");
+        return NULL;
+    }
+    bench.fit = edge_parse_fit(fit);
+    if (bench.fit < 0)
+    {
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    edge_benchmark_run(&bench);
+    Py_END_ALLOW_THREADS
+    if (!bench.ok)
+    {
+        return PyErr_NoMemory();
+    }
+
+    return Py_BuildValue("{s:i,s:i,s:i,s:d,s:d,s:i,s:i,s:d,s:d}",
+            "width", bench.width,
+            "height", bench.height,
+            "drops", bench.drops,
+            "ms", bench.best_ns / 1e6,
+            "fps", bench.best_ns > 0 ? 1e9 / bench.best_ns : 0.0,
+            "contours", bench.contours,
+            "points", bench.points,
+            "rms_error_px", bench.rms_px,
+            "max_error_px", bench.max_px);
+}
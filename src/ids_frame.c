@@ -0,0 +1,802 @@
+#include <uEye.h>
+#include "ids.h"
+#define PY_ARRAY_UNIQUE_SYMBOL ids_ARRAY_API
+#define NO_IMPORT_ARRAY
+#include <numpy/arrayobject.h>
+
+/* Deallocated objects kept for reuse instead of being freed, per kind */
+#define FRAME_FREELIST_SIZE 64
+#define LEASE_FREELIST_SIZE 64
+#define ARRAY_POOL_SIZE     64
+
+/*
+ * The subset of dlpack.h (v1.0) needed to export a host buffer
+ */
+#define DLPACK_MAJOR_VERSION 1
+#define DLPACK_MINOR_VERSION 0
+#define DL_CPU               1
+#define DL_UINT              1
+
+typedef struct
+{
+    int32_t            device_type;
+    int32_t            device_id;
+} DLDevice;
+
+typedef struct
+{
+    uint8_t            code;
+    uint8_t            bits;
+    uint16_t           lanes;
+} DLDataType;
+
+typedef struct
+{
+    void *             data;
+    DLDevice           device;
+    int32_t            ndim;
+    DLDataType         dtype;
+    int64_t *          shape;
+    int64_t *          strides;
+    uint64_t           byte_offset;
+} DLTensor;
+
+typedef struct DLManagedTensor
+{
+    DLTensor           dl_tensor;
+    void *             manager_ctx;
+    void (*deleter)(struct DLManagedTensor * self);
+} DLManagedTensor;
+
+typedef struct
+{
+    uint32_t           major;
+    uint32_t           minor;
+} DLPackVersion;
+
+typedef struct DLManagedTensorVersioned
+{
+    DLPackVersion      version;
+    void *             manager_ctx;
+    void (*deleter)(struct DLManagedTensorVersioned * self);
+    uint64_t           flags;
+    DLTensor           dl_tensor;
+} DLManagedTensorVersioned;
+
+/*
+ * Owner of one delivered sequence buffer and the base object of its arrays.
+ * Hands the buffer back to the SDK when the last array or view is gone.
+ */
+typedef struct
+{
+    PyObject_HEAD
+    Camera *           camera;
+    FrameSlot *        slot;
+} FrameLease;
+
+/*
+ * Frame returned by get_image, unpacks as (image, info)
+ */
+typedef struct
+{
+    PyObject_HEAD
+    PyObject *         image;
+    /* Built on first access */
+    PyObject *         info;
+    uint64_t           sequence;
+    /*
+     * NULL for a frame rebuilt by unpickling or converted to an output
+     * format, which owns its image
+     */
+    FrameLease *       lease;
+} Frame;
+
+/*
+ * What a DLPack consumer holds: the tensor description and a reference to
+ * the lease, dropped by the deleter
+ */
+typedef struct
+{
+    DLManagedTensor          legacy;
+    DLManagedTensorVersioned versioned;
+    int64_t                  shape[3];
+    int64_t                  strides[3];
+    FrameLease *             lease;
+} FrameExport;
+
+/*
+ * Freelists and the array pool. The GIL guards them, the free-threaded
+ * build takes pool_lock instead. Nothing is released while it is held:
+ * releasing a frame can land back in pool_put.
+ */
+#ifdef Py_GIL_DISABLED
+static PyMutex pool_lock;
+#define POOL_LOCK()   PyMutex_Lock(&pool_lock)
+#define POOL_UNLOCK() PyMutex_Unlock(&pool_lock)
+#else
+#define POOL_LOCK()
+#define POOL_UNLOCK()
+#endif
+
+static Frame * frame_freelist[FRAME_FREELIST_SIZE];
+static int frame_free_count = 0;
+static FrameLease * lease_freelist[LEASE_FREELIST_SIZE];
+static int lease_free_count = 0;
+static PyObject * array_pool[ARRAY_POOL_SIZE];
+static int array_pool_count = 0;
+/* Set by frame_pool_init when the array pool may be used, see there */
+static int array_pool_enabled = 0;
+
+/**
+  * Decides whether dropped arrays are pooled. The pool rewrites the data,
+  * base and shape fields of ndarrays in place, so it needs the NumPy at run
+  * time to have the ABI of the headers the module was built with. The
+  * free-threaded build leaves it off: there the refcount test in
+  * array_pool_put cannot tell that no other thread is about to take a
+  * reference to the array.
+  * @note Called once from the module initialization, after the NumPy import
+  */
+void frame_pool_init(void)
+{
+#ifdef Py_GIL_DISABLED
+    array_pool_enabled = 0;
+#else
+    array_pool_enabled = PyArray_GetNDArrayCVersion() == NPY_ABI_VERSION &&
+            PyArray_GetNDArrayCFeatureVersion() >= NPY_API_VERSION;
+#endif
+}
+
+int frame_pool_arrays_enabled(void)
+{
+    return array_pool_enabled;
+}
+
+/*
+ * Objects parked on a freelist drop the reference to their heap type, which
+ * PyObject_Init takes again when they are reused
+ */
+static void lease_dealloc(FrameLease * self)
+{
+    PyTypeObject * type = Py_TYPE(self);
+
+    stats_on_release(&self->camera->stats, self->slot);
+    frame_slot_release(self->slot);
+    Py_CLEAR(self->camera);
+    self->slot = NULL;
+
+    POOL_LOCK();
+    if (lease_free_count < LEASE_FREELIST_SIZE)
+    {
+        lease_freelist[lease_free_count++] = self;
+        self = NULL;
+    }
+    POOL_UNLOCK();
+    if (self != NULL)
+    {
+        type->tp_free((PyObject *)self);
+    }
+    Py_DECREF(type);
+}
+
+static PyType_Slot lease_slots[] = {
+    {Py_tp_dealloc, (void *)lease_dealloc},
+    {Py_tp_doc, (void *)"Keeps the sequence buffer of a frame locked"},
+    {0, NULL} /* Sentinel */
+};
+
+PyType_Spec ids_FrameLeaseSpec = {
+    "ids.FrameLease",          /* name */
+    sizeof(FrameLease),        /* basicsize */
+    0,                         /* itemsize */
+    IDS_TPFLAGS | Py_TPFLAGS_DISALLOW_INSTANTIATION, /* flags */
+    lease_slots,               /* slots */
+};
+
+/**
+  * Moves an array nobody else references into the pool, dropping its lease
+  * @note Detaching is only safe at refcount 1 without weak references: the
+  *       views of a frame array have the lease as their base, not the array
+  */
+static void array_pool_put(PyObject * image, PyTypeObject * lease_type)
+{
+    PyArrayObject_fields * fields = (PyArrayObject_fields *)image;
+    PyObject * base;
+
+    if (!array_pool_enabled || Py_REFCNT(image) != 1 || fields->weakreflist != NULL || array_pool_count >= ARRAY_POOL_SIZE ||
+            !PyArray_CheckExact(image) || fields->base == NULL || Py_TYPE(fields->base) != lease_type)
+    {
+        Py_DECREF(image);
+        return;
+    }
+
+    base = fields->base;
+    fields->base = NULL;
+    fields->data = NULL;
+    POOL_LOCK();
+    if (array_pool_count < ARRAY_POOL_SIZE)
+    {
+        array_pool[array_pool_count++] = image;
+        image = NULL;
+    }
+    POOL_UNLOCK();
+    /* Without data or base the array frees nothing but itself */
+    Py_XDECREF(image);
+    Py_XDECREF(base);
+}
+
+/**
+  * Points a pooled array at a new buffer
+  * @return 0 on success, -1 when the array no longer has the right layout
+  */
+static int array_pool_reuse(PyObject * image, int ndims, npy_intp * dimensions, npy_intp * strides, char * data)
+{
+    PyArrayObject_fields * fields = (PyArrayObject_fields *)image;
+    int i;
+
+    /* Someone may have reassigned shape or dtype before dropping it */
+    if (fields->nd != ndims || fields->descr->type_num != NPY_UINT8)
+    {
+        return -1;
+    }
+    for (i = 0; i < ndims; i++)
+    {
+        fields->dimensions[i] = dimensions[i];
+        fields->strides[i] = strides[i];
+    }
+    fields->data = data;
+    fields->flags = NPY_ARRAY_ALIGNED | NPY_ARRAY_WRITEABLE;
+    PyArray_UpdateFlags((PyArrayObject *)image, NPY_ARRAY_UPDATE_ALL);
+    return 0;
+}
+
+/**
+  * Wraps the buffer of a lease in an ndarray without copying
+  * @return New reference, NULL with a Python exception set
+  */
+static PyObject * frame_wrap(FrameLease * lease)
+{
+    FrameSlot * slot = lease->slot;
+    FrameRing * ring = slot->ring;
+    CameraStats * stats = &lease->camera->stats;
+    PyObject * img = NULL;
+    int ndims;
+    npy_intp dimensions[3];
+    npy_intp strides[3];
+
+    dimensions[0] = slot->info.dwImageHeight ? (npy_intp)slot->info.dwImageHeight : (npy_intp)ring->height;
+    dimensions[1] = slot->info.dwImageWidth ? (npy_intp)slot->info.dwImageWidth : (npy_intp)ring->width;
+    strides[0] = ring->pitch;
+    if (ring->color == IS_CM_MONO8 || ring->color == IS_CM_SENSOR_RAW8)
+    {
+        ndims = 2;
+        strides[1] = 1;
+    }
+    else
+    {
+        ndims = 3;
+        dimensions[2] = ring->bitdepth/8;
+        strides[1] = dimensions[2];
+        strides[2] = 1;
+    }
+
+    for (;;)
+    {
+        POOL_LOCK();
+        img = array_pool_count > 0 ? array_pool[--array_pool_count] : NULL;
+        POOL_UNLOCK();
+        if (img == NULL || array_pool_reuse(img, ndims, dimensions, strides, slot->pBuffer) == 0)
+        {
+            break;
+        }
+        Py_DECREF(img);
+    }
+    if (img != NULL)
+    {
+        ids_atomic_add64(&stats->arrays_reused, 1);
+    }
+    else
+    {
+        img = PyArray_New(&PyArray_Type, ndims, dimensions, NPY_UINT8, strides, slot->pBuffer, 0, NPY_ARRAY_CARRAY, NULL);
+        if (img == NULL)
+        {
+            return NULL;
+        }
+        ids_atomic_add64(&stats->arrays_allocated, 1);
+    }
+
+    Py_INCREF(lease);
+    if (PyArray_SetBaseObject((PyArrayObject *)img, (PyObject *)lease) != 0)
+    {
+        Py_DECREF(img);
+        return NULL;
+    }
+    return img;
+}
+
+static Frame * frame_alloc(PyTypeObject * type, CameraStats * stats)
+{
+    Frame * frame;
+
+    POOL_LOCK();
+    frame = frame_free_count > 0 ? frame_freelist[--frame_free_count] : NULL;
+    POOL_UNLOCK();
+    if (frame != NULL)
+    {
+        PyObject_Init((PyObject *)frame, type);
+        if (stats != NULL)
+        {
+            ids_atomic_add64(&stats->frame_objects_reused, 1);
+        }
+    }
+    else
+    {
+        frame = PyObject_New(Frame, type);
+        if (frame == NULL)
+        {
+            return NULL;
+        }
+        if (stats != NULL)
+        {
+            ids_atomic_add64(&stats->frame_objects_allocated, 1);
+        }
+    }
+    frame->image = NULL;
+    frame->info = NULL;
+    frame->sequence = 0;
+    frame->lease = NULL;
+    return frame;
+}
+
+/**
+  * Builds the Frame for a slot copied out in the camera's output format and
+  * orientation, or undistorted. The info is read while the slot is held, which is released
+  * right after.
+  * @return New reference, NULL with a Python exception set
+  */
+static PyObject * frame_converted(Camera * camera, FrameSlot * slot, int format, int orientation)
+{
+    Frame * frame;
+    int64_t trace_start;
+
+    frame = frame_alloc(camera->state->frame_type, &camera->stats);
+    if (frame != NULL)
+    {
+        frame->sequence = slot->sequence;
+        TRACE_BEGIN(trace_start);
+        frame->image = transform_slot(camera, slot, format, orientation);
+        TRACE_END("convert", trace_start, (int64_t)slot->sequence);
+        if (frame->image != NULL)
+        {
+            frame->info = camera_get_image_info(camera, slot);
+        }
+        if (frame->info == NULL)
+        {
+            Py_DECREF(frame);
+            frame = NULL;
+        }
+    }
+    stats_on_release(&camera->stats, slot);
+    frame_slot_release(slot);
+    return (PyObject *)frame;
+}
+
+/**
+  * Builds the Frame for a delivered slot
+  * @note Takes over the caller's reference to the slot, which is released
+  *       once the frame, its array and every view of it are gone, or right
+  *       away when the frame is copied out in an output format or orientation,
+  *       or undistorted
+  * @return New reference, NULL with a Python exception set
+  */
+PyObject * frame_from_slot(Camera * camera, FrameSlot * slot)
+{
+    ModuleState * state = camera->state;
+    FrameLease * lease;
+    Frame * frame;
+    int format = camera->output_format;
+    int orientation = camera_host_orientation(camera);
+
+    if (format != OUTPUT_RAW || orientation != 0 || camera->undistort != NULL)
+    {
+        return frame_converted(camera, slot, format, orientation);
+    }
+
+    POOL_LOCK();
+    lease = lease_free_count > 0 ? lease_freelist[--lease_free_count] : NULL;
+    POOL_UNLOCK();
+    if (lease != NULL)
+    {
+        PyObject_Init((PyObject *)lease, state->frame_lease_type);
+    }
+    else
+    {
+        lease = PyObject_New(FrameLease, state->frame_lease_type);
+        if (lease == NULL)
+        {
+            frame_slot_release(slot);
+            return NULL;
+        }
+    }
+    Py_INCREF(camera);
+    lease->camera = camera;
+    lease->slot = slot;
+
+    frame = frame_alloc(state->frame_type, &camera->stats);
+    if (frame == NULL)
+    {
+        Py_DECREF(lease);
+        return NULL;
+    }
+    frame->lease = lease;
+    frame->sequence = slot->sequence;
+    frame->image = frame_wrap(lease);
+    if (frame->image == NULL)
+    {
+        Py_DECREF(frame);
+        return NULL;
+    }
+    return (PyObject *)frame;
+}
+
+/**
+  * Creates a frame that is not backed by a camera, which is how unpickling
+  * rebuilds one
+  * This means the definition of the constructor is:
+  *     def Frame(image, info, sequence=0)
+  */
+static PyObject * frame_new(PyTypeObject * type, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"image", "info", "sequence", NULL};
+    unsigned PY_LONG_LONG sequence = 0;
+    PyObject * image;
+    PyObject * info;
+    Frame * frame;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|K", kwlist, &image, &info, &sequence))
+    {
+        return NULL;
+    }
+
+    frame = frame_alloc(type, NULL);
+    if (frame == NULL)
+    {
+        return NULL;
+    }
+    Py_INCREF(image);
+    Py_INCREF(info);
+    frame->image = image;
+    frame->info = info;
+    frame->sequence = sequence;
+    return (PyObject *)frame;
+}
+
+static void frame_dealloc(Frame * self)
+{
+    PyTypeObject * type = Py_TYPE(self);
+
+    Py_CLEAR(self->info);
+    if (self->image != NULL)
+    {
+        array_pool_put(self->image, self->lease != NULL ? Py_TYPE(self->lease) : NULL);
+        self->image = NULL;
+    }
+    Py_CLEAR(self->lease);
+
+    POOL_LOCK();
+    if (frame_free_count < FRAME_FREELIST_SIZE)
+    {
+        frame_freelist[frame_free_count++] = self;
+        self = NULL;
+    }
+    POOL_UNLOCK();
+    if (self != NULL)
+    {
+        type->tp_free((PyObject *)self);
+    }
+    Py_DECREF(type);
+}
+
+static PyObject * frame_get_image(Frame * self, void * closure)
+{
+    Py_INCREF(self->image);
+    return self->image;
+}
+
+static PyObject * frame_get_info(Frame * self, void * closure)
+{
+    PyObject * info;
+    int64_t trace_start;
+
+    /* Two threads reading info of a shared frame must build it once */
+    Py_BEGIN_CRITICAL_SECTION(self);
+    if (self->info == NULL && self->lease != NULL)
+    {
+        TRACE_BEGIN(trace_start);
+        self->info = camera_get_image_info(self->lease->camera, self->lease->slot);
+        TRACE_END("metadata", trace_start, (int64_t)self->lease->slot->sequence);
+    }
+    info = self->info;
+    Py_XINCREF(info);
+    Py_END_CRITICAL_SECTION();
+
+    if (info == NULL && !PyErr_Occurred())
+    {
+        Py_RETURN_NONE;
+    }
+    return info;
+}
+
+static PyObject * frame_get_sequence(Frame * self, void * closure)
+{
+    return Py_BuildValue("K", self->sequence);
+}
+
+static void frame_export_release(FrameExport * export)
+{
+    PyGILState_STATE state;
+
+    /* Consumers may free the tensor on any thread */
+    state = PyGILState_Ensure();
+    Py_DECREF(export->lease);
+    PyGILState_Release(state);
+    free(export);
+}
+
+static void frame_export_deleter(DLManagedTensor * tensor)
+{
+    frame_export_release((FrameExport *)tensor->manager_ctx);
+}
+
+static void frame_export_deleter_versioned(DLManagedTensorVersioned * tensor)
+{
+    frame_export_release((FrameExport *)tensor->manager_ctx);
+}
+
+/**
+  * Frees a tensor no consumer took, a consumer renames the capsule to
+  * used_dltensor and becomes responsible for calling the deleter
+  */
+static void frame_export_capsule_destructor(PyObject * capsule)
+{
+    DLManagedTensor * tensor;
+    DLManagedTensorVersioned * versioned;
+
+    if (PyCapsule_IsValid(capsule, "dltensor"))
+    {
+        tensor = (DLManagedTensor *)PyCapsule_GetPointer(capsule, "dltensor");
+        tensor->deleter(tensor);
+    }
+    else if (PyCapsule_IsValid(capsule, "dltensor_versioned"))
+    {
+        versioned = (DLManagedTensorVersioned *)PyCapsule_GetPointer(capsule, "dltensor_versioned");
+        versioned->deleter(versioned);
+    }
+}
+
+/**
+  * Function to export the frame through DLPack without copying
+  * This means the definition of the method is:
+  *     def __dlpack__(self, stream=None, max_version=None, dl_device=None, copy=None)
+  * @return A capsule holding a DLManagedTensor, or a DLManagedTensorVersioned
+  *         when the consumer supports version 1
+  * @note The SDK buffer stays locked until the consumer frees the tensor
+  */
+static PyObject * frame_dlpack(Frame * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"stream", "max_version", "dl_device", "copy", NULL};
+    PyObject * stream = Py_None;
+    PyObject * max_version = Py_None;
+    PyObject * device = Py_None;
+    PyObject * copy = Py_None;
+    PyObject * method;
+    PyObject * result;
+    PyObject * capsule;
+    FrameExport * export;
+    DLTensor * tensor;
+    long major = 0;
+    int device_type = DL_CPU;
+    int device_id = 0;
+    int i;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OOOO", kwlist, &stream, &max_version, &device, &copy))
+    {
+        return NULL;
+    }
+    if (stream != Py_None)
+    {
+        PyErr_SetString(PyExc_ValueError, "Frames live in host memory, stream must be None");
+        return NULL;
+    }
+    if (device != Py_None && !PyArg_ParseTuple(device, "ii", &device_type, &device_id))
+    {
+        return NULL;
+    }
+    if (device_type != DL_CPU || device_id != 0)
+    {
+        PyErr_SetString(PyExc_BufferError, "Frames can only be exported to the CPU device");
+        return NULL;
+    }
+    if (max_version != Py_None)
+    {
+        if (!PyTuple_Check(max_version) || PyTuple_Size(max_version) < 1)
+        {
+            PyErr_SetString(PyExc_TypeError, "max_version must be a (major, minor) tuple");
+            return NULL;
+        }
+        major = PyLong_AsLong(PyTuple_GetItem(max_version, 0));
+        if (major == -1 && PyErr_Occurred())
+        {
+            return NULL;
+        }
+    }
+
+    /* Without a buffer of our own, or when asked to copy, the array exports */
+    if (self->lease == NULL || PyObject_IsTrue(copy) == 1)
+    {
+        result = self->lease == NULL ? self->image : PyArray_NewCopy((PyArrayObject *)self->image, NPY_CORDER);
+        if (result == NULL)
+        {
+            return NULL;
+        }
+        if (self->lease == NULL)
+        {
+            Py_INCREF(result);
+        }
+        method = PyObject_GetAttrString(result, "__dlpack__");
+        Py_DECREF(result);
+        if (method == NULL)
+        {
+            return NULL;
+        }
+        result = PyObject_Call(method, args, kwds);
+        Py_DECREF(method);
+        return result;
+    }
+
+    export = (FrameExport *)calloc(1, sizeof(FrameExport));
+    if (export == NULL)
+    {
+        return PyErr_NoMemory();
+    }
+    Py_INCREF(self->lease);
+    export->lease = self->lease;
+
+    tensor = major >= 1 ? &export->versioned.dl_tensor : &export->legacy.dl_tensor;
+    tensor->data = PyArray_DATA((PyArrayObject *)self->image);
+    tensor->device.device_type = DL_CPU;
+    tensor->device.device_id = 0;
+    tensor->ndim = PyArray_NDIM((PyArrayObject *)self->image);
+    tensor->dtype.code = DL_UINT;
+    tensor->dtype.bits = 8;
+    tensor->dtype.lanes = 1;
+    for (i = 0; i < tensor->ndim; i++)
+    {
+        /* Strides count elements, which are single bytes */
+        export->shape[i] = PyArray_DIM((PyArrayObject *)self->image, i);
+        export->strides[i] = PyArray_STRIDE((PyArrayObject *)self->image, i);
+    }
+    tensor->shape = export->shape;
+    tensor->strides = export->strides;
+    tensor->byte_offset = 0;
+
+    if (major >= 1)
+    {
+        export->versioned.version.major = DLPACK_MAJOR_VERSION;
+        export->versioned.version.minor = DLPACK_MINOR_VERSION;
+        export->versioned.manager_ctx = export;
+        export->versioned.deleter = frame_export_deleter_versioned;
+        capsule = PyCapsule_New(&export->versioned, "dltensor_versioned", frame_export_capsule_destructor);
+    }
+    else
+    {
+        export->legacy.manager_ctx = export;
+        export->legacy.deleter = frame_export_deleter;
+        capsule = PyCapsule_New(&export->legacy, "dltensor", frame_export_capsule_destructor);
+    }
+    if (capsule == NULL)
+    {
+        Py_DECREF(export->lease);
+        free(export);
+        return NULL;
+    }
+    return capsule;
+}
+
+static PyObject * frame_dlpack_device(Frame * self)
+{
+    return Py_BuildValue("(ii)", DL_CPU, 0);
+}
+
+/**
+  * Pickles the frame as its array, info and sequence. With protocol 5 the
+  * array hands its buffer out of band, so a pickler with a buffer_callback
+  * sends the pixels without copying them into the pickle.
+  */
+static PyObject * frame_reduce_ex(Frame * self, PyObject * args)
+{
+    PyObject * info;
+    PyObject * result;
+    int protocol = 0;
+
+    if (!PyArg_ParseTuple(args, "|i", &protocol))
+    {
+        return NULL;
+    }
+    info = frame_get_info(self, NULL);
+    if (info == NULL)
+    {
+        return NULL;
+    }
+    result = Py_BuildValue("(O(OOK))", (PyObject *)Py_TYPE(self), self->image, info, self->sequence);
+    Py_DECREF(info);
+    return result;
+}
+
+static Py_ssize_t frame_length(Frame * self)
+{
+    return 2;
+}
+
+/**
+  * frame[0] is the image and frame[1] the info, so that
+  *     image, info = camera.get_image()
+  * keeps working
+  */
+static PyObject * frame_item(Frame * self, Py_ssize_t index)
+{
+    switch (index)
+    {
+        case 0:
+            return frame_get_image(self, NULL);
+        case 1:
+            return frame_get_info(self, NULL);
+        default:
+            PyErr_SetString(PyExc_IndexError, "Frame index out of range");
+            return NULL;
+    }
+}
+
+/**
+  * Declaration of all the publicly accessible functions of the Frame Object
+  */
+PyMethodDef frame_methods[] = {
+    {"__dlpack__", (PyCFunction)frame_dlpack, METH_VARARGS | METH_KEYWORDS,
+     "Export the image through DLPack without copying, the buffer stays locked until the consumer frees it"
+    },
+    {"__dlpack_device__", (PyCFunction)frame_dlpack_device, METH_NOARGS,
+     "Device the image lives on, always the CPU"
+    },
+    {"__reduce_ex__", (PyCFunction)frame_reduce_ex, METH_VARARGS,
+     "Pickle support, protocol 5 passes the image out of band"
+    },
+    {NULL} /* Sentinel */
+};
+
+/**
+  * Declaration of all the publicly accessible properties of the Frame Object
+  */
+PyGetSetDef frame_properties[] = {
+    {"image", (getter)frame_get_image, NULL, "The frame as an ndarray sharing the SDK buffer", NULL},
+    {"info", (getter)frame_get_info, NULL, "Dictionary with the frame's metadata, built on first access", NULL},
+    {"sequence", (getter)frame_get_sequence, NULL, "Number of the frame in the capture run", NULL},
+    {NULL} /* Sentinel */
+};
+
+static PyType_Slot frame_slots[] = {
+    {Py_tp_dealloc, (void *)frame_dealloc},
+    {Py_tp_doc, (void *)"Frame returned by Camera.get_image, unpacks as (image, info)"},
+    {Py_tp_methods, frame_methods},
+    {Py_tp_getset, frame_properties},
+    {Py_tp_new, (void *)frame_new},
+    {Py_sq_length, (void *)frame_length},
+    {Py_sq_item, (void *)frame_item},
+    {0, NULL} /* Sentinel */
+};
+
+PyType_Spec ids_FrameSpec = {
+    "ids.Frame",               /* name */
+    sizeof(Frame),             /* basicsize */
+    0,                         /* itemsize */
+    IDS_TPFLAGS,               /* flags */
+    frame_slots,               /* slots */
+};
@@ -0,0 +1,566 @@
+#include <uEye.h>
+#include "ids.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#define PY_ARRAY_UNIQUE_SYMBOL ids_ARRAY_API
+#define NO_IMPORT_ARRAY
+#include <numpy/arrayobject.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/* Iterations summed in 32 bit lanes before the AVX2 kernels spill to 64 bit */
+#define MOMENTS_FLUSH_BLOCKS   4096
+#define LAPLACIAN_FLUSH_BLOCKS 1024
+
+/*
+ * Running sums of one statistics pass
+ */
+typedef struct
+{
+    uint32_t  min;
+    uint32_t  max;
+    uint64_t  count;
+    uint64_t  sum;
+    uint64_t  sum_squares;
+    uint64_t  saturated;
+    uint64_t  laplacian_count;
+    int64_t   laplacian_sum;
+    uint64_t  laplacian_squares;
+} Moments;
+
+#if defined(__AVX2__)
+static int popcount32(uint32_t value)
+{
+#ifdef _MSC_VER
+    return (int)__popcnt(value);
+#else
+    return __builtin_popcount(value);
+#endif
+}
+
+/**
+  * Min, max, sums and saturation count of a contiguous run of 8 bit samples,
+  * 32 samples per iteration
+  * @return Number of samples consumed, the caller handles the tail
+  */
+static int row_moments_u8_avx2(const uint8_t * row, int n, uint8_t saturation, Moments * m)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i threshold = _mm256_set1_epi8((char)saturation);
+    __m256i low = _mm256_set1_epi8((char)0xff);
+    __m256i high = zero;
+    __m256i sum = zero;
+    __m256i squares = zero;
+    __m256i x;
+    __m256i wide;
+    uint8_t lanes[32];
+    uint64_t sums[4];
+    uint32_t square_lanes[8];
+    int blocks = 0;
+    int i;
+    int k;
+
+    for (i = 0; i + 32 <= n; i += 32)
+    {
+        x = _mm256_loadu_si256((const __m256i *)(row + i));
+        low = _mm256_min_epu8(low, x);
+        high = _mm256_max_epu8(high, x);
+        sum = _mm256_add_epi64(sum, _mm256_sad_epu8(x, zero));
+        wide = _mm256_unpacklo_epi8(x, zero);
+        squares = _mm256_add_epi32(squares, _mm256_madd_epi16(wide, wide));
+        wide = _mm256_unpackhi_epi8(x, zero);
+        squares = _mm256_add_epi32(squares, _mm256_madd_epi16(wide, wide));
+        m->saturated += popcount32((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(x, threshold), x)));
+
+        /* A lane gains at most 4 * 255^2 per iteration, spill before it can wrap */
+        if (++blocks == MOMENTS_FLUSH_BLOCKS)
+        {
+            _mm256_storeu_si256((__m256i *)square_lanes, squares);
+            for (k = 0; k < 8; k++)
+            {
+                m->sum_squares += square_lanes[k];
+            }
+            squares = zero;
+            blocks = 0;
+        }
+    }
+    if (i == 0)
+    {
+        return 0;
+    }
+
+    _mm256_storeu_si256((__m256i *)lanes, low);
+    for (k = 0; k < 32; k++)
+    {
+        m->min = lanes[k] < m->min ? lanes[k] : m->min;
+    }
+    _mm256_storeu_si256((__m256i *)lanes, high);
+    for (k = 0; k < 32; k++)
+    {
+        m->max = lanes[k] > m->max ? lanes[k] : m->max;
+    }
+    _mm256_storeu_si256((__m256i *)sums, sum);
+    m->sum += sums[0] + sums[1] + sums[2] + sums[3];
+    _mm256_storeu_si256((__m256i *)square_lanes, squares);
+    for (k = 0; k < 8; k++)
+    {
+        m->sum_squares += square_lanes[k];
+    }
+    m->count += i;
+    return i;
+}
+
+/**
+  * Sums of the 4-neighbour Laplacian over a contiguous run of 8 bit samples,
+  * 16 samples per iteration
+  * @arg step Distance to the left and right neighbour in samples
+  * @return Number of samples consumed, the caller handles the tail
+  */
+static int row_laplacian_u8_avx2(const uint8_t * up, const uint8_t * mid, const uint8_t * down, int n, int step, Moments * m)
+{
+    __m256i ones = _mm256_set1_epi16(1);
+    __m256i sum = _mm256_setzero_si256();
+    __m256i squares = _mm256_setzero_si256();
+    __m256i lap;
+    int32_t sum_lanes[8];
+    uint32_t square_lanes[8];
+    int blocks = 0;
+    int i;
+    int k;
+
+    for (i = 0; i + 16 <= n; i += 16)
+    {
+        lap = _mm256_slli_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(mid + i))), 2);
+        lap = _mm256_sub_epi16(lap, _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(mid + i - step))));
+        lap = _mm256_sub_epi16(lap, _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(mid + i + step))));
+        lap = _mm256_sub_epi16(lap, _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(up + i))));
+        lap = _mm256_sub_epi16(lap, _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(down + i))));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(lap, ones));
+        squares = _mm256_add_epi32(squares, _mm256_madd_epi16(lap, lap));
+
+        if (++blocks == LAPLACIAN_FLUSH_BLOCKS || i + 32 > n)
+        {
+            _mm256_storeu_si256((__m256i *)sum_lanes, sum);
+            _mm256_storeu_si256((__m256i *)square_lanes, squares);
+            for (k = 0; k < 8; k++)
+            {
+                m->laplacian_sum += sum_lanes[k];
+                m->laplacian_squares += square_lanes[k];
+            }
+            sum = _mm256_setzero_si256();
+            squares = _mm256_setzero_si256();
+            blocks = 0;
+        }
+    }
+    m->laplacian_count += i;
+    return i;
+}
+#endif
+
+static void sample_moments(uint32_t value, uint32_t saturation, Moments * m)
+{
+    m->min = value < m->min ? value : m->min;
+    m->max = value > m->max ? value : m->max;
+    m->sum += value;
+    m->sum_squares += (uint64_t)value * value;
+    m->saturated += value >= saturation;
+    m->count++;
+}
+
+#define SAMPLE(row, i) (wide ? (uint32_t)((const uint16_t *)(row))[i] : (uint32_t)((const uint8_t *)(row))[i])
+
+/*
+ * Scalar pass over one row of the sampling grid. The sums are kept in locals
+ * so the compiler does not reload them after every histogram store.
+ */
+static void grid_moments(const char * row, int wide, int width, int channels, int subsample, uint32_t saturation, int shift, int bins, uint32_t * histogram, Moments * m)
+{
+    uint32_t low = m->min;
+    uint32_t high = m->max;
+    uint64_t sum = 0;
+    uint64_t squares = 0;
+    uint64_t saturated = 0;
+    uint64_t count = 0;
+    uint32_t value;
+    int x, c;
+
+    for (x = 0; x < width; x += subsample)
+    {
+        for (c = 0; c < channels; c++)
+        {
+            value = SAMPLE(row, x * channels + c);
+            low = value < low ? value : low;
+            high = value > high ? value : high;
+            sum += value;
+            squares += (uint64_t)value * value;
+            saturated += value >= saturation;
+            value >>= shift;
+            histogram[value < (uint32_t)bins ? value : (uint32_t)bins - 1]++;
+        }
+        count += channels;
+    }
+    m->min = low;
+    m->max = high;
+    m->sum += sum;
+    m->sum_squares += squares;
+    m->saturated += saturated;
+    m->count += count;
+}
+
+/*
+ * 4-neighbour Laplacian over the interior of one row of the sampling grid,
+ * leaving out the first skip interior samples already summed by a SIMD kernel
+ */
+static void grid_laplacian(const char * up, const char * row, const char * down, int wide, int width, int channels, int subsample, int skip, Moments * m)
+{
+    int step = subsample * channels;
+    int start = (channels + skip) / channels;
+    int64_t sum = 0;
+    uint64_t squares = 0;
+    uint64_t count = 0;
+    int64_t lap;
+    int x, c, i;
+
+    for (x = start > subsample ? start : subsample; x + subsample < width; x += subsample)
+    {
+        for (c = 0; c < channels; c++)
+        {
+            i = x * channels + c;
+            if (i < channels + skip)
+            {
+                continue;
+            }
+            lap = 4 * (int64_t)SAMPLE(row, i) - SAMPLE(row, i - step) - SAMPLE(row, i + step) - SAMPLE(up, i) - SAMPLE(down, i);
+            sum += lap;
+            squares += (uint64_t)(lap * lap);
+            count++;
+        }
+    }
+    m->laplacian_sum += sum;
+    m->laplacian_squares += squares;
+    m->laplacian_count += count;
+}
+
+/**
+  * Computes histogram, moments, saturation count and Laplacian variance of
+  * an image on a grid of every subsample-th pixel of every subsample-th row.
+  * The Laplacian is taken on that grid, so its variance is comparable between
+  * frames of one subsampling only. Does not need the GIL.
+  * @arg pitch Bytes between the starts of two rows
+  * @arg channels Interleaved samples per pixel, each is counted separately
+  * @arg bits Significant bits per sample, more than 8 means 16 bit samples
+  * @arg saturation Samples at or above this value count as saturated
+  * @arg bins 256 or 4096 histogram bins spread over the range of bits
+  */
+void frame_stats_compute(FrameStats * stats, const char * data, int width, int height, int pitch, int channels, int bits, int subsample, uint32_t saturation, int bins)
+{
+    Moments m;
+    int wide = bits > 8;
+    int bin_bits = bins == 4096 ? 12 : 8;
+    int shift = bits > bin_bits ? bits - bin_bits : 0;
+    int samples = width * channels;
+    uint32_t partial[4][256];
+    const char * row;
+    const char * up;
+    const char * down;
+    double mean;
+    double laplacian_mean;
+    double variance;
+    int done;
+    int y, i;
+
+    memset(&m, 0, sizeof(m));
+    m.min = UINT32_MAX;
+    memset(stats->histogram, 0, bins * sizeof(uint32_t));
+    memset(partial, 0, sizeof(partial));
+
+    for (y = 0; y < height; y += subsample)
+    {
+        row = data + (size_t)y * pitch;
+        if (!wide && subsample == 1)
+        {
+            done = 0;
+#if defined(__AVX2__)
+            done = row_moments_u8_avx2((const uint8_t *)row, samples, (uint8_t)(saturation > 255 ? 255 : saturation), &m);
+#endif
+            for (i = done; i < samples; i++)
+            {
+                sample_moments(((const uint8_t *)row)[i], saturation, &m);
+            }
+            /* Four interleaved tables keep repeated values from stalling on one counter */
+            for (i = 0; i + 4 <= samples; i += 4)
+            {
+                partial[0][((const uint8_t *)row)[i]]++;
+                partial[1][((const uint8_t *)row)[i + 1]]++;
+                partial[2][((const uint8_t *)row)[i + 2]]++;
+                partial[3][((const uint8_t *)row)[i + 3]]++;
+            }
+            for (; i < samples; i++)
+            {
+                partial[0][((const uint8_t *)row)[i]]++;
+            }
+        }
+        else
+        {
+            grid_moments(row, wide, width, channels, subsample, saturation, shift, bins, stats->histogram, &m);
+        }
+
+        if (y < subsample || y + subsample >= height)
+        {
+            continue;
+        }
+        up = row - (size_t)subsample * pitch;
+        down = row + (size_t)subsample * pitch;
+        done = 0;
+#if defined(__AVX2__)
+        if (!wide && subsample == 1 && samples > 2 * channels)
+        {
+            done = row_laplacian_u8_avx2((const uint8_t *)up + channels, (const uint8_t *)row + channels, (const uint8_t *)down + channels, samples - 2 * channels, channels, &m);
+        }
+#endif
+        grid_laplacian(up, row, down, wide, width, channels, subsample, done, &m);
+    }
+
+    if (!wide && subsample == 1)
+    {
+        for (i = 0; i < 256; i++)
+        {
+            stats->histogram[i] = partial[0][i] + partial[1][i] + partial[2][i] + partial[3][i];
+        }
+    }
+
+    mean = m.count ? (double)m.sum / m.count : 0.0;
+    laplacian_mean = m.laplacian_count ? (double)m.laplacian_sum / m.laplacian_count : 0.0;
+    stats->bins = bins;
+    stats->bits = bits;
+    stats->subsample = subsample;
+    stats->count = m.count;
+    stats->min = m.count ? m.min : 0;
+    stats->max = m.max;
+    stats->mean = mean;
+    variance = m.count ? (double)m.sum_squares / m.count - mean * mean : 0.0;
+    stats->std = variance > 0.0 ? sqrt(variance) : 0.0;
+    stats->saturated = m.saturated;
+    variance = m.laplacian_count ? (double)m.laplacian_squares / m.laplacian_count - laplacian_mean * laplacian_mean : 0.0;
+    stats->sharpness = variance > 0.0 ? variance : 0.0;
+    stats->valid = 1;
+}
+
+#undef SAMPLE
+
+/**
+  * Sample layout of the frames in a ring
+  */
+static void ring_sample_format(FrameRing * ring, int * channels, int * bits)
+{
+    *channels = 1;
+    switch (ring->color)
+    {
+        case IS_CM_MONO10:
+            *bits = 10;
+            break;
+        case IS_CM_MONO12:
+            *bits = 12;
+            break;
+        case IS_CM_MONO16:
+            *bits = 16;
+            break;
+        default:
+            *bits = 8;
+            *channels = ring->bitdepth / 8 > 0 ? ring->bitdepth / 8 : 1;
+            break;
+    }
+}
+
+/**
+  * Computes the statistics of a frame on the capture thread when
+  * Camera.auto_stats is set. The stats stay with the slot until it is
+  * dequeued again.
+  */
+void frame_stats_on_capture(Camera * self, FrameSlot * slot)
+{
+    FrameRing * ring = slot->ring;
+    int subsample = self->capture.stats_subsample;
+    int width = slot->info.dwImageWidth ? (int)slot->info.dwImageWidth : ring->width;
+    int height = slot->info.dwImageHeight ? (int)slot->info.dwImageHeight : ring->height;
+    int channels;
+    int bits;
+
+    if (subsample <= 0)
+    {
+        if (slot->frame_stats != NULL)
+        {
+            slot->frame_stats->valid = 0;
+        }
+        return;
+    }
+    if (slot->frame_stats == NULL)
+    {
+        slot->frame_stats = (FrameStats *)malloc(sizeof(FrameStats));
+        if (slot->frame_stats == NULL)
+        {
+            return;
+        }
+    }
+
+    ring_sample_format(ring, &channels, &bits);
+    frame_stats_compute(slot->frame_stats, slot->pBuffer, width, height, ring->pitch, channels, bits, subsample,
+            (1u << bits) - 1, bits > 8 ? 4096 : 256);
+}
+
+/**
+  * Converts frame statistics to the dictionary handed to Python
+  */
+PyObject * frame_stats_as_dict(const FrameStats * stats)
+{
+    PyObject * histogram;
+    PyObject * dict;
+    npy_intp bins = stats->bins;
+
+    histogram = PyArray_SimpleNew(1, &bins, NPY_UINT32);
+    if (histogram == NULL)
+    {
+        return NULL;
+    }
+    memcpy(PyArray_DATA((PyArrayObject *)histogram), stats->histogram, bins * sizeof(uint32_t));
+
+    dict = Py_BuildValue("{s:K,s:I,s:I,s:d,s:d,s:K,s:d,s:d,s:i,s:i,s:O}",
+            "count", (unsigned PY_LONG_LONG)stats->count,
+            "min", stats->min,
+            "max", stats->max,
+            "mean", stats->mean,
+            "std", stats->std,
+            "saturated", (unsigned PY_LONG_LONG)stats->saturated,
+            "saturated_fraction", stats->count ? (double)stats->saturated / stats->count : 0.0,
+            "sharpness", stats->sharpness,
+            "subsample", stats->subsample,
+            "bits", stats->bits,
+            "histogram", histogram);
+    Py_DECREF(histogram);
+    return dict;
+}
+
+/**
+  * Computes histogram, min/max/mean/std, saturated pixel count and the
+  * Laplacian variance (sharpness) of a uint8 or uint16 image
+  * This means the definition of the function is:
+  *     def frame_stats(image, bits=None, bins=None, saturation=None, subsample=1)
+  */
+PyObject * ids_frame_stats(PyObject * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"image", "bits", "bins", "saturation", "subsample", NULL};
+    PyObject * image_obj;
+    PyObject * bits_obj = Py_None;
+    PyObject * bins_obj = Py_None;
+    PyObject * saturation_obj = Py_None;
+    PyArrayObject * image;
+    PyArrayObject * contiguous;
+    FrameStats * stats;
+    PyObject * result;
+    int bits = 0;
+    int bins = 0;
+    int subsample = 1;
+    int channels;
+    int wide;
+    uint32_t saturation;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|OOOi", kwlist, &image_obj, &bits_obj, &bins_obj, &saturation_obj, &subsample))
+    {
+        return NULL;
+    }
+    if ((bits_obj != Py_None && (bits = (int)PyLong_AsLong(bits_obj)) == -1 && PyErr_Occurred())
+            || (bins_obj != Py_None && (bins = (int)PyLong_AsLong(bins_obj)) == -1 && PyErr_Occurred()))
+    {
+        return NULL;
+    }
+
+    image = (PyArrayObject *)PyArray_FROMANY(image_obj, NPY_NOTYPE, 2, 3, 0);
+    if (image == NULL)
+    {
+        return NULL;
+    }
+    if (PyArray_TYPE(image) != NPY_UINT8 && PyArray_TYPE(image) != NPY_UINT16)
+    {
+        Py_DECREF(image);
+        PyErr_SetString(PyExc_TypeError, "frame_stats expects a uint8 or uint16 image");
+        return NULL;
+    }
+
+    /* Rows may be padded, but the samples within a row must be contiguous */
+    wide = PyArray_TYPE(image) == NPY_UINT16;
+    channels = PyArray_NDIM(image) == 3 ? (int)PyArray_DIM(image, 2) : 1;
+    if (PyArray_STRIDE(image, 1) != channels * PyArray_ITEMSIZE(image)
+            || (PyArray_NDIM(image) == 3 && PyArray_STRIDE(image, 2) != PyArray_ITEMSIZE(image)))
+    {
+        contiguous = (PyArrayObject *)PyArray_FROMANY((PyObject *)image, PyArray_TYPE(image), 2, 3, NPY_ARRAY_CARRAY);
+        Py_DECREF(image);
+        if (contiguous == NULL)
+        {
+            return NULL;
+        }
+        image = contiguous;
+    }
+
+    if (bits == 0)
+    {
+        bits = wide ? 16 : 8;
+    }
+    if (wide ? (bits <= 8 || bits > 16) : (bits < 1 || bits > 8))
+    {
+        Py_DECREF(image);
+        PyErr_SetString(PyExc_ValueError, "bits must be 1 to 8 for uint8 and 9 to 16 for uint16 images");
+        return NULL;
+    }
+    if (bins == 0)
+    {
+        bins = bits > 8 ? 4096 : 256;
+    }
+    if (bins != 256 && bins != 4096)
+    {
+        Py_DECREF(image);
+        PyErr_SetString(PyExc_ValueError, "bins must be 256 or 4096");
+        return NULL;
+    }
+    if (subsample < 1)
+    {
+        Py_DECREF(image);
+        PyErr_SetString(PyExc_ValueError, "subsample must be at least 1");
+        return NULL;
+    }
+    saturation = (1u << bits) - 1;
+    if (saturation_obj != Py_None)
+    {
+        saturation = (uint32_t)PyLong_AsUnsignedLongMask(saturation_obj);
+        if (PyErr_Occurred())
+        {
+            Py_DECREF(image);
+            return NULL;
+        }
+        if (saturation > (wide ? 65535u : 255u))
+        {
+            Py_DECREF(image);
+            PyErr_SetString(PyExc_ValueError, "saturation is out of range for the image dtype");
+            return NULL;
+        }
+    }
+
+    stats = (FrameStats *)malloc(sizeof(FrameStats));
+    if (stats == NULL)
+    {
+        Py_DECREF(image);
+        return PyErr_NoMemory();
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    frame_stats_compute(stats, PyArray_BYTES(image), (int)PyArray_DIM(image, 1), (int)PyArray_DIM(image, 0),
+            (int)PyArray_STRIDE(image, 0), channels, bits, subsample, saturation, bins);
+    Py_END_ALLOW_THREADS
+
+    result = frame_stats_as_dict(stats);
+    free(stats);
+    Py_DECREF(image);
+    return result;
+}
@@ -0,0 +1,232 @@
+#include <uEye.h>
+#include "ids.h"
+#include <stdlib.h>
+#define PY_ARRAY_UNIQUE_SYMBOL ids_ARRAY_API
+#define NO_IMPORT_ARRAY
+#include <numpy/arrayobject.h>
+
+/* Largest bracket hdr_merge accepts */
+#define HDR_MAX_FRAMES 32
+
+/**
+  * Radiance estimate of a single sample, used where every frame of the
+  * bracket is clipped: dark pixels trust the longest exposure, bright
+  * pixels the shortest
+  */
+static float hdr_fallback(const void ** data, int wide, npy_intp p, int shortest, int longest, const float * inv_exposure, int max_value)
+{
+    int z = wide ? ((const uint16_t *)data[shortest])[p] : ((const uint8_t *)data[shortest])[p];
+
+    if (z >= max_value / 2)
+    {
+        return z * inv_exposure[shortest];
+    }
+    z = wide ? ((const uint16_t *)data[longest])[p] : ((const uint8_t *)data[longest])[p];
+    return z * inv_exposure[longest];
+}
+
+/**
+  * Weighted average of z / exposure over the bracket with a hat weight that
+  * discounts samples near black and near saturation, assuming a linear
+  * sensor response. Runs without the GIL.
+  */
+static void hdr_merge_kernel(const void ** data, int wide, int count, npy_intp pixels, const float * inv_exposure, const float * weights, int max_value, float * out, float * weight_sum)
+{
+    const uint8_t * narrow_frame;
+    const uint16_t * wide_frame;
+    float scale;
+    float w;
+    int shortest = 0;
+    int longest = 0;
+    int z;
+    int i;
+    npy_intp p;
+
+    for (i = 1; i < count; i++)
+    {
+        if (inv_exposure[i] > inv_exposure[shortest])
+        {
+            shortest = i;
+        }
+        if (inv_exposure[i] < inv_exposure[longest])
+        {
+            longest = i;
+        }
+    }
+
+    for (p = 0; p < pixels; p++)
+    {
+        out[p] = 0.0f;
+        weight_sum[p] = 0.0f;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        scale = inv_exposure[i];
+        if (wide)
+        {
+            wide_frame = (const uint16_t *)data[i];
+            for (p = 0; p < pixels; p++)
+            {
+                z = wide_frame[p];
+                w = weights[z];
+                out[p] += w * z * scale;
+                weight_sum[p] += w;
+            }
+        }
+        else
+        {
+            narrow_frame = (const uint8_t *)data[i];
+            for (p = 0; p < pixels; p++)
+            {
+                z = narrow_frame[p];
+                w = weights[z];
+                out[p] += w * z * scale;
+                weight_sum[p] += w;
+            }
+        }
+    }
+
+    for (p = 0; p < pixels; p++)
+    {
+        if (weight_sum[p] > 0.0f)
+        {
+            out[p] /= weight_sum[p];
+        }
+        else
+        {
+            out[p] = hdr_fallback(data, wide, p, shortest, longest, inv_exposure, max_value);
+        }
+    }
+}
+
+/**
+  * Fuses an exposure bracket into a float32 radiance image
+  * def hdr_merge(frames, exposures, max_value=None)
+  * @arg frames uint8 or uint16 arrays of identical shape, for example the
+  *      frames of one Camera.bracket() cycle
+  * @arg exposures Exposure time of each frame in ms
+  * @arg max_value Saturation level, defaults to the full range of the dtype
+  * @return Radiance in digital numbers per ms of exposure
+  */
+PyObject * ids_hdr_merge(PyObject * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"frames", "exposures", "max_value", NULL};
+    PyObject * frames;
+    PyObject * exposures;
+    PyObject * frame_seq = NULL;
+    PyObject * exposure_seq = NULL;
+    PyArrayObject * arrays[HDR_MAX_FRAMES] = {NULL};
+    const void * data[HDR_MAX_FRAMES];
+    float inv_exposure[HDR_MAX_FRAMES];
+    PyArrayObject * out = NULL;
+    float * weights = NULL;
+    float * weight_sum = NULL;
+    double exposure;
+    npy_intp pixels;
+    int max_value = -1;
+    int type_num = 0;
+    int wide;
+    int levels;
+    int count = 0;
+    int converted = 0;
+    int i;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|i", kwlist, &frames, &exposures, &max_value))
+    {
+        return NULL;
+    }
+
+    frame_seq = PySequence_Fast(frames, "frames must be a sequence of arrays");
+    if (frame_seq == NULL)
+    {
+        return NULL;
+    }
+    exposure_seq = PySequence_Fast(exposures, "exposures must be a sequence");
+    if (exposure_seq == NULL)
+    {
+        goto done;
+    }
+    count = (int)PySequence_Fast_GET_SIZE(frame_seq);
+    if (count == 0 || count > HDR_MAX_FRAMES || PySequence_Fast_GET_SIZE(exposure_seq) != count)
+    {
+        PyErr_Format(PyExc_ValueError, "Between 1 and %d frames with one exposure each are required", HDR_MAX_FRAMES);
+        goto done;
+    }
+
+    for (converted = 0; converted < count; converted++)
+    {
+        arrays[converted] = (PyArrayObject *)PyArray_FROM_OF(PySequence_Fast_GET_ITEM(frame_seq, converted), NPY_ARRAY_IN_ARRAY);
+        if (arrays[converted] == NULL)
+        {
+            goto done;
+        }
+        if (converted == 0)
+        {
+            type_num = PyArray_TYPE(arrays[0]);
+        }
+        if ((type_num != NPY_UINT8 && type_num != NPY_UINT16) ||
+            PyArray_TYPE(arrays[converted]) != type_num ||
+            !PyArray_SAMESHAPE(arrays[converted], arrays[0]))
+        {
+            converted++;
+            PyErr_SetString(PyExc_ValueError, "frames must be uint8 or uint16 arrays of the same dtype and shape");
+            goto done;
+        }
+        data[converted] = PyArray_DATA(arrays[converted]);
+
+        exposure = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(exposure_seq, converted));
+        if (exposure <= 0.0)
+        {
+            converted++;
+            if (!PyErr_Occurred())
+            {
+                PyErr_SetString(PyExc_ValueError, "exposures must be positive");
+            }
+            goto done;
+        }
+        inv_exposure[converted] = (float)(1.0 / exposure);
+    }
+
+    wide = type_num == NPY_UINT16;
+    levels = wide ? 65536 : 256;
+    if (max_value <= 0 || max_value >= levels)
+    {
+        max_value = levels - 1;
+    }
+
+    out = (PyArrayObject *)PyArray_SimpleNew(PyArray_NDIM(arrays[0]), PyArray_DIMS(arrays[0]), NPY_FLOAT32);
+    pixels = PyArray_SIZE(arrays[0]);
+    weights = (float *)malloc(levels * sizeof(float));
+    weight_sum = (float *)malloc((pixels > 0 ? pixels : 1) * sizeof(float));
+    if (out == NULL || weights == NULL || weight_sum == NULL)
+    {
+        Py_CLEAR(out);
+        if (!PyErr_Occurred())
+        {
+            PyErr_NoMemory();
+        }
+        goto done;
+    }
+
+    /* Hat weight peaking at mid range, zero at black and from saturation up */
+    for (i = 0; i < levels; i++)
+    {
+        weights[i] = i >= max_value ? 0.0f : (float)(i <= max_value / 2 ? i : max_value - i) / (max_value / 2.0f);
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    hdr_merge_kernel(data, wide, count, pixels, inv_exposure, weights, max_value, (float *)PyArray_DATA(out), weight_sum);
+    Py_END_ALLOW_THREADS
+
+done:
+    for (i = 0; i < converted; i++)
+    {
+        Py_XDECREF(arrays[i]);
+    }
+    free(weights);
+    free(weight_sum);
+    Py_XDECREF(exposure_seq);
+    Py_DECREF(frame_seq);
+    return (PyObject *)out;
+}
@@ -0,0 +1,475 @@
+#include "ids_socket.h"
+#include <uEye.h>
+#include "ids.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Prometheus text exposition endpoint. The scrape path runs entirely on a
+ * native thread: it reads the lock-free counters of every open Camera from
+ * a registry guarded by a plain mutex and never touches the GIL.
+ */
+
+#define METRICS_INITIAL_CAMERAS 8
+#define METRICS_REQUEST_SIZE 4096
+#define METRICS_POLL_TIMEOUT 200
+
+/* Open cameras in the order they were opened, grown as needed */
+static ids_mutex_t registry_lock;
+static Camera ** registry;
+static int registry_count;
+static int registry_capacity;
+
+/*
+ * Struct that defines the MetricsServer class
+ */
+typedef struct
+{
+    PyObject_HEAD
+    ids_socket_t     listener;
+    int              port;
+    ids_thread_t     thread;
+    volatile int     running;
+} MetricsServer;
+
+/*
+ * Growable text buffer the exposition is rendered into
+ */
+typedef struct
+{
+    char *           data;
+    size_t           length;
+    size_t           capacity;
+} MetricsBuffer;
+
+void metrics_init(void)
+{
+    ids_mutex_init(&registry_lock);
+}
+
+/**
+  * Makes an initialized camera visible to the metrics endpoint
+  * @return 0 on success, -1 if the registry could not grow
+  */
+int metrics_register_camera(Camera * camera)
+{
+    Camera ** grown;
+    int capacity;
+    int result = 0;
+
+    ids_mutex_lock(&registry_lock);
+    if (registry_count == registry_capacity)
+    {
+        capacity = registry_capacity > 0 ? registry_capacity * 2 : METRICS_INITIAL_CAMERAS;
+        grown = (Camera **)realloc(registry, capacity * sizeof(Camera *));
+        if (grown != NULL)
+        {
+            registry = grown;
+            registry_capacity = capacity;
+        }
+    }
+    if (registry_count < registry_capacity)
+    {
+        registry[registry_count++] = camera;
+    }
+    else
+    {
+        result = -1;
+    }
+    ids_mutex_unlock(&registry_lock);
+    return result;
+}
+
+/**
+  * Removes a camera from the registry. Once this returns no scrape is
+  * reading from it anymore.
+  */
+void metrics_unregister_camera(Camera * camera)
+{
+    int i;
+
+    ids_mutex_lock(&registry_lock);
+    for (i = 0; i < registry_count; i++)
+    {
+        if (registry[i] == camera)
+        {
+            memmove(registry + i, registry + i + 1, (registry_count - i - 1) * sizeof(Camera *));
+            registry_count--;
+            break;
+        }
+    }
+    ids_mutex_unlock(&registry_lock);
+}
+
+static void metrics_printf(MetricsBuffer * buffer, const char * format, ...)
+{
+    va_list args;
+    int needed;
+    char * grown;
+
+    for (;;)
+    {
+        va_start(args, format);
+        needed = vsnprintf(buffer->data + buffer->length, buffer->capacity - buffer->length, format, args);
+        va_end(args);
+
+        if (needed >= 0 && buffer->length + needed < buffer->capacity)
+        {
+            buffer->length += needed;
+            return;
+        }
+
+        grown = (char *)realloc(buffer->data, buffer->capacity * 2);
+        if (grown == NULL)
+        {
+            return;
+        }
+        buffer->data = grown;
+        buffer->capacity *= 2;
+    }
+}
+
+/**
+  * Decodes the temperature word reported by is_DeviceFeature:
+  * bit 15 is the sign, bits 10..4 the integer part and bits 3..0 tenths
+  */
+static double decode_temperature(WORD raw)
+{
+    double celsius = ((raw >> 4) & 0x7F) + (raw & 0x0F) / 10.0;
+    return (raw & 0x8000) ? -celsius : celsius;
+}
+
+typedef int64_t (*counter_getter)(Camera * camera);
+
+static int64_t get_frames_captured(Camera * camera) { return ids_atomic_load64(&camera->stats.frames_captured); }
+static int64_t get_frames_delivered(Camera * camera) { return ids_atomic_load64(&camera->stats.frames_delivered); }
+static int64_t get_frames_dropped(Camera * camera) { return ids_atomic_load64(&camera->stats.frames_dropped); }
+static int64_t get_frames_missing(Camera * camera) { return ids_atomic_load64(&camera->stats.frames_missing); }
+static int64_t get_gap_events(Camera * camera) { return ids_atomic_load64(&camera->stats.gap_events); }
+static int64_t get_wait_errors(Camera * camera) { return ids_atomic_load64(&camera->stats.wait_errors); }
+static int64_t get_transfer_failures(Camera * camera) { return ids_atomic_load64(&camera->stats.transfer_failures); }
+static int64_t get_locked_buffers(Camera * camera) { return ids_atomic_load64(&camera->stats.locked_buffers); }
+static int64_t get_delivery_depth(Camera * camera) { return camera->capture.delivery_count; }
+static int64_t get_delivery_high_water(Camera * camera) { return ids_atomic_load64(&camera->stats.delivery_high_water); }
+static int64_t get_capture_running(Camera * camera) { return camera->capture.running; }
+static int64_t get_connected(Camera * camera) { return ids_atomic_load64(&camera->capture.disconnected_since_ns) == 0; }
+static int64_t get_disconnects(Camera * camera) { return ids_atomic_load64(&camera->stats.disconnects); }
+static int64_t get_reconnects(Camera * camera) { return ids_atomic_load64(&camera->stats.reconnects); }
+
+static const struct
+{
+    const char *     name;
+    const char *     type;
+    const char *     help;
+    counter_getter   getter;
+} camera_metrics[] = {
+    {"ids_frames_captured_total", "counter", "Frames dequeued from the SDK", get_frames_captured},
+    {"ids_frames_delivered_total", "counter", "Frames handed to Python", get_frames_delivered},
+    {"ids_frames_dropped_total", "counter", "Frames dropped because the consumer fell behind", get_frames_dropped},
+    {"ids_frames_missing_total", "counter", "Frames missing from the device frame counter sequence", get_frames_missing},
+    {"ids_frame_gap_events_total", "counter", "Occurrences of gaps in the device frame counter", get_gap_events},
+    {"ids_wait_errors_total", "counter", "Failed is_WaitForNextImage calls", get_wait_errors},
+    {"ids_transfer_failures_total", "counter", "Capture errors reported by is_CaptureStatus", get_transfer_failures},
+    {"ids_locked_buffers", "gauge", "Sequence buffers currently locked by consumers", get_locked_buffers},
+    {"ids_delivery_queue_depth", "gauge", "Frames waiting to be picked up by get_image", get_delivery_depth},
+    {"ids_delivery_queue_high_water", "gauge", "Highest delivery queue depth since the last reset", get_delivery_high_water},
+    {"ids_capture_running", "gauge", "Whether native capture is running", get_capture_running},
+    {"ids_connected", "gauge", "Whether the camera is attached, 0 while reconnecting", get_connected},
+    {"ids_disconnects_total", "counter", "Times the camera dropped off the bus during capture", get_disconnects},
+    {"ids_reconnects_total", "counter", "Times the camera was reopened after a disconnect", get_reconnects},
+};
+
+static const char * stage_labels[STAGE_COUNT] = {
+    "sdk_wait",
+    "buffer_to_dequeue",
+    "dequeue_to_delivery",
+    "delivery_to_release",
+};
+
+/**
+  * Renders the exposition for every registered camera. Holds the registry
+  * lock so cameras cannot be deallocated mid-scrape, which is why nothing
+  * in here calls into the SDK: a Camera being deallocated waits on this
+  * lock with the GIL held.
+  */
+static void metrics_render(MetricsBuffer * buffer)
+{
+    Camera * camera;
+    LatencyHistogram * histogram;
+    int64_t raw_temperature;
+    int64_t cumulative;
+    int64_t since;
+    int64_t downtime;
+    int metric;
+    int stage;
+    int bucket;
+    int i;
+
+    ids_mutex_lock(&registry_lock);
+
+    for (metric = 0; metric < (int)(sizeof(camera_metrics) / sizeof(camera_metrics[0])); metric++)
+    {
+        metrics_printf(buffer, "# HELP %s %s\n# TYPE %s %s\n", camera_metrics[metric].name, camera_metrics[metric].help, camera_metrics[metric].name, camera_metrics[metric].type);
+        for (i = 0; i < registry_count; i++)
+        {
+            camera = registry[i];
+            if (camera != NULL)
+            {
+                metrics_printf(buffer, "%s{camera=\"%s\"} %lld\n", camera_metrics[metric].name, camera->serial, (long long)camera_metrics[metric].getter(camera));
+            }
+        }
+    }
+
+    metrics_printf(buffer, "# HELP ids_frame_rate Frames per second measured over the last second\n# TYPE ids_frame_rate gauge\n");
+    for (i = 0; i < registry_count; i++)
+    {
+        camera = registry[i];
+        if (camera != NULL)
+        {
+            metrics_printf(buffer, "ids_frame_rate{camera=\"%s\"} %.3f\n", camera->serial, ids_atomic_load64(&camera->stats.measured_fps_milli) / 1000.0);
+        }
+    }
+
+    metrics_printf(buffer, "# HELP ids_downtime_seconds_total Time spent disconnected, including an ongoing outage\n# TYPE ids_downtime_seconds_total counter\n");
+    for (i = 0; i < registry_count; i++)
+    {
+        camera = registry[i];
+        if (camera != NULL)
+        {
+            since = ids_atomic_load64(&camera->capture.disconnected_since_ns);
+            downtime = ids_atomic_load64(&camera->stats.downtime_ns) + (since != 0 ? ids_monotonic_ns() - since : 0);
+            metrics_printf(buffer, "ids_downtime_seconds_total{camera=\"%s\"} %.3f\n", camera->serial, downtime / 1e9);
+        }
+    }
+
+    metrics_printf(buffer, "# HELP ids_temperature_celsius Device temperature polled by the capture thread, on cameras that report it\n# TYPE ids_temperature_celsius gauge\n");
+    for (i = 0; i < registry_count; i++)
+    {
+        camera = registry[i];
+        if (camera == NULL || !camera->capture.running)
+        {
+            continue;
+        }
+        raw_temperature = ids_atomic_load64(&camera->stats.temperature_raw);
+        if (raw_temperature >= 0)
+        {
+            metrics_printf(buffer, "ids_temperature_celsius{camera=\"%s\"} %.1f\n", camera->serial, decode_temperature((WORD)raw_temperature));
+        }
+    }
+
+    metrics_printf(buffer, "# HELP ids_stage_latency_seconds Latency of each acquisition pipeline stage\n# TYPE ids_stage_latency_seconds histogram\n");
+    for (i = 0; i < registry_count; i++)
+    {
+        camera = registry[i];
+        if (camera == NULL)
+        {
+            continue;
+        }
+        for (stage = 0; stage < STAGE_COUNT; stage++)
+        {
+            histogram = &camera->stats.latency[stage];
+            cumulative = 0;
+            for (bucket = 0; bucket < STATS_HISTOGRAM_BUCKETS - 1; bucket++)
+            {
+                cumulative += ids_atomic_load64(&histogram->buckets[bucket]);
+                metrics_printf(buffer, "ids_stage_latency_seconds_bucket{camera=\"%s\",stage=\"%s\",le=\"%g\"} %lld\n", camera->serial, stage_labels[stage], (double)(1LL << bucket) / 1e6, (long long)cumulative);
+            }
+            metrics_printf(buffer, "ids_stage_latency_seconds_bucket{camera=\"%s\",stage=\"%s\",le=\"+Inf\"} %lld\n", camera->serial, stage_labels[stage], (long long)ids_atomic_load64(&histogram->count));
+            metrics_printf(buffer, "ids_stage_latency_seconds_sum{camera=\"%s\",stage=\"%s\"} %.9f\n", camera->serial, stage_labels[stage], ids_atomic_load64(&histogram->total_ns) / 1e9);
+            metrics_printf(buffer, "ids_stage_latency_seconds_count{camera=\"%s\",stage=\"%s\"} %lld\n", camera->serial, stage_labels[stage], (long long)ids_atomic_load64(&histogram->count));
+        }
+    }
+
+    ids_mutex_unlock(&registry_lock);
+}
+
+/**
+  * Answers one HTTP request. Only GET /metrics (and /) is served.
+  */
+static void metrics_serve(ids_socket_t sock)
+{
+    MetricsBuffer body;
+    char request[METRICS_REQUEST_SIZE];
+    char header[256];
+    size_t received = 0;
+    int n;
+
+    while (received < sizeof(request) - 1)
+    {
+        if (ids_socket_wait_readable(sock, 1000) <= 0)
+        {
+            return;
+        }
+        n = recv(sock, request + received, (int)(sizeof(request) - 1 - received), 0);
+        if (n <= 0)
+        {
+            return;
+        }
+        received += n;
+        request[received] = '\0';
+        if (strstr(request, "\r\n\r\n") != NULL || strstr(request, "\n\n") != NULL)
+        {
+            break;
+        }
+    }
+
+    if (strncmp(request, "GET /metrics", 12) != 0 && strncmp(request, "GET / ", 6) != 0)
+    {
+        static const char not_found[] = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        ids_socket_send_all(sock, not_found, sizeof(not_found) - 1);
+        return;
+    }
+
+    body.capacity = 16384;
+    body.length = 0;
+    body.data = (char *)malloc(body.capacity);
+    if (body.data == NULL)
+    {
+        return;
+    }
+    body.data[0] = '\0';
+    metrics_render(&body);
+
+    n = sprintf(header, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: %lu\r\nConnection: close\r\n\r\n", (unsigned long)body.length);
+    if (ids_socket_send_all(sock, header, n) == 0)
+    {
+        ids_socket_send_all(sock, body.data, body.length);
+    }
+    free(body.data);
+}
+
+static void metrics_server_main(void * arg)
+{
+    MetricsServer * server = (MetricsServer *)arg;
+    ids_socket_t sock;
+
+    while (server->running)
+    {
+        if (ids_socket_wait_readable(server->listener, METRICS_POLL_TIMEOUT) <= 0)
+        {
+            continue;
+        }
+        sock = accept(server->listener, NULL, NULL);
+        if (sock == INVALID_IDS_SOCKET)
+        {
+            continue;
+        }
+        metrics_serve(sock);
+        close_socket(sock);
+    }
+}
+
+static void metrics_server_shutdown(MetricsServer * self)
+{
+    if (!self->running)
+    {
+        return;
+    }
+
+    self->running = 0;
+    Py_BEGIN_ALLOW_THREADS
+    ids_thread_join(self->thread);
+    Py_END_ALLOW_THREADS
+    close_socket(self->listener);
+    self->listener = INVALID_IDS_SOCKET;
+}
+
+/**
+  * Starts the metrics endpoint
+  * This means the definition of the function is:
+  *     def metrics_server(port=9100, host="127.0.0.1")
+  */
+PyObject * ids_metrics_server(PyObject * module, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"port", "host", NULL};
+    MetricsServer * server;
+    int port = 9100;
+    char * host = "127.0.0.1";
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|is", kwlist, &port, &host))
+    {
+        return NULL;
+    }
+
+    server = (MetricsServer *)PyType_GenericAlloc(module_state(module)->metrics_server_type, 0);
+    if (server == NULL)
+    {
+        return NULL;
+    }
+
+    server->port = port;
+    server->listener = ids_socket_listen_tcp(host, &server->port);
+    if (server->listener == INVALID_IDS_SOCKET)
+    {
+        Py_DECREF(server);
+        return NULL;
+    }
+
+    server->running = 1;
+    if (ids_thread_start(&server->thread, metrics_server_main, server) != 0)
+    {
+        server->running = 0;
+        PyErr_SetString(PyExc_RuntimeError, "Unable to start metrics server thread");
+        Py_DECREF(server);
+        return NULL;
+    }
+
+    return (PyObject *)server;
+}
+
+void metrics_server_dealloc(MetricsServer * self)
+{
+    PyTypeObject * type = Py_TYPE(self);
+
+    metrics_server_shutdown(self);
+    if (self->listener != INVALID_IDS_SOCKET)
+    {
+        close_socket(self->listener);
+    }
+    type->tp_free((PyObject *)self);
+    Py_DECREF(type);
+}
+
+PyObject * metrics_server_close(MetricsServer * self)
+{
+    metrics_server_shutdown(self);
+    Py_RETURN_NONE;
+}
+
+PyObject * metrics_server_get_port(MetricsServer * self, void * closure)
+{
+    return Py_BuildValue("i", self->port);
+}
+
+/**
+  * Declaration of all the publicly accessible functions of the MetricsServer Object
+  */
+PyMethodDef metrics_server_methods[] = {
+    {"close", (PyCFunction)metrics_server_close, METH_NOARGS,
+     "Stop serving metrics"
+    },
+    {NULL} /* Sentinel */
+};
+
+PyGetSetDef metrics_server_properties[] = {
+    {"port", (getter)metrics_server_get_port, NULL, "TCP port the endpoint listens on", NULL},
+    {NULL} /* Sentinel */
+};
+
+static PyType_Slot metrics_server_slots[] = {
+    {Py_tp_dealloc, (void *)metrics_server_dealloc},
+    {Py_tp_doc, (void *)"Prometheus text exposition endpoint for all open cameras"},
+    {Py_tp_methods, metrics_server_methods},
+    {Py_tp_getset, metrics_server_properties},
+    {0, NULL} /* Sentinel */
+};
+
+PyType_Spec ids_MetricsServerSpec = {
+    "ids.MetricsServer",       /* name */
+    sizeof(MetricsServer),     /* basicsize */
+    0,                         /* itemsize */
+    IDS_TPFLAGS | Py_TPFLAGS_DISALLOW_INSTANTIATION, /* flags */
+    metrics_server_slots,      /* slots */
+};
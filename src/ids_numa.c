@@ -0,0 +1,164 @@
+#include <uEye.h>
+#include "ids.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_BENCHMARK_MEGABYTES 64
+#define DEFAULT_BENCHMARK_REPEAT    5
+/* Row length the buffer is viewed as when measuring the statistics kernel */
+#define BENCHMARK_IMAGE_WIDTH       4096
+
+/*
+ * One cell of the benchmark: a thread on cpu_node working on memory placed
+ * on memory_node
+ */
+typedef struct
+{
+    int                cpu_node;
+    int                memory_node;
+    size_t             bytes;
+    int                repeat;
+    int                try_huge;
+
+    int                ok;
+    int                bound;
+    int                huge_pages;
+    double             memcpy_gb_s;
+    double             stats_gb_s;
+} NumaBenchmark;
+
+static void numa_benchmark_main(void * arg)
+{
+    NumaBenchmark * bench = (NumaBenchmark *)arg;
+    FrameStats * stats;
+    char * source;
+    char * target;
+    int huge_source;
+    int huge_target;
+    int64_t start;
+    int64_t best_copy = 0;
+    int64_t best_stats = 0;
+    int64_t elapsed;
+    int i;
+
+    bench->bound = ids_thread_bind_node(bench->cpu_node) == 0;
+
+    stats = (FrameStats *)malloc(sizeof(FrameStats));
+    source = (char *)ids_large_alloc(bench->bytes, bench->try_huge, bench->memory_node, &huge_source);
+    target = (char *)ids_large_alloc(bench->bytes, bench->try_huge, bench->memory_node, &huge_target);
+    if (stats != NULL && source != NULL && target != NULL)
+    {
+        for (i = 0; i < (int)bench->bytes; i += 64)
+        {
+            source[i] = (char)i;
+        }
+
+        /* Best of repeat, the first pass also warms the TLB */
+        for (i = 0; i < bench->repeat; i++)
+        {
+            start = ids_monotonic_ns();
+            memcpy(target, source, bench->bytes);
+            elapsed = ids_monotonic_ns() - start;
+            best_copy = best_copy == 0 || elapsed < best_copy ? elapsed : best_copy;
+
+            start = ids_monotonic_ns();
+            frame_stats_compute(stats, source, BENCHMARK_IMAGE_WIDTH, (int)(bench->bytes / BENCHMARK_IMAGE_WIDTH),
+                    BENCHMARK_IMAGE_WIDTH, 1, 8, 1, 255, 256);
+            elapsed = ids_monotonic_ns() - start;
+            best_stats = best_stats == 0 || elapsed < best_stats ? elapsed : best_stats;
+        }
+
+        bench->ok = 1;
+        bench->huge_pages = huge_source && huge_target;
+        bench->memcpy_gb_s = best_copy > 0 ? bench->bytes / (double)best_copy : 0.0;
+        bench->stats_gb_s = best_stats > 0 ? bench->bytes / (double)best_stats : 0.0;
+    }
+
+    ids_large_free(source, bench->bytes);
+    ids_large_free(target, bench->bytes);
+    free(stats);
+}
+
+/**
+  * Function to measure memory throughput for every pair of CPU and memory node
+  * This means the definition of the function is:
+  *     def numa_benchmark(megabytes=64, repeat=5, huge_pages=True)
+  * @return A list of dictionaries with the memcpy and frame_stats throughput
+  *         in GB/s of a thread on cpu_node using buffers on memory_node
+  * @note Diagonal entries are what start_capture(numa_node=n) gives the
+  *       capture thread, the rest is the cost of crossing sockets
+  */
+PyObject * ids_numa_benchmark(PyObject * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"megabytes", "repeat", "huge_pages", NULL};
+    int megabytes = DEFAULT_BENCHMARK_MEGABYTES;
+    int repeat = DEFAULT_BENCHMARK_REPEAT;
+    int huge_pages = 1;
+    int nodes = ids_numa_node_count();
+    NumaBenchmark bench;
+    ids_thread_t thread;
+    PyObject * results;
+    PyObject * result;
+    int started;
+    int cpu, memory;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|iii", kwlist, &megabytes, &repeat, &huge_pages))
+    {
+        return NULL;
+    }
+    if (megabytes < 1 || repeat < 1)
+    {
+        PyErr_SetString(PyExc_ValueError, "megabytes and repeat must be positive");
+        return NULL;
+    }
+
+    results = PyList_New(0);
+    for (cpu = 0; results != NULL && cpu < nodes; cpu++)
+    {
+        for (memory = 0; memory < nodes; memory++)
+        {
+            memset(&bench, 0, sizeof(bench));
+            bench.cpu_node = cpu;
+            bench.memory_node = memory;
+            bench.bytes = (size_t)megabytes << 20;
+            bench.repeat = repeat;
+            bench.try_huge = huge_pages;
+
+            /* One thread per cell, so the binding never leaks into the caller */
+            Py_BEGIN_ALLOW_THREADS
+            started = ids_thread_start(&thread, numa_benchmark_main, &bench) == 0;
+            if (started)
+            {
+                ids_thread_join(thread);
+            }
+            Py_END_ALLOW_THREADS
+            if (!started)
+            {
+                Py_DECREF(results);
+                PyErr_SetString(PyExc_RuntimeError, "Unable to start benchmark thread");
+                return NULL;
+            }
+            if (!bench.ok)
+            {
+                Py_DECREF(results);
+                return PyErr_NoMemory();
+            }
+
+            result = Py_BuildValue("{s:i,s:i,s:O,s:O,s:d,s:d}",
+                    "cpu_node", cpu,
+                    "memory_node", memory,
+                    "bound", bench.bound ? Py_True : Py_False,
+                    "huge_pages", bench.huge_pages ? Py_True : Py_False,
+                    "memcpy_gb_s", bench.memcpy_gb_s,
+                    "frame_stats_gb_s", bench.stats_gb_s);
+            if (result == NULL || PyList_Append(results, result) != 0)
+            {
+                Py_XDECREF(result);
+                Py_DECREF(results);
+                return NULL;
+            }
+            Py_DECREF(result);
+        }
+    }
+    return results;
+}
@@ -0,0 +1,852 @@
+#include <uEye.h>
+#include "ids.h"
+#include "structmember.h"
+#include <stdlib.h>
+#include <string.h>
+#define PY_ARRAY_UNIQUE_SYMBOL ids_ARRAY_API
+#define NO_IMPORT_ARRAY
+#include <numpy/arrayobject.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/* Smallest scale accepted, keeps the per-pixel box sums within 32 bits */
+#define PREVIEW_MIN_SCALE   (1.0 / 64)
+#define PREVIEW_POLL_MS     100
+
+/*
+ * Layout of a source pixel as far as the preview cares
+ */
+enum PreviewSource
+{
+    SOURCE_MONO8,
+    SOURCE_MONO16,
+    SOURCE_BGR,
+    SOURCE_RGB,
+};
+
+enum PreviewColormap
+{
+    COLORMAP_NONE,
+    COLORMAP_GRAY,
+    COLORMAP_HOT,
+    COLORMAP_JET,
+    COLORMAP_CUSTOM,
+};
+
+/*
+ * One rendered RGB preview frame. The shape and strides live here so a
+ * memoryview exported from the buffer stays valid while it is pinned.
+ */
+typedef struct
+{
+    uint8_t *    data;
+    size_t       capacity;
+    Py_ssize_t   shape[3];
+    Py_ssize_t   strides[3];
+    uint64_t     sequence;
+    uint64_t     frame_number;
+} PreviewBuffer;
+
+/*
+ * Struct that defines the Preview class
+ *
+ * Three buffers rotate between the worker and Python: the worker renders into
+ * write, publishes by swapping it with ready, and Python reads front. front is
+ * only replaced by ready while no buffer export is alive.
+ */
+typedef struct
+{
+    PyObject_HEAD
+    Camera *          camera;
+    double            scale;
+    int64_t           period_ns;
+    int               colormap;
+    uint8_t           lut[256][3];
+
+    ids_thread_t      thread;
+    volatile int      running;
+
+    /* Only touched by the capture thread */
+    int64_t           next_due_ns;
+
+    ids_mutex_t       lock;
+    ids_cond_t        wake;
+    ids_cond_t        ready;
+    FrameSlot *       pending;
+    PreviewBuffer     buffers[3];
+    int               write_index;
+    int               ready_index;
+    int               front_index;
+    int               fresh;
+    int               exports;
+    uint64_t          rendered;
+    uint64_t          last_returned;
+
+    /* Worker scratch space */
+    uint32_t *        accumulator;
+    size_t            accumulator_size;
+    int *             columns;
+    size_t            columns_size;
+
+    volatile int64_t  frames_offered;
+    volatile int64_t  frames_replaced;
+    volatile int64_t  frames_rendered;
+    volatile int64_t  render_ns;
+} Preview;
+
+static const struct
+{
+    const char * name;
+    int          colormap;
+} colormap_names[] = {
+    {"gray", COLORMAP_GRAY},
+    {"hot", COLORMAP_HOT},
+    {"jet", COLORMAP_JET},
+};
+
+static uint8_t clamp_u8(int value)
+{
+    return value < 0 ? 0 : value > 255 ? 255 : (uint8_t)value;
+}
+
+/**
+  * Fills the 256 entry lookup table of one of the built-in colormaps
+  */
+static void colormap_fill(uint8_t lut[256][3], int colormap)
+{
+    int i;
+
+    for (i = 0; i < 256; i++)
+    {
+        switch (colormap)
+        {
+            case COLORMAP_HOT:
+                lut[i][0] = clamp_u8(i * 3);
+                lut[i][1] = clamp_u8(i * 3 - 255);
+                lut[i][2] = clamp_u8(i * 3 - 510);
+                break;
+            case COLORMAP_JET:
+                /* Piecewise linear blue - cyan - yellow - red ramp */
+                lut[i][0] = clamp_u8(i < 96 ? 0 : i < 160 ? (i - 96) * 4 : i < 224 ? 255 : 255 - (i - 224) * 4);
+                lut[i][1] = clamp_u8(i < 32 ? 0 : i < 96 ? (i - 32) * 4 : i < 160 ? 255 : 255 - (i - 160) * 4);
+                lut[i][2] = clamp_u8(i < 32 ? 128 + i * 4 : i < 96 ? 255 : 255 - (i - 96) * 4);
+                break;
+            default:
+                lut[i][0] = lut[i][1] = lut[i][2] = (uint8_t)i;
+                break;
+        }
+    }
+}
+
+/**
+  * Parses the colormap argument of Camera.preview: None, a built-in name or
+  * a (256, 3) uint8 lookup table
+  */
+static int colormap_parse(Preview * self, PyObject * value)
+{
+    PyArrayObject * table;
+    char * name;
+    int i;
+
+    if (value == Py_None)
+    {
+        self->colormap = COLORMAP_NONE;
+        colormap_fill(self->lut, COLORMAP_GRAY);
+        return 0;
+    }
+
+    if (check_is_string(value))
+    {
+        name = get_as_string(value);
+        if (name == NULL)
+        {
+            return -1;
+        }
+        for (i = 0; i < (int)(sizeof(colormap_names) / sizeof(colormap_names[0])); i++)
+        {
+            if (strcmp(name, colormap_names[i].name) == 0)
+            {
+                self->colormap = colormap_names[i].colormap;
+                colormap_fill(self->lut, self->colormap);
+                return 0;
+            }
+        }
+        PyErr_Format(PyExc_ValueError, "Unknown colormap '%s', expected gray, hot, jet or a (256, 3) uint8 table", name);
+        return -1;
+    }
+
+    table = (PyArrayObject *)PyArray_FROMANY(value, NPY_UINT8, 2, 2, NPY_ARRAY_CARRAY);
+    if (table == NULL)
+    {
+        return -1;
+    }
+    if (PyArray_DIM(table, 0) != 256 || PyArray_DIM(table, 1) != 3)
+    {
+        Py_DECREF(table);
+        PyErr_SetString(PyExc_ValueError, "A colormap table must have shape (256, 3)");
+        return -1;
+    }
+    memcpy(self->lut, PyArray_DATA(table), sizeof(self->lut));
+    Py_DECREF(table);
+    self->colormap = COLORMAP_CUSTOM;
+    return 0;
+}
+
+/**
+  * Classifies the pixel layout of the ring
+  * @arg shift Set to the right shift that brings a 16 bit sample to 8 bits
+  * @arg channels Set to the number of samples per pixel
+  */
+static int preview_source(FrameRing * ring, int * shift, int * channels)
+{
+    *shift = 0;
+    *channels = ring->bitdepth / 8;
+    switch (ring->color)
+    {
+        case IS_CM_MONO8:
+        case IS_CM_SENSOR_RAW8:
+            *channels = 1;
+            return SOURCE_MONO8;
+        case IS_CM_MONO10:
+            *shift = 2;
+            *channels = 1;
+            return SOURCE_MONO16;
+        case IS_CM_MONO12:
+            *shift = 4;
+            *channels = 1;
+            return SOURCE_MONO16;
+        case IS_CM_MONO16:
+            *shift = 8;
+            *channels = 1;
+            return SOURCE_MONO16;
+        case IS_CM_RGB8_PACKED:
+        case IS_CM_RGBA8_PACKED:
+            return SOURCE_RGB;
+        case IS_CM_BGR8_PACKED:
+        case IS_CM_BGRA8_PACKED:
+            return SOURCE_BGR;
+        default:
+            /* Anything else is previewed from the first byte of each pixel */
+            return SOURCE_MONO8;
+    }
+}
+
+/**
+  * Adds one row of 8 bit samples into the 32 bit column accumulator
+  */
+static void accumulate_u8(uint32_t * acc, const uint8_t * row, int n)
+{
+    int i = 0;
+
+#if defined(__AVX2__)
+    __m256i sum;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        sum = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(acc + i)),
+                _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(row + i))));
+        _mm256_storeu_si256((__m256i *)(acc + i), sum);
+    }
+#elif defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    __m128i bytes;
+    __m128i low;
+    __m128i high;
+
+    for (; i + 16 <= n; i += 16)
+    {
+        bytes = _mm_loadu_si128((const __m128i *)(row + i));
+        low = _mm_unpacklo_epi8(bytes, zero);
+        high = _mm_unpackhi_epi8(bytes, zero);
+        _mm_storeu_si128((__m128i *)(acc + i), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(acc + i)), _mm_unpacklo_epi16(low, zero)));
+        _mm_storeu_si128((__m128i *)(acc + i + 4), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(acc + i + 4)), _mm_unpackhi_epi16(low, zero)));
+        _mm_storeu_si128((__m128i *)(acc + i + 8), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(acc + i + 8)), _mm_unpacklo_epi16(high, zero)));
+        _mm_storeu_si128((__m128i *)(acc + i + 12), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(acc + i + 12)), _mm_unpackhi_epi16(high, zero)));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        acc[i] += row[i];
+    }
+}
+
+/**
+  * Adds one row of 16 bit samples into the 32 bit column accumulator
+  */
+static void accumulate_u16(uint32_t * acc, const uint16_t * row, int n)
+{
+    int i = 0;
+
+#if defined(__AVX2__)
+    __m256i sum;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        sum = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(acc + i)),
+                _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(row + i))));
+        _mm256_storeu_si256((__m256i *)(acc + i), sum);
+    }
+#elif defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    __m128i words;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        words = _mm_loadu_si128((const __m128i *)(row + i));
+        _mm_storeu_si128((__m128i *)(acc + i), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(acc + i)), _mm_unpacklo_epi16(words, zero)));
+        _mm_storeu_si128((__m128i *)(acc + i + 4), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(acc + i + 4)), _mm_unpackhi_epi16(words, zero)));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        acc[i] += row[i];
+    }
+}
+
+/**
+  * Grows a worker scratch array, keeping it on failure
+  */
+static void * scratch_reserve(void * current, size_t * size, size_t needed)
+{
+    void * grown;
+
+    if (needed <= *size)
+    {
+        return current;
+    }
+    grown = realloc(current, needed);
+    if (grown == NULL)
+    {
+        return NULL;
+    }
+    *size = needed;
+    return grown;
+}
+
+/**
+  * Box-filters one frame down to the preview size and converts it to RGB.
+  * Every source pixel contributes to exactly one output pixel: rows are
+  * summed into a column accumulator with SIMD, then neighbouring columns
+  * are summed and divided.
+  * @return 0 on success, -1 when memory ran out
+  */
+static int preview_render(Preview * self, FrameSlot * slot, PreviewBuffer * target)
+{
+    FrameRing * ring = slot->ring;
+    int width = slot->info.dwImageWidth ? (int)slot->info.dwImageWidth : ring->width;
+    int height = slot->info.dwImageHeight ? (int)slot->info.dwImageHeight : ring->height;
+    int out_width = (int)(width * self->scale + 0.5);
+    int out_height = (int)(height * self->scale + 0.5);
+    int shift;
+    int channels;
+    int source = preview_source(ring, &shift, &channels);
+    int samples;
+    int x0, x1, y0, y1;
+    int ox, oy, x, y, c;
+    uint32_t sum[3];
+    uint32_t count;
+    uint8_t value[3];
+    uint8_t * out;
+    size_t needed;
+
+    out_width = out_width < 1 ? 1 : out_width;
+    out_height = out_height < 1 ? 1 : out_height;
+    samples = source == SOURCE_MONO8 || source == SOURCE_MONO16 ? 1 : 3;
+
+    needed = (size_t)out_width * out_height * 3;
+    if (needed > target->capacity)
+    {
+        out = (uint8_t *)realloc(target->data, needed);
+        if (out == NULL)
+        {
+            return -1;
+        }
+        target->data = out;
+        target->capacity = needed;
+    }
+    self->accumulator = (uint32_t *)scratch_reserve(self->accumulator, &self->accumulator_size, (size_t)width * channels * sizeof(uint32_t));
+    self->columns = (int *)scratch_reserve(self->columns, &self->columns_size, (size_t)(out_width + 1) * sizeof(int));
+    if (self->accumulator == NULL || self->columns == NULL)
+    {
+        self->accumulator_size = 0;
+        self->columns_size = 0;
+        return -1;
+    }
+    for (ox = 0; ox <= out_width; ox++)
+    {
+        self->columns[ox] = (int)((int64_t)ox * width / out_width);
+    }
+
+    out = target->data;
+    for (oy = 0; oy < out_height; oy++)
+    {
+        y0 = (int)((int64_t)oy * height / out_height);
+        y1 = (int)((int64_t)(oy + 1) * height / out_height);
+        memset(self->accumulator, 0, (size_t)width * channels * sizeof(uint32_t));
+        for (y = y0; y < y1; y++)
+        {
+            if (source == SOURCE_MONO16)
+            {
+                accumulate_u16(self->accumulator, (const uint16_t *)(slot->pBuffer + (size_t)y * ring->pitch), width);
+            }
+            else
+            {
+                accumulate_u8(self->accumulator, (const uint8_t *)(slot->pBuffer + (size_t)y * ring->pitch), width * channels);
+            }
+        }
+
+        for (ox = 0; ox < out_width; ox++)
+        {
+            x0 = self->columns[ox];
+            x1 = self->columns[ox + 1];
+            count = (uint32_t)(x1 - x0) * (y1 - y0);
+            sum[0] = sum[1] = sum[2] = 0;
+            for (x = x0; x < x1; x++)
+            {
+                for (c = 0; c < samples; c++)
+                {
+                    sum[c] += self->accumulator[x * channels + c];
+                }
+            }
+            for (c = 0; c < samples; c++)
+            {
+                value[c] = (uint8_t)((sum[c] / count) >> shift);
+            }
+
+            if (samples == 1)
+            {
+                out[0] = self->lut[value[0]][0];
+                out[1] = self->lut[value[0]][1];
+                out[2] = self->lut[value[0]][2];
+            }
+            else
+            {
+                if (source == SOURCE_BGR)
+                {
+                    c = value[0];
+                    value[0] = value[2];
+                    value[2] = (uint8_t)c;
+                }
+                if (self->colormap != COLORMAP_NONE)
+                {
+                    c = (77 * value[0] + 150 * value[1] + 29 * value[2]) >> 8;
+                    value[0] = self->lut[c][0];
+                    value[1] = self->lut[c][1];
+                    value[2] = self->lut[c][2];
+                }
+                out[0] = value[0];
+                out[1] = value[1];
+                out[2] = value[2];
+            }
+            out += 3;
+        }
+    }
+
+    target->shape[0] = out_height;
+    target->shape[1] = out_width;
+    target->shape[2] = 3;
+    target->strides[0] = (Py_ssize_t)out_width * 3;
+    target->strides[1] = 3;
+    target->strides[2] = 1;
+    target->frame_number = slot->info.u64FrameNumber;
+    return 0;
+}
+
+/**
+  * Frame sink attached to the camera: hands at most fps frames per second to
+  * the worker. A frame the worker has not started on yet is replaced by the
+  * newer one, so the capture thread never waits on rendering.
+  */
+static void preview_on_frame(void * context, FrameSlot * slot)
+{
+    Preview * self = (Preview *)context;
+    FrameSlot * replaced;
+    int64_t now = ids_monotonic_ns();
+
+    if (now < self->next_due_ns)
+    {
+        return;
+    }
+    if (self->next_due_ns + self->period_ns < now)
+    {
+        self->next_due_ns = now;
+    }
+    self->next_due_ns += self->period_ns;
+    ids_atomic_add64(&self->frames_offered, 1);
+
+    frame_slot_retain(slot);
+    ids_mutex_lock(&self->lock);
+    replaced = self->pending;
+    self->pending = slot;
+    ids_cond_signal(&self->wake);
+    ids_mutex_unlock(&self->lock);
+
+    if (replaced != NULL)
+    {
+        ids_atomic_add64(&self->frames_replaced, 1);
+        frame_slot_release(replaced);
+    }
+}
+
+/**
+  * Worker thread: renders pending frames and publishes them
+  */
+static void preview_main(void * arg)
+{
+    Preview * self = (Preview *)arg;
+    FrameSlot * slot;
+    PreviewBuffer * target;
+    int64_t started;
+    int returnCode;
+    int index;
+
+    trace_thread_name("ids preview");
+    thread_options_apply(self->camera, THREAD_PROCESSING);
+
+    ids_mutex_lock(&self->lock);
+    while (self->running)
+    {
+        if (self->pending == NULL)
+        {
+            ids_cond_wait(&self->wake, &self->lock, PREVIEW_POLL_MS);
+            continue;
+        }
+        slot = self->pending;
+        self->pending = NULL;
+        target = &self->buffers[self->write_index];
+        ids_mutex_unlock(&self->lock);
+
+        started = ids_monotonic_ns();
+        returnCode = preview_render(self, slot, target);
+        frame_slot_release(slot);
+
+        ids_mutex_lock(&self->lock);
+        if (returnCode == 0)
+        {
+            target->sequence = ++self->rendered;
+            index = self->ready_index;
+            self->ready_index = self->write_index;
+            self->write_index = index;
+            self->fresh = 1;
+            ids_cond_broadcast(&self->ready);
+            ids_atomic_add64(&self->frames_rendered, 1);
+            ids_atomic_add64(&self->render_ns, ids_monotonic_ns() - started);
+        }
+    }
+    ids_mutex_unlock(&self->lock);
+}
+
+/**
+  * Detaches from the camera and stops the worker, buffers stay readable
+  */
+static void preview_shutdown(Preview * self)
+{
+    if (!self->running)
+    {
+        return;
+    }
+
+    camera_remove_sink(self->camera, preview_on_frame, self);
+
+    Py_BEGIN_ALLOW_THREADS
+    ids_mutex_lock(&self->lock);
+    self->running = 0;
+    ids_cond_signal(&self->wake);
+    ids_cond_broadcast(&self->ready);
+    ids_mutex_unlock(&self->lock);
+    ids_thread_join(self->thread);
+    Py_END_ALLOW_THREADS
+
+    if (self->pending != NULL)
+    {
+        frame_slot_release(self->pending);
+        self->pending = NULL;
+    }
+}
+
+static void preview_dealloc(Preview * self)
+{
+    PyTypeObject * type = Py_TYPE(self);
+    int i;
+
+    if (self->camera != NULL)
+    {
+        preview_shutdown(self);
+        Py_DECREF(self->camera);
+        ids_cond_destroy(&self->ready);
+        ids_cond_destroy(&self->wake);
+        ids_mutex_destroy(&self->lock);
+    }
+    for (i = 0; i < 3; i++)
+    {
+        free(self->buffers[i].data);
+    }
+    free(self->accumulator);
+    free(self->columns);
+    type->tp_free((PyObject *)self);
+    Py_DECREF(type);
+}
+
+/**
+  * Function to return a Preview of this camera's frames
+  * This means the definition of the method is:
+  *     def preview(self, scale=0.25, fps=30, colormap=None)
+  */
+PyObject * camera_preview(Camera * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"scale", "fps", "colormap", NULL};
+    Preview * preview;
+    double scale = 0.25;
+    double fps = 30.0;
+    PyObject * colormap = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|ddO", kwlist, &scale, &fps, &colormap))
+    {
+        return NULL;
+    }
+    if (scale < PREVIEW_MIN_SCALE || scale > 1.0)
+    {
+        PyErr_SetString(PyExc_ValueError, "scale must be between 1/64 and 1");
+        return NULL;
+    }
+    if (fps <= 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "fps must be positive");
+        return NULL;
+    }
+
+    preview = (Preview *)PyType_GenericAlloc(self->state->preview_type, 0);
+    if (preview == NULL)
+    {
+        return NULL;
+    }
+    if (colormap_parse(preview, colormap) != 0)
+    {
+        Py_DECREF(preview);
+        return NULL;
+    }
+    preview->scale = scale;
+    preview->period_ns = (int64_t)(1e9 / fps);
+    preview->write_index = 0;
+    preview->ready_index = 1;
+    preview->front_index = 2;
+    ids_mutex_init(&preview->lock);
+    ids_cond_init(&preview->wake);
+    ids_cond_init(&preview->ready);
+    Py_INCREF(self);
+    preview->camera = self;
+
+    if (camera_capture_ensure(self, DEFAULT_CAPTURE_BUFFERS, NULL) != 0)
+    {
+        Py_DECREF(preview);
+        return NULL;
+    }
+
+    preview->running = 1;
+    if (ids_thread_start(&preview->thread, preview_main, preview) != 0)
+    {
+        preview->running = 0;
+        PyErr_SetString(PyExc_RuntimeError, "Unable to start preview thread");
+        Py_DECREF(preview);
+        return NULL;
+    }
+
+    if (camera_add_sink(self, preview_on_frame, preview) != 0)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Too many frame consumers attached to this camera");
+        Py_DECREF(preview);
+        return NULL;
+    }
+
+    return (PyObject *)preview;
+}
+
+/**
+  * Waits for a preview frame newer than the last one returned and copies it
+  * This means the definition of the method is:
+  *     def get_frame(self, timeout=None)
+  * @return An (height, width, 3) uint8 RGB array, or None on timeout
+  */
+static PyObject * preview_get_frame(Preview * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"timeout", NULL};
+    PyObject * timeout = Py_None;
+    PyObject * img;
+    PreviewBuffer * buffer;
+    npy_intp dimensions[3];
+    int64_t deadline = 0;
+    int64_t remaining;
+    int available = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &timeout))
+    {
+        return NULL;
+    }
+    if (timeout != Py_None)
+    {
+        deadline = ids_monotonic_ns() + (int64_t)(PyFloat_AsDouble(timeout) * 1e9);
+        if (PyErr_Occurred())
+        {
+            return NULL;
+        }
+    }
+
+    for (;;)
+    {
+        Py_BEGIN_ALLOW_THREADS
+        ids_mutex_lock(&self->lock);
+        while (self->running && self->rendered <= self->last_returned)
+        {
+            remaining = deadline ? (deadline - ids_monotonic_ns()) / 1000000 : PREVIEW_POLL_MS;
+            if (remaining <= 0)
+            {
+                break;
+            }
+            ids_cond_wait(&self->ready, &self->lock, remaining < PREVIEW_POLL_MS ? (int)remaining : PREVIEW_POLL_MS);
+        }
+        available = self->rendered > self->last_returned;
+        buffer = &self->buffers[self->ready_index];
+        dimensions[0] = buffer->shape[0];
+        dimensions[1] = buffer->shape[1];
+        dimensions[2] = 3;
+        ids_mutex_unlock(&self->lock);
+        Py_END_ALLOW_THREADS
+
+        if (!available)
+        {
+            Py_RETURN_NONE;
+        }
+
+        img = PyArray_SimpleNew(3, dimensions, NPY_UINT8);
+        if (img == NULL)
+        {
+            return NULL;
+        }
+
+        /* The worker may have published a frame of another size meanwhile */
+        ids_mutex_lock(&self->lock);
+        buffer = &self->buffers[self->ready_index];
+        if (buffer->shape[0] == dimensions[0] && buffer->shape[1] == dimensions[1])
+        {
+            memcpy(PyArray_DATA((PyArrayObject *)img), buffer->data, (size_t)dimensions[0] * dimensions[1] * 3);
+            self->last_returned = buffer->sequence;
+            ids_mutex_unlock(&self->lock);
+            return img;
+        }
+        ids_mutex_unlock(&self->lock);
+        Py_DECREF(img);
+    }
+}
+
+/**
+  * Exports the latest rendered frame without copying. The frame stays pinned
+  * until every view of it is released; the worker keeps rendering meanwhile.
+  */
+static int preview_getbuffer(Preview * self, Py_buffer * view, int flags)
+{
+    PreviewBuffer * front;
+    int index;
+
+    view->obj = NULL;
+    if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE)
+    {
+        PyErr_SetString(PyExc_BufferError, "Preview frames are read-only");
+        return -1;
+    }
+
+    ids_mutex_lock(&self->lock);
+    if (self->exports == 0 && self->fresh)
+    {
+        index = self->front_index;
+        self->front_index = self->ready_index;
+        self->ready_index = index;
+        self->fresh = 0;
+        self->last_returned = self->buffers[self->front_index].sequence;
+    }
+    front = &self->buffers[self->front_index];
+    if (front->sequence == 0)
+    {
+        ids_mutex_unlock(&self->lock);
+        PyErr_SetString(PyExc_BufferError, "No preview frame has been rendered yet");
+        return -1;
+    }
+    self->exports++;
+    ids_mutex_unlock(&self->lock);
+
+    Py_INCREF(self);
+    view->obj = (PyObject *)self;
+    view->buf = front->data;
+    view->len = front->shape[0] * front->shape[1] * 3;
+    view->readonly = 1;
+    view->itemsize = 1;
+    view->format = (flags & PyBUF_FORMAT) ? "B" : NULL;
+    view->ndim = 3;
+    view->shape = (flags & PyBUF_ND) ? front->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? front->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+static void preview_releasebuffer(Preview * self, Py_buffer * view)
+{
+    ids_mutex_lock(&self->lock);
+    self->exports--;
+    ids_mutex_unlock(&self->lock);
+}
+
+static PyObject * preview_close(Preview * self)
+{
+    preview_shutdown(self);
+    Py_RETURN_NONE;
+}
+
+/**
+  * Returns the preview counters
+  * @note frames_replaced counts frames superseded before the worker got to them
+  */
+static PyObject * preview_stats(Preview * self)
+{
+    int64_t rendered = ids_atomic_load64(&self->frames_rendered);
+
+    return Py_BuildValue("{s:L,s:L,s:L,s:d}",
+            "frames_offered", ids_atomic_load64(&self->frames_offered),
+            "frames_replaced", ids_atomic_load64(&self->frames_replaced),
+            "frames_rendered", rendered,
+            "render_mean_us", rendered ? ids_atomic_load64(&self->render_ns) / 1000.0 / rendered : 0.0);
+}
+
+/**
+  * Declaration of all the publicly accessible functions of the Preview Object
+  */
+PyMethodDef preview_methods[] = {
+    {"get_frame", (PyCFunction)preview_get_frame, METH_VARARGS | METH_KEYWORDS,
+     "Wait for the next preview frame and return a copy as an RGB array"
+    },
+    {"close", (PyCFunction)preview_close, METH_NOARGS,
+     "Stop rendering preview frames"
+    },
+    {"stats", (PyCFunction)preview_stats, METH_NOARGS,
+     "Returns the preview counters"
+    },
+    {NULL} /* Sentinel */
+};
+
+static PyType_Slot preview_slots[] = {
+    {Py_tp_dealloc, (void *)preview_dealloc},
+    {Py_tp_doc, (void *)"Downscaled RGB preview of a Camera, readable as a buffer or with get_frame()"},
+    {Py_tp_methods, preview_methods},
+    {Py_bf_getbuffer, (void *)preview_getbuffer},
+    {Py_bf_releasebuffer, (void *)preview_releasebuffer},
+    {0, NULL} /* Sentinel */
+};
+
+PyType_Spec ids_PreviewSpec = {
+    "ids.Preview",             /* name */
+    sizeof(Preview),           /* basicsize */
+    0,                         /* itemsize */
+    IDS_TPFLAGS | Py_TPFLAGS_DISALLOW_INSTANTIATION, /* flags */
+    preview_slots,             /* slots */
+};
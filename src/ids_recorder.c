@@ -0,0 +1,853 @@
+#include <uEye.h>
+#include "ids.h"
+#include "structmember.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#define PY_ARRAY_UNIQUE_SYMBOL ids_ARRAY_API
+#define NO_IMPORT_ARRAY
+#include <numpy/arrayobject.h>
+
+/*
+ * Dump file layout (all fields little-endian, no padding):
+ *
+ *   DumpFileHeader, then for every frame DumpRecordHeader + payload
+ *
+ * The payload is payload_size bytes of tightly packed rows.
+ */
+#define DUMP_MAGIC           0x44534449 /* "IDSD" */
+#define DUMP_VERSION         1
+
+/* Retained frames waiting for the copy thread */
+#define RECORDER_QUEUE       32
+/* Dumps that may be writing out of one recorder at the same time */
+#define RECORDER_MAX_DUMPS   4
+#define RECORDER_POLL_MS     100
+/* How long a dump waits past its window for frames still being copied */
+#define DUMP_GRACE_NS        1000000000LL
+#define DUMP_FILE_BUFFER     (4 << 20)
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t record_header_size;
+} DumpFileHeader;
+
+typedef struct
+{
+    uint64_t sequence;
+    uint64_t frame_number;
+    uint64_t timestamp_device;
+    int64_t  dequeue_ns;
+    uint32_t width;
+    uint32_t height;
+    uint32_t bytes_per_pixel;
+    uint32_t color_mode;
+    uint32_t payload_size;
+    uint32_t reserved;
+} DumpRecordHeader;
+
+/*
+ * Metadata of one recorded frame, the pixels live at the same index in the
+ * recorder memory
+ */
+typedef struct
+{
+    uint64_t           sequence;
+    uint64_t           frame_number;
+    uint64_t           timestamp_device;
+    int64_t            dequeue_ns;
+    int                width;
+    int                height;
+    int                pitch;
+    int                bytes_per_pixel;
+    int                color;
+} RecordEntry;
+
+/*
+ * Host-RAM circular recorder fed by a frame sink. The sink only queues the
+ * retained slot; the copy thread moves it into the ring and unlocks the SDK
+ * buffer. An entry still needed by a running dump is never overwritten, the
+ * incoming frame is dropped instead.
+ */
+typedef struct Recorder
+{
+    volatile long      refcount;
+    Camera *           camera;
+    char *             memory;
+    size_t             memory_size;
+    int                huge_pages;
+    int                numa_node;
+    size_t             frame_bytes;
+    int                capacity;
+    RecordEntry *      entries;
+
+    ids_thread_t       thread;
+    volatile int       running;
+
+    ids_mutex_t        lock;
+    ids_cond_t         queued;
+    ids_cond_t         recorded;
+    FrameSlot *        queue[RECORDER_QUEUE];
+    int                queue_head;
+    int                queue_count;
+    /* Entries [next_sequence - capacity, next_sequence) are valid once recorded */
+    uint64_t           next_sequence;
+    uint64_t           pins[RECORDER_MAX_DUMPS];
+    int                pinned[RECORDER_MAX_DUMPS];
+
+    volatile int64_t   frames_recorded;
+    volatile int64_t   frames_dropped;
+    volatile int64_t   frames_overrun;
+    volatile int64_t   dumps;
+} Recorder;
+
+/*
+ * Struct that defines the Dump class, one window being written to disk
+ */
+typedef struct
+{
+    PyObject_HEAD
+    Camera *           camera;
+    Recorder *         recorder;
+    int                pin;
+    char *             path;
+    FILE *             file;
+    int64_t            end_ns;
+    ids_thread_t       thread;
+    int                started;
+    volatile int       done;
+    volatile int       error;
+    volatile int64_t   frames_written;
+    volatile int64_t   bytes_written;
+    int64_t            started_ns;
+    volatile int64_t   finished_ns;
+} Dump;
+
+static void recorder_decref(Recorder * recorder)
+{
+    if (ids_atomic_dec(&recorder->refcount) != 0)
+    {
+        return;
+    }
+    ids_large_free(recorder->memory, recorder->memory_size);
+    free(recorder->entries);
+    ids_cond_destroy(&recorder->recorded);
+    ids_cond_destroy(&recorder->queued);
+    ids_mutex_destroy(&recorder->lock);
+    free(recorder);
+}
+
+/**
+  * Frame sink attached to the camera: hands the frame to the copy thread,
+  * or drops it when the copy thread has fallen behind
+  */
+static void recorder_on_frame(void * context, FrameSlot * slot)
+{
+    Recorder * recorder = (Recorder *)context;
+
+    ids_mutex_lock(&recorder->lock);
+    if (recorder->queue_count == RECORDER_QUEUE)
+    {
+        ids_mutex_unlock(&recorder->lock);
+        ids_atomic_add64(&recorder->frames_dropped, 1);
+        return;
+    }
+    frame_slot_retain(slot);
+    recorder->queue[(recorder->queue_head + recorder->queue_count) % RECORDER_QUEUE] = slot;
+    recorder->queue_count++;
+    ids_cond_signal(&recorder->queued);
+    ids_mutex_unlock(&recorder->lock);
+}
+
+/**
+  * Oldest sequence number any running dump still has to write
+  */
+static uint64_t recorder_pin_floor(Recorder * recorder)
+{
+    uint64_t floor = recorder->next_sequence;
+    int i;
+
+    for (i = 0; i < RECORDER_MAX_DUMPS; i++)
+    {
+        if (recorder->pinned[i] && recorder->pins[i] < floor)
+        {
+            floor = recorder->pins[i];
+        }
+    }
+    return floor;
+}
+
+/**
+  * Copy thread: moves queued frames into the ring and publishes them
+  */
+static void recorder_main(void * arg)
+{
+    Recorder * recorder = (Recorder *)arg;
+    FrameSlot * slot;
+    FrameRing * ring;
+    RecordEntry * entry;
+    uint64_t sequence;
+    size_t bytes;
+
+    if (recorder->numa_node >= 0)
+    {
+        ids_thread_bind_node(recorder->numa_node);
+    }
+    trace_thread_name("ids recorder");
+    thread_options_apply(recorder->camera, THREAD_PROCESSING);
+
+    ids_mutex_lock(&recorder->lock);
+    while (recorder->running || recorder->queue_count > 0)
+    {
+        if (recorder->queue_count == 0)
+        {
+            ids_cond_wait(&recorder->queued, &recorder->lock, RECORDER_POLL_MS);
+            continue;
+        }
+        slot = recorder->queue[recorder->queue_head];
+        recorder->queue_head = (recorder->queue_head + 1) % RECORDER_QUEUE;
+        recorder->queue_count--;
+
+        ring = slot->ring;
+        sequence = recorder->next_sequence;
+        bytes = (size_t)ring->pitch * ring->height;
+        if (bytes > recorder->frame_bytes || sequence >= recorder_pin_floor(recorder) + recorder->capacity)
+        {
+            ids_atomic_add64(bytes > recorder->frame_bytes ? &recorder->frames_dropped : &recorder->frames_overrun, 1);
+            ids_mutex_unlock(&recorder->lock);
+            frame_slot_release(slot);
+            ids_mutex_lock(&recorder->lock);
+            continue;
+        }
+        ids_mutex_unlock(&recorder->lock);
+
+        /* The entry is unpublished and unpinned, nothing else reads it */
+        entry = &recorder->entries[sequence % recorder->capacity];
+        memcpy(recorder->memory + (sequence % recorder->capacity) * recorder->frame_bytes, slot->pBuffer, bytes);
+        entry->sequence = slot->sequence;
+        entry->frame_number = slot->info.u64FrameNumber;
+        entry->timestamp_device = slot->info.u64TimestampDevice;
+        entry->dequeue_ns = slot->dequeue_ns;
+        entry->width = slot->info.dwImageWidth ? (int)slot->info.dwImageWidth : ring->width;
+        entry->height = slot->info.dwImageHeight ? (int)slot->info.dwImageHeight : ring->height;
+        entry->pitch = ring->pitch;
+        entry->bytes_per_pixel = (ring->bitdepth + 7) / 8;
+        entry->color = ring->color;
+        frame_slot_release(slot);
+
+        ids_mutex_lock(&recorder->lock);
+        recorder->next_sequence = sequence + 1;
+        ids_atomic_add64(&recorder->frames_recorded, 1);
+        ids_cond_broadcast(&recorder->recorded);
+    }
+    ids_cond_broadcast(&recorder->recorded);
+    ids_mutex_unlock(&recorder->lock);
+}
+
+/**
+  * Detaches the recorder from the camera and drops the camera's reference.
+  * Running dumps finish writing what was recorded.
+  */
+void recorder_close(Camera * self)
+{
+    Recorder * recorder = self->recorder;
+
+    if (recorder == NULL)
+    {
+        return;
+    }
+    self->recorder = NULL;
+
+    camera_remove_sink(self, recorder_on_frame, recorder);
+    Py_BEGIN_ALLOW_THREADS
+    ids_mutex_lock(&recorder->lock);
+    recorder->running = 0;
+    ids_cond_signal(&recorder->queued);
+    ids_mutex_unlock(&recorder->lock);
+    ids_thread_join(recorder->thread);
+    Py_END_ALLOW_THREADS
+    recorder_decref(recorder);
+}
+
+PyObject * recorder_stats_as_dict(Camera * self)
+{
+    Recorder * recorder = self->recorder;
+    uint64_t recorded;
+
+    if (recorder == NULL)
+    {
+        Py_RETURN_NONE;
+    }
+    ids_mutex_lock(&recorder->lock);
+    recorded = recorder->next_sequence;
+    ids_mutex_unlock(&recorder->lock);
+
+    return Py_BuildValue("{s:i,s:K,s:O,s:i,s:K,s:L,s:L,s:L,s:L}",
+            "capacity", recorder->capacity,
+            "frame_bytes", (unsigned PY_LONG_LONG)recorder->frame_bytes,
+            "huge_pages", recorder->huge_pages ? Py_True : Py_False,
+            "numa_node", recorder->numa_node,
+            "held", (unsigned PY_LONG_LONG)(recorded < (uint64_t)recorder->capacity ? recorded : (uint64_t)recorder->capacity),
+            "frames_recorded", ids_atomic_load64(&recorder->frames_recorded),
+            "frames_dropped", ids_atomic_load64(&recorder->frames_dropped),
+            "frames_overrun", ids_atomic_load64(&recorder->frames_overrun),
+            "dumps", ids_atomic_load64(&recorder->dumps));
+}
+
+/**
+  * Function to keep the most recent frames in host memory for dump()
+  * This means the definition of the method is:
+  *     def record(self, seconds=None, gigabytes=None, frames=None, huge_pages=True)
+  * @note Without any size the recorder is stopped. Sizing by seconds uses the
+  *       current frame rate.
+  */
+PyObject * camera_record(Camera * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"seconds", "gigabytes", "frames", "huge_pages", NULL};
+    PyObject * seconds = Py_None;
+    PyObject * gigabytes = Py_None;
+    PyObject * frames = Py_None;
+    int huge_pages = 1;
+    Recorder * recorder;
+    FrameRing * ring;
+    double frame_rate = 0.0;
+    double capacity = 0.0;
+    size_t frame_bytes;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OOOi", kwlist, &seconds, &gigabytes, &frames, &huge_pages))
+    {
+        return NULL;
+    }
+
+    recorder_close(self);
+    if (seconds == Py_None && gigabytes == Py_None && frames == Py_None)
+    {
+        Py_RETURN_NONE;
+    }
+
+    if (camera_capture_ensure(self, DEFAULT_CAPTURE_BUFFERS, NULL) != 0)
+    {
+        return NULL;
+    }
+    ring = capture_ring_acquire(self);
+    if (ring == NULL)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Capture was stopped");
+        return NULL;
+    }
+    frame_bytes = (size_t)ring->pitch * ring->height;
+    frame_ring_decref(ring);
+
+    if (frames != Py_None)
+    {
+        capacity = PyFloat_AsDouble(frames);
+    }
+    else if (gigabytes != Py_None)
+    {
+        capacity = PyFloat_AsDouble(gigabytes) * 1e9 / frame_bytes;
+    }
+    else
+    {
+        is_SetFrameRate(camera_handle(self), IS_GET_FRAMERATE, &frame_rate);
+        capacity = PyFloat_AsDouble(seconds) * frame_rate;
+    }
+    if (PyErr_Occurred())
+    {
+        return NULL;
+    }
+    if (capacity < 2 || capacity > INT32_MAX)
+    {
+        PyErr_SetString(PyExc_ValueError, "The recorder must hold at least 2 frames");
+        return NULL;
+    }
+
+    recorder = (Recorder *)calloc(1, sizeof(Recorder));
+    if (recorder == NULL)
+    {
+        return PyErr_NoMemory();
+    }
+    recorder->refcount = 1;
+    recorder->camera = self;
+    recorder->capacity = (int)capacity;
+    recorder->frame_bytes = frame_bytes;
+    recorder->memory_size = frame_bytes * recorder->capacity;
+    /* Next to the capture buffers it copies from */
+    recorder->numa_node = self->capture.numa_node;
+    ids_mutex_init(&recorder->lock);
+    ids_cond_init(&recorder->queued);
+    ids_cond_init(&recorder->recorded);
+
+    recorder->entries = (RecordEntry *)calloc(recorder->capacity, sizeof(RecordEntry));
+    Py_BEGIN_ALLOW_THREADS
+    recorder->memory = (char *)ids_large_alloc(recorder->memory_size, huge_pages, recorder->numa_node, &recorder->huge_pages);
+    Py_END_ALLOW_THREADS
+    if (recorder->entries == NULL || recorder->memory == NULL)
+    {
+        recorder_decref(recorder);
+        return PyErr_NoMemory();
+    }
+    /* Unmapping the ring drops the lock again */
+    thread_options_lock_memory(self, THREAD_PROCESSING, recorder->memory, recorder->memory_size);
+
+    recorder->running = 1;
+    if (ids_thread_start(&recorder->thread, recorder_main, recorder) != 0)
+    {
+        recorder_decref(recorder);
+        PyErr_SetString(PyExc_RuntimeError, "Unable to start recorder thread");
+        return NULL;
+    }
+    self->recorder = recorder;
+
+    if (camera_add_sink(self, recorder_on_frame, recorder) != 0)
+    {
+        recorder_close(self);
+        PyErr_SetString(PyExc_RuntimeError, "Too many frame consumers attached to this camera");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+/**
+  * Writes one recorded frame, tightly packed
+  * @return 0 on success, -1 with errno set
+  */
+static int dump_write_entry(Dump * self, const RecordEntry * entry, const char * pixels)
+{
+    DumpRecordHeader header;
+    size_t row_bytes = (size_t)entry->width * entry->bytes_per_pixel;
+    int y;
+
+    memset(&header, 0, sizeof(header));
+    header.sequence = entry->sequence;
+    header.frame_number = entry->frame_number;
+    header.timestamp_device = entry->timestamp_device;
+    header.dequeue_ns = entry->dequeue_ns;
+    header.width = entry->width;
+    header.height = entry->height;
+    header.bytes_per_pixel = entry->bytes_per_pixel;
+    header.color_mode = entry->color;
+    header.payload_size = (uint32_t)(row_bytes * entry->height);
+
+    if (fwrite(&header, sizeof(header), 1, self->file) != 1)
+    {
+        return -1;
+    }
+    if ((size_t)entry->pitch == row_bytes)
+    {
+        if (fwrite(pixels, header.payload_size, 1, self->file) != 1)
+        {
+            return -1;
+        }
+    }
+    else
+    {
+        for (y = 0; y < entry->height; y++)
+        {
+            if (fwrite(pixels + (size_t)y * entry->pitch, row_bytes, 1, self->file) != 1)
+            {
+                return -1;
+            }
+        }
+    }
+    ids_atomic_add64(&self->frames_written, 1);
+    ids_atomic_add64(&self->bytes_written, sizeof(header) + header.payload_size);
+    return 0;
+}
+
+/**
+  * Writer thread of one dump: follows the recorder from the first frame of
+  * the window until a frame past its end, moving its pin along
+  */
+static void dump_main(void * arg)
+{
+    Dump * self = (Dump *)arg;
+    Recorder * recorder = self->recorder;
+    RecordEntry entry;
+    uint64_t sequence;
+    int index;
+
+    trace_thread_name("ids dump");
+    thread_options_apply(self->camera, THREAD_WRITER);
+
+    ids_mutex_lock(&recorder->lock);
+    for (;;)
+    {
+        sequence = recorder->pins[self->pin];
+        if (sequence == recorder->next_sequence)
+        {
+            if (!recorder->running || ids_monotonic_ns() > self->end_ns + DUMP_GRACE_NS)
+            {
+                break;
+            }
+            ids_cond_wait(&recorder->recorded, &recorder->lock, RECORDER_POLL_MS);
+            continue;
+        }
+
+        index = (int)(sequence % recorder->capacity);
+        entry = recorder->entries[index];
+        if (entry.dequeue_ns > self->end_ns)
+        {
+            break;
+        }
+        ids_mutex_unlock(&recorder->lock);
+
+        /* Pinned, so the copy thread leaves this entry alone */
+        if (dump_write_entry(self, &entry, recorder->memory + (size_t)index * recorder->frame_bytes) != 0)
+        {
+            self->error = errno ? errno : EIO;
+            ids_mutex_lock(&recorder->lock);
+            break;
+        }
+
+        ids_mutex_lock(&recorder->lock);
+        recorder->pins[self->pin] = sequence + 1;
+    }
+    recorder->pinned[self->pin] = 0;
+    ids_mutex_unlock(&recorder->lock);
+
+    if (fclose(self->file) != 0 && self->error == 0)
+    {
+        self->error = errno ? errno : EIO;
+    }
+    self->file = NULL;
+    self->finished_ns = ids_monotonic_ns();
+    self->done = 1;
+}
+
+/**
+  * Function to write the recorded frames around now to a file in the background
+  * This means the definition of the method is:
+  *     def dump(self, path, pre=1.0, post=1.0)
+  * @arg pre Seconds of frames before the call to include
+  * @arg post Seconds of frames after the call to include
+  * @return A Dump tracking the write
+  */
+PyObject * camera_dump(Camera * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"path", "pre", "post", NULL};
+    Recorder * recorder = self->recorder;
+    DumpFileHeader header;
+    Dump * dump;
+    char * path;
+    double pre = 1.0;
+    double post = 1.0;
+    int64_t now = ids_monotonic_ns();
+    int64_t start_ns;
+    uint64_t first;
+    uint64_t oldest;
+    int pin;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|dd", kwlist, &path, &pre, &post))
+    {
+        return NULL;
+    }
+    if (recorder == NULL)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Call record() before dump()");
+        return NULL;
+    }
+    if (pre < 0 || post < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "pre and post must not be negative");
+        return NULL;
+    }
+
+    dump = (Dump *)PyType_GenericAlloc(self->state->dump_type, 0);
+    if (dump == NULL)
+    {
+        return NULL;
+    }
+    dump->pin = -1;
+    dump->path = (char *)malloc(strlen(path) + 1);
+    if (dump->path == NULL)
+    {
+        Py_DECREF(dump);
+        return PyErr_NoMemory();
+    }
+    strcpy(dump->path, path);
+    Py_INCREF(self);
+    dump->camera = self;
+
+    dump->file = fopen(path, "wb");
+    if (dump->file == NULL)
+    {
+        PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+        Py_DECREF(dump);
+        return NULL;
+    }
+    setvbuf(dump->file, NULL, _IOFBF, DUMP_FILE_BUFFER);
+    header.magic = DUMP_MAGIC;
+    header.version = DUMP_VERSION;
+    header.header_size = sizeof(DumpFileHeader);
+    header.record_header_size = sizeof(DumpRecordHeader);
+    if (fwrite(&header, sizeof(header), 1, dump->file) != 1)
+    {
+        PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+        Py_DECREF(dump);
+        return NULL;
+    }
+
+    /* Freeze the window: pin the oldest recorded frame that falls into it */
+    start_ns = now - (int64_t)(pre * 1e9);
+    ids_mutex_lock(&recorder->lock);
+    for (pin = 0; pin < RECORDER_MAX_DUMPS && recorder->pinned[pin]; pin++)
+    {
+    }
+    if (pin == RECORDER_MAX_DUMPS)
+    {
+        ids_mutex_unlock(&recorder->lock);
+        PyErr_Format(PyExc_RuntimeError, "At most %d dumps can run at the same time", RECORDER_MAX_DUMPS);
+        Py_DECREF(dump);
+        return NULL;
+    }
+    oldest = recorder->next_sequence > (uint64_t)recorder->capacity ? recorder->next_sequence - recorder->capacity : 0;
+    first = recorder->next_sequence;
+    while (first > oldest && recorder->entries[(first - 1) % recorder->capacity].dequeue_ns >= start_ns)
+    {
+        first--;
+    }
+    recorder->pins[pin] = first;
+    recorder->pinned[pin] = 1;
+    ids_mutex_unlock(&recorder->lock);
+
+    ids_atomic_inc(&recorder->refcount);
+    dump->recorder = recorder;
+    dump->pin = pin;
+    dump->end_ns = now + (int64_t)(post * 1e9);
+    dump->started_ns = now;
+    ids_atomic_add64(&recorder->dumps, 1);
+
+    if (ids_thread_start(&dump->thread, dump_main, dump) != 0)
+    {
+        ids_mutex_lock(&recorder->lock);
+        recorder->pinned[pin] = 0;
+        ids_mutex_unlock(&recorder->lock);
+        PyErr_SetString(PyExc_RuntimeError, "Unable to start dump thread");
+        Py_DECREF(dump);
+        return NULL;
+    }
+    dump->started = 1;
+    return (PyObject *)dump;
+}
+
+static void dump_dealloc(Dump * self)
+{
+    PyTypeObject * type = Py_TYPE(self);
+
+    if (self->started)
+    {
+        Py_BEGIN_ALLOW_THREADS
+        ids_thread_join(self->thread);
+        Py_END_ALLOW_THREADS
+    }
+    if (self->file != NULL)
+    {
+        fclose(self->file);
+    }
+    if (self->recorder != NULL)
+    {
+        recorder_decref(self->recorder);
+    }
+    Py_XDECREF(self->camera);
+    free(self->path);
+    type->tp_free((PyObject *)self);
+    Py_DECREF(type);
+}
+
+/**
+  * Waits for the dump to be written
+  * This means the definition of the method is:
+  *     def wait(self, timeout=None)
+  * @return True once the file is complete, False on timeout
+  */
+static PyObject * dump_wait(Dump * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"timeout", NULL};
+    PyObject * timeout = Py_None;
+    int64_t deadline = 0;
+    int done;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &timeout))
+    {
+        return NULL;
+    }
+    if (timeout != Py_None)
+    {
+        deadline = ids_monotonic_ns() + (int64_t)(PyFloat_AsDouble(timeout) * 1e9);
+        if (PyErr_Occurred())
+        {
+            return NULL;
+        }
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    while (!self->done && (deadline == 0 || ids_monotonic_ns() < deadline))
+    {
+        ids_sleep_ms(5);
+    }
+    Py_END_ALLOW_THREADS
+
+    done = self->done;
+    if (done && self->error != 0)
+    {
+        errno = self->error;
+        return PyErr_SetFromErrnoWithFilename(PyExc_IOError, self->path);
+    }
+    return PyBool_FromLong(done);
+}
+
+/**
+  * Returns the progress of the dump
+  */
+static PyObject * dump_stats(Dump * self)
+{
+    int64_t finished = self->finished_ns;
+    int64_t elapsed = (finished ? finished : ids_monotonic_ns()) - self->started_ns;
+    int64_t bytes = ids_atomic_load64(&self->bytes_written);
+
+    return Py_BuildValue("{s:O,s:L,s:L,s:d,s:d}",
+            "done", self->done ? Py_True : Py_False,
+            "frames_written", ids_atomic_load64(&self->frames_written),
+            "bytes_written", bytes,
+            "elapsed_s", elapsed / 1e9,
+            "write_mb_s", elapsed > 0 ? bytes / 1e6 / (elapsed / 1e9) : 0.0);
+}
+
+static PyObject * dump_get_path(Dump * self, void * closure)
+{
+    return Py_BuildValue("s", self->path);
+}
+
+static PyObject * dump_get_done(Dump * self, void * closure)
+{
+    return PyBool_FromLong(self->done);
+}
+
+/**
+  * Function to read a file written by Camera.dump
+  * This means the definition of the function is:
+  *     def read_dump(path)
+  * @return A list of (image, info) tuples shaped like get_image returns them
+  */
+PyObject * ids_read_dump(PyObject * self, PyObject * args)
+{
+    DumpFileHeader header;
+    DumpRecordHeader record;
+    PyObject * frames;
+    PyObject * img;
+    PyObject * info;
+    PyObject * frame;
+    npy_intp dimensions[3];
+    char * path;
+    FILE * file;
+    size_t got;
+    int ndims;
+
+    if (!PyArg_ParseTuple(args, "s", &path))
+    {
+        return NULL;
+    }
+    file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+    }
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != DUMP_MAGIC
+            || header.version != DUMP_VERSION || header.record_header_size != sizeof(DumpRecordHeader))
+    {
+        fclose(file);
+        PyErr_Format(PyExc_ValueError, "%s is not a dump file", path);
+        return NULL;
+    }
+
+    frames = PyList_New(0);
+    while (frames != NULL && fread(&record, sizeof(record), 1, file) == 1)
+    {
+        dimensions[0] = record.height;
+        dimensions[1] = record.width;
+        dimensions[2] = record.bytes_per_pixel;
+        ndims = record.bytes_per_pixel == 1 ? 2 : 3;
+        if ((uint64_t)record.width * record.height * record.bytes_per_pixel != record.payload_size)
+        {
+            PyErr_Format(PyExc_ValueError, "Corrupt frame record in %s", path);
+            Py_CLEAR(frames);
+            break;
+        }
+
+        img = PyArray_SimpleNew(ndims, dimensions, NPY_UINT8);
+        if (img == NULL)
+        {
+            Py_CLEAR(frames);
+            break;
+        }
+        Py_BEGIN_ALLOW_THREADS
+        got = fread(PyArray_DATA((PyArrayObject *)img), 1, record.payload_size, file);
+        Py_END_ALLOW_THREADS
+        if (got != record.payload_size)
+        {
+            /* A dump cut short keeps every complete frame */
+            Py_DECREF(img);
+            break;
+        }
+
+        info = Py_BuildValue("{s:K,s:K,s:K,s:d,s:I,s:I,s:I}",
+                "sequence", record.sequence,
+                "frame_number", record.frame_number,
+                "timestamp_device", record.timestamp_device,
+                "dequeue_s", record.dequeue_ns / 1e9,
+                "color_mode", record.color_mode,
+                "height", record.height,
+                "width", record.width);
+        frame = info == NULL ? NULL : Py_BuildValue("(OO)", img, info);
+        Py_DECREF(img);
+        Py_XDECREF(info);
+        if (frame == NULL || PyList_Append(frames, frame) != 0)
+        {
+            Py_XDECREF(frame);
+            Py_CLEAR(frames);
+            break;
+        }
+        Py_DECREF(frame);
+    }
+    fclose(file);
+    return frames;
+}
+
+/**
+  * Declaration of all the publicly accessible functions of the Dump Object
+  */
+PyMethodDef dump_methods[] = {
+    {"wait", (PyCFunction)dump_wait, METH_VARARGS | METH_KEYWORDS,
+     "Wait until the dump is written, returns False on timeout"
+    },
+    {"stats", (PyCFunction)dump_stats, METH_NOARGS,
+     "Returns frames and bytes written so far and the write rate"
+    },
+    {NULL} /* Sentinel */
+};
+
+PyGetSetDef dump_properties[] = {
+    {"path", (getter)dump_get_path, NULL, "File the frames are written to", NULL},
+    {"done", (getter)dump_get_done, NULL, "Whether the file is complete", NULL},
+    {NULL} /* Sentinel */
+};
+
+static PyType_Slot dump_slots[] = {
+    {Py_tp_dealloc, (void *)dump_dealloc},
+    {Py_tp_doc, (void *)"Recorded frames being written to disk by Camera.dump"},
+    {Py_tp_methods, dump_methods},
+    {Py_tp_getset, dump_properties},
+    {0, NULL} /* Sentinel */
+};
+
+PyType_Spec ids_DumpSpec = {
+    "ids.Dump",                /* name */
+    sizeof(Dump),              /* basicsize */
+    0,                         /* itemsize */
+    IDS_TPFLAGS | Py_TPFLAGS_DISALLOW_INSTANTIATION, /* flags */
+    dump_slots,                /* slots */
+};
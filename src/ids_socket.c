@@ -0,0 +1,110 @@
+#include "ids_socket.h"
+#include <uEye.h>
+#include "ids.h"
+#include <string.h>
+
+int ids_socket_startup(void)
+{
+#ifdef _WIN32
+    static int started = 0;
+    WSADATA data;
+
+    if (!started)
+    {
+        if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+        {
+            PyErr_SetString(PyExc_IOError, "Unable to initialize Winsock");
+            return -1;
+        }
+        started = 1;
+    }
+#endif
+    return 0;
+}
+
+ids_socket_t ids_socket_listen_tcp(const char * host, int * pPort)
+{
+    struct sockaddr_in address;
+    socklen_t length = sizeof(address);
+    ids_socket_t listener;
+    int one = 1;
+
+    if (ids_socket_startup() != 0)
+    {
+        return INVALID_IDS_SOCKET;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons((unsigned short)*pPort);
+    if (inet_pton(AF_INET, host, &address.sin_addr) != 1)
+    {
+        PyErr_Format(PyExc_ValueError, "Invalid IPv4 address '%s'", host);
+        return INVALID_IDS_SOCKET;
+    }
+
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener == INVALID_IDS_SOCKET)
+    {
+        PyErr_SetString(PyExc_IOError, "Unable to create socket");
+        return INVALID_IDS_SOCKET;
+    }
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char *)&one, sizeof(one));
+
+    if (bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 4) != 0)
+    {
+        close_socket(listener);
+        PyErr_Format(PyExc_IOError, "Unable to listen on %s:%d", host, *pPort);
+        return INVALID_IDS_SOCKET;
+    }
+    getsockname(listener, (struct sockaddr *)&address, &length);
+    *pPort = ntohs(address.sin_port);
+    return listener;
+}
+
+int ids_socket_wait_readable(ids_socket_t sock, int timeout_ms)
+{
+    fd_set readable;
+    struct timeval timeout;
+
+    FD_ZERO(&readable);
+    FD_SET(sock, &readable);
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_usec = (timeout_ms % 1000) * 1000;
+
+    return select((int)sock + 1, &readable, NULL, NULL, timeout_ms < 0 ? NULL : &timeout);
+}
+
+int ids_socket_recv_all(ids_socket_t sock, char * buffer, size_t length)
+{
+    size_t received = 0;
+    int n;
+
+    while (received < length)
+    {
+        n = recv(sock, buffer + received, (int)(length - received), 0);
+        if (n <= 0)
+        {
+            return -1;
+        }
+        received += n;
+    }
+    return 0;
+}
+
+int ids_socket_send_all(ids_socket_t sock, const char * buffer, size_t length)
+{
+    size_t sent = 0;
+    int n;
+
+    while (sent < length)
+    {
+        n = send(sock, buffer + sent, (int)(length - sent), MSG_NOSIGNAL);
+        if (n <= 0)
+        {
+            return -1;
+        }
+        sent += n;
+    }
+    return 0;
+}
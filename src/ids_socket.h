@@ -0,0 +1,56 @@
+#pragma once
+
+#ifndef IDS_SOCKET_H_INCLUDED
+#define IDS_SOCKET_H_INCLUDED
+
+/*
+ * Socket portability helpers shared by the frame streaming server and the
+ * metrics endpoint. On Windows this must be included before uEye.h so that
+ * winsock2.h is seen before windows.h.
+ */
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET ids_socket_t;
+#define INVALID_IDS_SOCKET INVALID_SOCKET
+#define close_socket closesocket
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+typedef int ids_socket_t;
+#define INVALID_IDS_SOCKET (-1)
+#define close_socket close
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/* Initializes the socket library once, sets a Python exception on failure */
+int ids_socket_startup(void);
+
+/*
+ * Opens a listening IPv4 TCP socket
+ * @arg pPort In: requested port (0 for any), out: the bound port
+ * @return The socket, or INVALID_IDS_SOCKET with a Python exception set
+ */
+ids_socket_t ids_socket_listen_tcp(const char * host, int * pPort);
+
+/*
+ * Waits until the socket is readable
+ * @return 1 when readable, 0 on timeout, -1 on error
+ */
+int ids_socket_wait_readable(ids_socket_t sock, int timeout_ms);
+
+int ids_socket_recv_all(ids_socket_t sock, char * buffer, size_t length);
+int ids_socket_send_all(ids_socket_t sock, const char * buffer, size_t length);
+
+#endif
@@ -0,0 +1,1251 @@
+#include "ids_socket.h"
+#include <uEye.h>
+#include "ids.h"
+#include "structmember.h"
+#include <string.h>
+#define PY_ARRAY_UNIQUE_SYMBOL ids_ARRAY_API
+#define NO_IMPORT_ARRAY
+#include <numpy/arrayobject.h>
+
+/*
+ * Wire protocol (all fields little-endian, no padding):
+ *
+ *   client -> server, once after connecting: StreamRequest
+ *   server -> client, for every frame:       StreamFrameHeader + payload
+ *
+ * The payload is payload_size bytes of tightly packed rows of the requested
+ * region of interest. Frames are sent straight out of the locked sequence
+ * buffer with scatter-gather writes, one vector per row when the ROI does not
+ * cover whole rows.
+ */
+#define STREAM_REQUEST_MAGIC 0x52534449 /* "IDSR" */
+#define STREAM_FRAME_MAGIC   0x46534449 /* "IDSF" */
+#define STREAM_VERSION       1
+
+#define STREAM_MAX_CLIENTS   16
+#define STREAM_MAX_PENDING   16
+/* Clients together hold at most 1/STREAM_RING_SHARE of the sequence buffers */
+#define STREAM_RING_SHARE    2
+#define STREAM_IOV_BATCH     64
+#define STREAM_MAX_DIMENSION 65536
+#define STREAM_MAX_BYTES_PER_PIXEL 8
+#define STREAM_POLL_TIMEOUT  100
+
+#define DEFAULT_BENCHMARK_WIDTH  1920
+#define DEFAULT_BENCHMARK_HEIGHT 1080
+#define DEFAULT_BENCHMARK_FRAMES 200
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    int32_t  x;
+    int32_t  y;
+    int32_t  width;
+    int32_t  height;
+    uint32_t decimation;
+    uint32_t max_pending;
+} StreamRequest;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t header_size;
+    uint64_t sequence;
+    uint64_t frame_number;
+    uint64_t timestamp_device;
+    uint32_t width;
+    uint32_t height;
+    uint32_t bytes_per_pixel;
+    uint32_t color_mode;
+    uint32_t payload_size;
+    uint32_t dropped;
+} StreamFrameHeader;
+
+#ifdef _WIN32
+typedef WSABUF stream_iov;
+#define IOV_SET(v, p, n) ((v).buf = (char *)(p), (v).len = (ULONG)(n))
+#else
+typedef struct iovec stream_iov;
+#define IOV_SET(v, p, n) ((v).iov_base = (void *)(p), (v).iov_len = (size_t)(n))
+#endif
+
+struct StreamServer;
+
+/*
+ * One connected client. The capture thread queues retained slots into
+ * pending; the connection thread sends and releases them.
+ */
+typedef struct
+{
+    struct StreamServer * server;
+    ids_socket_t          sock;
+    ids_thread_t          thread;
+    volatile int          active;
+    volatile int          finished;
+    StreamRequest         request;
+    uint32_t              countdown;
+
+    ids_mutex_t           lock;
+    ids_cond_t            ready;
+    FrameSlot *           pending[STREAM_MAX_PENDING];
+    int                   pending_head;
+    int                   pending_count;
+    uint32_t              dropped_since_sent;
+
+    volatile int64_t      frames_sent;
+    volatile int64_t      bytes_sent;
+    volatile int64_t      frames_dropped;
+} StreamConnection;
+
+/*
+ * Struct that defines the StreamServer class
+ */
+typedef struct StreamServer
+{
+    PyObject_HEAD
+    Camera *              camera;
+    ids_socket_t          listener;
+    int                   port;
+    char                  path[108];
+    int                   max_clients;
+    ids_thread_t          accept_thread;
+    volatile int          running;
+
+    ids_mutex_t           lock;
+    StreamConnection *    clients[STREAM_MAX_CLIENTS];
+    /* Slots queued to or being sent by any client */
+    volatile long         slots_held;
+} StreamServer;
+
+/*
+ * Struct that defines the StreamClient class
+ */
+typedef struct
+{
+    PyObject_HEAD
+    ids_socket_t          sock;
+} StreamClient;
+
+/**
+  * Checks a frame header received from a peer before anything is allocated
+  * from it. The payload must be exactly the packed rows the header describes.
+  * @return 1 if the header is consistent, 0 otherwise
+  */
+static int stream_header_valid(const StreamFrameHeader * header)
+{
+    if (header->magic != STREAM_FRAME_MAGIC || header->header_size != sizeof(StreamFrameHeader))
+    {
+        return 0;
+    }
+    if (header->bytes_per_pixel == 0 || header->bytes_per_pixel > STREAM_MAX_BYTES_PER_PIXEL)
+    {
+        return 0;
+    }
+    if (header->width > STREAM_MAX_DIMENSION || header->height > STREAM_MAX_DIMENSION)
+    {
+        return 0;
+    }
+    return (uint64_t)header->width * header->bytes_per_pixel * header->height == header->payload_size;
+}
+
+/**
+  * Writes a vector of buffers completely, resuming after partial writes
+  */
+static int stream_send_iov(ids_socket_t sock, stream_iov * iov, int count)
+{
+#ifdef _WIN32
+    DWORD sent;
+    return WSASend(sock, iov, count, &sent, 0, NULL, NULL) == 0 ? 0 : -1;
+#else
+    struct msghdr message;
+    ssize_t n;
+
+    while (count > 0)
+    {
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = iov;
+        message.msg_iovlen = count;
+        n = sendmsg(sock, &message, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            return -1;
+        }
+        while (count > 0 && (size_t)n >= iov->iov_len)
+        {
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+#endif
+}
+
+/**
+  * Sends one frame to a client, clipped to its region of interest
+  */
+static int stream_send_frame(StreamConnection * connection, FrameSlot * slot, size_t * pSent)
+{
+    FrameRing * ring = slot->ring;
+    StreamFrameHeader header;
+    stream_iov iov[STREAM_IOV_BATCH];
+    int image_width = slot->info.dwImageWidth ? (int)slot->info.dwImageWidth : ring->width;
+    int image_height = slot->info.dwImageHeight ? (int)slot->info.dwImageHeight : ring->height;
+    int bytes_per_pixel = (ring->bitdepth + 7) / 8;
+    int x = connection->request.x;
+    int y = connection->request.y;
+    int width = connection->request.width;
+    int height = connection->request.height;
+    size_t row_bytes;
+    char * origin;
+    int count;
+    int row;
+
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (x > image_width) x = image_width;
+    if (y > image_height) y = image_height;
+    if (width <= 0 || width > image_width - x) width = image_width - x;
+    if (height <= 0 || height > image_height - y) height = image_height - y;
+
+    row_bytes = (size_t)width * bytes_per_pixel;
+    origin = slot->pBuffer + (size_t)y * ring->pitch + (size_t)x * bytes_per_pixel;
+
+    header.magic = STREAM_FRAME_MAGIC;
+    header.header_size = sizeof(StreamFrameHeader);
+    header.sequence = slot->sequence;
+    header.frame_number = slot->info.u64FrameNumber;
+    header.timestamp_device = slot->info.u64TimestampDevice;
+    header.width = width;
+    header.height = height;
+    header.bytes_per_pixel = bytes_per_pixel;
+    header.color_mode = ring->color;
+    header.payload_size = (uint32_t)(row_bytes * height);
+    header.dropped = connection->dropped_since_sent;
+    connection->dropped_since_sent = 0;
+    *pSent = sizeof(header) + header.payload_size;
+
+    IOV_SET(iov[0], &header, sizeof(header));
+    count = 1;
+
+    if (row_bytes == (size_t)ring->pitch)
+    {
+        IOV_SET(iov[1], origin, header.payload_size);
+        return stream_send_iov(connection->sock, iov, 2);
+    }
+
+    for (row = 0; row < height; row++)
+    {
+        IOV_SET(iov[count], origin + (size_t)row * ring->pitch, row_bytes);
+        count++;
+        if (count == STREAM_IOV_BATCH)
+        {
+            if (stream_send_iov(connection->sock, iov, count) != 0)
+            {
+                return -1;
+            }
+            count = 0;
+        }
+    }
+    return count > 0 ? stream_send_iov(connection->sock, iov, count) : 0;
+}
+
+/**
+  * Number of sequence buffers all clients of a server may hold at once, so
+  * that the SDK and get_image always keep the rest of the ring
+  */
+static int stream_slot_budget(int buffers)
+{
+    return buffers / STREAM_RING_SHARE > 0 ? buffers / STREAM_RING_SHARE : 1;
+}
+
+/**
+  * Gives a slot queued by stream_on_frame back to the ring
+  */
+static void stream_slot_release(StreamConnection * connection, FrameSlot * slot)
+{
+    frame_slot_release(slot);
+    ids_atomic_dec(&connection->server->slots_held);
+}
+
+/**
+  * Body of the per-client sender thread
+  */
+static void stream_connection_main(void * arg)
+{
+    StreamConnection * connection = (StreamConnection *)arg;
+    FrameSlot * slot;
+    size_t sent;
+
+    trace_thread_name("ids stream");
+    thread_options_apply(connection->server->camera, THREAD_WRITER);
+
+    while (connection->active && connection->server->running)
+    {
+        ids_mutex_lock(&connection->lock);
+        if (connection->pending_count == 0)
+        {
+            ids_cond_wait(&connection->ready, &connection->lock, STREAM_POLL_TIMEOUT);
+        }
+        slot = NULL;
+        if (connection->pending_count > 0)
+        {
+            slot = connection->pending[connection->pending_head];
+            connection->pending_head = (connection->pending_head + 1) % STREAM_MAX_PENDING;
+            connection->pending_count--;
+        }
+        ids_mutex_unlock(&connection->lock);
+
+        if (slot == NULL)
+        {
+            continue;
+        }
+
+        if (stream_send_frame(connection, slot, &sent) != 0)
+        {
+            connection->active = 0;
+        }
+        else
+        {
+            ids_atomic_add64(&connection->frames_sent, 1);
+            ids_atomic_add64(&connection->bytes_sent, (int64_t)sent);
+        }
+        stream_slot_release(connection, slot);
+    }
+
+    ids_mutex_lock(&connection->lock);
+    connection->active = 0;
+    while (connection->pending_count > 0)
+    {
+        stream_slot_release(connection, connection->pending[connection->pending_head]);
+        connection->pending_head = (connection->pending_head + 1) % STREAM_MAX_PENDING;
+        connection->pending_count--;
+    }
+    ids_mutex_unlock(&connection->lock);
+
+    close_socket(connection->sock);
+    connection->finished = 1;
+}
+
+static void stream_connection_free(StreamConnection * connection)
+{
+    ids_thread_join(connection->thread);
+    ids_cond_destroy(&connection->ready);
+    ids_mutex_destroy(&connection->lock);
+    free(connection);
+}
+
+/**
+  * Frame sink attached to the camera: queues the frame for every client whose
+  * decimation counter is due. A client that is too slow, or that would take
+  * the clients past their share of the ring, loses frames instead of stalling
+  * the capture thread.
+  */
+static void stream_on_frame(void * context, FrameSlot * slot)
+{
+    StreamServer * server = (StreamServer *)context;
+    StreamConnection * connection;
+    int budget = stream_slot_budget(slot->ring->count);
+    int tail;
+    int i;
+
+    ids_mutex_lock(&server->lock);
+    for (i = 0; i < server->max_clients; i++)
+    {
+        connection = server->clients[i];
+        if (connection == NULL || !connection->active)
+        {
+            continue;
+        }
+        if (connection->countdown > 1)
+        {
+            connection->countdown--;
+            continue;
+        }
+        connection->countdown = connection->request.decimation;
+
+        ids_mutex_lock(&connection->lock);
+        if (connection->pending_count >= (int)connection->request.max_pending ||
+            server->slots_held >= budget)
+        {
+            connection->dropped_since_sent++;
+            ids_atomic_add64(&connection->frames_dropped, 1);
+        }
+        else
+        {
+            frame_slot_retain(slot);
+            ids_atomic_inc(&server->slots_held);
+            tail = (connection->pending_head + connection->pending_count) % STREAM_MAX_PENDING;
+            connection->pending[tail] = slot;
+            connection->pending_count++;
+            ids_cond_signal(&connection->ready);
+        }
+        ids_mutex_unlock(&connection->lock);
+    }
+    ids_mutex_unlock(&server->lock);
+}
+
+/**
+  * Reads and validates the subscription request of a new client
+  */
+static StreamConnection * stream_handshake(StreamServer * server, ids_socket_t sock)
+{
+    StreamConnection * connection;
+    StreamRequest request;
+    int budget;
+
+    if (ids_socket_wait_readable(sock, 1000) <= 0 || ids_socket_recv_all(sock, (char *)&request, sizeof(request)) != 0)
+    {
+        return NULL;
+    }
+    if (request.magic != STREAM_REQUEST_MAGIC || request.version != STREAM_VERSION)
+    {
+        return NULL;
+    }
+    if (request.decimation == 0)
+    {
+        request.decimation = 1;
+    }
+    budget = stream_slot_budget(capture_buffer_count(server->camera));
+    if (budget > STREAM_MAX_PENDING)
+    {
+        budget = STREAM_MAX_PENDING;
+    }
+    if (request.max_pending == 0 || request.max_pending > (uint32_t)budget)
+    {
+        request.max_pending = budget;
+    }
+
+    connection = (StreamConnection *)calloc(1, sizeof(StreamConnection));
+    if (connection == NULL)
+    {
+        return NULL;
+    }
+    connection->server = server;
+    connection->sock = sock;
+    connection->request = request;
+    connection->countdown = 1;
+    connection->active = 1;
+    ids_mutex_init(&connection->lock);
+    ids_cond_init(&connection->ready);
+    return connection;
+}
+
+/**
+  * Body of the accept thread. Also reaps clients that have disconnected.
+  */
+static void stream_accept_main(void * arg)
+{
+    StreamServer * server = (StreamServer *)arg;
+    StreamConnection * connection;
+    StreamConnection * finished;
+    ids_socket_t sock;
+    int one = 1;
+    int i;
+
+    while (server->running)
+    {
+        for (i = 0; i < server->max_clients; i++)
+        {
+            finished = NULL;
+            ids_mutex_lock(&server->lock);
+            if (server->clients[i] != NULL && server->clients[i]->finished)
+            {
+                finished = server->clients[i];
+                server->clients[i] = NULL;
+            }
+            ids_mutex_unlock(&server->lock);
+            if (finished != NULL)
+            {
+                stream_connection_free(finished);
+            }
+        }
+
+        if (ids_socket_wait_readable(server->listener, STREAM_POLL_TIMEOUT) <= 0)
+        {
+            continue;
+        }
+        sock = accept(server->listener, NULL, NULL);
+        if (sock == INVALID_IDS_SOCKET)
+        {
+            continue;
+        }
+        if (server->path[0] == '\0')
+        {
+            setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char *)&one, sizeof(one));
+        }
+
+        connection = stream_handshake(server, sock);
+        if (connection == NULL)
+        {
+            close_socket(sock);
+            continue;
+        }
+
+        ids_mutex_lock(&server->lock);
+        for (i = 0; i < server->max_clients; i++)
+        {
+            if (server->clients[i] == NULL)
+            {
+                break;
+            }
+        }
+        if (i == server->max_clients || ids_thread_start(&connection->thread, stream_connection_main, connection) != 0)
+        {
+            ids_mutex_unlock(&server->lock);
+            close_socket(sock);
+            ids_cond_destroy(&connection->ready);
+            ids_mutex_destroy(&connection->lock);
+            free(connection);
+            continue;
+        }
+        server->clients[i] = connection;
+        ids_mutex_unlock(&server->lock);
+    }
+}
+
+/**
+  * Opens the listening socket, TCP when path is NULL, Unix-domain otherwise
+  */
+static int stream_listen(StreamServer * server, const char * host, int port, const char * path)
+{
+    if (path != NULL)
+    {
+#ifdef _WIN32
+        PyErr_SetString(PyExc_NotImplementedError, "Unix-domain sockets are not supported on this platform");
+        return -1;
+#else
+        struct sockaddr_un local;
+
+        if (strlen(path) >= sizeof(local.sun_path))
+        {
+            PyErr_SetString(PyExc_ValueError, "Socket path is too long");
+            return -1;
+        }
+        server->listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (server->listener == INVALID_IDS_SOCKET)
+        {
+            PyErr_SetFromErrno(PyExc_IOError);
+            return -1;
+        }
+        memset(&local, 0, sizeof(local));
+        local.sun_family = AF_UNIX;
+        strcpy(local.sun_path, path);
+        unlink(path);
+        if (bind(server->listener, (struct sockaddr *)&local, sizeof(local)) != 0 || listen(server->listener, 4) != 0)
+        {
+            PyErr_SetFromErrno(PyExc_IOError);
+            return -1;
+        }
+        strcpy(server->path, path);
+        return 0;
+#endif
+    }
+
+    server->port = port;
+    server->listener = ids_socket_listen_tcp(host, &server->port);
+    return server->listener == INVALID_IDS_SOCKET ? -1 : 0;
+}
+
+/**
+  * Stops accepting, disconnects every client and detaches from the camera
+  */
+static void stream_server_shutdown(StreamServer * server)
+{
+    StreamConnection * connection;
+    int i;
+
+    if (!server->running)
+    {
+        return;
+    }
+
+    camera_remove_sink(server->camera, stream_on_frame, server);
+    server->running = 0;
+
+    Py_BEGIN_ALLOW_THREADS
+    ids_thread_join(server->accept_thread);
+    for (i = 0; i < server->max_clients; i++)
+    {
+        connection = server->clients[i];
+        if (connection != NULL)
+        {
+            connection->active = 0;
+            ids_cond_signal(&connection->ready);
+            shutdown(connection->sock, 2);
+            stream_connection_free(connection);
+            server->clients[i] = NULL;
+        }
+    }
+    Py_END_ALLOW_THREADS
+
+    close_socket(server->listener);
+    server->listener = INVALID_IDS_SOCKET;
+#ifndef _WIN32
+    if (server->path[0] != '\0')
+    {
+        unlink(server->path);
+    }
+#endif
+}
+
+/*
+ * One direction of the loopback benchmark, run on its own thread
+ */
+typedef struct
+{
+    StreamConnection * connection;
+    FrameSlot *        slot;
+    int                frames;
+    int                failed;
+} StreamBenchmark;
+
+static void stream_benchmark_send(void * arg)
+{
+    StreamBenchmark * bench = (StreamBenchmark *)arg;
+    size_t sent;
+    int i;
+
+    for (i = 0; i < bench->frames; i++)
+    {
+        if (stream_send_frame(bench->connection, bench->slot, &sent) != 0)
+        {
+            bench->failed = 1;
+            return;
+        }
+    }
+}
+
+/**
+  * Sends frames of slot through a connected socket pair with the server's
+  * sender and reads them back like StreamClient.get_frame. Does not need the GIL.
+  * @arg payload Receives the pixels, large enough for the whole frame
+  * @return The elapsed nanoseconds, -1 if the connection failed
+  */
+static int64_t stream_benchmark_run(ids_socket_t sender, ids_socket_t receiver, FrameSlot * slot, const StreamRequest * request, int frames, char * payload)
+{
+    StreamConnection connection;
+    StreamBenchmark bench;
+    StreamFrameHeader header;
+    ids_thread_t thread;
+    int64_t start;
+    int failed = 0;
+    int i;
+
+    memset(&connection, 0, sizeof(connection));
+    connection.sock = sender;
+    connection.request = *request;
+    bench.connection = &connection;
+    bench.slot = slot;
+    bench.frames = frames;
+    bench.failed = 0;
+
+    start = ids_monotonic_ns();
+    if (ids_thread_start(&thread, stream_benchmark_send, &bench) != 0)
+    {
+        return -1;
+    }
+    for (i = 0; i < frames && !failed; i++)
+    {
+        failed = ids_socket_recv_all(receiver, (char *)&header, sizeof(header)) != 0 ||
+                 !stream_header_valid(&header) ||
+                 ids_socket_recv_all(receiver, payload, header.payload_size) != 0;
+    }
+    if (failed)
+    {
+        /* Unblocks a sender waiting for the reader */
+        shutdown(receiver, 2);
+    }
+    ids_thread_join(thread);
+    return failed || bench.failed ? -1 : ids_monotonic_ns() - start;
+}
+
+/**
+  * Function to measure the frame streaming path without a camera
+  * This means the definition of the method is:
+  *     def stream_benchmark(width=1920, height=1080, frames=200)
+  * @return A list with one dictionary for the whole frame, sent as one
+  *         vector, and one for a centred ROI, sent row by row
+  */
+PyObject * ids_stream_benchmark(PyObject * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"width", "height", "frames", NULL};
+    StreamRequest requests[2];
+    FrameRing ring;
+    FrameSlot slot;
+    ids_socket_t listener;
+    ids_socket_t sender = INVALID_IDS_SOCKET;
+    ids_socket_t receiver = INVALID_IDS_SOCKET;
+    struct sockaddr_in address;
+    socklen_t length = sizeof(address);
+    PyObject * list = NULL;
+    PyObject * entry;
+    char * payload = NULL;
+    int64_t elapsed[2];
+    double bytes;
+    int width = DEFAULT_BENCHMARK_WIDTH;
+    int height = DEFAULT_BENCHMARK_HEIGHT;
+    int frames = DEFAULT_BENCHMARK_FRAMES;
+    int port = 0;
+    int one = 1;
+    int i;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|iii", kwlist, &width, &height, &frames))
+    {
+        return NULL;
+    }
+    if (width < 4 || height < 4 || frames < 1)
+    {
+        PyErr_SetString(PyExc_ValueError, "width and height must be at least 4, frames positive");
+        return NULL;
+    }
+
+    memset(&ring, 0, sizeof(ring));
+    ring.count = 1;
+    ring.width = width;
+    ring.height = height;
+    ring.bitdepth = 8;
+    ring.pitch = width;
+    ring.color = IS_CM_MONO8;
+    memset(&slot, 0, sizeof(slot));
+    slot.ring = &ring;
+    slot.pBuffer = (char *)malloc((size_t)width * height);
+    payload = (char *)malloc((size_t)width * height);
+    if (slot.pBuffer == NULL || payload == NULL)
+    {
+        PyErr_NoMemory();
+        goto done;
+    }
+    memset(slot.pBuffer, 0x5a, (size_t)width * height);
+
+    memset(requests, 0, sizeof(requests));
+    requests[1].x = width / 4;
+    requests[1].y = height / 4;
+    requests[1].width = width / 2;
+    requests[1].height = height / 2;
+
+    /* A TCP pair on the loopback interface, set up like the server's connections */
+    listener = ids_socket_listen_tcp("127.0.0.1", &port);
+    if (listener == INVALID_IDS_SOCKET)
+    {
+        goto done;
+    }
+    getsockname(listener, (struct sockaddr *)&address, &length);
+    receiver = socket(AF_INET, SOCK_STREAM, 0);
+    if (receiver != INVALID_IDS_SOCKET && connect(receiver, (struct sockaddr *)&address, sizeof(address)) == 0)
+    {
+        sender = accept(listener, NULL, NULL);
+    }
+    close_socket(listener);
+    if (sender == INVALID_IDS_SOCKET)
+    {
+        PyErr_SetString(PyExc_IOError, "Unable to open a loopback connection");
+        goto done;
+    }
+    setsockopt(sender, IPPROTO_TCP, TCP_NODELAY, (const char *)&one, sizeof(one));
+
+    Py_BEGIN_ALLOW_THREADS
+    for (i = 0; i < 2; i++)
+    {
+        elapsed[i] = stream_benchmark_run(sender, receiver, &slot, &requests[i], frames, payload);
+        if (elapsed[i] < 0)
+        {
+            break;
+        }
+    }
+    Py_END_ALLOW_THREADS
+    if (i < 2)
+    {
+        PyErr_SetString(PyExc_IOError, "Loopback stream failed");
+        goto done;
+    }
+
+    list = PyList_New(2);
+    if (list == NULL)
+    {
+        goto done;
+    }
+    for (i = 0; i < 2; i++)
+    {
+        bytes = (double)frames * (requests[i].width > 0 ? requests[i].width : width) * (requests[i].height > 0 ? requests[i].height : height);
+        entry = Py_BuildValue("{s:(iiii),s:d,s:d,s:d}",
+                "roi", requests[i].x, requests[i].y,
+                requests[i].width > 0 ? requests[i].width : width,
+                requests[i].height > 0 ? requests[i].height : height,
+                "ms", elapsed[i] / 1e6 / frames,
+                "fps", elapsed[i] > 0 ? frames * 1e9 / elapsed[i] : 0.0,
+                "megabytes_per_s", elapsed[i] > 0 ? bytes * 1e3 / elapsed[i] : 0.0);
+        if (entry == NULL)
+        {
+            Py_CLEAR(list);
+            goto done;
+        }
+        PyList_SET_ITEM(list, i, entry);
+    }
+
+done:
+    if (sender != INVALID_IDS_SOCKET)
+    {
+        close_socket(sender);
+    }
+    if (receiver != INVALID_IDS_SOCKET)
+    {
+        close_socket(receiver);
+    }
+    free(payload);
+    free(slot.pBuffer);
+    return list;
+}
+
+/**
+  * Function to return a StreamServer serving this camera's frames
+  * This means the definition of the method is:
+  *     def stream(self, port=0, host="127.0.0.1", path=None, max_clients=4)
+  */
+PyObject * camera_stream(Camera * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"port", "host", "path", "max_clients", NULL};
+    StreamServer * server;
+    int port = 0;
+    char * host = "127.0.0.1";
+    char * path = NULL;
+    int max_clients = 4;
+    int started;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|iszi", kwlist, &port, &host, &path, &max_clients))
+    {
+        return NULL;
+    }
+    if (max_clients < 1 || max_clients > STREAM_MAX_CLIENTS)
+    {
+        PyErr_Format(PyExc_ValueError, "max_clients must be between 1 and %d", STREAM_MAX_CLIENTS);
+        return NULL;
+    }
+    if (ids_socket_startup() != 0)
+    {
+        return NULL;
+    }
+    if (camera_capture_ensure(self, DEFAULT_CAPTURE_BUFFERS, &started) != 0)
+    {
+        return NULL;
+    }
+
+    server = (StreamServer *)PyType_GenericAlloc(self->state->stream_server_type, 0);
+    if (server == NULL)
+    {
+        goto fail_capture;
+    }
+    server->listener = INVALID_IDS_SOCKET;
+    server->max_clients = max_clients;
+    ids_mutex_init(&server->lock);
+    Py_INCREF(self);
+    server->camera = self;
+
+    if (stream_listen(server, host, port, path) != 0)
+    {
+        goto fail_server;
+    }
+
+    server->running = 1;
+    if (ids_thread_start(&server->accept_thread, stream_accept_main, server) != 0)
+    {
+        server->running = 0;
+        PyErr_SetString(PyExc_RuntimeError, "Unable to start stream server thread");
+        goto fail_server;
+    }
+
+    if (camera_add_sink(self, stream_on_frame, server) != 0)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Too many frame consumers attached to this camera");
+        goto fail_server;
+    }
+
+    return (PyObject *)server;
+
+fail_server:
+    Py_DECREF(server);
+fail_capture:
+    /* Leave capture as it was found */
+    if (started)
+    {
+        capture_control_lock(self);
+        camera_capture_stop(self);
+        capture_control_unlock(self);
+    }
+    return NULL;
+}
+
+void stream_server_dealloc(StreamServer * self)
+{
+    PyTypeObject * type = Py_TYPE(self);
+
+    stream_server_shutdown(self);
+    if (self->listener != INVALID_IDS_SOCKET)
+    {
+        close_socket(self->listener);
+    }
+    ids_mutex_destroy(&self->lock);
+    Py_XDECREF(self->camera);
+    type->tp_free((PyObject *)self);
+    Py_DECREF(type);
+}
+
+PyObject * stream_server_close(StreamServer * self)
+{
+    stream_server_shutdown(self);
+    Py_RETURN_NONE;
+}
+
+/*
+ * Returns per-client counters
+ * @return A Python list with one dictionary per connected client
+ */
+PyObject * stream_server_stats(StreamServer * self)
+{
+    StreamConnection * connection;
+    PyObject * list = PyList_New(0);
+    PyObject * client;
+    int i;
+
+    ids_mutex_lock(&self->lock);
+    for (i = 0; i < self->max_clients; i++)
+    {
+        connection = self->clients[i];
+        if (connection == NULL || !connection->active)
+        {
+            continue;
+        }
+        client = Py_BuildValue("{s:L,s:L,s:L,s:(iiii),s:I,s:I}",
+                "frames_sent", ids_atomic_load64(&connection->frames_sent),
+                "bytes_sent", ids_atomic_load64(&connection->bytes_sent),
+                "frames_dropped", ids_atomic_load64(&connection->frames_dropped),
+                "roi", connection->request.x, connection->request.y, connection->request.width, connection->request.height,
+                "decimation", connection->request.decimation,
+                "max_pending", connection->request.max_pending);
+        PyList_Append(list, client);
+        Py_DECREF(client);
+    }
+    ids_mutex_unlock(&self->lock);
+
+    return list;
+}
+
+PyObject * stream_server_get_port(StreamServer * self, void * closure)
+{
+    if (self->path[0] != '\0')
+    {
+        Py_RETURN_NONE;
+    }
+    return Py_BuildValue("i", self->port);
+}
+
+PyObject * stream_server_get_path(StreamServer * self, void * closure)
+{
+    if (self->path[0] == '\0')
+    {
+        Py_RETURN_NONE;
+    }
+    return Py_BuildValue("s", self->path);
+}
+
+/**
+  * Connects to a StreamServer and subscribes to its frames
+  * This means the definition of the client object is:
+  *     def __init__(self, port=0, host="127.0.0.1", path=None, roi=None, decimation=1, max_pending=4)
+  */
+int stream_client_init(StreamClient * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"port", "host", "path", "roi", "decimation", "max_pending", NULL};
+    StreamRequest request;
+    int port = 0;
+    char * host = "127.0.0.1";
+    char * path = NULL;
+    PyObject * roi = Py_None;
+    unsigned int decimation = 1;
+    unsigned int max_pending = 4;
+    int returnCode;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|iszOII", kwlist, &port, &host, &path, &roi, &decimation, &max_pending))
+    {
+        return -1;
+    }
+    if (ids_socket_startup() != 0)
+    {
+        return -1;
+    }
+
+    memset(&request, 0, sizeof(request));
+    request.magic = STREAM_REQUEST_MAGIC;
+    request.version = STREAM_VERSION;
+    request.decimation = decimation;
+    request.max_pending = max_pending;
+    if (roi != Py_None && !PyArg_ParseTuple(roi, "iiii", &request.x, &request.y, &request.width, &request.height))
+    {
+        return -1;
+    }
+
+    if (path != NULL)
+    {
+#ifdef _WIN32
+        PyErr_SetString(PyExc_NotImplementedError, "Unix-domain sockets are not supported on this platform");
+        return -1;
+#else
+        struct sockaddr_un local;
+
+        if (strlen(path) >= sizeof(local.sun_path))
+        {
+            PyErr_SetString(PyExc_ValueError, "Socket path is too long");
+            return -1;
+        }
+        memset(&local, 0, sizeof(local));
+        local.sun_family = AF_UNIX;
+        strcpy(local.sun_path, path);
+        self->sock = socket(AF_UNIX, SOCK_STREAM, 0);
+        Py_BEGIN_ALLOW_THREADS
+        returnCode = connect(self->sock, (struct sockaddr *)&local, sizeof(local));
+        Py_END_ALLOW_THREADS
+#endif
+    }
+    else
+    {
+        struct sockaddr_in address;
+
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons((unsigned short)port);
+        if (inet_pton(AF_INET, host, &address.sin_addr) != 1)
+        {
+            PyErr_Format(PyExc_ValueError, "Invalid IPv4 address '%s'", host);
+            return -1;
+        }
+        self->sock = socket(AF_INET, SOCK_STREAM, 0);
+        Py_BEGIN_ALLOW_THREADS
+        returnCode = connect(self->sock, (struct sockaddr *)&address, sizeof(address));
+        Py_END_ALLOW_THREADS
+    }
+
+    if (self->sock == INVALID_IDS_SOCKET || returnCode != 0)
+    {
+        PyErr_SetString(PyExc_IOError, "Unable to connect to stream server");
+        return -1;
+    }
+
+    if (send(self->sock, (const char *)&request, sizeof(request), MSG_NOSIGNAL) != sizeof(request))
+    {
+        PyErr_SetString(PyExc_IOError, "Unable to subscribe to stream server");
+        return -1;
+    }
+
+    return 0;
+}
+
+PyObject * stream_client_new
+(
+    PyTypeObject * type,
+    PyObject * args,
+    PyObject * kwds
+)
+{
+    StreamClient * self;
+
+    self = (StreamClient *)type->tp_alloc(type, 0);
+    if (self != NULL)
+    {
+        self->sock = INVALID_IDS_SOCKET;
+    }
+    return (PyObject *)self;
+}
+
+void stream_client_dealloc(StreamClient * self)
+{
+    PyTypeObject * type = Py_TYPE(self);
+
+    if (self->sock != INVALID_IDS_SOCKET)
+    {
+        close_socket(self->sock);
+    }
+    type->tp_free((PyObject *)self);
+    Py_DECREF(type);
+}
+
+PyObject * stream_client_close(StreamClient * self)
+{
+    if (self->sock != INVALID_IDS_SOCKET)
+    {
+        close_socket(self->sock);
+        self->sock = INVALID_IDS_SOCKET;
+    }
+    Py_RETURN_NONE;
+}
+
+/*
+ * Receives the next frame from the server
+ * @arg timeout Seconds to wait, None to block
+ * @return A tuple (image, info), or None on timeout
+ */
+PyObject * stream_client_get_frame(StreamClient * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"timeout", NULL};
+    StreamFrameHeader header;
+    PyObject * timeout = Py_None;
+    PyObject * img;
+    PyObject * info;
+    PyObject * returnObj;
+    npy_intp dimensions[3];
+    int timeout_ms = -1;
+    int returnCode;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &timeout))
+    {
+        return NULL;
+    }
+    if (timeout != Py_None)
+    {
+        timeout_ms = (int)(PyFloat_AsDouble(timeout) * 1000);
+        if (PyErr_Occurred())
+        {
+            return NULL;
+        }
+    }
+    if (self->sock == INVALID_IDS_SOCKET)
+    {
+        PyErr_SetString(PyExc_IOError, "Stream client is closed");
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    returnCode = ids_socket_wait_readable(self->sock, timeout_ms);
+    if (returnCode > 0)
+    {
+        returnCode = ids_socket_recv_all(self->sock, (char *)&header, sizeof(header)) == 0 ? 1 : -1;
+    }
+    Py_END_ALLOW_THREADS
+
+    if (returnCode == 0)
+    {
+        Py_RETURN_NONE;
+    }
+    if (returnCode < 0)
+    {
+        PyErr_SetString(PyExc_IOError, "Stream connection lost");
+        return NULL;
+    }
+    if (!stream_header_valid(&header))
+    {
+        /* The rest of the stream cannot be trusted either */
+        close_socket(self->sock);
+        self->sock = INVALID_IDS_SOCKET;
+        PyErr_SetString(PyExc_IOError, "Stream sent a malformed frame header");
+        return NULL;
+    }
+
+    dimensions[0] = header.height;
+    dimensions[1] = header.width;
+    dimensions[2] = header.bytes_per_pixel;
+    img = PyArray_SimpleNew(header.bytes_per_pixel == 1 ? 2 : 3, dimensions, NPY_UINT8);
+    if (img == NULL)
+    {
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    returnCode = ids_socket_recv_all(self->sock, PyArray_BYTES((PyArrayObject *)img), header.payload_size);
+    Py_END_ALLOW_THREADS
+
+    if (returnCode != 0)
+    {
+        Py_DECREF(img);
+        PyErr_SetString(PyExc_IOError, "Stream connection lost");
+        return NULL;
+    }
+
+    info = Py_BuildValue("{s:K,s:K,s:K,s:I,s:I,s:I,s:I}",
+            "sequence", header.sequence,
+            "frame_number", header.frame_number,
+            "timestamp_device", header.timestamp_device,
+            "color_mode", header.color_mode,
+            "dropped", header.dropped,
+            "height", header.height,
+            "width", header.width);
+    if (info == NULL)
+    {
+        Py_DECREF(img);
+        return NULL;
+    }
+
+    returnObj = Py_BuildValue("(OO)", img, info);
+    Py_DECREF(img);
+    Py_DECREF(info);
+    return returnObj;
+}
+
+/**
+  * Declaration of all the publicly accessible functions of the StreamServer Object
+  */
+PyMethodDef stream_server_methods[] = {
+    {"close", (PyCFunction)stream_server_close, METH_NOARGS,
+     "Disconnect every client and stop serving frames"
+    },
+    {"stats", (PyCFunction)stream_server_stats, METH_NOARGS,
+     "Returns a list of per-client counters"
+    },
+    {NULL} /* Sentinel */
+};
+
+PyGetSetDef stream_server_properties[] = {
+    {"port", (getter)stream_server_get_port, NULL, "TCP port the server listens on", NULL},
+    {"path", (getter)stream_server_get_path, NULL, "Unix-domain socket path the server listens on", NULL},
+    {NULL} /* Sentinel */
+};
+
+/**
+  * Declaration of all the publicly accessible functions of the StreamClient Object
+  */
+PyMethodDef stream_client_methods[] = {
+    {"get_frame", (PyCFunction)stream_client_get_frame, METH_VARARGS | METH_KEYWORDS,
+     "Receive the next frame as (image, info)"
+    },
+    {"close", (PyCFunction)stream_client_close, METH_NOARGS,
+     "Disconnect from the server"
+    },
+    {NULL} /* Sentinel */
+};
+
+static PyType_Slot stream_server_slots[] = {
+    {Py_tp_dealloc, (void *)stream_server_dealloc},
+    {Py_tp_doc, (void *)"Serves frames of a Camera over TCP or a Unix-domain socket"},
+    {Py_tp_methods, stream_server_methods},
+    {Py_tp_getset, stream_server_properties},
+    {0, NULL} /* Sentinel */
+};
+
+PyType_Spec ids_StreamServerSpec = {
+    "ids.StreamServer",        /* name */
+    sizeof(StreamServer),      /* basicsize */
+    0,                         /* itemsize */
+    IDS_TPFLAGS | Py_TPFLAGS_DISALLOW_INSTANTIATION, /* flags */
+    stream_server_slots,       /* slots */
+};
+
+static PyType_Slot stream_client_slots[] = {
+    {Py_tp_dealloc, (void *)stream_client_dealloc},
+    {Py_tp_doc, (void *)"Receives frames from a StreamServer"},
+    {Py_tp_methods, stream_client_methods},
+    {Py_tp_init, (void *)stream_client_init},
+    {Py_tp_new, (void *)stream_client_new},
+    {0, NULL} /* Sentinel */
+};
+
+PyType_Spec ids_StreamClientSpec = {
+    "ids.StreamClient",        /* name */
+    sizeof(StreamClient),      /* basicsize */
+    0,                         /* itemsize */
+    IDS_TPFLAGS,               /* flags */
+    stream_client_slots,       /* slots */
+};
@@ -0,0 +1,600 @@
+#ifndef _WIN32
+/* For the CPU affinity interface */
+#define _GNU_SOURCE 1
+#endif
+#include <uEye.h>
+#include "ids.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifndef _WIN32
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+/**
+  * Trampoline used to adapt ids_thread_func to the native thread entry point
+  */
+typedef struct
+{
+    ids_thread_func func;
+    void *          arg;
+} ThreadStart;
+
+#ifdef _WIN32
+static DWORD WINAPI thread_entry(LPVOID param)
+#else
+static void * thread_entry(void * param)
+#endif
+{
+    ThreadStart start = *(ThreadStart *)param;
+    free(param);
+    start.func(start.arg);
+    trace_thread_exit();
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+int ids_thread_start(ids_thread_t * thread, ids_thread_func func, void * arg)
+{
+    ThreadStart * start = (ThreadStart *)malloc(sizeof(ThreadStart));
+    if (start == NULL)
+    {
+        return -1;
+    }
+    start->func = func;
+    start->arg = arg;
+
+#ifdef _WIN32
+    *thread = CreateThread(NULL, 0, thread_entry, start, 0, NULL);
+    if (*thread == NULL)
+    {
+        free(start);
+        return -1;
+    }
+#else
+    if (pthread_create(thread, NULL, thread_entry, start) != 0)
+    {
+        free(start);
+        return -1;
+    }
+#endif
+    return 0;
+}
+
+void ids_thread_join(ids_thread_t thread)
+{
+#ifdef _WIN32
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_join(thread, NULL);
+#endif
+}
+
+void ids_mutex_init(ids_mutex_t * mutex)
+{
+#ifdef _WIN32
+    InitializeCriticalSection(mutex);
+#else
+    pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+void ids_mutex_destroy(ids_mutex_t * mutex)
+{
+#ifdef _WIN32
+    DeleteCriticalSection(mutex);
+#else
+    pthread_mutex_destroy(mutex);
+#endif
+}
+
+void ids_mutex_lock(ids_mutex_t * mutex)
+{
+#ifdef _WIN32
+    EnterCriticalSection(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+void ids_mutex_unlock(ids_mutex_t * mutex)
+{
+#ifdef _WIN32
+    LeaveCriticalSection(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+void ids_cond_init(ids_cond_t * cond)
+{
+#ifdef _WIN32
+    InitializeConditionVariable(cond);
+#else
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+#endif
+}
+
+void ids_cond_destroy(ids_cond_t * cond)
+{
+#ifndef _WIN32
+    pthread_cond_destroy(cond);
+#endif
+}
+
+void ids_cond_signal(ids_cond_t * cond)
+{
+#ifdef _WIN32
+    WakeConditionVariable(cond);
+#else
+    pthread_cond_signal(cond);
+#endif
+}
+
+void ids_cond_broadcast(ids_cond_t * cond)
+{
+#ifdef _WIN32
+    WakeAllConditionVariable(cond);
+#else
+    pthread_cond_broadcast(cond);
+#endif
+}
+
+int ids_cond_wait(ids_cond_t * cond, ids_mutex_t * mutex, int timeout_ms)
+{
+#ifdef _WIN32
+    if (!SleepConditionVariableCS(cond, mutex, timeout_ms < 0 ? INFINITE : (DWORD)timeout_ms))
+    {
+        return GetLastError() == ERROR_TIMEOUT ? 1 : 0;
+    }
+    return 0;
+#else
+    struct timespec deadline;
+
+    if (timeout_ms < 0)
+    {
+        pthread_cond_wait(cond, mutex);
+        return 0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    return pthread_cond_timedwait(cond, mutex, &deadline) == ETIMEDOUT ? 1 : 0;
+#endif
+}
+
+int64_t ids_monotonic_ns(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+
+    if (frequency.QuadPart == 0)
+    {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&counter);
+    return (int64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000LL
+         + (int64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000LL / frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+#endif
+}
+
+int64_t ids_realtime_ns(void)
+{
+#ifdef _WIN32
+    FILETIME now;
+    ULARGE_INTEGER ticks;
+
+    /* 100ns ticks since 1601 */
+    GetSystemTimePreciseAsFileTime(&now);
+    ticks.LowPart = now.dwLowDateTime;
+    ticks.HighPart = now.dwHighDateTime;
+    return (int64_t)(ticks.QuadPart - 116444736000000000ULL) * 100;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+#endif
+}
+
+void ids_sleep_ms(int milliseconds)
+{
+#ifdef _WIN32
+    Sleep(milliseconds);
+#else
+    struct timespec duration;
+    duration.tv_sec = milliseconds / 1000;
+    duration.tv_nsec = (long)(milliseconds % 1000) * 1000000L;
+    nanosleep(&duration, NULL);
+#endif
+}
+
+void ids_sleep_until_ns(int64_t deadline)
+{
+#ifdef _WIN32
+    static volatile LONG high_resolution = 1;
+    LARGE_INTEGER due;
+    HANDLE timer = NULL;
+    int64_t remaining = deadline - ids_monotonic_ns();
+
+    if (remaining <= 0)
+    {
+        return;
+    }
+    /* CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, Windows 10 1803 and later */
+    if (high_resolution)
+    {
+        timer = CreateWaitableTimerExW(NULL, NULL, 0x00000002, TIMER_ALL_ACCESS);
+        if (timer == NULL)
+        {
+            high_resolution = 0;
+        }
+    }
+    if (timer == NULL)
+    {
+        timer = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+    }
+    if (timer == NULL)
+    {
+        Sleep((DWORD)(remaining / 1000000));
+        return;
+    }
+    /* Relative due time in 100ns ticks */
+    due.QuadPart = -(LONGLONG)(remaining / 100);
+    if (SetWaitableTimer(timer, &due, 0, NULL, NULL, FALSE))
+    {
+        WaitForSingleObject(timer, INFINITE);
+    }
+    CloseHandle(timer);
+#else
+    struct timespec until;
+
+    until.tv_sec = (time_t)(deadline / 1000000000LL);
+    until.tv_nsec = (long)(deadline % 1000000000LL);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) == EINTR)
+    {
+    }
+#endif
+}
+
+/* Granularity every large allocation is rounded up to, the usual huge page size */
+#define LARGE_PAGE_ROUNDING (2u << 20)
+
+/* Most NUMA nodes the node masks below can describe */
+#define MAX_NUMA_NODES 64
+
+static size_t large_round(size_t size)
+{
+    return (size + LARGE_PAGE_ROUNDING - 1) & ~(size_t)(LARGE_PAGE_ROUNDING - 1);
+}
+
+int ids_numa_node_count(void)
+{
+#ifdef _WIN32
+    ULONG highest = 0;
+
+    if (!GetNumaHighestNodeNumber(&highest))
+    {
+        return 1;
+    }
+    return (int)highest + 1;
+#else
+    char path[64];
+    int count = 0;
+
+    while (count < MAX_NUMA_NODES)
+    {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", count);
+        if (access(path, F_OK) != 0)
+        {
+            break;
+        }
+        count++;
+    }
+    return count > 0 ? count : 1;
+#endif
+}
+
+int ids_thread_bind_node(int node)
+{
+#ifdef _WIN32
+    GROUP_AFFINITY affinity;
+
+    if (!GetNumaNodeProcessorMaskEx((USHORT)node, &affinity))
+    {
+        return -1;
+    }
+    return SetThreadGroupAffinity(GetCurrentThread(), &affinity, NULL) ? 0 : -1;
+#else
+    char path[64];
+    cpu_set_t cpus;
+    FILE * file;
+    int first;
+    int last;
+    int cpu;
+    char separator;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return -1;
+    }
+
+    /* The list reads like "0-7,16-23" */
+    CPU_ZERO(&cpus);
+    while (fscanf(file, "%d", &first) == 1)
+    {
+        last = first;
+        separator = (char)fgetc(file);
+        if (separator == '-')
+        {
+            if (fscanf(file, "%d", &last) != 1)
+            {
+                break;
+            }
+            separator = (char)fgetc(file);
+        }
+        for (cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+        {
+            CPU_SET(cpu, &cpus);
+        }
+        if (separator != ',')
+        {
+            break;
+        }
+    }
+    fclose(file);
+
+    if (CPU_COUNT(&cpus) == 0)
+    {
+        return -1;
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0 ? 0 : -1;
+#endif
+}
+
+int ids_cpu_count(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return count > 0 ? (int)count : 1;
+#endif
+}
+
+int ids_thread_set_affinity(const uint64_t * mask)
+{
+#ifdef _WIN32
+    /* Only the first processor group */
+    if (mask[0] == 0)
+    {
+        return EINVAL;
+    }
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)mask[0]) != 0 ? 0 : EINVAL;
+#else
+    cpu_set_t cpus;
+    int cpu;
+
+    CPU_ZERO(&cpus);
+    for (cpu = 0; cpu < IDS_MAX_CPUS && cpu < CPU_SETSIZE; cpu++)
+    {
+        if (mask[cpu / 64] & ((uint64_t)1 << (cpu % 64)))
+        {
+            CPU_SET(cpu, &cpus);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#endif
+}
+
+int ids_thread_set_realtime(int priority)
+{
+#ifdef _WIN32
+    /* Windows has no fixed-priority class per thread, the closest is time critical */
+    return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) ? 0 : EPERM;
+#else
+    struct sched_param param;
+    int low = sched_get_priority_min(SCHED_FIFO);
+    int high = sched_get_priority_max(SCHED_FIFO);
+
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority < low ? low : priority > high ? high : priority;
+    return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+#endif
+}
+
+int ids_memory_lock(void * memory, size_t size)
+{
+#ifdef _WIN32
+    /* Bounded by the working set, which is not raised here */
+    return VirtualLock(memory, size) ? 0 : ENOMEM;
+#else
+    return mlock(memory, size) == 0 ? 0 : errno;
+#endif
+}
+
+void ids_memory_unlock(void * memory, size_t size)
+{
+#ifdef _WIN32
+    VirtualUnlock(memory, size);
+#else
+    munlock(memory, size);
+#endif
+}
+
+void * ids_large_alloc(size_t size, int try_huge, int node, int * huge)
+{
+    void * memory;
+#ifdef _WIN32
+    DWORD type = MEM_RESERVE | MEM_COMMIT;
+    DWORD preferred = node >= 0 ? (DWORD)node : NUMA_NO_PREFERRED_NODE;
+#else
+    unsigned long mask[MAX_NUMA_NODES / (8 * sizeof(unsigned long)) + 1];
+    size_t offset;
+#endif
+
+    size = large_round(size);
+    *huge = 0;
+#ifdef _WIN32
+    /* Large pages need SeLockMemoryPrivilege, without it this fails and normal pages are used */
+    if (try_huge && GetLargePageMinimum() != 0 && size % GetLargePageMinimum() == 0)
+    {
+        memory = VirtualAllocExNuma(GetCurrentProcess(), NULL, size, type | MEM_LARGE_PAGES, PAGE_READWRITE, preferred);
+        if (memory != NULL)
+        {
+            *huge = 1;
+            return memory;
+        }
+    }
+    return VirtualAllocExNuma(GetCurrentProcess(), NULL, size, type, PAGE_READWRITE, preferred);
+#else
+    memory = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (try_huge)
+    {
+        /* The huge pages are reserved here, so touching them below cannot fail */
+        memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        *huge = memory != MAP_FAILED;
+    }
+#endif
+    if (memory == MAP_FAILED)
+    {
+        memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+        {
+            return NULL;
+        }
+#ifdef MADV_HUGEPAGE
+        /* Transparent huge pages, where enabled, before the memory is touched */
+        if (try_huge)
+        {
+            madvise(memory, size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+
+#ifdef SYS_mbind
+    /* MPOL_BIND; a kernel without NUMA support only has node 0 and refuses the call */
+    if (node >= 0 && node < MAX_NUMA_NODES)
+    {
+        memset(mask, 0, sizeof(mask));
+        mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+        syscall(SYS_mbind, memory, size, 2, mask, (unsigned long)MAX_NUMA_NODES + 1, 0);
+    }
+#endif
+
+    /* Fault every page in now, on the bound node, rather than on the first frame written into it */
+    for (offset = 0; offset < size; offset += 4096)
+    {
+        ((volatile char *)memory)[offset] = 0;
+    }
+    return memory;
+#endif
+}
+
+void ids_large_free(void * memory, size_t size)
+{
+    if (memory == NULL)
+    {
+        return;
+    }
+#ifdef _WIN32
+    VirtualFree(memory, 0, MEM_RELEASE);
+#else
+    munmap(memory, large_round(size));
+#endif
+}
+
+long ids_atomic_inc(volatile long * value)
+{
+#ifdef _WIN32
+    return InterlockedIncrement(value);
+#else
+    return __atomic_add_fetch(value, 1, __ATOMIC_SEQ_CST);
+#endif
+}
+
+long ids_atomic_dec(volatile long * value)
+{
+#ifdef _WIN32
+    return InterlockedDecrement(value);
+#else
+    return __atomic_sub_fetch(value, 1, __ATOMIC_SEQ_CST);
+#endif
+}
+
+int64_t ids_atomic_add64(volatile int64_t * value, int64_t delta)
+{
+#ifdef _WIN32
+    return InterlockedExchangeAdd64((volatile LONGLONG *)value, delta) + delta;
+#else
+    return __atomic_add_fetch(value, delta, __ATOMIC_SEQ_CST);
+#endif
+}
+
+int64_t ids_atomic_load64(volatile int64_t * value)
+{
+#ifdef _WIN32
+    return InterlockedCompareExchange64((volatile LONGLONG *)value, 0, 0);
+#else
+    return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+void ids_atomic_store64(volatile int64_t * value, int64_t new_value)
+{
+#ifdef _WIN32
+    InterlockedExchange64((volatile LONGLONG *)value, new_value);
+#else
+    __atomic_store_n(value, new_value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+void ids_atomic_max64(volatile int64_t * value, int64_t candidate)
+{
+    int64_t current = ids_atomic_load64(value);
+
+    while (candidate > current)
+    {
+#ifdef _WIN32
+        int64_t seen = InterlockedCompareExchange64((volatile LONGLONG *)value, candidate, current);
+        if (seen == current)
+        {
+            break;
+        }
+        current = seen;
+#else
+        if (__atomic_compare_exchange_n(value, &current, candidate, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+        {
+            break;
+        }
+#endif
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#ifndef IDS_THREAD_H_INCLUDED
+#define IDS_THREAD_H_INCLUDED
+
+/*
+ * Thin portability layer over the native threading, atomic and clock
+ * primitives used by the capture engine. Everything in here is callable
+ * without holding the GIL. Included through ids.h.
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#endif
+
+#ifdef _WIN32
+typedef HANDLE              ids_thread_t;
+typedef CRITICAL_SECTION    ids_mutex_t;
+typedef CONDITION_VARIABLE  ids_cond_t;
+#else
+typedef pthread_t           ids_thread_t;
+typedef pthread_mutex_t     ids_mutex_t;
+typedef pthread_cond_t      ids_cond_t;
+#endif
+
+typedef void (*ids_thread_func)(void * arg);
+
+int  ids_thread_start(ids_thread_t * thread, ids_thread_func func, void * arg);
+void ids_thread_join(ids_thread_t thread);
+
+void ids_mutex_init(ids_mutex_t * mutex);
+void ids_mutex_destroy(ids_mutex_t * mutex);
+void ids_mutex_lock(ids_mutex_t * mutex);
+void ids_mutex_unlock(ids_mutex_t * mutex);
+
+void ids_cond_init(ids_cond_t * cond);
+void ids_cond_destroy(ids_cond_t * cond);
+void ids_cond_signal(ids_cond_t * cond);
+void ids_cond_broadcast(ids_cond_t * cond);
+
+/*
+ * Waits on the condition for at most timeout_ms milliseconds
+ * @return 0 when signalled, 1 on timeout
+ */
+int  ids_cond_wait(ids_cond_t * cond, ids_mutex_t * mutex, int timeout_ms);
+
+/* Monotonic clock in nanoseconds, unrelated to wall-clock time */
+int64_t ids_monotonic_ns(void);
+/* Nanoseconds since the Unix epoch */
+int64_t ids_realtime_ns(void);
+void    ids_sleep_ms(int milliseconds);
+/* Sleeps until the monotonic clock reaches deadline, returns at once if it has */
+void    ids_sleep_until_ns(int64_t deadline);
+
+/*
+ * Page-aligned, zeroed and pre-faulted allocation for large buffers, backed
+ * by huge pages where the OS grants them and by normal pages otherwise
+ * @arg node NUMA node to place the memory on, -1 for the default policy
+ * @arg huge Set to 1 when the memory is backed by huge pages
+ * @note Free with ids_large_free and the same size
+ */
+void *  ids_large_alloc(size_t size, int try_huge, int node, int * huge);
+void    ids_large_free(void * memory, size_t size);
+
+/* Number of NUMA nodes, 1 on machines without NUMA */
+int     ids_numa_node_count(void);
+/* Restricts the calling thread to the CPUs of a NUMA node, 0 on success */
+int     ids_thread_bind_node(int node);
+
+/* CPUs a thread can be restricted to with ids_thread_set_affinity */
+#define IDS_MAX_CPUS 256
+
+/*
+ * Scheduling and paging controls for the calling thread. Each returns 0 on
+ * success or an errno value, typically EPERM without the privilege.
+ */
+int     ids_cpu_count(void);
+int     ids_thread_set_affinity(const uint64_t * mask);
+int     ids_thread_set_realtime(int priority);
+int     ids_memory_lock(void * memory, size_t size);
+void    ids_memory_unlock(void * memory, size_t size);
+
+/* Atomic helpers, all sequentially consistent */
+long    ids_atomic_inc(volatile long * value);
+long    ids_atomic_dec(volatile long * value);
+int64_t ids_atomic_add64(volatile int64_t * value, int64_t delta);
+int64_t ids_atomic_load64(volatile int64_t * value);
+void    ids_atomic_store64(volatile int64_t * value, int64_t new_value);
+void    ids_atomic_max64(volatile int64_t * value, int64_t candidate);
+
+#endif
@@ -0,0 +1,1518 @@
+#include <uEye.h>
+#include "ids.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#define PY_ARRAY_UNIQUE_SYMBOL ids_ARRAY_API
+#define NO_IMPORT_ARRAY
+#include <numpy/arrayobject.h>
+
+/*
+ * BigTIFF layout (little-endian):
+ *
+ *   16 byte header, then every page as
+ *   IFD (TIFF_TAGS entries) | DateTime | ImageDescription | pixels
+ *
+ * Pages of one file all have the same size, so every IFD offset is known
+ * before the frame arrives and the file is written front to back. Only the
+ * next-IFD link of the last page is patched when recording stops early.
+ */
+#define TIFF_HEADER_BYTES      16
+#define TIFF_TAGS              13
+#define TIFF_ENTRY_BYTES       20
+#define TIFF_IFD_BYTES         (8 + TIFF_TAGS * TIFF_ENTRY_BYTES + 8)
+#define TIFF_DATETIME_BYTES    24
+/* Per-page metadata, JSON with the keys of the get_image info */
+#define TIFF_DESCRIPTION_BYTES 512
+#define TIFF_PAGE_HEADER_BYTES (TIFF_IFD_BYTES + TIFF_DATETIME_BYTES + TIFF_DESCRIPTION_BYTES)
+
+#define TIFF_SHORT             3
+#define TIFF_LONG              4
+#define TIFF_ASCII             2
+#define TIFF_LONG8             16
+
+/* Retained frames waiting for the packing thread */
+#define TIFF_QUEUE             32
+/* Staging blocks between the packing and the writing thread */
+#define TIFF_BLOCKS            4
+#define TIFF_BLOCK_BYTES       (8 << 20)
+/* Unbuffered writes are padded to this, the file is truncated afterwards */
+#define TIFF_ALIGN             4096
+#define TIFF_POLL_MS           100
+
+#ifdef _WIN32
+#define TIFF_OPEN_FLAGS        (_O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY)
+#else
+#define TIFF_OPEN_FLAGS        (O_WRONLY | O_CREAT | O_TRUNC)
+#endif
+
+/*
+ * A staging block, a run of bytes of one file
+ */
+typedef struct
+{
+    char *             data;
+    int                file;
+    uint64_t           offset;
+    size_t             bytes;
+    /* Last block of its file: truncate the file to offset + bytes and close it */
+    int                last;
+    /* Next-IFD link to zero before closing, 0 for none */
+    uint64_t           patch;
+} TiffBlock;
+
+/*
+ * Struct that defines the TiffWriter class. A frame sink queues retained
+ * slots; the packing thread lays the pages out in the staging blocks and
+ * unlocks the SDK buffers; the writing thread puts the blocks on disk.
+ */
+typedef struct
+{
+    PyObject_HEAD
+    Camera *           camera;
+    char *             path;
+    int                split;
+    int                attached;
+    int                started;
+
+    /* Page layout, fixed when recording starts */
+    int                width;
+    int                height;
+    int                color;
+    int                samples;
+    int                bits;
+    int                source_bytes;
+    int                swap;
+    size_t             row_bytes;
+    uint64_t           page_bytes;
+    int64_t            pages_per_file;
+    int64_t            frame_limit;
+
+    ids_mutex_t        lock;
+    ids_cond_t         queued;
+    ids_cond_t         freed;
+    volatile int       running;
+    FrameSlot *        queue[TIFF_QUEUE];
+    int                queue_head;
+    int                queue_count;
+    int64_t            accepted;
+    int                free_blocks[TIFF_BLOCKS];
+    int                free_count;
+    int                filled[TIFF_BLOCKS];
+    int                filled_head;
+    int                filled_count;
+    int                packing_done;
+    char *             memory;
+    size_t             memory_size;
+    int                huge_pages;
+    TiffBlock          blocks[TIFF_BLOCKS];
+    ids_thread_t       pack_thread;
+    ids_thread_t       write_thread;
+
+    /* Only touched by the packing thread */
+    int                current;
+    int                file_index;
+    uint64_t           file_offset;
+    int64_t            file_pages;
+    uint64_t           last_link;
+    char *             row;
+
+    /* Only touched by the writing thread, after record_tiff opened the first file */
+    int                fd;
+    int                fd_file;
+    volatile int       direct;
+
+    volatile int       done;
+    volatile int       error;
+    volatile int64_t   frames_written;
+    volatile int64_t   frames_dropped;
+    volatile int64_t   bytes_written;
+    volatile long      files;
+    int64_t            started_ns;
+    volatile int64_t   finished_ns;
+} TiffWriter;
+
+/**
+  * Samples written per pixel for a color mode
+  * @return 0 when the mode can be written, -1 otherwise
+  */
+static int tiff_format(int color, int bitdepth, int * samples, int * bits, int * source_bytes, int * swap)
+{
+    *swap = 0;
+    *source_bytes = (bitdepth + 7) / 8;
+    switch (color)
+    {
+        case IS_CM_MONO8:
+        case IS_CM_SENSOR_RAW8:
+            *samples = 1;
+            *bits = 8;
+            return 0;
+        case IS_CM_MONO10:
+        case IS_CM_MONO12:
+        case IS_CM_MONO16:
+            *samples = 1;
+            *bits = 16;
+            return 0;
+        case IS_CM_BGR8_PACKED:
+        case IS_CM_BGRA8_PACKED:
+            *swap = 1;
+            /* fall through */
+        case IS_CM_RGB8_PACKED:
+        case IS_CM_RGBA8_PACKED:
+            /* The fourth byte of the 32 bit modes is padding and is dropped */
+            *samples = 3;
+            *bits = 8;
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+/**
+  * Path of the index-th file, <stem>_<index><ext> when splitting
+  */
+static void tiff_file_path(TiffWriter * self, int index, char * buffer, size_t size)
+{
+    const char * dot = strrchr(self->path, '.');
+    const char * slash = strrchr(self->path, '/');
+    const char * backslash = strrchr(self->path, '\\');
+    size_t stem;
+
+    if (!self->split)
+    {
+        snprintf(buffer, size, "%s", self->path);
+        return;
+    }
+    if (dot == NULL || (slash != NULL && dot < slash) || (backslash != NULL && dot < backslash))
+    {
+        dot = self->path + strlen(self->path);
+    }
+    stem = (size_t)(dot - self->path);
+    snprintf(buffer, size, "%.*s_%04d%s", (int)stem, self->path, index, dot);
+}
+
+static int tiff_open(const char * path, int direct)
+{
+#ifdef O_DIRECT
+    if (direct)
+    {
+        return open(path, TIFF_OPEN_FLAGS | O_DIRECT, 0644);
+    }
+#endif
+    return open(path, TIFF_OPEN_FLAGS, 0644);
+}
+
+static int tiff_pwrite(int fd, const char * data, size_t bytes, uint64_t offset)
+{
+    long written;
+
+    while (bytes > 0)
+    {
+#ifdef _WIN32
+        if (_lseeki64(fd, (int64_t)offset, SEEK_SET) < 0)
+        {
+            return -1;
+        }
+        written = _write(fd, data, (unsigned int)bytes);
+#else
+        written = (long)pwrite(fd, data, bytes, (off_t)offset);
+#endif
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        data += written;
+        bytes -= written;
+        offset += written;
+    }
+    return 0;
+}
+
+/**
+  * Truncates a finished file to its size, zeroes the link of its last page
+  * and closes it. The patch goes through a buffered descriptor since
+  * unbuffered writes must cover whole sectors.
+  * @return 0 on success, -1 with errno set
+  */
+static int tiff_close_file(const char * path, int fd, uint64_t size, uint64_t patch)
+{
+    uint64_t zero = 0;
+    int failed;
+
+    failed = close(fd) != 0;
+    fd = open(path, O_WRONLY
+#ifdef _WIN32
+            | _O_BINARY
+#endif
+            );
+    if (fd < 0)
+    {
+        return -1;
+    }
+#ifdef _WIN32
+    failed |= _chsize_s(fd, (int64_t)size) != 0;
+#else
+    failed |= ftruncate(fd, (off_t)size) != 0;
+#endif
+    if (patch != 0)
+    {
+        failed |= tiff_pwrite(fd, (const char *)&zero, sizeof(zero), patch) != 0;
+    }
+    failed |= close(fd) != 0;
+    return failed ? -1 : 0;
+}
+
+/**
+  * Reserves the space of a file up front so the file system does not
+  * allocate it extent by extent while the frames stream in
+  */
+static void tiff_preallocate(TiffWriter * self, int fd, int file)
+{
+#if defined(__linux__)
+    int64_t pages = self->pages_per_file;
+    int64_t remaining;
+
+    if (self->frame_limit > 0)
+    {
+        remaining = self->frame_limit - (int64_t)file * (self->pages_per_file > 0 ? self->pages_per_file : 0);
+        if (pages <= 0 || remaining < pages)
+        {
+            pages = remaining;
+        }
+    }
+    if (pages > 0)
+    {
+        posix_fallocate(fd, 0, (off_t)(TIFF_HEADER_BYTES + pages * self->page_bytes));
+    }
+#endif
+}
+
+/**
+  * Writing thread: puts the filled blocks on disk in order, opening and
+  * closing the files as the blocks cross from one into the next
+  */
+static void tiff_write_main(void * arg)
+{
+    TiffWriter * self = (TiffWriter *)arg;
+    TiffBlock * block;
+    char path[4096];
+    size_t bytes;
+    int index;
+    int failed;
+
+    trace_thread_name("ids tiff writer");
+    thread_options_apply(self->camera, THREAD_WRITER);
+
+    ids_mutex_lock(&self->lock);
+    for (;;)
+    {
+        if (self->filled_count == 0)
+        {
+            if (self->packing_done)
+            {
+                break;
+            }
+            ids_cond_wait(&self->queued, &self->lock, TIFF_POLL_MS);
+            continue;
+        }
+        index = self->filled[self->filled_head];
+        self->filled_head = (self->filled_head + 1) % TIFF_BLOCKS;
+        self->filled_count--;
+        ids_mutex_unlock(&self->lock);
+
+        block = &self->blocks[index];
+        failed = 0;
+        if (self->error == 0 && block->file != self->fd_file)
+        {
+            tiff_file_path(self, block->file, path, sizeof(path));
+            self->fd = tiff_open(path, self->direct);
+            self->fd_file = block->file;
+            failed = self->fd < 0;
+            if (!failed)
+            {
+                ids_atomic_inc(&self->files);
+                tiff_preallocate(self, self->fd, block->file);
+            }
+        }
+        if (self->error == 0 && !failed && block->bytes > 0)
+        {
+            bytes = block->bytes;
+            if (self->direct)
+            {
+                bytes = (bytes + TIFF_ALIGN - 1) & ~(size_t)(TIFF_ALIGN - 1);
+            }
+            failed = tiff_pwrite(self->fd, block->data, bytes, block->offset) != 0;
+#if defined(O_DIRECT) && !defined(_WIN32)
+            if (failed && errno == EINVAL && self->direct)
+            {
+                /* The file system refuses unbuffered writes after all */
+                self->direct = 0;
+                fcntl(self->fd, F_SETFL, fcntl(self->fd, F_GETFL) & ~O_DIRECT);
+                failed = tiff_pwrite(self->fd, block->data, block->bytes, block->offset) != 0;
+            }
+#endif
+            if (!failed)
+            {
+                ids_atomic_add64(&self->bytes_written, (int64_t)block->bytes);
+            }
+        }
+        if (self->error == 0 && !failed && block->last)
+        {
+            tiff_file_path(self, block->file, path, sizeof(path));
+            failed = tiff_close_file(path, self->fd, block->offset + block->bytes, block->patch) != 0;
+            self->fd = -1;
+        }
+        if (failed && self->error == 0)
+        {
+            self->error = errno ? errno : EIO;
+        }
+
+        ids_mutex_lock(&self->lock);
+        self->free_blocks[self->free_count++] = index;
+        ids_cond_broadcast(&self->freed);
+    }
+    ids_mutex_unlock(&self->lock);
+
+    if (self->fd >= 0)
+    {
+        close(self->fd);
+        self->fd = -1;
+    }
+    self->finished_ns = ids_monotonic_ns();
+    self->done = 1;
+    trace_thread_exit();
+}
+
+/**
+  * Hands the current block to the writing thread
+  */
+static void tiff_submit(TiffWriter * self, int last, uint64_t patch)
+{
+    self->blocks[self->current].last = last;
+    self->blocks[self->current].patch = patch;
+    ids_mutex_lock(&self->lock);
+    self->filled[(self->filled_head + self->filled_count) % TIFF_BLOCKS] = self->current;
+    self->filled_count++;
+    ids_cond_broadcast(&self->queued);
+    ids_mutex_unlock(&self->lock);
+    self->current = -1;
+}
+
+/**
+  * Takes a free block for the bytes from file_offset on, waiting for the
+  * writing thread to return one
+  */
+static void tiff_take_block(TiffWriter * self)
+{
+    TiffBlock * block;
+
+    ids_mutex_lock(&self->lock);
+    while (self->free_count == 0)
+    {
+        ids_cond_wait(&self->freed, &self->lock, TIFF_POLL_MS);
+    }
+    self->current = self->free_blocks[--self->free_count];
+    ids_mutex_unlock(&self->lock);
+
+    block = &self->blocks[self->current];
+    block->file = self->file_index;
+    block->offset = self->file_offset;
+    block->bytes = 0;
+}
+
+/**
+  * Appends bytes to the current file
+  */
+static void tiff_emit(TiffWriter * self, const char * data, size_t bytes)
+{
+    TiffBlock * block;
+    size_t count;
+
+    while (bytes > 0)
+    {
+        if (self->current < 0)
+        {
+            tiff_take_block(self);
+        }
+        block = &self->blocks[self->current];
+        count = TIFF_BLOCK_BYTES - block->bytes;
+        count = count < bytes ? count : bytes;
+        memcpy(block->data + block->bytes, data, count);
+        block->bytes += count;
+        self->file_offset += count;
+        data += count;
+        bytes -= count;
+        if (block->bytes == TIFF_BLOCK_BYTES)
+        {
+            tiff_submit(self, 0, 0);
+        }
+    }
+}
+
+/**
+  * Starts the next file with its header
+  */
+static void tiff_begin_file(TiffWriter * self)
+{
+    char header[TIFF_HEADER_BYTES];
+    uint16_t magic = 43;
+    uint16_t offset_size = 8;
+    uint16_t reserved = 0;
+    uint64_t first = TIFF_HEADER_BYTES;
+
+    header[0] = 'I';
+    header[1] = 'I';
+    memcpy(header + 2, &magic, 2);
+    memcpy(header + 4, &offset_size, 2);
+    memcpy(header + 6, &reserved, 2);
+    memcpy(header + 8, &first, 8);
+    self->file_offset = 0;
+    self->file_pages = 0;
+    self->last_link = 8;
+    tiff_emit(self, header, sizeof(header));
+}
+
+/**
+  * Closes the current file, unlinking its last page when more were planned
+  */
+static void tiff_end_file(TiffWriter * self, int complete)
+{
+    if (self->current < 0)
+    {
+        tiff_take_block(self);
+    }
+    tiff_submit(self, 1, complete ? 0 : self->last_link);
+    self->file_index++;
+}
+
+static char * tiff_entry(char * p, uint16_t tag, uint16_t type, uint64_t count, uint64_t value)
+{
+    memcpy(p, &tag, 2);
+    memcpy(p + 2, &type, 2);
+    memcpy(p + 4, &count, 8);
+    memcpy(p + 12, &value, 8);
+    return p + TIFF_ENTRY_BYTES;
+}
+
+static const char * tiff_gate_roles[] = {"none", "pre", "trigger", "post"};
+
+/**
+  * Lays out the IFD, date and description of the page at offset
+  */
+static void tiff_page_header(TiffWriter * self, FrameSlot * slot, char * header, uint64_t offset, uint64_t next)
+{
+    const UEYEIMAGEINFO * info = &slot->info;
+    const UEYETIME * time = &info->TimestampSystem;
+    uint64_t datetime = offset + TIFF_IFD_BYTES;
+    uint64_t description = datetime + TIFF_DATETIME_BYTES;
+    uint64_t bits = self->samples == 1 ? (uint64_t)self->bits : (uint64_t)self->bits * 0x0001000100010001ULL;
+    uint64_t count = TIFF_TAGS;
+    char * text = header + TIFF_IFD_BYTES + TIFF_DATETIME_BYTES;
+    char host[64];
+    char realtime[64];
+    int used;
+    char * p;
+
+    memset(header, 0, TIFF_PAGE_HEADER_BYTES);
+    memcpy(header, &count, 8);
+    p = header + 8;
+    p = tiff_entry(p, 256, TIFF_LONG, 1, self->width);
+    p = tiff_entry(p, 257, TIFF_LONG, 1, self->height);
+    p = tiff_entry(p, 258, TIFF_SHORT, self->samples, bits & (((uint64_t)1 << (16 * self->samples)) - 1));
+    p = tiff_entry(p, 259, TIFF_SHORT, 1, 1);
+    p = tiff_entry(p, 262, TIFF_SHORT, 1, self->samples == 1 ? 1 : 2);
+    p = tiff_entry(p, 270, TIFF_ASCII, TIFF_DESCRIPTION_BYTES, description);
+    p = tiff_entry(p, 273, TIFF_LONG8, 1, offset + TIFF_PAGE_HEADER_BYTES);
+    p = tiff_entry(p, 277, TIFF_SHORT, 1, self->samples);
+    p = tiff_entry(p, 278, TIFF_LONG, 1, self->height);
+    p = tiff_entry(p, 279, TIFF_LONG8, 1, (uint64_t)self->row_bytes * self->height);
+    p = tiff_entry(p, 284, TIFF_SHORT, 1, 1);
+    p = tiff_entry(p, 305, TIFF_ASCII, 4, 0x736469); /* "ids" */
+    p = tiff_entry(p, 306, TIFF_ASCII, 20, datetime);
+    memcpy(p, &next, 8);
+
+    /* DateTime is exactly 20 bytes, so every field is held to its width */
+    snprintf(header + TIFF_IFD_BYTES, 20, "%04u:%02u:%02u %02u:%02u:%02u",
+            time->wYear % 10000u, time->wMonth % 100u, time->wDay % 100u,
+            time->wHour % 100u, time->wMinute % 100u, time->wSecond % 100u);
+
+    if (slot->host_ns != 0)
+    {
+        snprintf(host, sizeof(host), "%lld", (long long)slot->host_ns);
+        snprintf(realtime, sizeof(realtime), "%lld", (long long)(slot->host_ns + clock_realtime_offset(self->camera)));
+    }
+    else
+    {
+        strcpy(host, "null");
+        strcpy(realtime, "null");
+    }
+    used = snprintf(text, TIFF_DESCRIPTION_BYTES,
+            "{\"sequence\":%llu,\"frame_number\":%llu,"
+            "\"timestamp\":\"%04u-%02u-%02uT%02u:%02u:%02u.%03u\",\"timestamp_device\":%llu,"
+            "\"timestamp_ns\":%s,\"timestamp_realtime_ns\":%s,"
+            "\"digital_input\":%u,\"gpio1\":%u,\"gpio2\":%u,"
+            "\"camera_buffers\":%u,\"used_camera_buffers\":%u,\"height\":%d,\"width\":%d",
+            (unsigned long long)slot->sequence, (unsigned long long)info->u64FrameNumber,
+            time->wYear, time->wMonth, time->wDay, time->wHour, time->wMinute, time->wSecond, time->wMilliseconds,
+            (unsigned long long)info->u64TimestampDevice, host, realtime,
+            (unsigned int)(info->dwIoStatus & 4), (unsigned int)(info->dwIoStatus & 2), (unsigned int)(info->dwIoStatus & 1),
+            (unsigned int)info->dwImageBuffers, (unsigned int)info->dwImageBuffersInUse, self->height, self->width);
+    if (slot->bracket_index >= 0 && used < TIFF_DESCRIPTION_BYTES)
+    {
+        used += snprintf(text + used, TIFF_DESCRIPTION_BYTES - used, ",\"bracket\":{\"index\":%d,\"exposure\":%.17g,\"gain\":%d}",
+                slot->bracket_index, slot->bracket_exposure, slot->bracket_gain);
+    }
+    if (slot->gate_role != GATE_NONE && used < TIFF_DESCRIPTION_BYTES)
+    {
+        used += snprintf(text + used, TIFF_DESCRIPTION_BYTES - used, ",\"gate\":{\"role\":\"%s\",\"event\":%lld,\"score\":%.17g}",
+                tiff_gate_roles[slot->gate_role], (long long)slot->gate_event, slot->gate_score);
+    }
+    if (slot->timelapse_index >= 0 && used < TIFF_DESCRIPTION_BYTES)
+    {
+        used += snprintf(text + used, TIFF_DESCRIPTION_BYTES - used, ",\"timelapse\":{\"index\":%lld,\"deadline_ns\":%lld}",
+                (long long)slot->timelapse_index, (long long)slot->timelapse_deadline_ns);
+    }
+    if (used < TIFF_DESCRIPTION_BYTES)
+    {
+        snprintf(text + used, TIFF_DESCRIPTION_BYTES - used, "}");
+    }
+}
+
+/**
+  * Appends one frame as a page, tightly packed and in RGB order
+  */
+static void tiff_write_page(TiffWriter * self, FrameSlot * slot)
+{
+    char header[TIFF_PAGE_HEADER_BYTES];
+    const uint8_t * source;
+    uint8_t * row;
+    uint64_t offset;
+    uint64_t next;
+    int x, y;
+
+    if (self->pages_per_file > 0 && self->file_pages == self->pages_per_file)
+    {
+        tiff_end_file(self, 1);
+        tiff_begin_file(self);
+    }
+    offset = self->file_offset;
+    next = self->file_pages + 1 == self->pages_per_file ? 0 : offset + self->page_bytes;
+    tiff_page_header(self, slot, header, offset, next);
+    tiff_emit(self, header, sizeof(header));
+
+    if (self->samples == 1 || (self->source_bytes == 3 && !self->swap))
+    {
+        if ((size_t)slot->ring->pitch == self->row_bytes)
+        {
+            tiff_emit(self, slot->pBuffer, self->row_bytes * self->height);
+        }
+        else
+        {
+            for (y = 0; y < self->height; y++)
+            {
+                tiff_emit(self, slot->pBuffer + (size_t)y * slot->ring->pitch, self->row_bytes);
+            }
+        }
+    }
+    else
+    {
+        row = (uint8_t *)self->row;
+        for (y = 0; y < self->height; y++)
+        {
+            source = (const uint8_t *)slot->pBuffer + (size_t)y * slot->ring->pitch;
+            for (x = 0; x < self->width; x++)
+            {
+                row[3 * x] = source[self->swap ? 2 : 0];
+                row[3 * x + 1] = source[1];
+                row[3 * x + 2] = source[self->swap ? 0 : 2];
+                source += self->source_bytes;
+            }
+            tiff_emit(self, self->row, self->row_bytes);
+        }
+    }
+    /* Pad to the page size, which keeps every IFD on an 8 byte boundary */
+    memset(header, 0, 8);
+    tiff_emit(self, header, (size_t)(offset + self->page_bytes - self->file_offset));
+
+    self->last_link = offset + 8 + TIFF_TAGS * TIFF_ENTRY_BYTES;
+    self->file_pages++;
+}
+
+/**
+  * Packing thread: turns queued frames into pages until recording stops
+  * or the requested number of frames is written
+  */
+static void tiff_pack_main(void * arg)
+{
+    TiffWriter * self = (TiffWriter *)arg;
+    FrameSlot * slot;
+    FrameRing * ring;
+    int width, height;
+
+    trace_thread_name("ids tiff");
+    thread_options_apply(self->camera, THREAD_PROCESSING);
+
+    ids_mutex_lock(&self->lock);
+    while (self->queue_count > 0 || (self->running && self->error == 0
+                && (self->frame_limit == 0 || self->accepted < self->frame_limit)))
+    {
+        if (self->queue_count == 0)
+        {
+            ids_cond_wait(&self->queued, &self->lock, TIFF_POLL_MS);
+            continue;
+        }
+        slot = self->queue[self->queue_head];
+        self->queue_head = (self->queue_head + 1) % TIFF_QUEUE;
+        self->queue_count--;
+        ids_mutex_unlock(&self->lock);
+
+        ring = slot->ring;
+        width = slot->info.dwImageWidth ? (int)slot->info.dwImageWidth : ring->width;
+        height = slot->info.dwImageHeight ? (int)slot->info.dwImageHeight : ring->height;
+        if (self->error != 0 || width != self->width || height != self->height || ring->color != self->color)
+        {
+            /* Capture was reconfigured, the pages of a stack share one layout */
+            ids_atomic_add64(&self->frames_dropped, 1);
+        }
+        else
+        {
+            tiff_write_page(self, slot);
+            ids_atomic_add64(&self->frames_written, 1);
+        }
+        frame_slot_release(slot);
+        ids_mutex_lock(&self->lock);
+    }
+    ids_mutex_unlock(&self->lock);
+
+    tiff_end_file(self, self->file_pages > 0 && self->file_pages == self->pages_per_file);
+
+    ids_mutex_lock(&self->lock);
+    self->packing_done = 1;
+    ids_cond_broadcast(&self->queued);
+    ids_mutex_unlock(&self->lock);
+    trace_thread_exit();
+}
+
+/**
+  * Frame sink attached to the camera: hands the frame to the packing
+  * thread, or drops it when the writer has fallen behind
+  */
+static void tiff_on_frame(void * context, FrameSlot * slot)
+{
+    TiffWriter * self = (TiffWriter *)context;
+
+    ids_mutex_lock(&self->lock);
+    if (!self->running || (self->frame_limit > 0 && self->accepted >= self->frame_limit))
+    {
+        ids_mutex_unlock(&self->lock);
+        return;
+    }
+    if (self->queue_count == TIFF_QUEUE || self->error != 0)
+    {
+        ids_mutex_unlock(&self->lock);
+        ids_atomic_add64(&self->frames_dropped, 1);
+        return;
+    }
+    frame_slot_retain(slot);
+    self->queue[(self->queue_head + self->queue_count) % TIFF_QUEUE] = slot;
+    self->queue_count++;
+    self->accepted++;
+    ids_cond_signal(&self->queued);
+    ids_mutex_unlock(&self->lock);
+}
+
+/**
+  * Detaches from the camera, writes out the queued frames and closes the
+  * last file
+  */
+static void tiff_writer_shutdown(TiffWriter * self)
+{
+    if (self->attached)
+    {
+        camera_remove_sink(self->camera, tiff_on_frame, self);
+        self->attached = 0;
+    }
+    if (!self->started)
+    {
+        return;
+    }
+    self->started = 0;
+
+    Py_BEGIN_ALLOW_THREADS
+    ids_mutex_lock(&self->lock);
+    self->running = 0;
+    ids_cond_broadcast(&self->queued);
+    ids_mutex_unlock(&self->lock);
+    ids_thread_join(self->pack_thread);
+    ids_thread_join(self->write_thread);
+    Py_END_ALLOW_THREADS
+}
+
+/**
+  * Function to stream frames into a multi-page BigTIFF in the background
+  * This means the definition of the method is:
+  *     def record_tiff(self, path, frames=None, split_gigabytes=None, direct=True)
+  * @arg frames Number of frames to write, None to record until stop()
+  * @arg split_gigabytes Start a new file <stem>_0001<ext> and so on before a
+  *      file grows past this size, the first is <stem>_0000<ext>
+  * @arg direct Bypass the page cache where the file system allows it
+  * @return A TiffWriter tracking the recording
+  */
+PyObject * camera_record_tiff(Camera * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"path", "frames", "split_gigabytes", "direct", NULL};
+    PyObject * frames = Py_None;
+    PyObject * split = Py_None;
+    TiffWriter * writer;
+    FrameRing * ring;
+    char * path;
+    char first[4096];
+    double split_bytes = 0.0;
+    long long frame_limit = 0;
+    int direct = 1;
+    int result;
+    int i;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|OOi", kwlist, &path, &frames, &split, &direct))
+    {
+        return NULL;
+    }
+    if (frames != Py_None)
+    {
+        frame_limit = PyLong_AsLongLong(frames);
+        if (frame_limit == -1 && PyErr_Occurred())
+        {
+            return NULL;
+        }
+        if (frame_limit < 1)
+        {
+            PyErr_SetString(PyExc_ValueError, "frames must be positive");
+            return NULL;
+        }
+    }
+    if (split != Py_None)
+    {
+        split_bytes = PyFloat_AsDouble(split) * 1e9;
+        if (PyErr_Occurred())
+        {
+            return NULL;
+        }
+    }
+    if (camera_capture_ensure(self, DEFAULT_CAPTURE_BUFFERS, NULL) != 0)
+    {
+        return NULL;
+    }
+    ring = capture_ring_acquire(self);
+    if (ring == NULL)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Capture was stopped");
+        return NULL;
+    }
+
+    writer = (TiffWriter *)PyType_GenericAlloc(self->state->tiff_writer_type, 0);
+    if (writer == NULL)
+    {
+        frame_ring_decref(ring);
+        return NULL;
+    }
+    writer->fd = -1;
+    writer->current = -1;
+    ids_mutex_init(&writer->lock);
+    ids_cond_init(&writer->queued);
+    ids_cond_init(&writer->freed);
+    Py_INCREF(self);
+    writer->camera = self;
+
+    writer->width = ring->width;
+    writer->height = ring->height;
+    writer->color = ring->color;
+    result = tiff_format(ring->color, ring->bitdepth, &writer->samples, &writer->bits, &writer->source_bytes, &writer->swap);
+    frame_ring_decref(ring);
+    if (result != 0)
+    {
+        PyErr_Format(PyExc_ValueError, "Color mode %d cannot be written to TIFF", writer->color);
+        Py_DECREF(writer);
+        return NULL;
+    }
+    writer->row_bytes = (size_t)writer->width * writer->samples * (writer->bits / 8);
+    writer->page_bytes = (TIFF_PAGE_HEADER_BYTES + (uint64_t)writer->row_bytes * writer->height + 7) & ~(uint64_t)7;
+    writer->frame_limit = frame_limit;
+    if (split_bytes > 0.0)
+    {
+        writer->split = 1;
+        writer->pages_per_file = (int64_t)((split_bytes - TIFF_HEADER_BYTES) / writer->page_bytes);
+        if (writer->pages_per_file < 1)
+        {
+            PyErr_SetString(PyExc_ValueError, "split_gigabytes is smaller than one frame");
+            Py_DECREF(writer);
+            return NULL;
+        }
+    }
+
+    writer->path = (char *)malloc(strlen(path) + 1);
+    writer->row = (char *)malloc(writer->row_bytes);
+    writer->memory_size = (size_t)TIFF_BLOCKS * TIFF_BLOCK_BYTES;
+    Py_BEGIN_ALLOW_THREADS
+    writer->memory = (char *)ids_large_alloc(writer->memory_size, 0, -1, &writer->huge_pages);
+    Py_END_ALLOW_THREADS
+    if (writer->path == NULL || writer->row == NULL || writer->memory == NULL)
+    {
+        Py_DECREF(writer);
+        return PyErr_NoMemory();
+    }
+    strcpy(writer->path, path);
+    for (i = 0; i < TIFF_BLOCKS; i++)
+    {
+        writer->blocks[i].data = writer->memory + (size_t)i * TIFF_BLOCK_BYTES;
+        writer->free_blocks[i] = i;
+    }
+    writer->free_count = TIFF_BLOCKS;
+
+    /* Open the first file here so a bad path raises at once */
+    tiff_file_path(writer, 0, first, sizeof(first));
+    writer->direct = direct;
+    writer->fd = tiff_open(first, direct);
+    if (writer->fd < 0 && direct)
+    {
+        writer->direct = 0;
+        writer->fd = tiff_open(first, 0);
+    }
+    if (writer->fd < 0)
+    {
+        PyErr_SetFromErrnoWithFilename(PyExc_IOError, first);
+        Py_DECREF(writer);
+        return NULL;
+    }
+    writer->fd_file = 0;
+    writer->files = 1;
+    tiff_preallocate(writer, writer->fd, 0);
+    tiff_begin_file(writer);
+
+    writer->running = 1;
+    writer->started_ns = ids_monotonic_ns();
+    if (ids_thread_start(&writer->write_thread, tiff_write_main, writer) != 0)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Unable to start TIFF writer thread");
+        Py_DECREF(writer);
+        return NULL;
+    }
+    if (ids_thread_start(&writer->pack_thread, tiff_pack_main, writer) != 0)
+    {
+        ids_mutex_lock(&writer->lock);
+        writer->packing_done = 1;
+        ids_mutex_unlock(&writer->lock);
+        Py_BEGIN_ALLOW_THREADS
+        ids_thread_join(writer->write_thread);
+        Py_END_ALLOW_THREADS
+        PyErr_SetString(PyExc_RuntimeError, "Unable to start TIFF writer thread");
+        Py_DECREF(writer);
+        return NULL;
+    }
+    writer->started = 1;
+
+    if (camera_add_sink(self, tiff_on_frame, writer) != 0)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Too many frame consumers attached to this camera");
+        Py_DECREF(writer);
+        return NULL;
+    }
+    writer->attached = 1;
+    return (PyObject *)writer;
+}
+
+static void tiff_writer_dealloc(TiffWriter * self)
+{
+    PyTypeObject * type = Py_TYPE(self);
+    int i;
+
+    tiff_writer_shutdown(self);
+    /* Set up only partly when record_tiff failed */
+    for (i = 0; i < self->queue_count; i++)
+    {
+        frame_slot_release(self->queue[(self->queue_head + i) % TIFF_QUEUE]);
+    }
+    if (self->fd >= 0)
+    {
+        close(self->fd);
+    }
+    if (self->memory != NULL)
+    {
+        ids_large_free(self->memory, self->memory_size);
+    }
+    if (self->camera != NULL)
+    {
+        ids_cond_destroy(&self->freed);
+        ids_cond_destroy(&self->queued);
+        ids_mutex_destroy(&self->lock);
+    }
+    free(self->row);
+    free(self->path);
+    Py_XDECREF(self->camera);
+    type->tp_free((PyObject *)self);
+    Py_DECREF(type);
+}
+
+static PyObject * tiff_writer_raise(TiffWriter * self)
+{
+    char path[4096];
+
+    errno = self->error;
+    tiff_file_path(self, self->files > 0 ? (int)self->files - 1 : 0, path, sizeof(path));
+    return PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+}
+
+/**
+  * Stops recording, writes out the frames still queued and closes the file
+  * @return None, raises IOError if a write failed
+  */
+static PyObject * tiff_writer_stop(TiffWriter * self)
+{
+    tiff_writer_shutdown(self);
+    if (self->error != 0)
+    {
+        return tiff_writer_raise(self);
+    }
+    Py_RETURN_NONE;
+}
+
+/**
+  * Waits until the requested frames are written
+  * This means the definition of the method is:
+  *     def wait(self, timeout=None)
+  * @return True once the files are complete, False on timeout
+  */
+static PyObject * tiff_writer_wait(TiffWriter * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"timeout", NULL};
+    PyObject * timeout = Py_None;
+    int64_t deadline = 0;
+    int done;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &timeout))
+    {
+        return NULL;
+    }
+    if (timeout != Py_None)
+    {
+        deadline = ids_monotonic_ns() + (int64_t)(PyFloat_AsDouble(timeout) * 1e9);
+        if (PyErr_Occurred())
+        {
+            return NULL;
+        }
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    while (!self->done && (deadline == 0 || ids_monotonic_ns() < deadline))
+    {
+        ids_sleep_ms(5);
+    }
+    Py_END_ALLOW_THREADS
+
+    done = self->done;
+    if (done && self->error != 0)
+    {
+        return tiff_writer_raise(self);
+    }
+    return PyBool_FromLong(done);
+}
+
+/**
+  * Returns the progress of the recording
+  */
+static PyObject * tiff_writer_stats(TiffWriter * self)
+{
+    int64_t finished = self->finished_ns;
+    int64_t elapsed = (finished ? finished : ids_monotonic_ns()) - self->started_ns;
+    int64_t bytes = ids_atomic_load64(&self->bytes_written);
+
+    return Py_BuildValue("{s:O,s:L,s:L,s:L,s:l,s:O,s:d,s:d}",
+            "done", self->done ? Py_True : Py_False,
+            "frames_written", ids_atomic_load64(&self->frames_written),
+            "frames_dropped", ids_atomic_load64(&self->frames_dropped),
+            "bytes_written", bytes,
+            "files", (long)self->files,
+            "direct", self->direct ? Py_True : Py_False,
+            "elapsed_s", elapsed / 1e9,
+            "write_mb_s", elapsed > 0 ? bytes / 1e6 / (elapsed / 1e9) : 0.0);
+}
+
+static PyObject * tiff_writer_get_paths(TiffWriter * self, void * closure)
+{
+    PyObject * paths = PyList_New(0);
+    PyObject * path;
+    char buffer[4096];
+    long i;
+
+    for (i = 0; paths != NULL && i < self->files; i++)
+    {
+        tiff_file_path(self, (int)i, buffer, sizeof(buffer));
+        path = Py_BuildValue("s", buffer);
+        if (path == NULL || PyList_Append(paths, path) != 0)
+        {
+            Py_XDECREF(path);
+            Py_CLEAR(paths);
+            break;
+        }
+        Py_DECREF(path);
+    }
+    return paths;
+}
+
+static PyObject * tiff_writer_get_done(TiffWriter * self, void * closure)
+{
+    return PyBool_FromLong(self->done);
+}
+
+/*
+ * Read-only mapping of a TIFF file, the base of the page arrays
+ */
+typedef struct
+{
+    const uint8_t *    data;
+    size_t             size;
+#ifdef _WIN32
+    HANDLE             file;
+    HANDLE             mapping;
+#endif
+} TiffMapping;
+
+static void tiff_unmap(PyObject * capsule)
+{
+    TiffMapping * map = (TiffMapping *)PyCapsule_GetPointer(capsule, "ids.tiff_mapping");
+
+    if (map == NULL)
+    {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile((LPCVOID)map->data);
+    CloseHandle(map->mapping);
+    CloseHandle(map->file);
+#else
+    munmap((void *)map->data, map->size);
+#endif
+    free(map);
+}
+
+/**
+  * Maps a whole file read-only
+  * @return 0 on success, -1 with a Python exception set
+  */
+static int tiff_map(const char * path, TiffMapping * map)
+{
+#ifdef _WIN32
+    LARGE_INTEGER size;
+
+    map->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (map->file == INVALID_HANDLE_VALUE || !GetFileSizeEx(map->file, &size))
+    {
+        PyErr_SetFromWindowsErrWithFilename(0, path);
+        return -1;
+    }
+    map->size = (size_t)size.QuadPart;
+    map->mapping = CreateFileMappingA(map->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    map->data = map->mapping == NULL ? NULL : (const uint8_t *)MapViewOfFile(map->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (map->data == NULL)
+    {
+        PyErr_SetFromWindowsErrWithFilename(0, path);
+        if (map->mapping != NULL)
+        {
+            CloseHandle(map->mapping);
+        }
+        CloseHandle(map->file);
+        return -1;
+    }
+    return 0;
+#else
+    struct stat status;
+    void * data;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0 || fstat(fd, &status) != 0)
+    {
+        PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+    map->size = (size_t)status.st_size;
+    data = map->size > 0 ? mmap(NULL, map->size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        if (map->size > 0)
+        {
+            PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+        }
+        else
+        {
+            PyErr_Format(PyExc_ValueError, "%s is not a TIFF file", path);
+        }
+        return -1;
+    }
+    map->data = (const uint8_t *)data;
+    return 0;
+#endif
+}
+
+/*
+ * Directory walker over a mapped classic TIFF or BigTIFF
+ */
+typedef struct
+{
+    const uint8_t *    data;
+    size_t             size;
+    int                big;
+} TiffReader;
+
+static uint64_t tiff_read(const TiffReader * reader, uint64_t offset, int bytes)
+{
+    uint64_t value = 0;
+
+    if (offset + bytes > reader->size || offset + bytes < offset)
+    {
+        return 0;
+    }
+    memcpy(&value, reader->data + offset, bytes);
+    return value;
+}
+
+/**
+  * Value index of an IFD entry, from the entry itself when it fits there
+  * @return The value, 0 when it lies outside the file
+  */
+static uint64_t tiff_entry_value(const TiffReader * reader, uint64_t entry, uint64_t index)
+{
+    static const int type_bytes[17] = {0, 1, 1, 2, 4, 8, 1, 1, 2, 4, 8, 4, 8, 4, 0, 0, 8};
+    int type = (int)tiff_read(reader, entry + 2, 2);
+    int size = type > 0 && type <= 16 ? type_bytes[type] : 0;
+    uint64_t count = tiff_read(reader, entry + 4, reader->big ? 8 : 4);
+    uint64_t field = entry + (reader->big ? 12 : 8);
+
+    if (size == 0 || index >= count)
+    {
+        return 0;
+    }
+    if (count * size > (uint64_t)(reader->big ? 8 : 4))
+    {
+        field = tiff_read(reader, field, reader->big ? 8 : 4);
+    }
+    return tiff_read(reader, field + index * size, size);
+}
+
+/*
+ * What read_tiff needs of one page
+ */
+typedef struct
+{
+    uint64_t           width;
+    uint64_t           height;
+    uint64_t           bits;
+    uint64_t           samples;
+    uint64_t           compression;
+    uint64_t           planar;
+    uint64_t           data;
+    uint64_t           bytes;
+    uint64_t           description;
+    uint64_t           description_bytes;
+    int                contiguous;
+} TiffPage;
+
+/**
+  * Reads the tags of the IFD at offset
+  * @return The offset of the next IFD, 0 after the last
+  */
+static uint64_t tiff_read_page(const TiffReader * reader, uint64_t offset, TiffPage * page)
+{
+    int count_bytes = reader->big ? 8 : 2;
+    int entry_bytes = reader->big ? 20 : 12;
+    uint64_t count = tiff_read(reader, offset, count_bytes);
+    uint64_t entry;
+    uint64_t strips = 0;
+    uint64_t expected;
+    uint64_t i, s;
+
+    memset(page, 0, sizeof(TiffPage));
+    page->bits = 1;
+    page->samples = 1;
+    page->compression = 1;
+    page->planar = 1;
+    page->contiguous = 1;
+    for (i = 0; i < count; i++)
+    {
+        entry = offset + count_bytes + i * entry_bytes;
+        switch (tiff_read(reader, entry, 2))
+        {
+            case 256: page->width = tiff_entry_value(reader, entry, 0); break;
+            case 257: page->height = tiff_entry_value(reader, entry, 0); break;
+            case 258: page->bits = tiff_entry_value(reader, entry, 0); break;
+            case 259: page->compression = tiff_entry_value(reader, entry, 0); break;
+            case 277: page->samples = tiff_entry_value(reader, entry, 0); break;
+            case 284: page->planar = tiff_entry_value(reader, entry, 0); break;
+            case 270:
+                page->description_bytes = tiff_read(reader, entry + 4, reader->big ? 8 : 4);
+                page->description = page->description_bytes > (uint64_t)(reader->big ? 8 : 4)
+                        ? tiff_read(reader, entry + (reader->big ? 12 : 8), reader->big ? 8 : 4)
+                        : entry + (reader->big ? 12 : 8);
+                break;
+            case 273:
+                strips = tiff_read(reader, entry + 4, reader->big ? 8 : 4);
+                page->data = tiff_entry_value(reader, entry, 0);
+                break;
+            case 279:
+                for (s = 0; s < tiff_read(reader, entry + 4, reader->big ? 8 : 4); s++)
+                {
+                    page->bytes += tiff_entry_value(reader, entry, s);
+                }
+                break;
+        }
+    }
+    /* Strips must follow each other to form one array */
+    for (s = 1; s < strips && page->contiguous; s++)
+    {
+        expected = 0;
+        for (i = 0; i < count; i++)
+        {
+            entry = offset + count_bytes + i * entry_bytes;
+            if (tiff_read(reader, entry, 2) == 279)
+            {
+                expected = tiff_entry_value(reader, entry, s - 1);
+            }
+        }
+        for (i = 0; i < count; i++)
+        {
+            entry = offset + count_bytes + i * entry_bytes;
+            if (tiff_read(reader, entry, 2) == 273)
+            {
+                page->contiguous = tiff_entry_value(reader, entry, s) == tiff_entry_value(reader, entry, s - 1) + expected;
+            }
+        }
+    }
+    return tiff_read(reader, offset + count_bytes + count * entry_bytes, reader->big ? 8 : 4);
+}
+
+/**
+  * Builds the info of a page from its description, JSON as written by
+  * record_tiff, or the plain text of other writers
+  */
+static PyObject * tiff_page_info(const TiffReader * reader, const TiffPage * page, PyObject * loads)
+{
+    PyObject * text;
+    PyObject * info;
+    size_t length = 0;
+
+    if (page->description == 0 || page->description + page->description_bytes > reader->size)
+    {
+        return PyDict_New();
+    }
+    while (length < page->description_bytes && reader->data[page->description + length] != '\0')
+    {
+        length++;
+    }
+    text = PyUnicode_DecodeLatin1((const char *)reader->data + page->description, (Py_ssize_t)length, "replace");
+    if (text == NULL)
+    {
+        return NULL;
+    }
+    if (length > 0 && reader->data[page->description] == '{')
+    {
+        info = PyObject_CallFunctionObjArgs(loads, text, NULL);
+        if (info != NULL && PyDict_Check(info))
+        {
+            Py_DECREF(text);
+            return info;
+        }
+        Py_XDECREF(info);
+        PyErr_Clear();
+    }
+    info = Py_BuildValue("{s:O}", "description", text);
+    Py_DECREF(text);
+    return info;
+}
+
+/**
+  * Function to read the pages of a TIFF file as arrays mapped from the file
+  * This means the definition of the function is:
+  *     def read_tiff(path)
+  * @return A list of (image, info) tuples. The images are read-only views of
+  *         the mapped file, which stays mapped while any of them is alive.
+  * @note Reads uncompressed 8 and 16 bit pages with interleaved samples, as
+  *       record_tiff writes them
+  */
+PyObject * ids_read_tiff(PyObject * self, PyObject * args)
+{
+    TiffMapping * map;
+    TiffReader reader;
+    TiffPage page;
+    PyObject * capsule;
+    PyObject * json;
+    PyObject * loads;
+    PyObject * pages;
+    PyObject * img;
+    PyObject * info;
+    PyObject * item;
+    npy_intp dimensions[3];
+    uint64_t offset;
+    uint64_t limit;
+    char * path;
+    int magic;
+
+    if (!PyArg_ParseTuple(args, "s", &path))
+    {
+        return NULL;
+    }
+    json = PyImport_ImportModule("json");
+    if (json == NULL)
+    {
+        return NULL;
+    }
+    loads = PyObject_GetAttrString(json, "loads");
+    Py_DECREF(json);
+    if (loads == NULL)
+    {
+        return NULL;
+    }
+
+    map = (TiffMapping *)calloc(1, sizeof(TiffMapping));
+    if (map == NULL)
+    {
+        Py_DECREF(loads);
+        return PyErr_NoMemory();
+    }
+    if (tiff_map(path, map) != 0)
+    {
+        free(map);
+        Py_DECREF(loads);
+        return NULL;
+    }
+    capsule = PyCapsule_New(map, "ids.tiff_mapping", tiff_unmap);
+    if (capsule == NULL)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile((LPCVOID)map->data);
+        CloseHandle(map->mapping);
+        CloseHandle(map->file);
+#else
+        munmap((void *)map->data, map->size);
+#endif
+        free(map);
+        Py_DECREF(loads);
+        return NULL;
+    }
+
+    reader.data = map->data;
+    reader.size = map->size;
+    magic = (int)tiff_read(&reader, 2, 2);
+    reader.big = magic == 43;
+    if (map->size < 8 || reader.data[0] != 'I' || reader.data[1] != 'I' || (magic != 42 && magic != 43))
+    {
+        PyErr_Format(PyExc_ValueError, "%s is not a little-endian TIFF file", path);
+        Py_DECREF(capsule);
+        Py_DECREF(loads);
+        return NULL;
+    }
+    offset = reader.big ? tiff_read(&reader, 8, 8) : tiff_read(&reader, 4, 4);
+
+    /* Each IFD takes at least a few bytes, which bounds a looping chain */
+    limit = map->size / 8;
+    pages = PyList_New(0);
+    while (pages != NULL && offset != 0 && limit-- > 0)
+    {
+        offset = tiff_read_page(&reader, offset, &page);
+        if (page.compression != 1 || (page.bits != 8 && page.bits != 16) || (page.samples > 1 && page.planar != 1)
+                || !page.contiguous || page.width == 0 || page.height == 0
+                || page.bytes < page.width * page.height * page.samples * (page.bits / 8)
+                || page.data + page.bytes > map->size || page.data + page.bytes < page.data)
+        {
+            PyErr_Format(PyExc_ValueError, "%s has a page read_tiff cannot map", path);
+            Py_CLEAR(pages);
+            break;
+        }
+
+        dimensions[0] = (npy_intp)page.height;
+        dimensions[1] = (npy_intp)page.width;
+        dimensions[2] = (npy_intp)page.samples;
+        img = PyArray_New(&PyArray_Type, page.samples == 1 ? 2 : 3, dimensions, page.bits == 8 ? NPY_UINT8 : NPY_UINT16,
+                NULL, (void *)(map->data + page.data), 0, NPY_ARRAY_C_CONTIGUOUS, NULL);
+        if (img == NULL)
+        {
+            Py_CLEAR(pages);
+            break;
+        }
+        Py_INCREF(capsule);
+        if (PyArray_SetBaseObject((PyArrayObject *)img, capsule) != 0)
+        {
+            Py_DECREF(img);
+            Py_CLEAR(pages);
+            break;
+        }
+
+        info = tiff_page_info(&reader, &page, loads);
+        item = info == NULL ? NULL : Py_BuildValue("(OO)", img, info);
+        Py_DECREF(img);
+        Py_XDECREF(info);
+        if (item == NULL || PyList_Append(pages, item) != 0)
+        {
+            Py_XDECREF(item);
+            Py_CLEAR(pages);
+            break;
+        }
+        Py_DECREF(item);
+    }
+    Py_DECREF(capsule);
+    Py_DECREF(loads);
+    return pages;
+}
+
+/**
+  * Declaration of all the publicly accessible functions of the TiffWriter Object
+  */
+PyMethodDef tiff_writer_methods[] = {
+    {"stop", (PyCFunction)tiff_writer_stop, METH_NOARGS,
+     "Stop recording, write out the queued frames and close the file"
+    },
+    {"wait", (PyCFunction)tiff_writer_wait, METH_VARARGS | METH_KEYWORDS,
+     "Wait until the requested frames are written, returns False on timeout"
+    },
+    {"stats", (PyCFunction)tiff_writer_stats, METH_NOARGS,
+     "Returns frames and bytes written so far, dropped frames and the write rate"
+    },
+    {NULL} /* Sentinel */
+};
+
+PyGetSetDef tiff_writer_properties[] = {
+    {"paths", (getter)tiff_writer_get_paths, NULL, "Files written so far", NULL},
+    {"done", (getter)tiff_writer_get_done, NULL, "Whether the last file is complete", NULL},
+    {NULL} /* Sentinel */
+};
+
+static PyType_Slot tiff_writer_slots[] = {
+    {Py_tp_dealloc, (void *)tiff_writer_dealloc},
+    {Py_tp_doc, (void *)"Frames being streamed into BigTIFF files by Camera.record_tiff"},
+    {Py_tp_methods, tiff_writer_methods},
+    {Py_tp_getset, tiff_writer_properties},
+    {0, NULL} /* Sentinel */
+};
+
+PyType_Spec ids_TiffWriterSpec = {
+    "ids.TiffWriter",          /* name */
+    sizeof(TiffWriter),        /* basicsize */
+    0,                         /* itemsize */
+    IDS_TPFLAGS | Py_TPFLAGS_DISALLOW_INSTANTIATION, /* flags */
+    tiff_writer_slots,         /* slots */
+};
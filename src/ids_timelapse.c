@@ -0,0 +1,924 @@
+#include <uEye.h>
+#include "ids.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * Camera.timelapse takes one frame per interval at absolute deadlines on the
+ * monotonic clock, start + k * interval, so a late wake-up delays only its
+ * own frame and never shifts the ones after it.
+ *
+ * In trigger mode live video is off and the camera waits for software
+ * triggers; the scheduler thread calls is_FreezeVideo at every deadline and
+ * the link is idle in between. In stream mode live video keeps running and
+ * the capture thread passes on only the first frame taken at or after each
+ * deadline.
+ */
+enum TimelapseMode
+{
+    TIMELAPSE_TRIGGER,
+    TIMELAPSE_STREAM,
+};
+
+static const char * timelapse_modes[] = {"trigger", "stream"};
+
+/*
+ * The scheduler waits on a condition variable, which stop() interrupts,
+ * until TIMELAPSE_WAKE_NS before the deadline, then sleeps on an absolute
+ * timer until TIMELAPSE_SPIN_NS before it and spins the rest. Windows wakes
+ * up less precisely, so it hands over to the timer and the spin earlier.
+ */
+#ifdef _WIN32
+#define TIMELAPSE_WAKE_NS          20000000LL
+#define TIMELAPSE_SPIN_NS          1000000LL
+#else
+#define TIMELAPSE_WAKE_NS          2000000LL
+#define TIMELAPSE_SPIN_NS          200000LL
+#endif
+#define TIMELAPSE_POLL_MS          1000
+/* How long the frame of the last trigger is waited for before the schedule ends */
+#define TIMELAPSE_FRAME_TIMEOUT_MS 2000
+
+/*
+ * Running count, mean, variance (Welford) and range of a series
+ */
+typedef struct
+{
+    int64_t            count;
+    double             mean;
+    double             m2;
+    double             min;
+    double             max;
+} Moments;
+
+/*
+ * Achieved timing of one schedule. Lateness is the trigger call (trigger
+ * mode) or the frame (stream mode) relative to its deadline.
+ */
+typedef struct
+{
+    int64_t            triggers;
+    int64_t            frames;
+    int64_t            missed;
+    int64_t            trigger_errors;
+    int                last_error;
+    Moments            lateness;
+    Moments            device_interval;
+    Moments            host_interval;
+} TimelapseStats;
+
+/*
+ * A running schedule. The scheduler thread fires the triggers; the capture
+ * thread matches the frames to their deadlines in timelapse_on_frame. Both
+ * update the statistics under lock. The camera holds one reference until
+ * the next timelapse() replaces it, so the schedule keeps running after its
+ * Timelapse object was dropped; the object holds the other.
+ */
+typedef struct Timelapse
+{
+    volatile long      refcount;
+    /* Borrowed, the camera outlives its schedules */
+    Camera *           camera;
+    int                mode;
+    int64_t            interval_ns;
+    /* Number of frames to take, 0 until stop() */
+    int64_t            count;
+    int                attached;
+    int                started;
+
+    /* Trigger mode: camera state put back when the schedule ends */
+    int                previous_trigger;
+    unsigned int       previous_applied;
+    int                previous_setting;
+    int                was_live;
+
+    ids_mutex_t        lock;
+    ids_cond_t         wake;
+    volatile int       running;
+    ids_thread_t       thread;
+    int64_t            start_ns;
+
+    /* Guarded by lock */
+    int64_t            fired_index;
+    int64_t            fired_deadline_ns;
+    int64_t            answered_index;
+    int64_t            next_index;
+    TimelapseStats     stats;
+    int64_t            last_index;
+    uint64_t           last_device_ticks;
+    int64_t            last_dequeue_ns;
+
+    /* Guarded by lock, wake is broadcast when it is set */
+    volatile int       done;
+    int64_t            finished_ns;
+} Timelapse;
+
+/*
+ * Struct that defines the Timelapse class, a view of one schedule
+ */
+typedef struct
+{
+    PyObject_HEAD
+    Camera *           camera;
+    Timelapse *        timelapse;
+} TimelapseObject;
+
+static void moments_add(Moments * moments, double value)
+{
+    double delta = value - moments->mean;
+
+    if (moments->count == 0 || value < moments->min)
+    {
+        moments->min = value;
+    }
+    if (moments->count == 0 || value > moments->max)
+    {
+        moments->max = value;
+    }
+    moments->count++;
+    moments->mean += delta / moments->count;
+    moments->m2 += delta * (value - moments->mean);
+}
+
+static double moments_std(const Moments * moments)
+{
+    return moments->count > 1 ? sqrt(moments->m2 / (moments->count - 1)) : 0.0;
+}
+
+/**
+  * Trigger or frame times relative to their deadlines, in microseconds
+  */
+static PyObject * lateness_as_dict(const Moments * moments)
+{
+    if (moments->count == 0)
+    {
+        Py_RETURN_NONE;
+    }
+    return Py_BuildValue("{s:L,s:d,s:d,s:d,s:d}",
+            "count", (long long)moments->count,
+            "mean_us", moments->mean / 1e3,
+            "std_us", moments_std(moments) / 1e3,
+            "min_us", moments->min / 1e3,
+            "max_us", moments->max / 1e3);
+}
+
+/**
+  * Achieved intervals between consecutive frames; max_error_us is the
+  * largest deviation from the nominal interval
+  */
+static PyObject * interval_as_dict(const Moments * moments, int64_t nominal_ns)
+{
+    double error;
+
+    if (moments->count == 0)
+    {
+        Py_RETURN_NONE;
+    }
+    error = fabs(moments->max - nominal_ns);
+    if (fabs(moments->min - nominal_ns) > error)
+    {
+        error = fabs(moments->min - nominal_ns);
+    }
+    return Py_BuildValue("{s:L,s:d,s:d,s:d,s:d,s:d}",
+            "count", (long long)moments->count,
+            "mean_ms", moments->mean / 1e6,
+            "std_us", moments_std(moments) / 1e3,
+            "min_ms", moments->min / 1e6,
+            "max_ms", moments->max / 1e6,
+            "max_error_us", error / 1e3);
+}
+
+/**
+  * Tags a frame with its deadline and adds it to the interval statistics
+  * @note Called with lock held
+  */
+static void timelapse_record_frame(Timelapse * self, FrameSlot * slot, int64_t index, int64_t deadline)
+{
+    uint64_t ticks = slot->info.u64TimestampDevice;
+
+    slot->timelapse_index = index;
+    slot->timelapse_deadline_ns = deadline;
+    /* Only frames of adjacent deadlines measure one interval */
+    if (self->stats.frames > 0 && index == self->last_index + 1)
+    {
+        if (ticks != 0 && self->last_device_ticks != 0 && ticks > self->last_device_ticks)
+        {
+            moments_add(&self->stats.device_interval, (double)(ticks - self->last_device_ticks) * 100.0);
+        }
+        moments_add(&self->stats.host_interval, (double)(slot->dequeue_ns - self->last_dequeue_ns));
+    }
+    self->last_index = index;
+    self->last_device_ticks = ticks;
+    self->last_dequeue_ns = slot->dequeue_ns;
+    self->answered_index = index;
+    self->stats.frames++;
+    ids_cond_broadcast(&self->wake);
+}
+
+/**
+  * Capture hook: matches the frame to a deadline of the running timelapse.
+  * In trigger mode a frame answers the latest trigger, earlier unanswered
+  * triggers count as lost. In stream mode only the first frame at or after
+  * a deadline is passed on, timed by its device timestamp once the clock
+  * mapping is known and by its arrival before.
+  * @return 0 when the frame is to be dropped
+  */
+int timelapse_on_frame(Camera * self, FrameSlot * slot)
+{
+    Capture * capture = &self->capture;
+    Timelapse * timelapse;
+    int64_t frame_ns;
+    int64_t deadline = 0;
+    int64_t index = -1;
+    int passed = 1;
+
+    slot->timelapse_index = -1;
+    if (capture->timelapse == NULL)
+    {
+        return 1;
+    }
+
+    ids_mutex_lock(&capture->sink_lock);
+    timelapse = capture->timelapse;
+    if (timelapse != NULL)
+    {
+        ids_mutex_lock(&timelapse->lock);
+        if (timelapse->mode == TIMELAPSE_TRIGGER)
+        {
+            if (timelapse->fired_index > timelapse->answered_index)
+            {
+                index = timelapse->fired_index;
+                deadline = timelapse->fired_deadline_ns;
+            }
+        }
+        else
+        {
+            frame_ns = slot->host_ns != 0 ? slot->host_ns : slot->dequeue_ns;
+            deadline = timelapse->start_ns + timelapse->next_index * timelapse->interval_ns;
+            /* Live frames of the setup, before the first deadline was set */
+            if (timelapse->start_ns == 0 || frame_ns < deadline || (timelapse->count > 0 && timelapse->next_index >= timelapse->count))
+            {
+                passed = 0;
+            }
+            else
+            {
+                index = (frame_ns - timelapse->start_ns) / timelapse->interval_ns;
+                if (timelapse->count > 0 && index >= timelapse->count)
+                {
+                    index = timelapse->count - 1;
+                }
+                timelapse->stats.missed += index - timelapse->next_index;
+                timelapse->next_index = index + 1;
+                deadline = timelapse->start_ns + index * timelapse->interval_ns;
+                moments_add(&timelapse->stats.lateness, (double)(frame_ns - deadline));
+            }
+        }
+        if (index >= 0)
+        {
+            timelapse_record_frame(timelapse, slot, index, deadline);
+        }
+        ids_mutex_unlock(&timelapse->lock);
+    }
+    ids_mutex_unlock(&capture->sink_lock);
+    return passed;
+}
+
+/**
+  * Waits until the monotonic clock reaches deadline
+  * @return 0 at the deadline, -1 once stop() was called
+  */
+static int timelapse_sleep_until(Timelapse * self, int64_t deadline)
+{
+    int64_t remaining;
+    int running;
+
+    ids_mutex_lock(&self->lock);
+    while (self->running)
+    {
+        remaining = (deadline - TIMELAPSE_WAKE_NS - ids_monotonic_ns()) / 1000000;
+        if (remaining <= 0)
+        {
+            break;
+        }
+        ids_cond_wait(&self->wake, &self->lock, remaining > TIMELAPSE_POLL_MS ? TIMELAPSE_POLL_MS : (int)remaining);
+    }
+    running = self->running;
+    ids_mutex_unlock(&self->lock);
+    if (!running)
+    {
+        return -1;
+    }
+
+    ids_sleep_until_ns(deadline - TIMELAPSE_SPIN_NS);
+    while (ids_monotonic_ns() < deadline)
+    {
+    }
+    return 0;
+}
+
+/**
+  * Detaches from the capture thread and, in trigger mode, puts back the
+  * trigger mode and live video the camera had before
+  * @note Called with the control lock held, callable without the GIL
+  */
+static void timelapse_restore(Timelapse * self)
+{
+    Camera * camera = self->camera;
+    Capture * capture = &camera->capture;
+
+    if (!self->attached)
+    {
+        return;
+    }
+    ids_mutex_lock(&capture->sink_lock);
+    capture->timelapse = NULL;
+    ids_mutex_unlock(&capture->sink_lock);
+    self->attached = 0;
+
+    if (self->mode != TIMELAPSE_TRIGGER)
+    {
+        return;
+    }
+    ids_mutex_lock(&camera->settings_lock);
+    camera->settings.applied = (camera->settings.applied & ~SETTING_TRIGGER) | self->previous_applied;
+    camera->settings.trigger = self->previous_setting;
+    ids_mutex_unlock(&camera->settings_lock);
+    is_SetExternalTrigger(camera_handle(camera), self->previous_trigger);
+
+    if (!capture->running)
+    {
+        capture->idle = 0;
+    }
+    else if (self->was_live)
+    {
+        capture_set_live(camera, 1);
+    }
+    /* Otherwise live video resumes once the frames were read, see camera_capture_ensure */
+}
+
+/**
+  * Body of the scheduler thread. Runs without the GIL.
+  */
+static void timelapse_thread_main(void * arg)
+{
+    Timelapse * self = (Timelapse *)arg;
+    Camera * camera = self->camera;
+    int64_t index = 0;
+    int64_t deadline;
+    int64_t now;
+    int64_t behind;
+    int64_t previous;
+    int64_t previous_deadline;
+    int returnCode;
+
+    trace_thread_name("ids timelapse");
+    thread_options_apply(camera, THREAD_CAPTURE);
+
+    while (self->mode == TIMELAPSE_TRIGGER && (self->count == 0 || index < self->count))
+    {
+        deadline = self->start_ns + index * self->interval_ns;
+        if (timelapse_sleep_until(self, deadline) != 0)
+        {
+            break;
+        }
+        now = ids_monotonic_ns();
+
+        /* Woken up after a later deadline had passed: take that one instead */
+        behind = (now - self->start_ns) / self->interval_ns;
+        if (self->count > 0 && behind >= self->count)
+        {
+            behind = self->count - 1;
+        }
+        if (behind > index)
+        {
+            ids_mutex_lock(&self->lock);
+            self->stats.missed += behind - index;
+            ids_mutex_unlock(&self->lock);
+            index = behind;
+            deadline = self->start_ns + index * self->interval_ns;
+        }
+
+        /* The frame of a trigger fired while capture is stopped would be lost */
+        if (!camera->capture.running)
+        {
+            ids_mutex_lock(&self->lock);
+            self->stats.missed++;
+            ids_mutex_unlock(&self->lock);
+            index++;
+            continue;
+        }
+
+        /* Announced first, the frame may arrive before is_FreezeVideo returns */
+        ids_mutex_lock(&self->lock);
+        previous = self->fired_index;
+        previous_deadline = self->fired_deadline_ns;
+        self->fired_index = index;
+        self->fired_deadline_ns = deadline;
+        ids_mutex_unlock(&self->lock);
+
+        now = ids_monotonic_ns();
+        returnCode = is_FreezeVideo(camera_handle(camera), IS_DONT_WAIT);
+        if (ids_trace_enabled)
+        {
+            trace_record("trigger", now, index);
+        }
+
+        ids_mutex_lock(&self->lock);
+        if (returnCode == IS_SUCCESS)
+        {
+            self->stats.triggers++;
+            moments_add(&self->stats.lateness, (double)(now - deadline));
+        }
+        else
+        {
+            self->fired_index = previous;
+            self->fired_deadline_ns = previous_deadline;
+            self->stats.trigger_errors++;
+            self->stats.last_error = returnCode;
+        }
+        ids_mutex_unlock(&self->lock);
+        index++;
+    }
+
+    ids_mutex_lock(&self->lock);
+    if (self->mode == TIMELAPSE_TRIGGER)
+    {
+        /* The frame of the last trigger is still on its way */
+        deadline = ids_monotonic_ns() + TIMELAPSE_FRAME_TIMEOUT_MS * 1000000LL;
+        while (self->running && self->fired_index > self->answered_index && ids_monotonic_ns() < deadline)
+        {
+            ids_cond_wait(&self->wake, &self->lock, TIMELAPSE_POLL_MS);
+        }
+    }
+    else
+    {
+        while (self->running && (self->count == 0 || self->answered_index < self->count - 1))
+        {
+            ids_cond_wait(&self->wake, &self->lock, TIMELAPSE_POLL_MS);
+        }
+    }
+    ids_mutex_unlock(&self->lock);
+
+    ids_mutex_lock(&camera->capture.control_lock);
+    timelapse_restore(self);
+    ids_mutex_unlock(&camera->capture.control_lock);
+
+    ids_mutex_lock(&self->lock);
+    self->finished_ns = ids_monotonic_ns();
+    self->done = 1;
+    ids_cond_broadcast(&self->wake);
+    ids_mutex_unlock(&self->lock);
+}
+
+static void timelapse_decref(Timelapse * self)
+{
+    if (ids_atomic_dec(&self->refcount) != 0)
+    {
+        return;
+    }
+    ids_cond_destroy(&self->wake);
+    ids_mutex_destroy(&self->lock);
+    free(self);
+}
+
+/**
+  * Stops the schedule, waits for the scheduler thread, which restores the
+  * camera on its way out, and drops the camera's reference
+  * @note Called without the control lock
+  */
+static void timelapse_release(Timelapse * self)
+{
+    if (self == NULL)
+    {
+        return;
+    }
+    if (self->started)
+    {
+        Py_BEGIN_ALLOW_THREADS
+        ids_mutex_lock(&self->lock);
+        self->running = 0;
+        ids_cond_broadcast(&self->wake);
+        ids_mutex_unlock(&self->lock);
+        ids_thread_join(self->thread);
+        Py_END_ALLOW_THREADS
+    }
+    timelapse_decref(self);
+}
+
+/**
+  * Stops the last schedule started on the camera
+  */
+void timelapse_close(Camera * self)
+{
+    Timelapse * timelapse;
+
+    if (self->timelapse == NULL)
+    {
+        return;
+    }
+    capture_control_lock(self);
+    timelapse = self->timelapse;
+    self->timelapse = NULL;
+    capture_control_unlock(self);
+    timelapse_release(timelapse);
+}
+
+/**
+  * Switches the camera to software trigger with live video off, starting
+  * capture if needed
+  * @return 0 on success, -1 with a Python exception set
+  * @note Called with the control lock held
+  */
+static int timelapse_enter_trigger(Timelapse * self)
+{
+    Camera * camera = self->camera;
+    Capture * capture = &camera->capture;
+    int returnCode;
+
+    self->previous_trigger = is_SetExternalTrigger(camera_handle(camera), IS_GET_EXTERNALTRIGGER);
+    ids_mutex_lock(&camera->settings_lock);
+    self->previous_applied = camera->settings.applied & SETTING_TRIGGER;
+    self->previous_setting = camera->settings.trigger;
+    ids_mutex_unlock(&camera->settings_lock);
+    self->was_live = capture->running && !capture->idle;
+
+    Py_BEGIN_ALLOW_THREADS
+    returnCode = capture_set_live(camera, 0);
+    if (returnCode == IS_SUCCESS)
+    {
+        returnCode = is_SetExternalTrigger(camera_handle(camera), IS_SET_TRIGGER_SOFTWARE);
+    }
+    Py_END_ALLOW_THREADS
+    if (returnCode != IS_SUCCESS)
+    {
+        raise_error(camera, returnCode);
+        return -1;
+    }
+
+    /* Replayed onto the camera should it reconnect meanwhile */
+    ids_mutex_lock(&camera->settings_lock);
+    camera->settings.applied |= SETTING_TRIGGER;
+    camera->settings.trigger = IS_SET_TRIGGER_SOFTWARE;
+    ids_mutex_unlock(&camera->settings_lock);
+
+    return camera_capture_start(camera, DEFAULT_CAPTURE_BUFFERS);
+}
+
+/**
+  * Function to take frames at fixed intervals
+  * This means the definition of the method is:
+  *     def timelapse(self, interval, count=None, mode='trigger')
+  * @arg interval Seconds between frames, the first is taken at once; None
+  *      stops the running schedule
+  * @arg count Number of frames, None to run until stop()
+  * @arg mode 'trigger' fires a software trigger at every deadline with live
+  *      video off, 'stream' passes on one frame of the live video per deadline
+  * @return A Timelapse tracking the schedule, frames arrive through get_image
+  *         and the attached consumers
+  * @note The schedule keeps running when the Timelapse is dropped, the camera
+  *       holds it until it is stopped or replaced
+  */
+PyObject * camera_timelapse(Camera * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"interval", "count", "mode", NULL};
+    Capture * capture = &self->capture;
+    PyObject * interval_arg;
+    PyObject * count = Py_None;
+    const char * mode = "trigger";
+    TimelapseObject * object;
+    Timelapse * timelapse;
+    Timelapse * previous;
+    double interval;
+    long long frames = 0;
+    int returnCode;
+    int result;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|Os", kwlist, &interval_arg, &count, &mode))
+    {
+        return NULL;
+    }
+    if (interval_arg == Py_None)
+    {
+        timelapse_close(self);
+        Py_RETURN_NONE;
+    }
+    interval = PyFloat_AsDouble(interval_arg);
+    if (interval == -1.0 && PyErr_Occurred())
+    {
+        return NULL;
+    }
+    if (!(interval >= 1e-3 && interval <= 1e6))
+    {
+        PyErr_SetString(PyExc_ValueError, "interval must be between 1 ms and 1e6 seconds");
+        return NULL;
+    }
+    if (count != Py_None)
+    {
+        frames = PyLong_AsLongLong(count);
+        if (frames == -1 && PyErr_Occurred())
+        {
+            return NULL;
+        }
+        if (frames < 1)
+        {
+            PyErr_SetString(PyExc_ValueError, "count must be positive");
+            return NULL;
+        }
+    }
+    if (strcmp(mode, "trigger") != 0 && strcmp(mode, "stream") != 0)
+    {
+        PyErr_Format(PyExc_ValueError, "Unknown timelapse mode '%s', expected 'trigger' or 'stream'", mode);
+        return NULL;
+    }
+
+    object = (TimelapseObject *)PyType_GenericAlloc(self->state->timelapse_type, 0);
+    if (object == NULL)
+    {
+        return NULL;
+    }
+    Py_INCREF(self);
+    object->camera = self;
+    timelapse = (Timelapse *)calloc(1, sizeof(Timelapse));
+    if (timelapse == NULL)
+    {
+        Py_DECREF(object);
+        return PyErr_NoMemory();
+    }
+    ids_mutex_init(&timelapse->lock);
+    ids_cond_init(&timelapse->wake);
+    timelapse->refcount = 1;
+    timelapse->camera = self;
+    timelapse->mode = strcmp(mode, "trigger") == 0 ? TIMELAPSE_TRIGGER : TIMELAPSE_STREAM;
+    timelapse->interval_ns = (int64_t)(interval * 1e9 + 0.5);
+    timelapse->count = frames;
+    timelapse->fired_index = -1;
+    timelapse->answered_index = -1;
+    timelapse->last_index = -1;
+
+    capture_control_lock(self);
+    if (capture->timelapse != NULL)
+    {
+        capture_control_unlock(self);
+        PyErr_SetString(PyExc_RuntimeError, "A timelapse is already running on this camera");
+        timelapse_decref(timelapse);
+        Py_DECREF(object);
+        return NULL;
+    }
+    /* Detached, so the previous schedule has restored the camera and is about to end */
+    previous = self->timelapse;
+    self->timelapse = NULL;
+    /* Attached first, so that starting capture keeps live video off */
+    ids_mutex_lock(&capture->sink_lock);
+    capture->timelapse = timelapse;
+    ids_mutex_unlock(&capture->sink_lock);
+    timelapse->attached = 1;
+
+    if (timelapse->mode == TIMELAPSE_TRIGGER)
+    {
+        result = timelapse_enter_trigger(timelapse);
+    }
+    else if (capture->running)
+    {
+        Py_BEGIN_ALLOW_THREADS
+        returnCode = capture_set_live(self, 1);
+        Py_END_ALLOW_THREADS
+        result = returnCode == IS_SUCCESS ? 0 : -1;
+        if (result != 0)
+        {
+            raise_error(self, returnCode);
+        }
+    }
+    else
+    {
+        result = camera_capture_start(self, DEFAULT_CAPTURE_BUFFERS);
+    }
+
+    if (result == 0)
+    {
+        /* Frames queued before the first deadline are not part of the timelapse */
+        capture_flush(self);
+        ids_mutex_lock(&timelapse->lock);
+        timelapse->start_ns = ids_monotonic_ns();
+        timelapse->running = 1;
+        ids_mutex_unlock(&timelapse->lock);
+        if (ids_thread_start(&timelapse->thread, timelapse_thread_main, timelapse) != 0)
+        {
+            PyErr_SetString(PyExc_RuntimeError, "Unable to start timelapse thread");
+            result = -1;
+        }
+    }
+    if (result != 0)
+    {
+        timelapse_restore(timelapse);
+        capture_control_unlock(self);
+        timelapse_release(previous);
+        timelapse_decref(timelapse);
+        Py_DECREF(object);
+        return NULL;
+    }
+    timelapse->started = 1;
+    self->timelapse = timelapse;
+    capture_control_unlock(self);
+    timelapse_release(previous);
+
+    ids_atomic_inc(&timelapse->refcount);
+    object->timelapse = timelapse;
+    return (PyObject *)object;
+}
+
+/**
+  * Drops the view only, the camera keeps the schedule running
+  */
+static void timelapse_dealloc(TimelapseObject * self)
+{
+    PyTypeObject * type = Py_TYPE(self);
+
+    if (self->timelapse != NULL)
+    {
+        timelapse_decref(self->timelapse);
+    }
+    Py_XDECREF(self->camera);
+    type->tp_free((PyObject *)self);
+    Py_DECREF(type);
+}
+
+/**
+  * Stops the schedule and waits until the camera is back in its previous
+  * trigger mode
+  */
+static PyObject * timelapse_stop(TimelapseObject * self)
+{
+    Timelapse * timelapse = self->timelapse;
+
+    Py_BEGIN_ALLOW_THREADS
+    ids_mutex_lock(&timelapse->lock);
+    timelapse->running = 0;
+    ids_cond_broadcast(&timelapse->wake);
+    while (!timelapse->done)
+    {
+        ids_cond_wait(&timelapse->wake, &timelapse->lock, -1);
+    }
+    ids_mutex_unlock(&timelapse->lock);
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+}
+
+/**
+  * Waits until every frame was taken
+  * This means the definition of the method is:
+  *     def wait(self, timeout=None)
+  * @return True once the schedule ended, False on timeout
+  */
+static PyObject * timelapse_wait(TimelapseObject * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"timeout", NULL};
+    Timelapse * timelapse = self->timelapse;
+    PyObject * timeout = Py_None;
+    int64_t deadline = 0;
+    int64_t remaining;
+    int done;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &timeout))
+    {
+        return NULL;
+    }
+    if (timeout != Py_None)
+    {
+        deadline = ids_monotonic_ns() + (int64_t)(PyFloat_AsDouble(timeout) * 1e9);
+        if (PyErr_Occurred())
+        {
+            return NULL;
+        }
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    ids_mutex_lock(&timelapse->lock);
+    while (!timelapse->done)
+    {
+        if (deadline == 0)
+        {
+            ids_cond_wait(&timelapse->wake, &timelapse->lock, -1);
+            continue;
+        }
+        remaining = (deadline - ids_monotonic_ns() + 999999) / 1000000;
+        if (remaining <= 0)
+        {
+            break;
+        }
+        ids_cond_wait(&timelapse->wake, &timelapse->lock, remaining > TIMELAPSE_POLL_MS ? TIMELAPSE_POLL_MS : (int)remaining);
+    }
+    done = timelapse->done;
+    ids_mutex_unlock(&timelapse->lock);
+    Py_END_ALLOW_THREADS
+
+    return PyBool_FromLong(done);
+}
+
+/**
+  * Returns the progress of the schedule and the achieved timing
+  */
+static PyObject * timelapse_stats(TimelapseObject * object)
+{
+    Timelapse * self = object->timelapse;
+    TimelapseStats copy;
+    PyObject * count;
+    PyObject * lateness;
+    PyObject * device_interval;
+    PyObject * host_interval;
+    PyObject * stats;
+    int64_t finished = self->finished_ns;
+    int64_t lost = 0;
+    int done = self->done;
+
+    ids_mutex_lock(&self->lock);
+    copy = self->stats;
+    if (self->mode == TIMELAPSE_TRIGGER)
+    {
+        /* Triggers without a frame, not counting one still on its way */
+        lost = copy.triggers - copy.frames - (self->fired_index > self->answered_index && !done ? 1 : 0);
+    }
+    ids_mutex_unlock(&self->lock);
+
+    if (self->count > 0)
+    {
+        count = Py_BuildValue("L", (long long)self->count);
+    }
+    else
+    {
+        Py_INCREF(Py_None);
+        count = Py_None;
+    }
+    lateness = lateness_as_dict(&copy.lateness);
+    device_interval = interval_as_dict(&copy.device_interval, self->interval_ns);
+    host_interval = interval_as_dict(&copy.host_interval, self->interval_ns);
+    if (count == NULL || lateness == NULL || device_interval == NULL || host_interval == NULL)
+    {
+        stats = NULL;
+    }
+    else
+    {
+        stats = Py_BuildValue("{s:s,s:d,s:O,s:O,s:L,s:L,s:L,s:L,s:L,s:i,s:O,s:O,s:O,s:d}",
+                "mode", timelapse_modes[self->mode],
+                "interval_s", self->interval_ns / 1e9,
+                "count", count,
+                "done", done ? Py_True : Py_False,
+                "frames", (long long)copy.frames,
+                "triggers", (long long)copy.triggers,
+                "missed", (long long)copy.missed,
+                "frames_lost", (long long)(lost > 0 ? lost : 0),
+                "trigger_errors", (long long)copy.trigger_errors,
+                "last_error", copy.last_error,
+                "lateness", lateness,
+                "device_interval", device_interval,
+                "host_interval", host_interval,
+                "elapsed_s", ((finished ? finished : ids_monotonic_ns()) - self->start_ns) / 1e9);
+    }
+    Py_XDECREF(count);
+    Py_XDECREF(lateness);
+    Py_XDECREF(device_interval);
+    Py_XDECREF(host_interval);
+    return stats;
+}
+
+static PyObject * timelapse_get_done(TimelapseObject * self, void * closure)
+{
+    return PyBool_FromLong(self->timelapse->done);
+}
+
+/**
+  * Declaration of all the publicly accessible functions of the Timelapse Object
+  */
+PyMethodDef timelapse_methods[] = {
+    {"stop", (PyCFunction)timelapse_stop, METH_NOARGS,
+     "Stop taking frames and restore the previous trigger mode"
+    },
+    {"wait", (PyCFunction)timelapse_wait, METH_VARARGS | METH_KEYWORDS,
+     "Wait until every frame was taken, returns False on timeout"
+    },
+    {"stats", (PyCFunction)timelapse_stats, METH_NOARGS,
+     "Returns frames taken, missed deadlines, trigger lateness and the achieved interval jitter"
+    },
+    {NULL} /* Sentinel */
+};
+
+PyGetSetDef timelapse_properties[] = {
+    {"done", (getter)timelapse_get_done, NULL, "Whether the schedule has ended", NULL},
+    {NULL} /* Sentinel */
+};
+
+static PyType_Slot timelapse_slots[] = {
+    {Py_tp_dealloc, (void *)timelapse_dealloc},
+    {Py_tp_doc, (void *)"Frames being taken at fixed intervals by Camera.timelapse"},
+    {Py_tp_methods, timelapse_methods},
+    {Py_tp_getset, timelapse_properties},
+    {0, NULL} /* Sentinel */
+};
+
+PyType_Spec ids_TimelapseSpec = {
+    "ids.Timelapse",           /* name */
+    sizeof(TimelapseObject),   /* basicsize */
+    0,                         /* itemsize */
+    IDS_TPFLAGS | Py_TPFLAGS_DISALLOW_INSTANTIATION, /* flags */
+    timelapse_slots,           /* slots */
+};
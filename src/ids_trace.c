@@ -0,0 +1,416 @@
+#include <uEye.h>
+#include "ids.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+#ifdef _WIN32
+#define IDS_THREAD_LOCAL __declspec(thread)
+#else
+#define IDS_THREAD_LOCAL __thread
+#endif
+
+#define DEFAULT_TRACE_EVENTS 65536
+
+/*
+ * One finished pipeline stage, written out as a Chrome "complete" event
+ */
+typedef struct
+{
+    const char *       name;
+    int64_t            start_ns;
+    int64_t            duration_ns;
+    int64_t            frame;
+} TraceEvent;
+
+/*
+ * Events of one thread. Only the owning thread appends; count is published
+ * after the event is written, so a dump can read up to it without a lock.
+ */
+typedef struct TraceBuffer
+{
+    struct TraceBuffer * next;
+    unsigned long      tid;
+    const char *       thread_name;
+    long               generation;
+    int                orphaned;
+    long               capacity;
+    volatile long      count;
+    volatile int64_t   dropped;
+    TraceEvent *       events;
+} TraceBuffer;
+
+volatile int ids_trace_enabled = 0;
+
+/* Guards the buffer list and the generation */
+static ids_mutex_t trace_lock;
+static TraceBuffer * trace_buffers = NULL;
+static volatile long trace_generation = 0;
+static long trace_capacity = DEFAULT_TRACE_EVENTS;
+
+static IDS_THREAD_LOCAL TraceBuffer * trace_local = NULL;
+static IDS_THREAD_LOCAL const char * trace_local_name = NULL;
+
+void trace_init(void)
+{
+    ids_mutex_init(&trace_lock);
+}
+
+static unsigned long trace_thread_id(void)
+{
+#ifdef _WIN32
+    return (unsigned long)GetCurrentThreadId();
+#else
+    return (unsigned long)syscall(SYS_gettid);
+#endif
+}
+
+/**
+  * Gives the calling thread a buffer of the current generation, reusing its
+  * own buffer from an earlier one
+  * @return NULL when tracing is off or out of memory
+  */
+static TraceBuffer * trace_attach(void)
+{
+    TraceBuffer * buffer = trace_local;
+
+    ids_mutex_lock(&trace_lock);
+    if (!ids_trace_enabled)
+    {
+        ids_mutex_unlock(&trace_lock);
+        return NULL;
+    }
+    if (buffer != NULL && buffer->capacity != trace_capacity)
+    {
+        /* Resized, the old buffer is freed by the next trace_start */
+        buffer->orphaned = 1;
+        buffer = NULL;
+    }
+    if (buffer == NULL)
+    {
+        buffer = (TraceBuffer *)calloc(1, sizeof(TraceBuffer));
+        if (buffer != NULL)
+        {
+            buffer->events = (TraceEvent *)malloc(trace_capacity * sizeof(TraceEvent));
+            if (buffer->events == NULL)
+            {
+                free(buffer);
+                buffer = NULL;
+            }
+        }
+        if (buffer == NULL)
+        {
+            ids_mutex_unlock(&trace_lock);
+            return NULL;
+        }
+        buffer->capacity = trace_capacity;
+        buffer->tid = trace_thread_id();
+        buffer->next = trace_buffers;
+        trace_buffers = buffer;
+    }
+    buffer->thread_name = trace_local_name;
+    buffer->count = 0;
+    buffer->dropped = 0;
+    buffer->generation = trace_generation;
+    ids_mutex_unlock(&trace_lock);
+
+    trace_local = buffer;
+    return buffer;
+}
+
+/**
+  * Appends a stage that started at start_ns and ends now. Only reached
+  * through TRACE_END while tracing is on.
+  */
+void trace_record(const char * name, int64_t start_ns, int64_t frame)
+{
+    TraceBuffer * buffer = trace_local;
+    int64_t end_ns = ids_monotonic_ns();
+    TraceEvent * event;
+    long index;
+
+    if (buffer == NULL || buffer->generation != trace_generation)
+    {
+        buffer = trace_attach();
+        if (buffer == NULL)
+        {
+            return;
+        }
+    }
+
+    index = buffer->count;
+    if (index >= buffer->capacity)
+    {
+        ids_atomic_add64(&buffer->dropped, 1);
+        return;
+    }
+    event = &buffer->events[index];
+    event->name = name;
+    event->start_ns = start_ns;
+    event->duration_ns = end_ns - start_ns;
+    event->frame = frame;
+    ids_atomic_inc(&buffer->count);
+}
+
+/**
+  * Names the calling thread in the trace, name must be a literal
+  */
+void trace_thread_name(const char * name)
+{
+    trace_local_name = name;
+    if (trace_local != NULL)
+    {
+        trace_local->thread_name = name;
+    }
+}
+
+/**
+  * Hands the buffer of an exiting thread over to the next trace_start, which
+  * frees it. Its events stay in the dump until then.
+  */
+void trace_thread_exit(void)
+{
+    if (trace_local != NULL)
+    {
+        ids_mutex_lock(&trace_lock);
+        trace_local->orphaned = 1;
+        ids_mutex_unlock(&trace_lock);
+        trace_local = NULL;
+    }
+    trace_local_name = NULL;
+}
+
+/**
+  * Growable text buffer the JSON is built in
+  */
+typedef struct
+{
+    char *             data;
+    size_t             size;
+    size_t             capacity;
+} TraceText;
+
+static int trace_text_printf(TraceText * text, const char * format, ...)
+{
+    va_list args;
+    size_t needed;
+    char * grown;
+    int written;
+
+    for (;;)
+    {
+        va_start(args, format);
+        written = vsnprintf(text->data + text->size, text->capacity - text->size, format, args);
+        va_end(args);
+        if (written < 0)
+        {
+            return -1;
+        }
+        if ((size_t)written < text->capacity - text->size)
+        {
+            text->size += written;
+            return 0;
+        }
+        needed = text->size + written + 1;
+        grown = (char *)realloc(text->data, needed > 2 * text->capacity ? needed : 2 * text->capacity);
+        if (grown == NULL)
+        {
+            return -1;
+        }
+        text->data = grown;
+        text->capacity = needed > 2 * text->capacity ? needed : 2 * text->capacity;
+    }
+}
+
+/**
+  * Renders the events of the current generation as Chrome trace-event JSON
+  * @return 0 on success, -1 when out of memory
+  */
+static int trace_render(TraceText * text, int64_t * events, int64_t * dropped)
+{
+    TraceBuffer * buffer;
+    TraceEvent * event;
+    const char * separator = "";
+    long count;
+    long i;
+    int pid;
+    int failed = 0;
+
+#ifdef _WIN32
+    pid = (int)GetCurrentProcessId();
+#else
+    pid = (int)getpid();
+#endif
+    *events = 0;
+    *dropped = 0;
+
+    failed |= trace_text_printf(text, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    ids_mutex_lock(&trace_lock);
+    for (buffer = trace_buffers; buffer != NULL && !failed; buffer = buffer->next)
+    {
+        if (buffer->generation != trace_generation)
+        {
+            continue;
+        }
+        if (buffer->thread_name != NULL)
+        {
+            failed |= trace_text_printf(text, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%lu,\"args\":{\"name\":\"%s\"}}",
+                    separator, pid, buffer->tid, buffer->thread_name);
+            separator = ",";
+        }
+        count = buffer->count;
+        for (i = 0; i < count && !failed; i++)
+        {
+            event = &buffer->events[i];
+            failed |= trace_text_printf(text, "%s{\"name\":\"%s\",\"cat\":\"ids\",\"ph\":\"X\",\"pid\":%d,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%lld}}",
+                    separator, event->name, pid, buffer->tid, event->start_ns / 1e3, event->duration_ns / 1e3, (long long)event->frame);
+            separator = ",";
+        }
+        *events += count;
+        *dropped += ids_atomic_load64(&buffer->dropped);
+    }
+    ids_mutex_unlock(&trace_lock);
+    failed |= trace_text_printf(text, "],\"otherData\":{\"dropped_events\":%lld}}", (long long)*dropped);
+    return failed ? -1 : 0;
+}
+
+/**
+  * Function to start recording pipeline stages, dropping earlier events
+  * This means the definition of the function is:
+  *     def trace_start(events_per_thread=65536)
+  * @note Each thread that records gets a buffer of events_per_thread events,
+  *       further events of that thread are counted as dropped
+  */
+PyObject * ids_trace_start(PyObject * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"events_per_thread", NULL};
+    TraceBuffer ** link;
+    TraceBuffer * buffer;
+    long capacity = DEFAULT_TRACE_EVENTS;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|l", kwlist, &capacity))
+    {
+        return NULL;
+    }
+    if (capacity < 1)
+    {
+        PyErr_SetString(PyExc_ValueError, "events_per_thread must be positive");
+        return NULL;
+    }
+
+    ids_mutex_lock(&trace_lock);
+    link = &trace_buffers;
+    while (*link != NULL)
+    {
+        buffer = *link;
+        if (buffer->orphaned)
+        {
+            *link = buffer->next;
+            free(buffer->events);
+            free(buffer);
+        }
+        else
+        {
+            link = &buffer->next;
+        }
+    }
+    trace_capacity = capacity;
+    trace_generation++;
+    ids_trace_enabled = 1;
+    ids_mutex_unlock(&trace_lock);
+    Py_RETURN_NONE;
+}
+
+/**
+  * Function to stop recording, the events stay available to trace_dump
+  * @return A dictionary with the number of recorded and dropped events
+  */
+PyObject * ids_trace_stop(PyObject * self)
+{
+    TraceBuffer * buffer;
+    int64_t events = 0;
+    int64_t dropped = 0;
+
+    ids_mutex_lock(&trace_lock);
+    ids_trace_enabled = 0;
+    for (buffer = trace_buffers; buffer != NULL; buffer = buffer->next)
+    {
+        if (buffer->generation == trace_generation)
+        {
+            events += buffer->count;
+            dropped += ids_atomic_load64(&buffer->dropped);
+        }
+    }
+    ids_mutex_unlock(&trace_lock);
+
+    return Py_BuildValue("{s:L,s:L}", "events", events, "dropped", dropped);
+}
+
+/**
+  * Function to write the recorded events as Chrome trace-event JSON, which
+  * Perfetto and chrome://tracing open
+  * This means the definition of the function is:
+  *     def trace_dump(path=None)
+  * @return The JSON text without a path, otherwise the number of events written
+  */
+PyObject * ids_trace_dump(PyObject * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"path", NULL};
+    TraceText text;
+    PyObject * result;
+    char * path = NULL;
+    FILE * file;
+    int64_t events;
+    int64_t dropped;
+    int failed;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|z", kwlist, &path))
+    {
+        return NULL;
+    }
+
+    text.size = 0;
+    text.capacity = 1 << 16;
+    text.data = (char *)malloc(text.capacity);
+    if (text.data == NULL)
+    {
+        return PyErr_NoMemory();
+    }
+    Py_BEGIN_ALLOW_THREADS
+    failed = trace_render(&text, &events, &dropped);
+    Py_END_ALLOW_THREADS
+    if (failed)
+    {
+        free(text.data);
+        return PyErr_NoMemory();
+    }
+
+    if (path == NULL)
+    {
+        result = Py_BuildValue("s", text.data);
+        free(text.data);
+        return result;
+    }
+
+    file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        free(text.data);
+        return PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+    }
+    Py_BEGIN_ALLOW_THREADS
+    failed = fwrite(text.data, 1, text.size, file) != text.size;
+    failed |= fclose(file) != 0;
+    Py_END_ALLOW_THREADS
+    free(text.data);
+    if (failed)
+    {
+        return PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+    }
+    return Py_BuildValue("L", events);
+}
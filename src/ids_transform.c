@@ -0,0 +1,656 @@
+#include <uEye.h>
+#include "ids.h"
+#include <stdlib.h>
+#include <string.h>
+#define PY_ARRAY_UNIQUE_SYMBOL ids_ARRAY_API
+#define NO_IMPORT_ARRAY
+#include <numpy/arrayobject.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/* Side of the square blocks a transpose works through, 16 KB at 4 bytes per pixel */
+#define TRANSFORM_TILE              64
+
+#define DEFAULT_BENCHMARK_WIDTH     1920
+#define DEFAULT_BENCHMARK_HEIGHT    1080
+#define DEFAULT_BENCHMARK_REPEAT    10
+
+/* Names by enum Orientation bits */
+static const char * orientation_names[ORIENTATIONS] = {
+    "none",
+    "flip_lr",
+    "flip_ud",
+    "rotate_180",
+    "transpose",
+    "rotate_270",
+    "rotate_90",
+    "transverse",
+};
+
+/*
+ * One image copied into a new buffer with an orientation applied. width and
+ * height are those of the source.
+ */
+typedef struct
+{
+    const uint8_t *    src;
+    size_t             src_pitch;
+    uint8_t *          dst;
+    size_t             dst_pitch;
+    int                width;
+    int                height;
+    int                bytes;
+    int                orientation;
+} Transform;
+
+/**
+  * Looks up an orientation by name
+  * @return The enum Orientation bits, -1 with a Python exception set
+  */
+int orientation_parse(const char * name)
+{
+    int orientation;
+
+    for (orientation = 0; orientation < ORIENTATIONS; orientation++)
+    {
+        if (strcmp(name, orientation_names[orientation]) == 0)
+        {
+            return orientation;
+        }
+    }
+    PyErr_Format(PyExc_ValueError, "Unknown orientation '%s', expected 'none', 'flip_lr', 'flip_ud', 'rotate_90', "
+            "'rotate_180', 'rotate_270', 'transpose' or 'transverse'", name);
+    return -1;
+}
+
+const char * orientation_name(int orientation)
+{
+    return orientation >= 0 && orientation < ORIENTATIONS ? orientation_names[orientation] : "unknown";
+}
+
+/**
+  * Works out what is left for the host to do: the requested orientation
+  * minus the mirrors the SDK already applies. Mirrors compose by exclusive
+  * or, so a mirror the SDK applies without being asked is undone.
+  */
+int camera_host_orientation(Camera * self)
+{
+    int rop = 0;
+
+    ids_mutex_lock(&self->settings_lock);
+    if (self->settings.applied & SETTING_ROP_EFFECT)
+    {
+        rop = self->settings.rop_effect;
+    }
+    ids_mutex_unlock(&self->settings_lock);
+
+    return self->orientation ^ ((rop & IS_SET_ROP_MIRROR_LEFTRIGHT) ? ORIENT_FLIP_LR : 0)
+            ^ ((rop & IS_SET_ROP_MIRROR_UPDOWN) ? ORIENT_FLIP_UD : 0);
+}
+
+/**
+  * Copies one pixel of any size
+  */
+static void copy_pixel(uint8_t * dst, const uint8_t * src, int bytes)
+{
+    switch (bytes)
+    {
+        case 1:
+            *dst = *src;
+            break;
+        case 2:
+            memcpy(dst, src, 2);
+            break;
+        case 3:
+            memcpy(dst, src, 3);
+            break;
+        case 4:
+            memcpy(dst, src, 4);
+            break;
+        default:
+            memcpy(dst, src, bytes);
+            break;
+    }
+}
+
+/**
+  * Copies a row in reverse pixel order
+  */
+static void reverse_row(const uint8_t * src, uint8_t * dst, int width, int bytes)
+{
+    int x = 0;
+
+#if defined(__SSSE3__)
+    __m128i reverse8 = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    __m128i reverse16 = _mm_setr_epi8(14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1);
+
+    if (bytes == 1)
+    {
+        for (; x + 16 <= width; x += 16)
+        {
+            _mm_storeu_si128((__m128i *)(dst + x), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + width - x - 16)), reverse8));
+        }
+    }
+    else if (bytes == 2)
+    {
+        for (; x + 8 <= width; x += 8)
+        {
+            _mm_storeu_si128((__m128i *)(dst + 2*x), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 2*(width - x - 8))), reverse16));
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    if (bytes == 4)
+    {
+        for (; x + 4 <= width; x += 4)
+        {
+            _mm_storeu_si128((__m128i *)(dst + 4*x), _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(src + 4*(width - x - 4))), _MM_SHUFFLE(0, 1, 2, 3)));
+        }
+    }
+#endif
+    for (; x < width; x++)
+    {
+        copy_pixel(dst + (size_t)x * bytes, src + (size_t)(width - 1 - x) * bytes, bytes);
+    }
+}
+
+/**
+  * Applies the mirrors alone, row by row
+  */
+static void transform_rows(const Transform * t)
+{
+    const uint8_t * src;
+    uint8_t * dst;
+    int y;
+
+    for (y = 0; y < t->height; y++)
+    {
+        src = t->src + (size_t)y * t->src_pitch;
+        dst = t->dst + (size_t)((t->orientation & ORIENT_FLIP_UD) ? t->height - 1 - y : y) * t->dst_pitch;
+        if (t->orientation & ORIENT_FLIP_LR)
+        {
+            reverse_row(src, dst, t->width, t->bytes);
+        }
+        else
+        {
+            memcpy(dst, src, (size_t)t->width * t->bytes);
+        }
+    }
+}
+
+/**
+  * Source row of output column j and source column of output row i
+  */
+static int source_row(const Transform * t, int j)
+{
+    return (t->orientation & ORIENT_FLIP_UD) ? t->height - 1 - j : j;
+}
+
+static int source_column(const Transform * t, int i)
+{
+    return (t->orientation & ORIENT_FLIP_LR) ? t->width - 1 - i : i;
+}
+
+/**
+  * Transposes the output rows i0..i1 and columns j0..j1 pixel by pixel
+  */
+static void transpose_block_scalar(const Transform * t, int i0, int i1, int j0, int j1)
+{
+    const uint8_t * src;
+    uint8_t * dst;
+    int i;
+    int j;
+
+    for (i = i0; i < i1; i++)
+    {
+        src = t->src + (size_t)source_column(t, i) * t->bytes;
+        dst = t->dst + (size_t)i * t->dst_pitch + (size_t)j0 * t->bytes;
+        for (j = j0; j < j1; j++, dst += t->bytes)
+        {
+            copy_pixel(dst, src + (size_t)source_row(t, j) * t->src_pitch, t->bytes);
+        }
+    }
+}
+
+#if defined(__SSE2__)
+/**
+  * Transposes the 8x8 bytes, 8x8 words or 4x4 double words whose top left
+  * output pixel is (i, j). The source rows are loaded in output column
+  * order, which takes care of an upside down flip, and a left-right flip
+  * reverses the order the transposed rows are stored in.
+  */
+static void transpose_micro(const Transform * t, int i, int j, int size)
+{
+    const uint8_t * src = t->src + (size_t)source_column(t, (t->orientation & ORIENT_FLIP_LR) ? i + size - 1 : i) * t->bytes;
+    __m128i a[8];
+    __m128i b[8];
+    __m128i c[8];
+    __m128i out[8];
+    int flip = (t->orientation & ORIENT_FLIP_LR) != 0;
+    int k;
+
+    /* Every lane is written, the 4x4 kernel leaves the upper four zero */
+    for (k = 0; k < 8; k++)
+    {
+        if (k >= size)
+        {
+            a[k] = _mm_setzero_si128();
+        }
+        else if (t->bytes == 1)
+        {
+            a[k] = _mm_loadl_epi64((const __m128i *)(src + (size_t)source_row(t, j + k) * t->src_pitch));
+        }
+        else
+        {
+            a[k] = _mm_loadu_si128((const __m128i *)(src + (size_t)source_row(t, j + k) * t->src_pitch));
+        }
+    }
+
+    if (t->bytes == 1)
+    {
+        b[0] = _mm_unpacklo_epi8(a[0], a[1]);
+        b[1] = _mm_unpacklo_epi8(a[2], a[3]);
+        b[2] = _mm_unpacklo_epi8(a[4], a[5]);
+        b[3] = _mm_unpacklo_epi8(a[6], a[7]);
+        c[0] = _mm_unpacklo_epi16(b[0], b[1]);
+        c[1] = _mm_unpackhi_epi16(b[0], b[1]);
+        c[2] = _mm_unpacklo_epi16(b[2], b[3]);
+        c[3] = _mm_unpackhi_epi16(b[2], b[3]);
+        out[0] = _mm_unpacklo_epi32(c[0], c[2]);
+        out[2] = _mm_unpackhi_epi32(c[0], c[2]);
+        out[4] = _mm_unpacklo_epi32(c[1], c[3]);
+        out[6] = _mm_unpackhi_epi32(c[1], c[3]);
+        for (k = 0; k < 8; k += 2)
+        {
+            out[k + 1] = _mm_unpackhi_epi64(out[k], out[k]);
+        }
+        for (k = 0; k < 8; k++)
+        {
+            _mm_storel_epi64((__m128i *)(t->dst + (size_t)(i + (flip ? 7 - k : k)) * t->dst_pitch + j), out[k]);
+        }
+        return;
+    }
+
+    if (t->bytes == 2)
+    {
+        for (k = 0; k < 4; k++)
+        {
+            b[k] = _mm_unpacklo_epi16(a[2*k], a[2*k + 1]);
+            b[k + 4] = _mm_unpackhi_epi16(a[2*k], a[2*k + 1]);
+        }
+        c[0] = _mm_unpacklo_epi32(b[0], b[1]);
+        c[1] = _mm_unpackhi_epi32(b[0], b[1]);
+        c[2] = _mm_unpacklo_epi32(b[4], b[5]);
+        c[3] = _mm_unpackhi_epi32(b[4], b[5]);
+        c[4] = _mm_unpacklo_epi32(b[2], b[3]);
+        c[5] = _mm_unpackhi_epi32(b[2], b[3]);
+        c[6] = _mm_unpacklo_epi32(b[6], b[7]);
+        c[7] = _mm_unpackhi_epi32(b[6], b[7]);
+        for (k = 0; k < 4; k++)
+        {
+            out[2*k] = _mm_unpacklo_epi64(c[k], c[k + 4]);
+            out[2*k + 1] = _mm_unpackhi_epi64(c[k], c[k + 4]);
+        }
+    }
+    else
+    {
+        b[0] = _mm_unpacklo_epi32(a[0], a[1]);
+        b[1] = _mm_unpackhi_epi32(a[0], a[1]);
+        b[2] = _mm_unpacklo_epi32(a[2], a[3]);
+        b[3] = _mm_unpackhi_epi32(a[2], a[3]);
+        out[0] = _mm_unpacklo_epi64(b[0], b[2]);
+        out[1] = _mm_unpackhi_epi64(b[0], b[2]);
+        out[2] = _mm_unpacklo_epi64(b[1], b[3]);
+        out[3] = _mm_unpackhi_epi64(b[1], b[3]);
+    }
+    for (k = 0; k < size; k++)
+    {
+        _mm_storeu_si128((__m128i *)(t->dst + (size_t)(i + (flip ? size - 1 - k : k)) * t->dst_pitch + (size_t)j * t->bytes), out[k]);
+    }
+}
+#endif
+
+/**
+  * Transposes one tile, in vector blocks where the pixel size has a kernel
+  */
+static void transpose_tile(const Transform * t, int i0, int i1, int j0, int j1)
+{
+    int i = i0;
+    int j;
+    int size = 0;
+
+#if defined(__SSE2__)
+    size = t->bytes == 4 ? 4 : (t->bytes <= 2 ? 8 : 0);
+    for (; size > 0 && i + size <= i1; i += size)
+    {
+        for (j = j0; j + size <= j1; j += size)
+        {
+            transpose_micro(t, i, j, size);
+        }
+        transpose_block_scalar(t, i, i + size, j, j1);
+    }
+#endif
+    transpose_block_scalar(t, i, i1, j0, j1);
+}
+
+/**
+  * Copies an image applying an orientation. A transpose goes through the
+  * image in tiles, so that the source rows a tile reads stay in cache while
+  * its output rows are written.
+  */
+static void transform_image(const Transform * t)
+{
+    int i0;
+    int j0;
+
+    if (!(t->orientation & ORIENT_TRANSPOSE))
+    {
+        transform_rows(t);
+        return;
+    }
+    for (i0 = 0; i0 < t->width; i0 += TRANSFORM_TILE)
+    {
+        for (j0 = 0; j0 < t->height; j0 += TRANSFORM_TILE)
+        {
+            transpose_tile(t, i0, i0 + TRANSFORM_TILE < t->width ? i0 + TRANSFORM_TILE : t->width,
+                    j0, j0 + TRANSFORM_TILE < t->height ? j0 + TRANSFORM_TILE : t->height);
+        }
+    }
+}
+
+/**
+  * Copies a delivered frame into a new C-contiguous array in the camera's
+  * output format with its lens distortion removed and the host part of its
+  * orientation applied. Without an output format the pixels are copied as
+  * delivered, in one pass per stage; with one the frame is converted first.
+  * @note The slot stays retained, the caller releases it
+  * @return New reference, NULL with a Python exception set
+  */
+PyObject * transform_slot(Camera * camera, FrameSlot * slot, int format, int orientation)
+{
+    FrameRing * ring = slot->ring;
+    PyObject * converted = NULL;
+    PyObject * undistorted;
+    PyObject * image;
+    Transform t;
+    npy_intp dimensions[3];
+    npy_intp swap;
+    int ndims;
+    int type = NPY_UINT8;
+    int undistort = camera->undistort != NULL;
+    int channels = 1;
+    int sample_bytes = 1;
+
+    if (format != OUTPUT_RAW)
+    {
+        converted = convert_slot(camera, slot, format);
+        if (converted == NULL || (orientation == 0 && !undistort))
+        {
+            return converted;
+        }
+        ndims = PyArray_NDIM((PyArrayObject *)converted);
+        memcpy(dimensions, PyArray_DIMS((PyArrayObject *)converted), ndims * sizeof(npy_intp));
+        type = PyArray_TYPE((PyArrayObject *)converted);
+        t.src = (const uint8_t *)PyArray_DATA((PyArrayObject *)converted);
+        t.src_pitch = PyArray_STRIDE((PyArrayObject *)converted, 0);
+        t.bytes = (int)PyArray_STRIDE((PyArrayObject *)converted, 1);
+        channels = ndims == 3 ? (int)dimensions[2] : 1;
+        sample_bytes = (int)PyArray_ITEMSIZE((PyArrayObject *)converted);
+    }
+    else
+    {
+        if ((ring->color == IS_CM_UYVY_PACKED || ring->color == IS_CM_CBYCRY_PACKED) && (orientation & (ORIENT_FLIP_LR | ORIENT_TRANSPOSE)))
+        {
+            PyErr_SetString(PyExc_ValueError, "UYVY pixels share their chroma in pairs and can only be flipped upside down, "
+                    "set output_format to rotate or mirror them");
+            return NULL;
+        }
+        if (undistort && undistort_layout(ring->color, &channels, &sample_bytes) != 0)
+        {
+            return NULL;
+        }
+        dimensions[0] = slot->info.dwImageHeight ? (npy_intp)slot->info.dwImageHeight : (npy_intp)ring->height;
+        dimensions[1] = slot->info.dwImageWidth ? (npy_intp)slot->info.dwImageWidth : (npy_intp)ring->width;
+        if (ring->color == IS_CM_MONO8 || ring->color == IS_CM_SENSOR_RAW8)
+        {
+            ndims = 2;
+            t.bytes = 1;
+        }
+        else
+        {
+            ndims = 3;
+            dimensions[2] = ring->bitdepth/8;
+            t.bytes = ring->bitdepth/8;
+        }
+        t.src = (const uint8_t *)slot->pBuffer;
+        t.src_pitch = ring->pitch;
+    }
+
+    if (undistort)
+    {
+        undistorted = undistort_copy(camera, t.src, t.src_pitch, ndims, dimensions, type, channels, sample_bytes);
+        Py_XDECREF(converted);
+        if (undistorted == NULL || orientation == 0)
+        {
+            return undistorted;
+        }
+        converted = undistorted;
+        t.src = (const uint8_t *)PyArray_DATA((PyArrayObject *)converted);
+        t.src_pitch = PyArray_STRIDE((PyArrayObject *)converted, 0);
+    }
+
+    t.height = (int)dimensions[0];
+    t.width = (int)dimensions[1];
+    t.orientation = orientation;
+    if (orientation & ORIENT_TRANSPOSE)
+    {
+        swap = dimensions[0];
+        dimensions[0] = dimensions[1];
+        dimensions[1] = swap;
+    }
+    image = PyArray_SimpleNew(ndims, dimensions, type);
+    if (image == NULL)
+    {
+        Py_XDECREF(converted);
+        return NULL;
+    }
+    t.dst = (uint8_t *)PyArray_DATA((PyArrayObject *)image);
+    t.dst_pitch = PyArray_STRIDE((PyArrayObject *)image, 0);
+
+    Py_BEGIN_ALLOW_THREADS
+    transform_image(&t);
+    Py_END_ALLOW_THREADS
+    Py_XDECREF(converted);
+    return image;
+}
+
+/**
+  * Builds the NumPy way of orienting an image: a view with negative or
+  * swapped strides, copied into a C-contiguous array
+  * @return New reference, NULL with a Python exception set
+  */
+static PyObject * numpy_orient(PyObject * image, int orientation)
+{
+    PyObject * view = image;
+    PyObject * next;
+    PyObject * key;
+    PyObject * step;
+    PyObject * copy;
+
+    Py_INCREF(view);
+    if (orientation & (ORIENT_FLIP_LR | ORIENT_FLIP_UD))
+    {
+        step = PyLong_FromLong(-1);
+        key = step != NULL ? Py_BuildValue("(NN)", PySlice_New(NULL, NULL, (orientation & ORIENT_FLIP_UD) ? step : NULL),
+                PySlice_New(NULL, NULL, (orientation & ORIENT_FLIP_LR) ? step : NULL)) : NULL;
+        next = key != NULL ? PyObject_GetItem(view, key) : NULL;
+        Py_XDECREF(step);
+        Py_XDECREF(key);
+        Py_DECREF(view);
+        if (next == NULL)
+        {
+            return NULL;
+        }
+        view = next;
+    }
+    if (orientation & ORIENT_TRANSPOSE)
+    {
+        next = PyArray_SwapAxes((PyArrayObject *)view, 0, 1);
+        Py_DECREF(view);
+        if (next == NULL)
+        {
+            return NULL;
+        }
+        view = next;
+    }
+    copy = PyArray_NewCopy((PyArrayObject *)view, NPY_CORDER);
+    Py_DECREF(view);
+    return copy;
+}
+
+/**
+  * Measures every orientation on a random image against NumPy slicing or
+  * swapaxes followed by a copy into a C-contiguous array
+  * This means the definition of the function is:
+  *     def orientation_benchmark(width=1920, height=1080, pixel_bytes=1, repeat=10)
+  * @arg pixel_bytes 1 for mono8, 2 for mono16, 3 for RGB8 and 4 for RGBA8
+  * @return A list of dicts with orientation, ms, numpy_ms, speedup,
+  *         megapixels_per_s and exact, True when both outputs are identical
+  */
+PyObject * ids_orientation_benchmark(PyObject * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"width", "height", "pixel_bytes", "repeat", NULL};
+    int width = DEFAULT_BENCHMARK_WIDTH;
+    int height = DEFAULT_BENCHMARK_HEIGHT;
+    int repeat = DEFAULT_BENCHMARK_REPEAT;
+    int bytes = 1;
+    PyObject * source = NULL;
+    PyObject * output = NULL;
+    PyObject * reference = NULL;
+    PyObject * list = NULL;
+    PyObject * entry;
+    npy_intp dimensions[3];
+    Transform t;
+    uint8_t * data;
+    uint32_t seed = 12345;
+    int64_t start;
+    int64_t elapsed;
+    int64_t best;
+    int64_t numpy_best;
+    int orientation;
+    int exact;
+    int i;
+    size_t n;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|iiii", kwlist, &width, &height, &bytes, &repeat))
+    {
+        return NULL;
+    }
+    if (width < 1 || height < 1 || repeat < 1 || bytes < 1 || bytes > 4)
+    {
+        PyErr_SetString(PyExc_ValueError, "width, height and repeat must be positive and pixel_bytes between 1 and 4");
+        return NULL;
+    }
+
+    dimensions[0] = height;
+    dimensions[1] = width;
+    dimensions[2] = bytes;
+    source = PyArray_SimpleNew(bytes >= 3 ? 3 : 2, dimensions, bytes == 2 ? NPY_UINT16 : NPY_UINT8);
+    list = PyList_New(0);
+    if (source == NULL || list == NULL)
+    {
+        goto error;
+    }
+    data = (uint8_t *)PyArray_DATA((PyArrayObject *)source);
+    for (n = 0; n < (size_t)width * height * bytes; n++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        data[n] = (uint8_t)(seed >> 16);
+    }
+
+    for (orientation = 1; orientation < ORIENTATIONS; orientation++)
+    {
+        if (orientation & ORIENT_TRANSPOSE)
+        {
+            dimensions[0] = width;
+            dimensions[1] = height;
+        }
+        else
+        {
+            dimensions[0] = height;
+            dimensions[1] = width;
+        }
+        output = PyArray_SimpleNew(bytes >= 3 ? 3 : 2, dimensions, bytes == 2 ? NPY_UINT16 : NPY_UINT8);
+        if (output == NULL)
+        {
+            goto error;
+        }
+        t.src = data;
+        t.src_pitch = (size_t)width * bytes;
+        t.dst = (uint8_t *)PyArray_DATA((PyArrayObject *)output);
+        t.dst_pitch = (size_t)dimensions[1] * bytes;
+        t.width = width;
+        t.height = height;
+        t.bytes = bytes;
+        t.orientation = orientation;
+
+        best = 0;
+        Py_BEGIN_ALLOW_THREADS
+        for (i = 0; i < repeat; i++)
+        {
+            start = ids_monotonic_ns();
+            transform_image(&t);
+            elapsed = ids_monotonic_ns() - start;
+            if (i == 0 || elapsed < best)
+            {
+                best = elapsed;
+            }
+        }
+        Py_END_ALLOW_THREADS
+
+        numpy_best = 0;
+        for (i = 0; i < repeat; i++)
+        {
+            Py_XDECREF(reference);
+            start = ids_monotonic_ns();
+            reference = numpy_orient(source, orientation);
+            elapsed = ids_monotonic_ns() - start;
+            if (reference == NULL)
+            {
+                goto error;
+            }
+            if (i == 0 || elapsed < numpy_best)
+            {
+                numpy_best = elapsed;
+            }
+        }
+        exact = memcmp(PyArray_DATA((PyArrayObject *)output), PyArray_DATA((PyArrayObject *)reference), (size_t)width * height * bytes) == 0;
+        Py_CLEAR(reference);
+        Py_CLEAR(output);
+
+        entry = Py_BuildValue("{s:s,s:d,s:d,s:d,s:d,s:O}",
+                "orientation", orientation_names[orientation],
+                "ms", best / 1e6,
+                "numpy_ms", numpy_best / 1e6,
+                "speedup", best > 0 ? (double)numpy_best / best : 0.0,
+                "megapixels_per_s", best > 0 ? (double)width * height * 1e3 / best : 0.0,
+                "exact", exact ? Py_True : Py_False);
+        if (entry == NULL || PyList_Append(list, entry) != 0)
+        {
+            Py_XDECREF(entry);
+            goto error;
+        }
+        Py_DECREF(entry);
+    }
+    Py_DECREF(source);
+    return list;
+
+error:
+    Py_XDECREF(source);
+    Py_XDECREF(output);
+    Py_XDECREF(reference);
+    Py_XDECREF(list);
+    return NULL;
+}
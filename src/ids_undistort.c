@@ -0,0 +1,1344 @@
+#include <uEye.h>
+#include "ids.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#define PY_ARRAY_UNIQUE_SYMBOL ids_ARRAY_API
+#define NO_IMPORT_ARRAY
+#include <numpy/arrayobject.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/* Threads a remap is split over, the calling thread included */
+#define UNDISTORT_MAX_THREADS       16
+/* Output pixels a thread works through at a time, 8 KB of map per tile */
+#define UNDISTORT_TILE_WIDTH        128
+#define UNDISTORT_TILE_HEIGHT       8
+/* Source positions are quantised to 1/256 pixel */
+#define UNDISTORT_FRACTION_BITS     8
+#define UNDISTORT_ONE               (1 << UNDISTORT_FRACTION_BITS)
+#define UNDISTORT_ROUND             (1 << (2 * UNDISTORT_FRACTION_BITS - 1))
+/* Map entry of an output pixel whose source lies outside the image */
+#define UNDISTORT_OUTSIDE           0xFFFFFFFFu
+#define UNDISTORT_POLL_MS           1000
+
+#define DEFAULT_BENCHMARK_WIDTH     1920
+#define DEFAULT_BENCHMARK_HEIGHT    1080
+#define DEFAULT_BENCHMARK_REPEAT    10
+
+/*
+ * Pinhole camera with Brown-Conrady lens distortion, in OpenCV's
+ * conventions. k holds k1, k2, p1, p2, k3, k4, k5 and k6; terms that were
+ * not given are 0.
+ */
+typedef struct
+{
+    double             fx;
+    double             fy;
+    double             cx;
+    double             cy;
+    double             skew;
+    double             k[8];
+} UndistortModel;
+
+/*
+ * Fixed-point remap table of one AOI. For every output pixel it holds the
+ * top-left of the 2 x 2 source pixels it is interpolated from and the
+ * bilinear weights of the right and bottom ones.
+ */
+typedef struct
+{
+    int                width;
+    int                height;
+    int                x;
+    int                y;
+    uint32_t *         xy;         /* y << 16 | x, UNDISTORT_OUTSIDE */
+    uint32_t *         weights;    /* fy << 16 | fx, 0 to UNDISTORT_ONE */
+} UndistortMap;
+
+struct Undistort;
+
+/*
+ * Work split into tiles of the map, which the calling thread and the
+ * workers take in turn
+ */
+typedef struct UndistortJob
+{
+    void               (*tile)(struct UndistortJob * job, int x0, int y0, int x1, int y1);
+    struct Undistort * undistort;
+    const uint8_t *    src;
+    size_t             src_pitch;
+    uint8_t *          dst;
+    size_t             dst_pitch;
+    int                channels;
+    int                sample_bytes;
+    int                simd;
+    int                tiles_x;
+    long               tiles;
+    volatile long      next_tile;
+} UndistortJob;
+
+typedef struct Undistort
+{
+    volatile long      refcount;
+    Camera *           camera;     /* NULL for ids.undistort */
+    UndistortModel     model;
+    /* Place of the image on the sensor unless an AOI was set on the camera */
+    int                origin_x;
+    int                origin_y;
+
+    /* Serialises remaps and guards map */
+    ids_mutex_t        lock;
+    UndistortMap       map;
+
+    /* Worker pool, a job is handed out by bumping generation */
+    ids_mutex_t        pool_lock;
+    ids_cond_t         wake;
+    ids_cond_t         done;
+    UndistortJob *     job;
+    int64_t            generation;
+    int                active;
+    int                running;
+    int                workers;
+    ids_thread_t       threads[UNDISTORT_MAX_THREADS];
+
+    volatile int64_t   frames;
+    volatile int64_t   map_builds;
+    volatile int64_t   map_ns;
+    volatile int64_t   last_ns;
+    volatile int64_t   total_ns;
+} Undistort;
+
+/**
+  * Projects an output pixel through the lens model
+  * @arg u, v Undistorted position on the sensor
+  * @arg sx, sy Where that point lands in the distorted image
+  */
+static void undistort_point(const UndistortModel * model, double u, double v, double * sx, double * sy)
+{
+    const double * k = model->k;
+    double x;
+    double y;
+    double x2;
+    double y2;
+    double r2;
+    double radial;
+    double xd;
+    double yd;
+
+    y = (v - model->cy) / model->fy;
+    x = (u - model->cx - model->skew * y) / model->fx;
+    x2 = x * x;
+    y2 = y * y;
+    r2 = x2 + y2;
+    radial = (1.0 + r2 * (k[0] + r2 * (k[1] + r2 * k[4]))) / (1.0 + r2 * (k[5] + r2 * (k[6] + r2 * k[7])));
+    xd = x * radial + 2.0 * k[2] * x * y + k[3] * (r2 + 2.0 * x2);
+    yd = y * radial + k[2] * (r2 + 2.0 * y2) + 2.0 * k[3] * x * y;
+    *sx = model->fx * xd + model->skew * yd + model->cx;
+    *sy = model->fy * yd + model->cy;
+}
+
+/**
+  * Finds the 2 x 2 source pixels around a point, the last row and column
+  * interpolating towards the one before
+  * @return 0 when the point lies outside the image
+  */
+static int undistort_cell(double sx, double sy, int width, int height, int * x, int * y)
+{
+    if (!(sx >= 0.0 && sx <= width - 1 && sy >= 0.0 && sy <= height - 1) || width < 2 || height < 2)
+    {
+        return 0;
+    }
+    *x = (int)sx < width - 2 ? (int)sx : width - 2;
+    *y = (int)sy < height - 2 ? (int)sy : height - 2;
+    return 1;
+}
+
+static void map_tile(UndistortJob * job, int x0, int y0, int x1, int y1)
+{
+    Undistort * undistort = job->undistort;
+    UndistortMap * map = &undistort->map;
+    double sx;
+    double sy;
+    size_t i;
+    int x;
+    int y;
+    int u;
+    int v;
+
+    for (v = y0; v < y1; v++)
+    {
+        for (u = x0; u < x1; u++)
+        {
+            i = (size_t)v * map->width + u;
+            undistort_point(&undistort->model, u + map->x, v + map->y, &sx, &sy);
+            sx -= map->x;
+            sy -= map->y;
+            if (!undistort_cell(sx, sy, map->width, map->height, &x, &y))
+            {
+                map->xy[i] = UNDISTORT_OUTSIDE;
+                map->weights[i] = 0;
+                continue;
+            }
+            map->xy[i] = (uint32_t)y << 16 | (uint32_t)x;
+            map->weights[i] = (uint32_t)((sy - y) * UNDISTORT_ONE + 0.5) << 16 | (uint32_t)((sx - x) * UNDISTORT_ONE + 0.5);
+        }
+    }
+}
+
+/**
+  * Interpolates a run of one output row
+  */
+static void remap_span_scalar(const UndistortJob * job, int v, int u0, int u1)
+{
+    const UndistortMap * map = &job->undistort->map;
+    const uint32_t * xy = map->xy + (size_t)v * map->width;
+    const uint32_t * weights = map->weights + (size_t)v * map->width;
+    size_t pixel = (size_t)job->channels * job->sample_bytes;
+    uint8_t * dst = job->dst + v * job->dst_pitch + u0 * pixel;
+    const uint8_t * top;
+    const uint16_t * top16;
+    const uint16_t * bottom16;
+    uint32_t fx;
+    uint32_t fy;
+    uint32_t upper;
+    uint32_t lower;
+    int c;
+    int u;
+
+    for (u = u0; u < u1; u++, dst += pixel)
+    {
+        if (xy[u] == UNDISTORT_OUTSIDE)
+        {
+            memset(dst, 0, pixel);
+            continue;
+        }
+        top = job->src + (xy[u] >> 16) * job->src_pitch + (xy[u] & 0xFFFF) * pixel;
+        fx = weights[u] & 0xFFFF;
+        fy = weights[u] >> 16;
+        if (job->sample_bytes == 1)
+        {
+            for (c = 0; c < job->channels; c++)
+            {
+                upper = top[c] * (UNDISTORT_ONE - fx) + top[c + pixel] * fx;
+                lower = top[c + job->src_pitch] * (UNDISTORT_ONE - fx) + top[c + job->src_pitch + pixel] * fx;
+                dst[c] = (uint8_t)((upper * (UNDISTORT_ONE - fy) + lower * fy + UNDISTORT_ROUND) >> (2 * UNDISTORT_FRACTION_BITS));
+            }
+        }
+        else
+        {
+            top16 = (const uint16_t *)top;
+            bottom16 = (const uint16_t *)(top + job->src_pitch);
+            for (c = 0; c < job->channels; c++)
+            {
+                upper = top16[c] * (UNDISTORT_ONE - fx) + top16[c + job->channels] * fx;
+                lower = bottom16[c] * (UNDISTORT_ONE - fx) + bottom16[c + job->channels] * fx;
+                ((uint16_t *)dst)[c] = (uint16_t)((upper * (UNDISTORT_ONE - fy) + lower * fy + UNDISTORT_ROUND) >> (2 * UNDISTORT_FRACTION_BITS));
+            }
+        }
+    }
+}
+
+#if defined(__AVX2__)
+/**
+  * Interpolates a run of one output row of single-channel pixels, 8 per
+  * iteration. Each gather fetches a horizontal pair of source pixels in one
+  * 32 bit load. For 8 bit samples the lower pair is loaded ending at the
+  * pair rather than starting at it, so neither load reads outside the image.
+  * The products are taken modulo 2^32, which holds the exact sums since
+  * they are never negative and never reach 2^32.
+  * @return Number of pixels done, the caller handles the tail
+  */
+static int remap_span_avx2(const UndistortJob * job, int v, int u0, int u1)
+{
+    const UndistortMap * map = &job->undistort->map;
+    const uint32_t * xy = map->xy + (size_t)v * map->width;
+    const uint32_t * weights = map->weights + (size_t)v * map->width;
+    const int * upper_base = (const int *)job->src;
+    const int * lower_base = (const int *)(job->src + job->src_pitch - (job->sample_bytes == 1 ? 2 : 0));
+    uint8_t * dst = job->dst + v * job->dst_pitch;
+    __m256i outside = _mm256_set1_epi32(-1);
+    __m256i low8 = _mm256_set1_epi32(0xFF);
+    __m256i low16 = _mm256_set1_epi32(0xFFFF);
+    __m256i pitch = _mm256_set1_epi32((int)job->src_pitch);
+    __m256i round = _mm256_set1_epi32(UNDISTORT_ROUND);
+    __m256i entry;
+    __m256i invalid;
+    __m256i offset;
+    __m256i weight;
+    __m256i fx;
+    __m256i fy;
+    __m256i upper;
+    __m256i lower;
+    __m256i a;
+    __m256i b;
+    __m256i c;
+    __m256i d;
+    __m128i packed;
+    int u;
+
+    if (job->channels != 1 || map->width < 2 || map->height < 2 || (size_t)map->height * job->src_pitch > INT32_MAX)
+    {
+        return 0;
+    }
+    for (u = u0; u + 8 <= u1; u += 8)
+    {
+        entry = _mm256_loadu_si256((const __m256i *)(xy + u));
+        weight = _mm256_loadu_si256((const __m256i *)(weights + u));
+        invalid = _mm256_cmpeq_epi32(entry, outside);
+        entry = _mm256_andnot_si256(invalid, entry);
+        offset = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(entry, 16), pitch),
+                _mm256_slli_epi32(_mm256_and_si256(entry, low16), job->sample_bytes - 1));
+        upper = _mm256_i32gather_epi32(upper_base, offset, 1);
+        lower = _mm256_i32gather_epi32(lower_base, offset, 1);
+        if (job->sample_bytes == 1)
+        {
+            a = _mm256_and_si256(upper, low8);
+            b = _mm256_and_si256(_mm256_srli_epi32(upper, 8), low8);
+            c = _mm256_and_si256(_mm256_srli_epi32(lower, 16), low8);
+            d = _mm256_srli_epi32(lower, 24);
+        }
+        else
+        {
+            a = _mm256_and_si256(upper, low16);
+            b = _mm256_srli_epi32(upper, 16);
+            c = _mm256_and_si256(lower, low16);
+            d = _mm256_srli_epi32(lower, 16);
+        }
+        fx = _mm256_and_si256(weight, low16);
+        fy = _mm256_srli_epi32(weight, 16);
+
+        /* a * (1 - fx) + b * fx as a * 256 + (b - a) * fx */
+        upper = _mm256_add_epi32(_mm256_slli_epi32(a, UNDISTORT_FRACTION_BITS), _mm256_mullo_epi32(_mm256_sub_epi32(b, a), fx));
+        lower = _mm256_add_epi32(_mm256_slli_epi32(c, UNDISTORT_FRACTION_BITS), _mm256_mullo_epi32(_mm256_sub_epi32(d, c), fx));
+        upper = _mm256_add_epi32(_mm256_slli_epi32(upper, UNDISTORT_FRACTION_BITS), _mm256_mullo_epi32(_mm256_sub_epi32(lower, upper), fy));
+        upper = _mm256_srli_epi32(_mm256_add_epi32(upper, round), 2 * UNDISTORT_FRACTION_BITS);
+        upper = _mm256_andnot_si256(invalid, upper);
+
+        /* Both halves packed to 16 bits land in the low 128 bits */
+        packed = _mm256_castsi256_si128(_mm256_permute4x64_epi64(_mm256_packus_epi32(upper, upper), 0x08));
+        if (job->sample_bytes == 1)
+        {
+            _mm_storel_epi64((__m128i *)(dst + u), _mm_packus_epi16(packed, packed));
+        }
+        else
+        {
+            _mm_storeu_si128((__m128i *)(dst + 2 * u), packed);
+        }
+    }
+    return u - u0;
+}
+
+/**
+  * Interpolates a run of one output row of 8 bit RGB or RGBA pixels, 8 per
+  * iteration. Every corner pixel is gathered whole and its channels are
+  * interpolated one after the other as in remap_span_avx2. Lower RGB pixels
+  * are loaded from one byte before, and the run stops 2 pixels early since
+  * 8 RGB pixels are stored as 32 bytes, so that neither reads outside the
+  * image nor writes beyond the run.
+  * @return Number of pixels done, the caller handles the tail
+  */
+static int remap_span_color_avx2(const UndistortJob * job, int v, int u0, int u1)
+{
+    const UndistortMap * map = &job->undistort->map;
+    const uint32_t * xy = map->xy + (size_t)v * map->width;
+    const uint32_t * weights = map->weights + (size_t)v * map->width;
+    int channels = job->channels;
+    int lower_shift = channels == 3 ? 8 : 0;
+    int margin = channels == 3 ? 2 : 0;
+    const int * upper_base = (const int *)job->src;
+    const int * lower_base = (const int *)(job->src + job->src_pitch - lower_shift / 8);
+    uint8_t * dst = job->dst + v * job->dst_pitch;
+    __m256i outside = _mm256_set1_epi32(-1);
+    __m256i low8 = _mm256_set1_epi32(0xFF);
+    __m256i low16 = _mm256_set1_epi32(0xFFFF);
+    __m256i pitch = _mm256_set1_epi32((int)job->src_pitch);
+    __m256i step = _mm256_set1_epi32(channels);
+    __m256i round = _mm256_set1_epi32(UNDISTORT_ROUND);
+    /* Drops the fourth byte of every pixel, leaving 12 bytes per lane */
+    __m256i pack3 = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+            0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    __m256i entry;
+    __m256i invalid;
+    __m256i offset;
+    __m256i weight;
+    __m256i fx;
+    __m256i fy;
+    __m256i pa;
+    __m256i pb;
+    __m256i pc;
+    __m256i pd;
+    __m256i a;
+    __m256i b;
+    __m256i c;
+    __m256i d;
+    __m256i upper;
+    __m256i lower;
+    __m256i pixels;
+    int channel;
+    int u;
+
+    if (job->sample_bytes != 1 || channels < 3 || map->width < 2 || map->height < 2 || (size_t)map->height * job->src_pitch > INT32_MAX)
+    {
+        return 0;
+    }
+    for (u = u0; u + 8 + margin <= u1; u += 8)
+    {
+        entry = _mm256_loadu_si256((const __m256i *)(xy + u));
+        weight = _mm256_loadu_si256((const __m256i *)(weights + u));
+        invalid = _mm256_cmpeq_epi32(entry, outside);
+        entry = _mm256_andnot_si256(invalid, entry);
+        offset = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(entry, 16), pitch),
+                _mm256_mullo_epi32(_mm256_and_si256(entry, low16), step));
+        pa = _mm256_i32gather_epi32(upper_base, offset, 1);
+        pc = _mm256_i32gather_epi32(lower_base, offset, 1);
+        offset = _mm256_add_epi32(offset, step);
+        pb = _mm256_i32gather_epi32(upper_base, offset, 1);
+        pd = _mm256_i32gather_epi32(lower_base, offset, 1);
+        fx = _mm256_and_si256(weight, low16);
+        fy = _mm256_srli_epi32(weight, 16);
+
+        pixels = _mm256_setzero_si256();
+        for (channel = 0; channel < channels; channel++)
+        {
+            a = _mm256_and_si256(_mm256_srli_epi32(pa, 8 * channel), low8);
+            b = _mm256_and_si256(_mm256_srli_epi32(pb, 8 * channel), low8);
+            c = _mm256_and_si256(_mm256_srli_epi32(pc, 8 * channel + lower_shift), low8);
+            d = _mm256_and_si256(_mm256_srli_epi32(pd, 8 * channel + lower_shift), low8);
+            upper = _mm256_add_epi32(_mm256_slli_epi32(a, UNDISTORT_FRACTION_BITS), _mm256_mullo_epi32(_mm256_sub_epi32(b, a), fx));
+            lower = _mm256_add_epi32(_mm256_slli_epi32(c, UNDISTORT_FRACTION_BITS), _mm256_mullo_epi32(_mm256_sub_epi32(d, c), fx));
+            upper = _mm256_add_epi32(_mm256_slli_epi32(upper, UNDISTORT_FRACTION_BITS), _mm256_mullo_epi32(_mm256_sub_epi32(lower, upper), fy));
+            upper = _mm256_srli_epi32(_mm256_add_epi32(upper, round), 2 * UNDISTORT_FRACTION_BITS);
+            pixels = _mm256_or_si256(pixels, _mm256_slli_epi32(upper, 8 * channel));
+        }
+        pixels = _mm256_andnot_si256(invalid, pixels);
+
+        if (channels == 4)
+        {
+            _mm256_storeu_si256((__m256i *)(dst + 4 * u), pixels);
+        }
+        else
+        {
+            pixels = _mm256_shuffle_epi8(pixels, pack3);
+            _mm_storeu_si128((__m128i *)(dst + 3 * u), _mm256_castsi256_si128(pixels));
+            _mm_storeu_si128((__m128i *)(dst + 3 * u + 12), _mm256_extracti128_si256(pixels, 1));
+        }
+    }
+    return u - u0;
+}
+#endif
+
+static void remap_tile(UndistortJob * job, int x0, int y0, int x1, int y1)
+{
+    int u;
+    int v;
+
+    for (v = y0; v < y1; v++)
+    {
+        u = x0;
+#if defined(__AVX2__)
+        if (job->simd)
+        {
+            u += job->channels == 1 ? remap_span_avx2(job, v, x0, x1) : remap_span_color_avx2(job, v, x0, x1);
+        }
+#endif
+        remap_span_scalar(job, v, u, x1);
+    }
+}
+
+static void undistort_run_tiles(UndistortJob * job)
+{
+    const UndistortMap * map = &job->undistort->map;
+    long tile;
+    int x0;
+    int y0;
+
+    while ((tile = ids_atomic_inc(&job->next_tile) - 1) < job->tiles)
+    {
+        x0 = (int)(tile % job->tiles_x) * UNDISTORT_TILE_WIDTH;
+        y0 = (int)(tile / job->tiles_x) * UNDISTORT_TILE_HEIGHT;
+        job->tile(job, x0, y0,
+                x0 + UNDISTORT_TILE_WIDTH < map->width ? x0 + UNDISTORT_TILE_WIDTH : map->width,
+                y0 + UNDISTORT_TILE_HEIGHT < map->height ? y0 + UNDISTORT_TILE_HEIGHT : map->height);
+    }
+}
+
+/**
+  * Worker thread: takes tiles of every job handed out until the pool stops
+  */
+static void undistort_worker(void * arg)
+{
+    Undistort * undistort = (Undistort *)arg;
+    UndistortJob * job;
+    int64_t seen = 0;
+
+    trace_thread_name("ids undistort");
+    if (undistort->camera != NULL)
+    {
+        thread_options_apply(undistort->camera, THREAD_PROCESSING);
+    }
+
+    ids_mutex_lock(&undistort->pool_lock);
+    while (undistort->running)
+    {
+        if (undistort->generation == seen)
+        {
+            ids_cond_wait(&undistort->wake, &undistort->pool_lock, UNDISTORT_POLL_MS);
+            continue;
+        }
+        seen = undistort->generation;
+        job = undistort->job;
+        ids_mutex_unlock(&undistort->pool_lock);
+        undistort_run_tiles(job);
+        ids_mutex_lock(&undistort->pool_lock);
+        if (--undistort->active == 0)
+        {
+            ids_cond_signal(&undistort->done);
+        }
+    }
+    ids_mutex_unlock(&undistort->pool_lock);
+    trace_thread_exit();
+}
+
+/**
+  * Runs a job over the whole map, on the calling thread and, with parallel
+  * set, on every worker
+  */
+static void undistort_run(Undistort * undistort, UndistortJob * job, int parallel)
+{
+    job->undistort = undistort;
+    job->tiles_x = (undistort->map.width + UNDISTORT_TILE_WIDTH - 1) / UNDISTORT_TILE_WIDTH;
+    job->tiles = (long)job->tiles_x * ((undistort->map.height + UNDISTORT_TILE_HEIGHT - 1) / UNDISTORT_TILE_HEIGHT);
+    job->next_tile = 0;
+    if (!parallel || undistort->workers == 0)
+    {
+        undistort_run_tiles(job);
+        return;
+    }
+
+    ids_mutex_lock(&undistort->pool_lock);
+    undistort->job = job;
+    undistort->active = undistort->workers;
+    undistort->generation++;
+    ids_cond_broadcast(&undistort->wake);
+    ids_mutex_unlock(&undistort->pool_lock);
+
+    undistort_run_tiles(job);
+
+    ids_mutex_lock(&undistort->pool_lock);
+    while (undistort->active > 0)
+    {
+        ids_cond_wait(&undistort->done, &undistort->pool_lock, UNDISTORT_POLL_MS);
+    }
+    ids_mutex_unlock(&undistort->pool_lock);
+}
+
+/**
+  * Rebuilds the map when the image or its place on the sensor changed
+  * @note Called with undistort->lock held
+  * @return 0 on success, -1 when out of memory
+  */
+static int undistort_prepare(Undistort * undistort, int width, int height, int x, int y)
+{
+    UndistortMap * map = &undistort->map;
+    UndistortJob job;
+    int64_t start;
+
+    if (map->xy != NULL && map->width == width && map->height == height && map->x == x && map->y == y)
+    {
+        return 0;
+    }
+    free(map->xy);
+    free(map->weights);
+    map->xy = (uint32_t *)malloc((size_t)width * height * sizeof(uint32_t));
+    map->weights = (uint32_t *)malloc((size_t)width * height * sizeof(uint32_t));
+    if (map->xy == NULL || map->weights == NULL)
+    {
+        free(map->xy);
+        free(map->weights);
+        map->xy = NULL;
+        map->weights = NULL;
+        return -1;
+    }
+    map->width = width;
+    map->height = height;
+    map->x = x;
+    map->y = y;
+
+    start = ids_monotonic_ns();
+    memset(&job, 0, sizeof(job));
+    job.tile = map_tile;
+    undistort_run(undistort, &job, 1);
+    ids_atomic_store64(&undistort->map_ns, ids_monotonic_ns() - start);
+    ids_atomic_add64(&undistort->map_builds, 1);
+    return 0;
+}
+
+/**
+  * Remaps one image, rebuilding the map first when needed
+  * @note Called without the GIL
+  * @return 0 on success, -1 when out of memory
+  */
+static int undistort_remap(Undistort * undistort, const uint8_t * src, size_t src_pitch, uint8_t * dst, size_t dst_pitch,
+        int width, int height, int x, int y, int channels, int sample_bytes, int simd, int parallel)
+{
+    UndistortJob job;
+    int64_t start = ids_monotonic_ns();
+    int64_t elapsed;
+
+    ids_mutex_lock(&undistort->lock);
+    if (undistort_prepare(undistort, width, height, x, y) != 0)
+    {
+        ids_mutex_unlock(&undistort->lock);
+        return -1;
+    }
+    memset(&job, 0, sizeof(job));
+    job.tile = remap_tile;
+    job.src = src;
+    job.src_pitch = src_pitch;
+    job.dst = dst;
+    job.dst_pitch = dst_pitch;
+    job.channels = channels;
+    job.sample_bytes = sample_bytes;
+    job.simd = simd;
+    undistort_run(undistort, &job, parallel);
+    ids_mutex_unlock(&undistort->lock);
+
+    elapsed = ids_monotonic_ns() - start;
+    ids_atomic_add64(&undistort->frames, 1);
+    ids_atomic_store64(&undistort->last_ns, elapsed);
+    ids_atomic_add64(&undistort->total_ns, elapsed);
+    return 0;
+}
+
+static int undistort_default_threads(void)
+{
+    int threads = ids_cpu_count();
+
+    return threads < 1 ? 1 : (threads > UNDISTORT_MAX_THREADS ? UNDISTORT_MAX_THREADS : threads);
+}
+
+/**
+  * Creates an undistorter and starts its workers, threads - 1 of them
+  * @return NULL when out of memory
+  */
+static Undistort * undistort_new(Camera * camera, const UndistortModel * model, int threads)
+{
+    Undistort * undistort = (Undistort *)calloc(1, sizeof(Undistort));
+
+    if (undistort == NULL)
+    {
+        return NULL;
+    }
+    undistort->refcount = 1;
+    undistort->camera = camera;
+    undistort->model = *model;
+    ids_mutex_init(&undistort->lock);
+    ids_mutex_init(&undistort->pool_lock);
+    ids_cond_init(&undistort->wake);
+    ids_cond_init(&undistort->done);
+
+    undistort->running = 1;
+    while (undistort->workers < threads - 1)
+    {
+        if (ids_thread_start(&undistort->threads[undistort->workers], undistort_worker, undistort) != 0)
+        {
+            break;
+        }
+        undistort->workers++;
+    }
+    return undistort;
+}
+
+static void undistort_decref(Undistort * undistort)
+{
+    int i;
+
+    if (ids_atomic_dec(&undistort->refcount) != 0)
+    {
+        return;
+    }
+    ids_mutex_lock(&undistort->pool_lock);
+    undistort->running = 0;
+    ids_cond_broadcast(&undistort->wake);
+    ids_mutex_unlock(&undistort->pool_lock);
+    for (i = 0; i < undistort->workers; i++)
+    {
+        ids_thread_join(undistort->threads[i]);
+    }
+    free(undistort->map.xy);
+    free(undistort->map.weights);
+    ids_cond_destroy(&undistort->done);
+    ids_cond_destroy(&undistort->wake);
+    ids_mutex_destroy(&undistort->pool_lock);
+    ids_mutex_destroy(&undistort->lock);
+    free(undistort);
+}
+
+/**
+  * Takes a reference to the camera's undistortion, which another thread may
+  * replace or turn off at any time
+  * @return The undistortion, to be given back with undistort_decref, or NULL
+  */
+static Undistort * undistort_acquire(Camera * self)
+{
+    Undistort * undistort;
+
+    ids_mutex_lock(&self->settings_lock);
+    undistort = self->undistort;
+    if (undistort != NULL)
+    {
+        ids_atomic_inc(&undistort->refcount);
+    }
+    ids_mutex_unlock(&self->settings_lock);
+    return undistort;
+}
+
+/**
+  * Replaces the camera's undistortion, dropping the camera's reference to
+  * the previous one
+  */
+static void undistort_publish(Camera * self, Undistort * undistort)
+{
+    Undistort * previous;
+
+    ids_mutex_lock(&self->settings_lock);
+    previous = self->undistort;
+    self->undistort = undistort;
+    ids_mutex_unlock(&self->settings_lock);
+
+    if (previous == NULL)
+    {
+        return;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    undistort_decref(previous);
+    Py_END_ALLOW_THREADS
+}
+
+void undistort_close(Camera * self)
+{
+    undistort_publish(self, NULL);
+}
+
+/**
+  * Reads a camera matrix and distortion coefficients as OpenCV's
+  * calibrateCamera returns them
+  * @return 0 on success, -1 with a Python exception set
+  */
+static int undistort_parse_model(PyObject * matrix_obj, PyObject * coeffs_obj, UndistortModel * model)
+{
+    PyArrayObject * matrix;
+    PyArrayObject * coeffs;
+    const double * m;
+    const double * k;
+    npy_intp count;
+    int finite = 1;
+    int i;
+
+    matrix = (PyArrayObject *)PyArray_FROMANY(matrix_obj, NPY_DOUBLE, 2, 2, NPY_ARRAY_CARRAY);
+    if (matrix == NULL)
+    {
+        return -1;
+    }
+    coeffs = (PyArrayObject *)PyArray_FROMANY(coeffs_obj, NPY_DOUBLE, 1, 2, NPY_ARRAY_CARRAY);
+    if (coeffs == NULL)
+    {
+        Py_DECREF(matrix);
+        return -1;
+    }
+    count = PyArray_SIZE(coeffs);
+    if (PyArray_DIM(matrix, 0) != 3 || PyArray_DIM(matrix, 1) != 3 || (count != 4 && count != 5 && count != 8))
+    {
+        Py_DECREF(matrix);
+        Py_DECREF(coeffs);
+        PyErr_SetString(PyExc_ValueError, "camera_matrix must be 3 x 3 and dist_coeffs hold k1, k2, p1, p2[, k3[, k4, k5, k6]]");
+        return -1;
+    }
+
+    m = (const double *)PyArray_DATA(matrix);
+    k = (const double *)PyArray_DATA(coeffs);
+    memset(model, 0, sizeof(UndistortModel));
+    model->fx = m[0];
+    model->skew = m[1];
+    model->cx = m[2];
+    model->fy = m[4];
+    model->cy = m[5];
+    for (i = 0; i < count; i++)
+    {
+        model->k[i] = k[i];
+        finite &= isfinite(k[i]) != 0;
+    }
+    for (i = 0; i < 9; i++)
+    {
+        finite &= isfinite(m[i]) != 0;
+    }
+    Py_DECREF(matrix);
+    Py_DECREF(coeffs);
+
+    if (!finite || model->fx == 0.0 || model->fy == 0.0)
+    {
+        PyErr_SetString(PyExc_ValueError, "The focal lengths must be non-zero and every coefficient finite");
+        return -1;
+    }
+    return 0;
+}
+
+static int undistort_parse_threads(PyObject * threads_obj, int * threads)
+{
+    if (threads_obj == Py_None)
+    {
+        *threads = undistort_default_threads();
+        return 0;
+    }
+    *threads = (int)PyLong_AsLong(threads_obj);
+    if (*threads == -1 && PyErr_Occurred())
+    {
+        return -1;
+    }
+    if (*threads < 1 || *threads > UNDISTORT_MAX_THREADS)
+    {
+        PyErr_Format(PyExc_ValueError, "threads must be between 1 and %d", UNDISTORT_MAX_THREADS);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+  * Samples per pixel and bytes per sample of a color mode as delivered
+  * @return 0 on success, -1 with a Python exception set
+  */
+int undistort_layout(int color, int * channels, int * sample_bytes)
+{
+    switch (color)
+    {
+        case IS_CM_MONO8:
+        case IS_CM_SENSOR_RAW8:
+            *channels = 1;
+            *sample_bytes = 1;
+            return 0;
+        case IS_CM_MONO10:
+        case IS_CM_MONO12:
+        case IS_CM_MONO16:
+            *channels = 1;
+            *sample_bytes = 2;
+            return 0;
+        case IS_CM_RGB8_PACKED:
+        case IS_CM_BGR8_PACKED:
+            *channels = 3;
+            *sample_bytes = 1;
+            return 0;
+        case IS_CM_RGBA8_PACKED:
+        case IS_CM_BGRA8_PACKED:
+            *channels = 4;
+            *sample_bytes = 1;
+            return 0;
+    }
+    PyErr_Format(PyExc_ValueError, "Color mode %d cannot be undistorted, set output_format to undistort it", color);
+    return -1;
+}
+
+/**
+  * Copies an image with the camera's lens distortion removed
+  * @arg dimensions Shape of the image, which the copy keeps, as it keeps type
+  * @arg channels Interleaved samples per pixel
+  * @arg sample_bytes 1 for 8 bit samples, 2 for 16 bit ones
+  * @return New reference, NULL with a Python exception set
+  */
+PyObject * undistort_copy(Camera * camera, const uint8_t * src, size_t pitch, int ndims, npy_intp * dimensions, int type, int channels, int sample_bytes)
+{
+    Undistort * undistort;
+    PyObject * image;
+    uint8_t * dst;
+    size_t dst_pitch;
+    int width = (int)dimensions[1];
+    int height = (int)dimensions[0];
+    int x;
+    int y;
+    int result = 0;
+
+    /* The reference and the AOI it applies to are taken together */
+    ids_mutex_lock(&camera->settings_lock);
+    undistort = camera->undistort;
+    if (undistort != NULL)
+    {
+        ids_atomic_inc(&undistort->refcount);
+        x = undistort->origin_x;
+        y = undistort->origin_y;
+        if (camera->settings.applied & SETTING_AOI)
+        {
+            x = camera->settings.aoi.s32X;
+            y = camera->settings.aoi.s32Y;
+        }
+    }
+    ids_mutex_unlock(&camera->settings_lock);
+
+    image = PyArray_SimpleNew(ndims, dimensions, type);
+    if (image == NULL)
+    {
+        if (undistort != NULL)
+        {
+            undistort_decref(undistort);
+        }
+        return NULL;
+    }
+    dst = (uint8_t *)PyArray_DATA((PyArrayObject *)image);
+    dst_pitch = PyArray_STRIDE((PyArrayObject *)image, 0);
+
+    /* Turned off while the frame was being converted */
+    if (undistort == NULL)
+    {
+        for (y = 0; y < height; y++)
+        {
+            memcpy(dst + y * dst_pitch, src + y * pitch, dst_pitch);
+        }
+        return image;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    result = undistort_remap(undistort, src, pitch, dst, dst_pitch, width, height, x, y, channels, sample_bytes, 1, 1);
+    Py_END_ALLOW_THREADS
+    undistort_decref(undistort);
+    if (result != 0)
+    {
+        Py_DECREF(image);
+        return PyErr_NoMemory();
+    }
+    return image;
+}
+
+PyObject * undistort_stats_as_dict(Camera * self)
+{
+    Undistort * undistort = undistort_acquire(self);
+    UndistortMap map;
+    PyObject * result;
+    int64_t frames;
+
+    if (undistort == NULL)
+    {
+        Py_RETURN_NONE;
+    }
+    ids_mutex_lock(&undistort->lock);
+    map = undistort->map;
+    ids_mutex_unlock(&undistort->lock);
+    frames = ids_atomic_load64(&undistort->frames);
+
+    result = Py_BuildValue("{s:i,s:L,s:L,s:d,s:d,s:d,s:i,s:i,s:i,s:i}",
+            "threads", undistort->workers + 1,
+            "frames", frames,
+            "map_builds", ids_atomic_load64(&undistort->map_builds),
+            "map_ms", ids_atomic_load64(&undistort->map_ns) / 1e6,
+            "last_ms", ids_atomic_load64(&undistort->last_ns) / 1e6,
+            "mean_ms", frames > 0 ? ids_atomic_load64(&undistort->total_ns) / 1e6 / frames : 0.0,
+            "x", map.x,
+            "y", map.y,
+            "width", map.width,
+            "height", map.height);
+    undistort_decref(undistort);
+    return result;
+}
+
+/**
+  * Function to remove lens distortion from every frame get_image returns
+  * This means the definition of the method is:
+  *     def set_undistort(self, camera_matrix, dist_coeffs, threads=None)
+  * @arg camera_matrix 3 x 3 intrinsics for the full sensor, None turns
+  *      undistortion off
+  * @arg dist_coeffs k1, k2, p1, p2[, k3[, k4, k5, k6]]
+  * @note The remap table is built for the AOI of the first frame and again
+  *       whenever the AOI moves or changes size
+  */
+PyObject * camera_set_undistort(Camera * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"camera_matrix", "dist_coeffs", "threads", NULL};
+    PyObject * matrix_obj;
+    PyObject * coeffs_obj = Py_None;
+    PyObject * threads_obj = Py_None;
+    UndistortModel model;
+    Undistort * undistort;
+    IS_RECT rectAOI;
+    int returnCode;
+    int threads;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|OO", kwlist, &matrix_obj, &coeffs_obj, &threads_obj))
+    {
+        return NULL;
+    }
+    if (matrix_obj == Py_None)
+    {
+        undistort_close(self);
+        Py_RETURN_NONE;
+    }
+    if (coeffs_obj == Py_None)
+    {
+        PyErr_SetString(PyExc_TypeError, "dist_coeffs is required with a camera_matrix");
+        return NULL;
+    }
+    if (undistort_parse_model(matrix_obj, coeffs_obj, &model) != 0 || undistort_parse_threads(threads_obj, &threads) != 0)
+    {
+        return NULL;
+    }
+
+    returnCode = is_AOI(camera_handle(self), IS_AOI_IMAGE_GET_AOI, (void *)&rectAOI, sizeof(rectAOI));
+    if (returnCode != IS_SUCCESS)
+    {
+        raise_error(self, returnCode);
+        return NULL;
+    }
+
+    undistort = undistort_new(self, &model, threads);
+    if (undistort == NULL)
+    {
+        return PyErr_NoMemory();
+    }
+    undistort->origin_x = rectAOI.s32X;
+    undistort->origin_y = rectAOI.s32Y;
+    undistort_publish(self, undistort);
+    Py_RETURN_NONE;
+}
+
+/**
+  * Removes lens distortion from one image
+  * This means the definition of the function is:
+  *     def undistort(image, camera_matrix, dist_coeffs, x=0, y=0, threads=None)
+  * @arg image uint8 or uint16 array, 2D or with up to 4 channels
+  * @arg x, y Place of the image on the sensor the camera matrix refers to
+  * @return A new array of the same shape and type
+  */
+PyObject * ids_undistort(PyObject * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"image", "camera_matrix", "dist_coeffs", "x", "y", "threads", NULL};
+    PyObject * image_obj;
+    PyObject * matrix_obj;
+    PyObject * coeffs_obj;
+    PyObject * threads_obj = Py_None;
+    PyArrayObject * image;
+    PyObject * output;
+    UndistortModel model;
+    Undistort * undistort;
+    int x = 0;
+    int y = 0;
+    int threads;
+    int channels;
+    int result;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OOO|iiO", kwlist, &image_obj, &matrix_obj, &coeffs_obj, &x, &y, &threads_obj))
+    {
+        return NULL;
+    }
+    if (undistort_parse_model(matrix_obj, coeffs_obj, &model) != 0 || undistort_parse_threads(threads_obj, &threads) != 0)
+    {
+        return NULL;
+    }
+
+    image = (PyArrayObject *)PyArray_FROMANY(image_obj, NPY_NOTYPE, 2, 3, NPY_ARRAY_CARRAY_RO);
+    if (image == NULL)
+    {
+        return NULL;
+    }
+    channels = PyArray_NDIM(image) == 3 ? (int)PyArray_DIM(image, 2) : 1;
+    if (PyArray_TYPE(image) != NPY_UINT8 && PyArray_TYPE(image) != NPY_UINT16)
+    {
+        Py_DECREF(image);
+        PyErr_SetString(PyExc_TypeError, "Undistortion expects a uint8 or uint16 image");
+        return NULL;
+    }
+    if (channels < 1 || channels > 4 || PyArray_DIM(image, 0) > 0xFFFF || PyArray_DIM(image, 1) > 0xFFFF)
+    {
+        Py_DECREF(image);
+        PyErr_SetString(PyExc_ValueError, "Undistortion expects 1 to 4 channels and at most 65535 x 65535 pixels");
+        return NULL;
+    }
+    output = PyArray_SimpleNew(PyArray_NDIM(image), PyArray_DIMS(image), PyArray_TYPE(image));
+    if (output == NULL)
+    {
+        Py_DECREF(image);
+        return NULL;
+    }
+
+    undistort = undistort_new(NULL, &model, threads);
+    if (undistort == NULL)
+    {
+        Py_DECREF(image);
+        Py_DECREF(output);
+        return PyErr_NoMemory();
+    }
+    Py_BEGIN_ALLOW_THREADS
+    result = undistort_remap(undistort, (const uint8_t *)PyArray_DATA(image), PyArray_STRIDE(image, 0),
+            (uint8_t *)PyArray_DATA((PyArrayObject *)output), PyArray_STRIDE((PyArrayObject *)output, 0),
+            (int)PyArray_DIM(image, 1), (int)PyArray_DIM(image, 0), x, y, channels, (int)PyArray_ITEMSIZE(image), 1, 1);
+    undistort_decref(undistort);
+    Py_END_ALLOW_THREADS
+    Py_DECREF(image);
+    if (result != 0)
+    {
+        Py_DECREF(output);
+        return PyErr_NoMemory();
+    }
+    return output;
+}
+
+/*
+ * One pixel layout measured by undistort_benchmark
+ */
+typedef struct
+{
+    const char *       name;
+    int                channels;
+    int                sample_bytes;
+} BenchmarkSource;
+
+static const BenchmarkSource benchmark_sources[] = {
+    {"mono8", 1, 1},
+    {"mono16", 1, 2},
+    {"rgb8", 3, 1},
+};
+
+/*
+ * Difference between the fixed-point remap and the reference
+ */
+typedef struct
+{
+    double             max_error;
+    double             rms_error;
+    double             map_error;
+} BenchmarkAccuracy;
+
+/**
+  * Compares a remapped image against bilinear interpolation at the exact
+  * source positions in double precision, and the map against those positions
+  */
+static void benchmark_accuracy(const Undistort * undistort, const uint8_t * src, const uint8_t * dst, int channels, int sample_bytes, BenchmarkAccuracy * accuracy)
+{
+    const UndistortMap * map = &undistort->map;
+    double squares = 0.0;
+    double sx;
+    double sy;
+    double ax;
+    double ay;
+    double value;
+    double error;
+    double p[4];
+    size_t i;
+    size_t j;
+    size_t n;
+    int inside;
+    int x = 0;
+    int y = 0;
+    int u;
+    int v;
+    int c;
+    int k;
+
+    memset(accuracy, 0, sizeof(BenchmarkAccuracy));
+    for (v = 0; v < map->height; v++)
+    {
+        for (u = 0; u < map->width; u++)
+        {
+            i = (size_t)v * map->width + u;
+            undistort_point(&undistort->model, u + map->x, v + map->y, &sx, &sy);
+            sx -= map->x;
+            sy -= map->y;
+            inside = undistort_cell(sx, sy, map->width, map->height, &x, &y);
+            ax = 0.0;
+            ay = 0.0;
+            if (inside)
+            {
+                ax = sx - x;
+                ay = sy - y;
+                error = hypot((map->xy[i] & 0xFFFF) + (map->weights[i] & 0xFFFF) / (double)UNDISTORT_ONE - sx,
+                        (map->xy[i] >> 16) + (map->weights[i] >> 16) / (double)UNDISTORT_ONE - sy);
+                accuracy->map_error = error > accuracy->map_error ? error : accuracy->map_error;
+            }
+            for (c = 0; c < channels; c++)
+            {
+                value = 0.0;
+                if (inside)
+                {
+                    for (k = 0; k < 4; k++)
+                    {
+                        n = (size_t)(y + k / 2) * map->width + x + k % 2;
+                        p[k] = sample_bytes == 1 ? src[n * channels + c] : ((const uint16_t *)src)[n * channels + c];
+                    }
+                    value = (p[0] * (1.0 - ax) + p[1] * ax) * (1.0 - ay) + (p[2] * (1.0 - ax) + p[3] * ax) * ay;
+                }
+                j = i * channels + c;
+                error = fabs((sample_bytes == 1 ? dst[j] : ((const uint16_t *)dst)[j]) - value);
+                accuracy->max_error = error > accuracy->max_error ? error : accuracy->max_error;
+                squares += error * error;
+            }
+        }
+    }
+    accuracy->rms_error = sqrt(squares / ((double)map->width * map->height * channels));
+}
+
+/**
+  * Times the remap of a whole image
+  * @return The best of repeat runs in nanoseconds
+  */
+static int64_t benchmark_time(Undistort * undistort, const uint8_t * src, uint8_t * dst, int width, int height, int channels, int sample_bytes, int simd, int parallel, int repeat)
+{
+    size_t pitch = (size_t)width * channels * sample_bytes;
+    int64_t best = 0;
+    int64_t start;
+    int64_t elapsed;
+    int i;
+
+    for (i = 0; i < repeat; i++)
+    {
+        start = ids_monotonic_ns();
+        undistort_remap(undistort, src, pitch, dst, pitch, width, height, 0, 0, channels, sample_bytes, simd, parallel);
+        elapsed = ids_monotonic_ns() - start;
+        if (i == 0 || elapsed < best)
+        {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+/**
+  * Benchmarks undistortion of mono8, mono16 and rgb8 images through a
+  * strongly distorting lens, and checks it against the reference
+  * This means the definition of the function is:
+  *     def undistort_benchmark(width=1920, height=1080, repeat=10, threads=None)
+  * @return A list with one dictionary per pixel layout
+  */
+PyObject * ids_undistort_benchmark(PyObject * self, PyObject * args, PyObject * kwds)
+{
+    static char *kwlist[] = {"width", "height", "repeat", "threads", NULL};
+    int width = DEFAULT_BENCHMARK_WIDTH;
+    int height = DEFAULT_BENCHMARK_HEIGHT;
+    int repeat = DEFAULT_BENCHMARK_REPEAT;
+    PyObject * threads_obj = Py_None;
+    PyObject * list = NULL;
+    PyObject * entry;
+    const BenchmarkSource * source;
+    BenchmarkAccuracy accuracy;
+    UndistortModel model;
+    Undistort * undistort = NULL;
+    uint8_t * src = NULL;
+    uint8_t * dst = NULL;
+    size_t samples;
+    size_t n;
+    double value;
+    int64_t best;
+    int64_t single;
+    int64_t scalar;
+    int64_t map_ns;
+    int threads;
+    int x;
+    int y;
+    int c;
+    int s;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|iiiO", kwlist, &width, &height, &repeat, &threads_obj))
+    {
+        return NULL;
+    }
+    if (undistort_parse_threads(threads_obj, &threads) != 0)
+    {
+        return NULL;
+    }
+    if (width < 2 || height < 2 || width > 0xFFFF || height > 0xFFFF || repeat < 1)
+    {
+        PyErr_SetString(PyExc_ValueError, "width and height must be between 2 and 65535 and repeat positive");
+        return NULL;
+    }
+
+    /* A wide-angle lens with strong barrel distortion */
+    memset(&model, 0, sizeof(model));
+    model.fx = 0.9 * width;
+    model.fy = 0.9 * width;
+    model.cx = (width - 1) / 2.0;
+    model.cy = (height - 1) / 2.0;
+    model.k[0] = -0.28;
+    model.k[1] = 0.09;
+    model.k[2] = 0.0008;
+    model.k[3] = -0.0005;
+    model.k[4] = -0.012;
+
+    samples = (size_t)width * height * 3;
+    src = (uint8_t *)malloc(samples * 2);
+    dst = (uint8_t *)malloc(samples * 2);
+    undistort = undistort_new(NULL, &model, threads);
+    list = PyList_New(0);
+    if (src == NULL || dst == NULL || undistort == NULL || list == NULL)
+    {
+        PyErr_NoMemory();
+        goto error;
+    }
+
+    for (s = 0; s < (int)(sizeof(benchmark_sources) / sizeof(benchmark_sources[0])); s++)
+    {
+        source = &benchmark_sources[s];
+        /* Smooth detail at several scales, so interpolation errors show */
+        for (y = 0; y < height; y++)
+        {
+            for (x = 0; x < width; x++)
+            {
+                for (c = 0; c < source->channels; c++)
+                {
+                    value = 0.5 + 0.3 * sin(x * 0.05 + c) * cos(y * 0.037) + 0.15 * sin((x + 2 * y) * 0.21 + c);
+                    n = ((size_t)y * width + x) * source->channels + c;
+                    if (source->sample_bytes == 1)
+                    {
+                        src[n] = (uint8_t)(value * 255.0 + 0.5);
+                    }
+                    else
+                    {
+                        ((uint16_t *)src)[n] = (uint16_t)(value * 65535.0 + 0.5);
+                    }
+                }
+            }
+        }
+
+        Py_BEGIN_ALLOW_THREADS
+        /* The first run builds the map, which every layout shares */
+        undistort_remap(undistort, src, (size_t)width * source->channels * source->sample_bytes, dst, (size_t)width * source->channels * source->sample_bytes,
+                width, height, 0, 0, source->channels, source->sample_bytes, 1, 1);
+        map_ns = undistort->map_ns;
+        best = benchmark_time(undistort, src, dst, width, height, source->channels, source->sample_bytes, 1, 1, repeat);
+        single = benchmark_time(undistort, src, dst, width, height, source->channels, source->sample_bytes, 1, 0, repeat);
+        scalar = benchmark_time(undistort, src, dst, width, height, source->channels, source->sample_bytes, 0, 0, repeat);
+        benchmark_accuracy(undistort, src, dst, source->channels, source->sample_bytes, &accuracy);
+        Py_END_ALLOW_THREADS
+
+        entry = Py_BuildValue("{s:s,s:i,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d}",
+                "source", source->name,
+                "threads", undistort->workers + 1,
+                "ms", best / 1e6,
+                "single_thread_ms", single / 1e6,
+                "scalar_ms", scalar / 1e6,
+                "speedup", best > 0 ? (double)scalar / best : 0.0,
+                "fps", best > 0 ? 1e9 / best : 0.0,
+                "megapixels_per_s", best > 0 ? (double)width * height * 1e3 / best : 0.0,
+                "map_ms", map_ns / 1e6,
+                "max_error", accuracy.max_error,
+                "rms_error", accuracy.rms_error,
+                "map_error_px", accuracy.map_error);
+        if (entry == NULL || PyList_Append(list, entry) != 0)
+        {
+            Py_XDECREF(entry);
+            goto error;
+        }
+        Py_DECREF(entry);
+    }
+
+    undistort_decref(undistort);
+    free(src);
+    free(dst);
+    return list;
+
+error:
+    if (undistort != NULL)
+    {
+        undistort_decref(undistort);
+    }
+    free(src);
+    free(dst);
+    Py_XDECREF(list);
+    return NULL;
+}
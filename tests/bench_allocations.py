@@ -0,0 +1,81 @@
+"""
+Counts the allocations get_image() makes per frame in steady state, against
+the simulated camera. tracemalloc counts the blocks the Python allocators
+hand out; preloading fake_sdk/malloc_count.c adds the calls to malloc,
+calloc and realloc of the whole process, NumPy and the module included.
+
+    LD_PRELOAD=./malloc_count.so python tests/bench_allocations.py
+"""
+import ctypes
+import gc
+import tracemalloc
+
+import ids
+
+WARMUP_FRAMES = 200
+
+
+def _malloc_counter():
+    try:
+        counter = ctypes.CDLL(None).malloc_count
+    except AttributeError:
+        return None
+    counter.restype = ctypes.c_long
+    return counter
+
+
+malloc_count = _malloc_counter()
+
+
+def _read(camera, frames, unpack):
+    for _ in range(frames):
+        if unpack:
+            image, info = camera.get_image()
+            del image, info
+        else:
+            frame = camera.get_image()
+            image = frame.image
+            del image, frame
+
+
+def allocations_per_frame(camera, frames=2000, unpack=False):
+    """
+    Reads frames and returns the Python blocks left behind and the malloc
+    calls, per frame. Keeping only frame.image lets the frame and its array be
+    reused, unpacking into (image, info) builds the info dictionary every
+    time. The malloc count is None without the preloaded counter.
+    """
+    _read(camera, WARMUP_FRAMES, unpack)
+    gc.collect()
+
+    # Counted apart: tracemalloc itself calls malloc for every block it traces
+    start = malloc_count() if malloc_count is not None else 0
+    _read(camera, frames, unpack)
+    calls = malloc_count() - start if malloc_count is not None else None
+
+    tracemalloc.start()
+    before = tracemalloc.take_snapshot()
+    _read(camera, frames, unpack)
+    after = tracemalloc.take_snapshot()
+    tracemalloc.stop()
+    blocks = sum(stat.count_diff for stat in after.compare_to(before, 'filename'))
+    return {
+        'frames': frames,
+        'python_blocks_left_per_frame': blocks / frames,
+        'mallocs_per_frame': calls / frames if calls is not None else None,
+    }
+
+
+def main():
+    camera = ids.Camera()
+    camera.frame_rate = 2000.0
+    camera.start_capture(buffers=16)
+    for unpack in (False, True):
+        result = allocations_per_frame(camera, unpack=unpack)
+        print('%-16s %s' % ('image, info' if unpack else 'frame.image', result))
+    print(camera.stats()['frame_pool'])
+    camera.stop_capture()
+
+
+if __name__ == '__main__':
+    main()
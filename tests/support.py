@@ -0,0 +1,35 @@
+"""
+Access to the simulated SDK that IDS_FAKE_SDK=1 builds link into the module
+"""
+import ctypes
+import unittest
+
+import ids
+
+
+def _load():
+    lib = ctypes.CDLL(ids.__file__)
+    if not hasattr(lib, 'fake_set_missing'):
+        return None
+    return lib
+
+
+sdk = _load()
+
+requires_fake_sdk = unittest.skipIf(sdk is None, "the module was built against the real SDK")
+
+
+def counter(name):
+    """Current value of one of the int counters of the simulated SDK"""
+    return ctypes.c_int.in_dll(sdk, name).value
+
+
+def reset():
+    """Plugs the simulated camera back in and clears every injected fault"""
+    sdk.fake_set_missing(0)
+    sdk.fake_set_wait_error(0)
+    sdk.fake_set_trigger(0)
+    sdk.fake_set_still(0)
+    sdk.fake_set_clock(ctypes.c_double(0.0), ctypes.c_double(0.0))
+    ctypes.c_int.in_dll(sdk, 'fake_clamp').value = 0
+    ctypes.c_int.in_dll(sdk, 'fake_no_arrival_event').value = 0
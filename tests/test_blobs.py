@@ -0,0 +1,73 @@
+import unittest
+
+import numpy
+
+import ids
+
+from support import requires_fake_sdk, reset
+
+
+def synthetic():
+    """A flat 6 x 4 block, a 3 x 3 block with a bright centre, and a two pixel blob"""
+    image = numpy.zeros((60, 80), numpy.uint8)
+    image[10:14, 20:26] = 200
+    image[40:43, 5:8] = 150
+    image[41, 6] = 250
+    image[50, 60] = 110
+    image[50, 61] = 140
+    return image
+
+
+class BlobsTest(unittest.TestCase):
+    def test_centroids(self):
+        blobs = ids.find_blobs(synthetic(), 100)
+        self.assertEqual(len(blobs), 3)
+        self.assertEqual(blobs[0].tolist(), (22.5, 11.5, 2400.0, 24, 20, 10, 25, 13))
+        self.assertEqual(blobs[1].tolist(), (6.0, 41.0, 550.0, 9, 5, 40, 7, 42))
+        self.assertAlmostEqual(blobs[2]['x'], (10 * 60 + 40 * 61) / 50)
+        self.assertEqual(blobs[2]['y'], 50.0)
+        self.assertEqual(blobs[2]['mass'], 50.0)
+
+    def test_dark_and_area(self):
+        image = synthetic()
+        blobs = ids.find_blobs(255 - image, 100, dark=True)
+        self.assertEqual([(b['x'], b['y'], b['area']) for b in blobs], [(22.5, 11.5, 24), (6.0, 41.0, 1)])
+        self.assertEqual(len(ids.find_blobs(image, 100, min_area=10)), 1)
+        self.assertEqual(len(ids.find_blobs(image, 100, max_area=2)), 1)
+
+    def test_threads_agree(self):
+        image = (numpy.random.default_rng(1).random((600, 300)) ** 3 * 255).astype(numpy.uint8)
+        single = ids.find_blobs(image, 100, threads=1)
+        self.assertGreater(len(single), 100)
+        for threads in (2, 3, 8):
+            self.assertTrue(numpy.array_equal(single, ids.find_blobs(image, 100, threads=threads)))
+        view = image[:, 3:250]
+        self.assertTrue(numpy.array_equal(ids.find_blobs(view, 100, threads=2), ids.find_blobs(view.copy(), 100)))
+
+    def test_errors(self):
+        with self.assertRaises(TypeError):
+            ids.find_blobs(numpy.zeros((4, 4), numpy.float32), 1)
+        with self.assertRaises(ValueError):
+            ids.find_blobs(synthetic(), 1, threads=0)
+
+
+@requires_fake_sdk
+class FrameBlobsTest(unittest.TestCase):
+    def setUp(self):
+        reset()
+        self.camera = ids.Camera()
+
+    def tearDown(self):
+        reset()
+        del self.camera
+
+    def test_sequence_buffer(self):
+        frame = self.camera.get_image()
+        blobs = ids.find_blobs(frame.image, 250)
+        self.assertGreater(len(blobs), 0)
+        self.assertTrue(numpy.array_equal(blobs, ids.find_blobs(frame.image.copy(), 250)))
+        del frame
+
+
+if __name__ == '__main__':
+    unittest.main()
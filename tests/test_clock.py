@@ -0,0 +1,60 @@
+import ctypes
+import time
+import unittest
+
+import ids
+
+from support import requires_fake_sdk, reset, sdk
+
+
+@requires_fake_sdk
+class ClockTest(unittest.TestCase):
+    def setUp(self):
+        reset()
+        # The simulated device counter runs 50 ppm fast, in 100 ns ticks, from an offset
+        sdk.fake_set_clock(ctypes.c_double(50.0), ctypes.c_double(3.7e12))
+        self.camera = ids.Camera()
+        self.camera.frame_rate = 500.0
+        self.camera.start_capture(buffers=16)
+
+    def tearDown(self):
+        self.camera.stop_capture()
+        reset()
+        del self.camera
+
+    def frames(self, count):
+        for i in range(count):
+            image, info = self.camera.get_image()
+            del image
+            yield info
+
+    def test_device_time_follows_the_host_clock(self):
+        time.sleep(1.5)
+        errors = []
+        for info in self.frames(200):
+            if info['timestamp_ns'] is None:
+                continue
+            true = (info['timestamp_device'] * 100 - 3.7e12) / (1 + 50e-6)
+            errors.append(abs(info['timestamp_ns'] - true))
+        self.assertGreater(len(errors), 100)
+        errors.sort()
+        # The fit tracks the fastest deliveries, so most frames land within a millisecond
+        self.assertLess(errors[len(errors) // 2], 1e6)
+        clock = self.camera.stats()['clock']
+        self.assertAlmostEqual(clock['drift_ppm'], 50.0, delta=20.0)
+        self.assertEqual(self.camera.device_time_to_host(info['timestamp_device']), info['timestamp_ns'])
+        realtime = self.camera.device_time_to_host(info['timestamp_device'], realtime=True)
+        self.assertLess(abs(realtime - time.time_ns()), 1e9)
+
+    def test_counter_jump_restarts_the_fit(self):
+        time.sleep(0.5)
+        resets = self.camera.stats()['clock']['resets']
+        sdk.fake_set_clock(ctypes.c_double(50.0), ctypes.c_double(-1e12))
+        time.sleep(0.3)
+        for info in self.frames(1):
+            pass
+        self.assertGreater(self.camera.stats()['clock']['resets'], resets)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,135 @@
+import unittest
+
+import numpy as np
+
+import ids
+
+from support import requires_fake_sdk, reset, sdk
+
+MONO8 = 6
+MONO12 = 26
+BGR8 = 1
+RGB8 = 129
+UYVY = 12
+BAYER_RG8 = 11
+
+
+def sensor_bytes(height, row_bytes, frame_number):
+    """Bytes the simulated sensor writes, (x + y + frame number) mod 256"""
+    return ((np.arange(row_bytes)[None, :] + np.arange(height)[:, None] + frame_number) & 255).astype(np.uint8)
+
+
+def expected(mode, raw, output):
+    """Reference conversion of the raw sensor bytes"""
+    height = raw.shape[0]
+    if mode == MONO8:
+        if output == 'rgb8':
+            return np.repeat(raw[:, :, None], 3, 2)
+        if output == 'gray8':
+            return raw
+        return (raw.astype(np.int64) * 257).astype(np.uint16)
+    if mode == MONO12:
+        value = raw.view('<u2').astype(np.int64)
+        if output == 'gray16':
+            return ((value << 4) & 0xffff).astype(np.uint16)
+        gray = np.clip(value >> 4, 0, 255).astype(np.uint8)
+        return np.repeat(gray[:, :, None], 3, 2) if output == 'rgb8' else gray
+    if mode in (BGR8, RGB8):
+        p = raw.reshape(height, -1, 3).astype(np.int64)
+        if mode == RGB8:
+            r, g, b = p[..., 0], p[..., 1], p[..., 2]
+        else:
+            r, g, b = p[..., 2], p[..., 1], p[..., 0]
+        if output == 'rgb8':
+            return np.stack([r, g, b], 2).astype(np.uint8)
+        if output == 'gray8':
+            return ((38 * r + 75 * g + 15 * b + 64) >> 7).astype(np.uint8)
+        s = 2 * (9798 * r + 19235 * g + 3735 * b)
+        return ((s + (s >> 8) + 128) >> 8).astype(np.uint16)
+    # UYVY, BT.601 limited range
+    p = raw.reshape(height, -1, 4).astype(np.int64)
+    u, v = np.repeat(p[..., 0], 2, 1), np.repeat(p[..., 2], 2, 1)
+    y = np.stack([p[..., 1], p[..., 3]], 2).reshape(height, -1)
+    if output == 'gray8':
+        return y.astype(np.uint8)
+    if output == 'gray16':
+        return (y * 257).astype(np.uint16)
+    scaled = lambda a, b: (a * b) >> 16
+    luma = scaled((y - 16) * 4, 19071)
+    r = luma + scaled((v - 128) * 4, 26149)
+    g = luma - scaled((u - 128) * 4, 6406) - scaled((v - 128) * 4, 13320)
+    b = luma + scaled((u - 128) * 8, 16532)
+    return np.clip(np.stack([r, g, b], 2), 0, 255).astype(np.uint8)
+
+
+@requires_fake_sdk
+class ConvertTest(unittest.TestCase):
+    def setUp(self):
+        reset()
+        self.camera = ids.Camera()
+        self.camera.frame_rate = 500.0
+
+    def tearDown(self):
+        self.set_color_mode(MONO8)
+        self.camera.stop_capture()
+        del self.camera
+
+    def set_color_mode(self, mode):
+        # The simulated SDK takes the mode directly, apply() then reallocates the buffers for it
+        base = self.camera.snapshot()
+        sdk.is_SetColorMode(sdk.fake_handle(), mode)
+        preset = self.camera.snapshot()
+        sdk.is_SetColorMode(sdk.fake_handle(), MONO8)
+        self.camera.apply(base)
+        self.camera.apply(preset)
+
+    def check(self, mode, bits_per_pixel):
+        self.set_color_mode(mode)
+        for output in ('rgb8', 'gray8', 'gray16'):
+            self.camera.output_format = output
+            image, info = self.camera.get_image()
+            raw = sensor_bytes(image.shape[0], image.shape[1] * bits_per_pixel // 8, info['frame_number'])
+            want = expected(mode, raw, output)
+            self.assertEqual(image.shape, want.shape, (mode, output))
+            self.assertEqual(image.dtype, want.dtype, (mode, output))
+            # The first pixels carry the frame counter
+            got = image.reshape(image.shape[0], -1)[:, 8:]
+            self.assertTrue(np.array_equal(got, want.reshape(want.shape[0], -1)[:, 8:]), (mode, output))
+
+    def test_mono8(self):
+        self.assertEqual(self.camera.output_format, 'raw')
+        self.check(MONO8, 8)
+
+    def test_mono12(self):
+        self.check(MONO12, 16)
+
+    def test_rgb8(self):
+        self.check(RGB8, 24)
+
+    def test_bgr8(self):
+        self.check(BGR8, 24)
+
+    def test_uyvy(self):
+        self.check(UYVY, 16)
+
+    def test_releases_the_buffer(self):
+        self.camera.output_format = 'gray8'
+        frames = [self.camera.get_image() for i in range(20)]
+        self.assertIsNone(frames[-1].image.base)
+        self.assertEqual(self.camera.stats()['locked_buffers'], 0)
+
+    def test_errors(self):
+        with self.assertRaises(ValueError):
+            self.camera.output_format = 'rgb'
+        with self.assertRaises(TypeError):
+            self.camera.output_format = 5
+        self.set_color_mode(BAYER_RG8)
+        self.camera.output_format = 'gray8'
+        with self.assertRaises(ValueError):
+            self.camera.get_image()
+        self.camera.output_format = 'raw'
+        self.assertIsNotNone(self.camera.get_image().image.base)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,76 @@
+import unittest
+
+import numpy
+
+import ids
+
+
+def step(dark_right=True):
+    """40 x 50 image, bright on one side of the line between columns 24 and 25"""
+    image = numpy.full((40, 50), 200, numpy.uint8)
+    if dark_right:
+        image[:, 25:] = 40
+    else:
+        image[:, :25] = 40
+    return image
+
+
+def drop(cx, cy, radius, size=(120, 160), supersample=8):
+    """Anti-aliased dark disc on a bright background"""
+    yy, xx = numpy.mgrid[0:size[0], 0:size[1]].astype(numpy.float64)
+    cover = numpy.zeros(size)
+    for sy in range(supersample):
+        for sx in range(supersample):
+            dx = xx + (sx + 0.5) / supersample - 0.5 - cx
+            dy = yy + (sy + 0.5) / supersample - 0.5 - cy
+            cover += dx * dx + dy * dy < radius * radius
+    return numpy.round(220 - 190 * cover / supersample ** 2).astype(numpy.uint8)
+
+
+class EdgesTest(unittest.TestCase):
+    def test_step(self):
+        edges = ids.find_edges(step(), 20)
+        self.assertEqual(edges.dtype, numpy.float32)
+        self.assertEqual(edges.shape, (38, 2))
+        self.assertTrue(numpy.all(edges[:, 0] == 24.5))
+        self.assertEqual(sorted(edges[:, 1].tolist()), list(range(1, 39)))
+
+        image = step()
+        image[:, 25] = 120
+        self.assertTrue(numpy.all(ids.find_edges(image, 20)[:, 0] == 25.0))
+
+    def test_step_direction(self):
+        contours = ids.find_contours(step(), 20, min_points=5)
+        self.assertEqual(len(contours), 1)
+        self.assertEqual(contours[0][0].tolist(), [24.5, 1.0])
+        self.assertEqual(contours[0][-1].tolist(), [24.5, 38.0])
+        mirrored = ids.find_contours(step(dark_right=False), 20, min_points=5)[0]
+        self.assertEqual(mirrored[0].tolist(), [24.5, 38.0])
+
+    def test_drop(self):
+        image = drop(80.3, 60.7, 40.4)
+        contours = ids.find_contours(image, 20)
+        self.assertEqual(len(contours), 1)
+        contour = contours[0]
+        self.assertTrue(numpy.array_equal(contour[0], contour[-1]))
+        distance = numpy.hypot(contour[:, 0] - 80.3, contour[:, 1] - 60.7) - 40.4
+        self.assertLess(numpy.sqrt((distance ** 2).mean()), 0.05)
+        self.assertLess(abs(distance).max(), 0.1)
+        x, y = contour[:, 0], contour[:, 1]
+        # Counterclockwise on screen is a negative area with y pointing down
+        self.assertLess(numpy.sum(x[:-1] * y[1:] - x[1:] * y[:-1]), 0)
+        self.assertEqual(len(ids.find_edges(image, 20)), len(contour) - 1)
+
+        wide = ids.find_contours(image.astype(numpy.uint16) * 256, 20 * 256)[0]
+        self.assertLess(abs(wide - contour).max(), 1e-3)
+        self.assertEqual(ids.find_contours(image, 20, roi=(500, 500, 10, 10)), [])
+
+    def test_errors(self):
+        with self.assertRaises(ValueError):
+            ids.find_contours(step(), 20, fit='x')
+        with self.assertRaises(TypeError):
+            ids.find_edges(step().astype(numpy.float32), 20)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,82 @@
+import gc
+import pickle
+import threading
+import unittest
+
+import numpy as np
+
+import ids
+
+from support import requires_fake_sdk, reset
+
+
+@requires_fake_sdk
+class ExportTest(unittest.TestCase):
+    def setUp(self):
+        reset()
+        self.camera = ids.Camera()
+        self.camera.frame_rate = 500.0
+        self.camera.start_capture(buffers=8)
+
+    def tearDown(self):
+        self.camera.stop_capture()
+        self.assertEqual(self.camera.stats()['locked_buffers'], 0)
+        del self.camera
+
+    def test_tensor_keeps_the_buffer_locked(self):
+        frame = self.camera.get_image()
+        self.assertEqual(frame.__dlpack_device__(), (1, 0))
+        tensor = np.from_dlpack(frame)
+        self.assertEqual(tensor.ctypes.data, frame.image.ctypes.data)
+        released = self.camera.stats()['frames_released']
+        del frame
+        gc.collect()
+        self.assertEqual(self.camera.stats()['frames_released'], released)
+        del tensor
+        self.assertEqual(self.camera.stats()['frames_released'], released + 1)
+
+    def test_capsules_and_copies(self):
+        frame = self.camera.get_image()
+        # Capsules nobody consumes free their tensor when collected
+        capsule = frame.__dlpack__()
+        del capsule
+        capsule = frame.__dlpack__(max_version=(1, 0))
+        del capsule
+        copy = np.from_dlpack(frame, copy=True)
+        self.assertFalse(np.shares_memory(copy, frame.image))
+        with self.assertRaises((ValueError, BufferError)):
+            frame.__dlpack__(stream=1)
+        with self.assertRaises((ValueError, BufferError)):
+            frame.__dlpack__(dl_device=(2, 0))
+
+    def test_deleter_on_another_thread(self):
+        tensors = [np.from_dlpack(self.camera.get_image())]
+        worker = threading.Thread(target=tensors.clear)
+        worker.start()
+        worker.join()
+
+    def test_pickle(self):
+        frame = self.camera.get_image()
+        for protocol in (2, 4, 5):
+            copy = pickle.loads(pickle.dumps(frame, protocol=protocol))
+            image, info = copy
+            self.assertEqual(copy.sequence, frame.sequence)
+            self.assertTrue(np.array_equal(image, frame.image))
+            self.assertEqual(info['frame_number'], frame.info['frame_number'])
+        buffers = []
+        data = pickle.dumps(frame, protocol=5, buffer_callback=buffers.append)
+        self.assertEqual(len(buffers), 1)
+        self.assertLess(len(data), frame.image.nbytes)
+        copy = pickle.loads(data, buffers=buffers)
+        self.assertTrue(np.shares_memory(copy.image, frame.image))
+        self.assertEqual(np.from_dlpack(copy).shape, frame.image.shape)
+
+    def test_detached_frame(self):
+        frame = ids.Frame(np.zeros((2, 3), np.uint8), {'a': 1}, 7)
+        self.assertEqual(frame.sequence, 7)
+        self.assertEqual(frame.info, {'a': 1})
+        self.assertEqual(frame[0].shape, (2, 3))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,38 @@
+import unittest
+
+import ids
+
+from bench_allocations import allocations_per_frame, malloc_count
+from support import requires_fake_sdk, reset
+
+
+@requires_fake_sdk
+class FramePoolTest(unittest.TestCase):
+    def setUp(self):
+        reset()
+        self.camera = ids.Camera()
+        self.camera.frame_rate = 2000.0
+        self.camera.start_capture(buffers=16)
+
+    def tearDown(self):
+        self.camera.stop_capture()
+        del self.camera
+
+    def test_frames_and_arrays_are_reused(self):
+        result = allocations_per_frame(self.camera, frames=1000)
+        pool = self.camera.stats()['frame_pool']
+        self.assertLess(result['python_blocks_left_per_frame'], 0.01)
+        self.assertGreater(pool['frames_reused'], 1000)
+        if pool['array_pool']:
+            self.assertGreater(pool['arrays_reused'], 1000)
+
+    @unittest.skipIf(malloc_count is None, "needs fake_sdk/malloc_count.c preloaded")
+    def test_no_mallocs_in_steady_state(self):
+        if not self.camera.stats()['frame_pool']['array_pool']:
+            self.skipTest("the array pool is off in this build")
+        result = allocations_per_frame(self.camera, frames=1000)
+        self.assertLess(result['mallocs_per_frame'], 0.05)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,76 @@
+import unittest
+
+import numpy
+
+import ids
+
+from support import requires_fake_sdk, reset
+
+
+def reference(image, saturation, subsample=1):
+    """min, max, mean, std, saturated count and Laplacian variance in numpy"""
+    g = image[::subsample, ::subsample].astype(numpy.float64)
+    lap = 4 * g[1:-1, 1:-1] - g[1:-1, :-2] - g[1:-1, 2:] - g[:-2, 1:-1] - g[2:, 1:-1]
+    return g.min(), g.max(), g.mean(), g.std(), (g >= saturation).sum(), lap.var()
+
+
+def summary(stats):
+    return (stats['min'], stats['max'], stats['mean'], stats['std'], stats['saturated'], stats['sharpness'])
+
+
+class FrameStatsTest(unittest.TestCase):
+    def test_known_image(self):
+        image = numpy.zeros((4, 6), numpy.uint8)
+        image[1, 2] = 255
+        image[2, 3] = 10
+        stats = ids.frame_stats(image)
+        self.assertEqual(stats['count'], 24)
+        self.assertEqual((stats['min'], stats['max']), (0, 255))
+        self.assertAlmostEqual(stats['mean'], 265 / 24)
+        self.assertEqual(stats['saturated'], 1)
+        self.assertEqual(len(stats['histogram']), 256)
+        self.assertEqual(stats['histogram'][0], 22)
+        self.assertEqual(stats['histogram'][10], 1)
+        self.assertEqual(stats['histogram'][255], 1)
+        self.assertTrue(numpy.allclose(summary(stats), reference(image, 255)))
+
+    def test_twelve_bit(self):
+        image = numpy.arange(64 * 99, dtype=numpy.uint16).reshape(64, 99) % 4096
+        stats = ids.frame_stats(image, bits=12, subsample=2)
+        self.assertEqual(len(stats['histogram']), 4096)
+        self.assertEqual(stats['histogram'].sum(), stats['count'])
+        self.assertEqual(stats['count'], 32 * 50)
+        self.assertTrue(numpy.allclose(summary(stats), reference(image, 4095, 2)))
+
+    def test_rejects_float(self):
+        with self.assertRaises(TypeError):
+            ids.frame_stats(numpy.zeros((4, 4), numpy.float32))
+
+
+@requires_fake_sdk
+class AutoStatsTest(unittest.TestCase):
+    def setUp(self):
+        reset()
+        self.camera = ids.Camera()
+
+    def tearDown(self):
+        reset()
+        del self.camera
+
+    def test_stats_of_a_captured_frame(self):
+        self.camera.auto_stats = 2
+        frame = self.camera.get_image()
+        stats = frame.info['stats']
+        self.assertEqual(stats['subsample'], 2)
+        self.assertTrue(numpy.allclose(summary(stats), reference(frame.image, 255, 2)))
+        self.assertTrue(numpy.array_equal(stats['histogram'], ids.frame_stats(frame.image, subsample=2)['histogram']))
+        del frame
+
+        self.camera.auto_stats = 0
+        for i in range(10):
+            frame = self.camera.get_image()
+        self.assertNotIn('stats', frame.info)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,79 @@
+import time
+import unittest
+
+import ids
+
+from support import requires_fake_sdk, reset, sdk
+
+
+@requires_fake_sdk
+class GateTest(unittest.TestCase):
+    def setUp(self):
+        reset()
+        self.camera = ids.Camera()
+
+    def tearDown(self):
+        self.camera.gate(None)
+        reset()
+        del self.camera
+
+    def drain(self):
+        frames = []
+        while True:
+            frame = self.camera.get_image(raise_on_timeout=False)
+            if frame is None:
+                return frames
+            frames.append((frame.info['gate'], frame.info['frame_number']))
+            del frame
+
+    def test_still_scene_is_gated(self):
+        sdk.fake_set_still(1)
+        self.camera.gate(4.0, pre=3, post=2, grid=4)
+        self.camera.start_capture()
+        time.sleep(0.2)
+        self.assertIsNone(self.camera.get_image(raise_on_timeout=False))
+        stats = self.camera.stats()['gate']
+        self.assertTrue(stats['enabled'])
+        self.assertEqual(stats['frames_passed'], 0)
+        self.assertEqual(stats['events'], 0)
+        self.assertGreater(stats['frames_gated'], 0)
+
+    def test_event_roles(self):
+        sdk.fake_set_still(1)
+        self.camera.gate(4.0, pre=3, post=2, grid=4, learn=0.5)
+        # Room in the delivery queue for the whole event
+        self.camera.start_capture(buffers=48)
+        time.sleep(0.2)
+        sdk.fake_set_still(0)
+        time.sleep(0.012)
+        sdk.fake_set_still(1)
+        time.sleep(0.2)
+
+        frames = self.drain()
+        roles = [gate['role'] for gate, number in frames]
+        self.assertEqual(roles[:3], ['pre'] * 3)
+        self.assertEqual(roles[-2:], ['post'] * 2)
+        self.assertEqual(roles[3], 'trigger')
+        events = [gate['event'] for gate, number in frames]
+        self.assertEqual(events[0], 1)
+        self.assertEqual(sorted(set(events)), list(range(1, events[-1] + 1)))
+        numbers = [number for gate, number in frames]
+        self.assertEqual(numbers, list(range(numbers[0], numbers[0] + len(numbers))))
+        stats = self.camera.stats()['gate']
+        self.assertEqual(stats['events'], events[-1])
+        self.assertEqual(stats['frames_passed'], len(frames))
+
+    def test_off(self):
+        self.camera.gate(4.0)
+        self.camera.gate(None)
+        frame = self.camera.get_image()
+        self.assertNotIn('gate', frame.info)
+        self.assertFalse(self.camera.stats()['gate']['enabled'])
+
+    def test_limits(self):
+        with self.assertRaises(ValueError):
+            self.camera.gate(1.0, pre=100)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,81 @@
+import re
+import unittest
+import urllib.error
+import urllib.request
+
+import ids
+
+from support import requires_fake_sdk, reset
+
+SAMPLE = re.compile(r'^(\w+)\{([^}]*)\} (\S+)$')
+
+
+def scrape(port, path='/metrics'):
+    with urllib.request.urlopen('http://127.0.0.1:%d%s' % (port, path), timeout=5) as response:
+        return response.read().decode()
+
+
+def samples(text):
+    """Maps (name, labels) to the value of every sample of an exposition"""
+    parsed = {}
+    for line in text.splitlines():
+        match = SAMPLE.match(line)
+        if match:
+            labels = tuple(sorted(re.findall(r'(\w+)="([^"]*)"', match.group(2))))
+            parsed[(match.group(1), labels)] = float(match.group(3))
+    return parsed
+
+
+@requires_fake_sdk
+class MetricsTest(unittest.TestCase):
+    def setUp(self):
+        reset()
+        self.camera = ids.Camera()
+        self.server = ids.metrics_server(port=0)
+        self.serial = (('camera', '4102000001'),)
+
+    def tearDown(self):
+        self.server.close()
+        del self.camera
+
+    def test_counters_match_stats(self):
+        for i in range(10):
+            self.camera.get_image()
+        self.camera.stop_capture()
+        stats = self.camera.stats()
+        text = scrape(self.server.port)
+        self.assertIn('# TYPE ids_frames_captured_total counter\n', text)
+        values = samples(text)
+        self.assertEqual(values[('ids_frames_captured_total', self.serial)], stats['frames_captured'])
+        self.assertEqual(values[('ids_frames_delivered_total', self.serial)], 10)
+        self.assertEqual(values[('ids_capture_running', self.serial)], 0)
+        self.assertEqual(values[('ids_connected', self.serial)], 1)
+
+    def test_latency_histogram_is_cumulative(self):
+        for i in range(10):
+            self.camera.get_image()
+        self.camera.stop_capture()
+        values = samples(scrape(self.server.port))
+        buckets = sorted((float(dict(labels)['le']), value) for (name, labels), value in values.items()
+                         if name == 'ids_stage_latency_seconds_bucket' and dict(labels)['stage'] == 'sdk_wait')
+        counts = [value for _, value in buckets]
+        self.assertEqual(counts, sorted(counts))
+        self.assertEqual(buckets[-1][0], float('inf'))
+        count = values[('ids_stage_latency_seconds_count', self.serial + (('stage', 'sdk_wait'),))]
+        self.assertEqual(buckets[-1][1], count)
+        self.assertEqual(count, self.camera.stats()['latency']['sdk_wait']['count'])
+
+    def test_closed_camera_is_left_out(self):
+        self.assertIn('camera="4102000001"', scrape(self.server.port, '/'))
+        del self.camera
+        self.assertNotIn('camera="4102000001"', scrape(self.server.port))
+        self.camera = ids.Camera()
+
+    def test_unknown_path(self):
+        with self.assertRaises(urllib.error.HTTPError) as raised:
+            scrape(self.server.port, '/other')
+        self.assertEqual(raised.exception.code, 404)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,64 @@
+import importlib
+import os
+import sys
+import unittest
+
+import ids
+
+from support import requires_fake_sdk, reset, sdk
+
+IS_TRANSFER_ERROR = 130
+
+
+class ModuleTest(unittest.TestCase):
+    def test_types_are_immutable(self):
+        with self.assertRaises(TypeError):
+            ids.Camera.extra = 1
+        for name in ('Timelapse', 'Dump', 'TiffWriter', 'Preset', 'Preview'):
+            with self.assertRaises(TypeError):
+                getattr(ids, name)()
+
+    @requires_fake_sdk
+    def test_reimport_has_own_types_and_exceptions(self):
+        reset()
+        first = ids
+        del sys.modules['ids']
+        try:
+            second = importlib.import_module('ids')
+        finally:
+            sys.modules['ids'] = first
+        self.assertIsNot(first.Camera, second.Camera)
+        self.assertIsNot(first.IDSError, second.IDSError)
+        self.assertTrue(issubclass(second.IDSDeviceLost, second.IDSError))
+
+        # Module functions and cameras raise the exceptions of their own module
+        sdk.fake_set_missing(1)
+        try:
+            with self.assertRaises(second.IDSError) as raised:
+                second.all_cams_info()
+        finally:
+            sdk.fake_set_missing(0)
+        self.assertNotIsInstance(raised.exception, first.IDSError)
+
+        camera = second.Camera()
+        try:
+            self.assertIs(type(camera.get_image()), second.Frame)
+            camera.stop_capture()
+            sdk.fake_set_wait_error(IS_TRANSFER_ERROR)
+            camera.start_capture()
+            with self.assertRaises(second.IDSTransferError) as raised:
+                for _ in range(16):
+                    camera.get_image()
+            self.assertNotIsInstance(raised.exception, first.IDSError)
+        finally:
+            reset()
+            del camera
+
+    @unittest.skipUnless(hasattr(sys, '_is_gil_enabled'), "needs the free-threaded build")
+    @unittest.skipIf('PYTHON_GIL' in os.environ, "the GIL was forced by PYTHON_GIL")
+    def test_import_keeps_the_gil_off(self):
+        self.assertFalse(sys._is_gil_enabled())
+
+
+if __name__ == '__main__':
+    unittest.main()
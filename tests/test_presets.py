@@ -0,0 +1,49 @@
+import ctypes
+import unittest
+
+import ids
+
+from support import requires_fake_sdk, reset, sdk
+
+
+@requires_fake_sdk
+class PresetTest(unittest.TestCase):
+    def setUp(self):
+        reset()
+        # The simulated sensor holds the frame rate and exposure to what the pixel clock allows
+        ctypes.c_int.in_dll(sdk, 'fake_clamp').value = 1
+        self.camera = ids.Camera()
+
+    def tearDown(self):
+        reset()
+        del self.camera
+
+    def test_apply_restores_clamped_settings(self):
+        self.camera.pixel_clock = 30
+        self.camera.frame_rate = 50.0
+        self.camera.exposure = 15.0
+        preset = self.camera.snapshot()
+
+        # Lowering the pixel clock pulls the frame rate down with it
+        self.camera.pixel_clock = 3
+        self.assertEqual(self.camera.frame_rate, 30.0)
+        self.camera.apply(preset)
+        self.assertEqual((self.camera.pixel_clock, self.camera.frame_rate, self.camera.exposure), (30, 50.0, 15.0))
+
+        # An exposure longer than the frame period is cut short by the sensor
+        self.camera.frame_rate = 100.0
+        self.camera.exposure = 50.0
+        self.assertEqual(self.camera.exposure, 10.0)
+        self.camera.apply(preset)
+        self.assertEqual((self.camera.frame_rate, self.camera.exposure), (50.0, 15.0))
+
+        # Back at the preset's frame rate the exposure stays cut short, apply must notice
+        self.camera.frame_rate = 100.0
+        self.camera.frame_rate = 50.0
+        self.assertEqual(self.camera.exposure, 10.0)
+        self.camera.apply(preset)
+        self.assertEqual(self.camera.exposure, 15.0)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,101 @@
+import ctypes
+import time
+import unittest
+
+import ids
+
+from support import counter, requires_fake_sdk, reset, sdk
+
+# Longer than one reconnect poll of the capture thread
+RECONNECT_WAIT = 1.0
+
+
+@requires_fake_sdk
+class ReconnectTest(unittest.TestCase):
+    def setUp(self):
+        reset()
+        self.camera = ids.Camera()
+
+    def tearDown(self):
+        reset()
+        del self.camera
+
+    def test_unplug_and_replug(self):
+        self.camera.exposure = 12.5
+        self.camera.master_gain = 40
+        held, _ = self.camera.get_image()
+
+        sdk.fake_set_missing(1)
+        sdk.fake_set_wait_error(-1)
+        time.sleep(0.5)
+        self.assertFalse(self.camera.stats()['connection']['connected'])
+        # Frames queued before the outage are still handed out first
+        with self.assertRaises(ids.IDSDeviceLost):
+            for _ in range(16):
+                self.camera.get_image()
+
+        sdk.fake_set_missing(0)
+        sdk.fake_set_wait_error(0)
+        time.sleep(RECONNECT_WAIT)
+        image, _ = self.camera.get_image()
+        connection = self.camera.stats()['connection']
+        self.assertTrue(connection['connected'])
+        self.assertEqual(connection['reconnects'], 1)
+        self.assertEqual(image.shape, (480, 640))
+        # Restored from the settings cache, the device came back at its defaults
+        self.assertEqual(self.camera.exposure, 12.5)
+        self.assertEqual(self.camera.master_gain, 40)
+        # The buffer outlived the handle it was captured with
+        self.assertGreater(int(held.sum()), 0)
+
+    def test_lost_handle_is_closed_before_reopening(self):
+        """The device stays plugged in, so reopening only works once the stale handle is closed"""
+        self.camera.get_image()
+        inits = counter('fake_inits')
+        exits = counter('fake_exit_calls')
+
+        self.camera._simulate_disconnect()
+        time.sleep(RECONNECT_WAIT)
+        self.camera.get_image()
+        self.assertEqual(self.camera.stats()['connection']['reconnects'], 1)
+        self.assertEqual(counter('fake_inits'), inits + 1)
+        self.assertEqual(counter('fake_exit_calls'), exits + 1)
+
+    def wait_connected(self, timeout):
+        deadline = time.monotonic() + timeout
+        while not self.camera.stats()['connection']['connected']:
+            if time.monotonic() > deadline:
+                self.fail("the camera did not reconnect")
+            time.sleep(0.01)
+
+    def unplug_and_replug(self):
+        self.camera.get_image()
+        sdk.fake_set_missing(1)
+        sdk.fake_set_wait_error(-1)
+        time.sleep(0.5)
+        self.assertFalse(self.camera.stats()['connection']['connected'])
+        sdk.fake_set_wait_error(0)
+        sdk.fake_set_missing(0)
+
+    def test_arrival_event_wakes_the_reconnect(self):
+        arrivals = counter('fake_arrivals')
+        self.unplug_and_replug()
+        # Well before the fallback poll, so the arrival event must have woken it
+        self.wait_connected(1.0)
+        self.assertEqual(counter('fake_arrivals'), arrivals + 1)
+
+    def test_polls_without_the_arrival_event(self):
+        ctypes.c_int.in_dll(sdk, 'fake_no_arrival_event').value = 1
+        arrivals = counter('fake_arrivals')
+        self.unplug_and_replug()
+        self.wait_connected(RECONNECT_WAIT)
+        self.assertEqual(counter('fake_arrivals'), arrivals)
+
+    def test_simulate_disconnect_needs_capture(self):
+        self.camera.stop_capture()
+        with self.assertRaises(RuntimeError):
+            self.camera._simulate_disconnect()
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,70 @@
+import os
+import shutil
+import tempfile
+import time
+import unittest
+
+import ids
+
+from support import requires_fake_sdk, reset
+
+
+@requires_fake_sdk
+class RecorderTest(unittest.TestCase):
+    def setUp(self):
+        reset()
+        self.directory = tempfile.mkdtemp()
+        self.camera = ids.Camera()
+        self.camera.record(seconds=2.0)
+
+    def tearDown(self):
+        self.camera.record()
+        del self.camera
+        shutil.rmtree(self.directory)
+
+    def path(self, name):
+        return os.path.join(self.directory, name)
+
+    def test_dump_is_contiguous_and_matches_the_pixels(self):
+        time.sleep(1.0)
+        dump = self.camera.dump(self.path('window.idsd'), pre=0.5, post=0.5)
+        self.assertTrue(dump.wait(5.0))
+        frames = ids.read_dump(dump.path)
+        numbers = [info['frame_number'] for _, info in frames]
+        self.assertGreater(len(frames), 1)
+        self.assertEqual(numbers, list(range(numbers[0], numbers[0] + len(numbers))))
+        # The simulated sensor writes (x + y + frame number) mod 256
+        image, info = frames[len(frames) // 2]
+        self.assertEqual(image[0, 1], (1 + info['frame_number']) % 256)
+        self.assertEqual(image[3, 10], (13 + info['frame_number']) % 256)
+        self.assertEqual(self.camera.stats()['recorder']['frames_overrun'], 0)
+
+    def test_concurrent_dumps(self):
+        time.sleep(0.3)
+        dumps = [self.camera.dump(self.path('%d.idsd' % i), pre=10, post=0.1) for i in range(4)]
+        with self.assertRaises(RuntimeError):
+            self.camera.dump(self.path('fifth.idsd'))
+        for dump in dumps:
+            self.assertTrue(dump.wait(5.0))
+            self.assertGreater(len(ids.read_dump(dump.path)), 0)
+
+    def test_stopping_the_recorder_finishes_a_dump(self):
+        dump = self.camera.dump(self.path('stopped.idsd'), pre=0.1, post=10)
+        time.sleep(0.2)
+        self.camera.record()
+        self.assertTrue(dump.wait(3.0))
+        self.assertGreater(len(ids.read_dump(dump.path)), 0)
+        with self.assertRaises(RuntimeError):
+            self.camera.dump(self.path('idle.idsd'))
+
+    def test_errors(self):
+        with self.assertRaises(IOError):
+            self.camera.dump(os.path.join(self.directory, 'missing', 'x.idsd'))
+        with self.assertRaises(ValueError):
+            self.camera.record(frames=1)
+        self.camera.record(gigabytes=0.05, huge_pages=False)
+        self.assertGreater(self.camera.stats()['recorder']['capacity'], 1)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,83 @@
+import time
+import unittest
+
+import ids
+
+from support import requires_fake_sdk, reset, sdk
+
+
+def bucket(histogram, upper_us):
+    """Count of the histogram bucket whose upper bound is upper_us"""
+    return dict(histogram['buckets_us']).get(upper_us, 0)
+
+
+@requires_fake_sdk
+class StatsTest(unittest.TestCase):
+    def setUp(self):
+        reset()
+        self.camera = ids.Camera()
+        self.camera.start_capture(buffers=16)
+
+    def tearDown(self):
+        reset()
+        del self.camera
+
+    def test_counters(self):
+        frames = [self.camera.get_image() for i in range(10)]
+        stats = self.camera.stats()
+        self.assertEqual(stats['frames_delivered'], 10)
+        self.assertGreaterEqual(stats['frames_captured'], 10)
+        self.assertEqual(stats['frames_released'], 0)
+        self.assertGreaterEqual(stats['locked_buffers'], 1)
+        del frames
+        stats = self.camera.stats()
+        self.assertEqual(stats['frames_released'], 10)
+        self.assertEqual(stats['latency']['delivery_to_release']['count'], 10)
+
+        sdk.fake_fail_next()
+        time.sleep(0.1)
+        for i in range(3):
+            self.camera.get_image()
+        self.assertEqual(self.camera.stats()['wait_errors'], 1)
+
+    def test_reset_keeps_the_locked_buffer_level(self):
+        for i in range(5):
+            self.camera.get_image()
+        held = self.camera.get_image()
+        self.camera.reset_stats()
+        stats = self.camera.stats()
+        self.assertEqual(stats['frames_delivered'], 0)
+        self.assertEqual(stats['frames_released'], 0)
+        self.assertEqual(stats['latency']['sdk_wait']['count'], 0)
+        self.assertEqual(stats['latency']['sdk_wait']['buckets_us'], [])
+        self.assertEqual(stats['locked_buffers'], 1)
+        self.assertEqual(stats['queue_high_water']['locked_buffers'], 1)
+        del held
+        self.camera.get_image()
+        stats = self.camera.stats()
+        self.assertEqual(stats['frames_delivered'], 1)
+        self.assertEqual(stats['frames_released'], 2)
+
+    def test_histogram_buckets(self):
+        self.camera.get_image()
+        self.camera.reset_stats()
+        # Held for 40 to 50 ms, between 2**15 and 2**16 microseconds
+        frame = self.camera.get_image()
+        time.sleep(0.04)
+        del frame
+        histogram = self.camera.stats()['latency']['delivery_to_release']
+        self.assertEqual(histogram['count'], 1)
+        self.assertEqual(bucket(histogram, 65536), 1)
+        self.assertGreaterEqual(histogram['max_us'], 40000)
+
+        # At 100 fps the capture thread waits close to 10 ms for every frame
+        self.camera.frame_rate = 100.0
+        self.camera.reset_stats()
+        for i in range(10):
+            self.camera.get_image()
+        histogram = self.camera.stats()['latency']['sdk_wait']
+        self.assertGreaterEqual(bucket(histogram, 16384), histogram['count'] // 2)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,83 @@
+import socket
+import struct
+import threading
+import time
+import unittest
+
+import ids
+
+from support import requires_fake_sdk, reset
+
+
+@requires_fake_sdk
+class StreamTest(unittest.TestCase):
+    def setUp(self):
+        reset()
+        self.camera = ids.Camera()
+
+    def tearDown(self):
+        del self.camera
+
+    def test_roi_is_clipped_to_the_frame(self):
+        server = self.camera.stream()
+        # x + width overflows an int
+        client = ids.StreamClient(port=server.port, roi=(600, 400, 2**31 - 100, 2**31 - 100))
+        image, info = client.get_frame(timeout=5.0)
+        self.assertEqual(image.shape, (80, 40))
+        client.close()
+        server.close()
+
+    def test_failed_stream_leaves_capture_stopped(self):
+        self.camera.stop_capture()
+        with self.assertRaises(ValueError):
+            self.camera.stream(host="not an address")
+        self.assertIsNone(self.camera.stats()['buffers'])
+
+    def test_stalled_clients_leave_buffers_for_capture(self):
+        self.camera.frame_rate = 200.0
+        server = self.camera.stream()
+        # None of these clients reads, and each asks for more buffers than the ring has
+        clients = [ids.StreamClient(port=server.port, max_pending=16) for i in range(3)]
+        time.sleep(0.5)
+        buffers = self.camera.stats()['buffers']['count']
+        self.assertEqual([client['max_pending'] for client in server.stats()], [buffers // 2] * 3)
+        self.assertLess(self.camera.stats()['locked_buffers'], buffers)
+        for i in range(20):
+            self.camera.get_image()
+        for client in clients:
+            client.close()
+        server.close()
+
+    def test_malformed_header_drops_the_connection(self):
+        listener = socket.socket()
+        listener.bind(('127.0.0.1', 0))
+        listener.listen(1)
+
+        def serve():
+            peer, _ = listener.accept()
+            peer.recv(32)
+            # A 2x2 frame that claims a 4 MiB payload
+            peer.sendall(struct.pack('<IIQQQIIIIII', 0x46534449, 56, 0, 0, 0, 2, 2, 1, 6, 4 << 20, 0))
+            peer.sendall(b'\0' * 65536)
+            peer.close()
+
+        server = threading.Thread(target=serve)
+        server.start()
+        client = ids.StreamClient(port=listener.getsockname()[1])
+        with self.assertRaises(IOError):
+            client.get_frame(timeout=5.0)
+        with self.assertRaises(IOError):
+            client.get_frame(timeout=5.0)
+        server.join()
+        listener.close()
+
+    def test_benchmark(self):
+        full, roi = ids.stream_benchmark(width=64, height=32, frames=10)
+        self.assertEqual(full['roi'], (0, 0, 64, 32))
+        self.assertEqual(roi['roi'], (16, 8, 32, 16))
+        self.assertGreater(full['fps'], 0.0)
+        self.assertGreater(roi['megabytes_per_s'], 0.0)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,127 @@
+import json
+import os
+import shutil
+import tempfile
+import time
+import unittest
+
+import numpy as np
+
+import ids
+
+from support import requires_fake_sdk, reset, sdk
+
+try:
+    import tifffile
+except ImportError:
+    tifffile = None
+
+
+def sensor_pattern(height, width, frame_number):
+    """Bytes the simulated sensor writes, (x + y + frame number) mod 256"""
+    return ((np.arange(width)[None, :] + np.arange(height)[:, None] + frame_number) & 255).astype(np.uint8)
+
+
+@requires_fake_sdk
+class TiffTest(unittest.TestCase):
+    def setUp(self):
+        reset()
+        self.directory = tempfile.mkdtemp()
+        self.camera = ids.Camera()
+        self.camera.frame_rate = 500.0
+
+    def tearDown(self):
+        self.camera.stop_capture()
+        del self.camera
+        shutil.rmtree(self.directory)
+
+    def path(self, name):
+        return os.path.join(self.directory, name)
+
+    def set_color_mode(self, mode):
+        # The simulated SDK takes the mode directly, apply() then reallocates the buffers for it
+        base = self.camera.snapshot()
+        sdk.is_SetColorMode(sdk.fake_handle(), mode)
+        preset = self.camera.snapshot()
+        sdk.is_SetColorMode(sdk.fake_handle(), 6)
+        self.camera.apply(base)
+        self.camera.apply(preset)
+
+    def test_mono8_pages(self):
+        writer = self.camera.record_tiff(self.path('mono8.tif'), frames=40)
+        self.assertTrue(writer.wait(10))
+        pages = ids.read_tiff(self.path('mono8.tif'))
+        self.assertEqual(len(pages), 40)
+        image, info = pages[3]
+        self.assertFalse(image.flags.writeable)
+        expected = sensor_pattern(image.shape[0], image.shape[1], info['frame_number'])
+        # The first pixel carries the frame counter
+        self.assertTrue(np.array_equal(image.ravel()[1:], expected.ravel()[1:]))
+        if tifffile is not None:
+            with tifffile.TiffFile(self.path('mono8.tif')) as tiff:
+                self.assertTrue(tiff.is_bigtiff)
+                self.assertEqual(len(tiff.pages), 40)
+                self.assertTrue(np.array_equal(tiff.asarray()[3], image))
+                self.assertEqual(json.loads(tiff.pages[5].description)['frame_number'], pages[5][1]['frame_number'])
+
+    def test_stop_and_drop(self):
+        writer = self.camera.record_tiff(self.path('stopped.tif'))
+        time.sleep(0.3)
+        writer.stop()
+        self.assertTrue(writer.done)
+        written = writer.stats()['frames_written']
+        self.assertEqual(len(ids.read_tiff(self.path('stopped.tif'))), written)
+        if tifffile is not None:
+            with tifffile.TiffFile(self.path('stopped.tif')) as tiff:
+                self.assertEqual(len(tiff.pages), written)
+        writer = self.camera.record_tiff(self.path('dropped.tif'))
+        time.sleep(0.1)
+        del writer
+        self.assertGreater(len(ids.read_tiff(self.path('dropped.tif'))), 0)
+
+    def test_split(self):
+        writer = self.camera.record_tiff(self.path('split.tif'), frames=25, split_gigabytes=0.0031, direct=False)
+        self.assertTrue(writer.wait(10))
+        self.assertGreater(len(writer.paths), 1)
+        sequences = []
+        for path in writer.paths:
+            sequences += [info['sequence'] for _, info in ids.read_tiff(path)]
+        self.assertEqual(sequences, list(range(sequences[0], sequences[0] + 25)))
+
+    def test_color_modes(self):
+        try:
+            for mode, channels in ((129, 3), (1, 3), (0, 4), (26, 2)):
+                self.set_color_mode(mode)
+                path = self.path('%d.tif' % mode)
+                self.assertTrue(self.camera.record_tiff(path, frames=5).wait(10))
+                image, info = ids.read_tiff(path)[2]
+                height, width = image.shape[:2]
+                raw = sensor_pattern(height, width * channels, info['frame_number'])
+                if mode == 26:
+                    expected = raw.view('<u2')
+                else:
+                    raw = raw.reshape(height, width, channels)
+                    # BGR is stored as RGB and the padding byte of 32-bit modes is dropped
+                    expected = raw[..., 2::-1] if mode in (1, 0) else raw
+                self.assertTrue(np.array_equal(image[1:], expected[1:]), mode)
+                if tifffile is not None:
+                    with tifffile.TiffFile(path) as tiff:
+                        self.assertTrue(np.array_equal(tiff.pages[2].asarray(), image))
+        finally:
+            self.set_color_mode(6)
+
+    def test_errors(self):
+        with self.assertRaises(IOError):
+            self.camera.record_tiff(os.path.join(self.directory, 'missing', 'x.tif'))
+        with self.assertRaises(ValueError):
+            self.camera.record_tiff(self.path('x.tif'), frames=0)
+        with self.assertRaises(ValueError):
+            self.camera.record_tiff(self.path('x.tif'), split_gigabytes=1e-7)
+        with open(self.path('bad.tif'), 'wb') as f:
+            f.write(b'hello world')
+        with self.assertRaises(ValueError):
+            ids.read_tiff(self.path('bad.tif'))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,64 @@
+import threading
+import time
+import unittest
+
+import ids
+
+from support import requires_fake_sdk, reset
+
+
+@requires_fake_sdk
+class TimelapseTest(unittest.TestCase):
+    def setUp(self):
+        reset()
+        self.camera = ids.Camera()
+        self.camera.frame_rate = 200.0
+
+    def tearDown(self):
+        del self.camera
+
+    def timelapse_frames(self, count, timeout=5.0):
+        indices = []
+        start = time.monotonic()
+        while len(indices) < count and time.monotonic() - start < timeout:
+            frame = self.camera.get_image(raise_on_timeout=False)
+            if frame is not None and 'timelapse' in frame.info:
+                indices.append(frame.info['timelapse']['index'])
+        return indices
+
+    def test_dropped_schedule_keeps_running(self):
+        timelapse = self.camera.timelapse(0.02, count=10)
+        del timelapse
+        self.assertEqual(self.timelapse_frames(10), list(range(10)))
+
+    def test_camera_stops_dropped_schedule(self):
+        self.camera.timelapse(0.02)
+        time.sleep(0.1)
+        with self.assertRaises(RuntimeError):
+            self.camera.timelapse(0.02)
+        self.assertIsNone(self.camera.timelapse(None))
+        timelapse = self.camera.timelapse(0.02, count=2)
+        self.assertTrue(timelapse.wait(timeout=5))
+
+    def test_camera_dropped_while_running(self):
+        self.camera.timelapse(0.01)
+        time.sleep(0.1)
+        del self.camera
+        self.camera = ids.Camera()
+        timelapse = self.camera.timelapse(0.02, count=2)
+        self.assertTrue(timelapse.wait(timeout=5))
+
+    def test_wait_wakes_on_stop(self):
+        timelapse = self.camera.timelapse(100.0, count=3)
+        self.assertFalse(timelapse.wait(timeout=0.05))
+        stopper = threading.Timer(0.1, timelapse.stop)
+        stopper.start()
+        start = time.monotonic()
+        self.assertTrue(timelapse.wait())
+        self.assertLess(time.monotonic() - start, 1.0)
+        stopper.join()
+        self.assertTrue(timelapse.done)
+
+
+if __name__ == '__main__':
+    unittest.main()
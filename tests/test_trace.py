@@ -0,0 +1,70 @@
+import json
+import os
+import tempfile
+import threading
+import unittest
+
+import ids
+
+from support import requires_fake_sdk, reset
+
+
+@requires_fake_sdk
+class TraceTest(unittest.TestCase):
+    def setUp(self):
+        reset()
+        self.camera = ids.Camera()
+        self.camera.frame_rate = 500.0
+        self.camera.start_capture(buffers=16)
+
+    def tearDown(self):
+        ids.trace_stop()
+        self.camera.stop_capture()
+        del self.camera
+
+    def grab(self, count):
+        for i in range(count):
+            image, info = self.camera.get_image()
+            del image
+
+    def test_stages_are_recorded(self):
+        self.grab(20)
+        ids.trace_start()
+        self.grab(100)
+        ids.trace_stop()
+        trace = json.loads(ids.trace_dump())
+        names = set(event['name'] for event in trace['traceEvents'] if event['ph'] == 'X')
+        for stage in ('sdk_wait', 'image_info', 'sinks', 'deliver', 'queue_wait', 'metadata', 'wrap', 'get_image', 'unlock'):
+            self.assertIn(stage, names)
+        with tempfile.TemporaryDirectory() as directory:
+            path = os.path.join(directory, 'trace.json')
+            count = ids.trace_dump(path)
+            with open(path) as f:
+                events = json.load(f)['traceEvents']
+            # Thread names come on top as metadata events
+            self.assertEqual(len([event for event in events if event['ph'] == 'X']), count)
+
+    def test_full_buffers_count_drops(self):
+        ids.trace_start(events_per_thread=10)
+        self.grab(20)
+        stats = ids.trace_stop()
+        self.assertGreater(stats['dropped'], 0)
+        with self.assertRaises(ValueError):
+            ids.trace_start(0)
+
+    def test_exited_threads_keep_their_events(self):
+        ids.trace_start()
+        worker = threading.Thread(target=self.grab, args=(20,))
+        worker.start()
+        worker.join()
+        trace = json.loads(ids.trace_dump())
+        waits = [event for event in trace['traceEvents'] if event['name'] == 'get_image']
+        self.assertGreaterEqual(len(waits), 20)
+        ids.trace_stop()
+        # A restart frees the buffers of threads that have gone
+        ids.trace_start()
+        ids.trace_stop()
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,43 @@
+import threading
+import unittest
+
+import ids
+
+from support import requires_fake_sdk, reset
+
+CAMERA_MATRIX = [[800.0, 0.0, 320.0], [0.0, 800.0, 240.0], [0.0, 0.0, 1.0]]
+DIST_COEFFS = [-0.2, 0.05, 0.0, 0.0]
+
+
+@requires_fake_sdk
+class UndistortTest(unittest.TestCase):
+    def setUp(self):
+        reset()
+        self.camera = ids.Camera()
+
+    def tearDown(self):
+        del self.camera
+
+    def test_toggle_while_reading(self):
+        """Turning undistortion off while frames are converted must not free it under them"""
+        done = threading.Event()
+
+        def toggle():
+            while not done.is_set():
+                self.camera.set_undistort(CAMERA_MATRIX, DIST_COEFFS, threads=2)
+                self.camera.stats()
+                self.camera.set_undistort(None)
+
+        thread = threading.Thread(target=toggle)
+        thread.start()
+        try:
+            for _ in range(200):
+                image, _ = self.camera.get_image()
+                self.assertEqual(image.shape, (480, 640))
+        finally:
+            done.set()
+            thread.join()
+
+
+if __name__ == '__main__':
+    unittest.main()